@@ -0,0 +1,51 @@
+
+"""
+Test that a dirfrag larger than the MDS cache is fetched in one pass
+when it is read from the metadata pool in several chunks.
+"""
+
+import logging
+
+from tasks.cephfs.cephfs_test_case import CephFSTestCase
+
+log = logging.getLogger(__name__)
+
+
+class TestDirfragFetch(CephFSTestCase):
+    CLIENTS_REQUIRED = 1
+    MDSS_REQUIRED = 1
+
+    def get_dir_fetches(self):
+        return self.fs.mds_asok(['perf', 'dump', 'mds'])['mds']['dir_fetch']
+
+    def test_fetch_larger_than_cache(self):
+        """
+        That dentries loaded from earlier chunks of a fetch are not trimmed
+        before the last chunk arrives, so the dirfrag is marked complete
+        instead of being fetched over and over again.
+        """
+        file_count = 1000
+        self.mount_a.create_n_files("bigdir/file", file_count)
+
+        # drop caps, and write everything back to the dirfrag object so
+        # nothing is replayed into the cache on restart
+        self.mount_a.umount_wait()
+        self.fs.mds_asok(['flush', 'journal'])
+
+        # A cache much smaller than the directory, and many chunks per fetch
+        self.set_conf("mds", "mds_cache_size", "100")
+        self.set_conf("mds", "mds_dir_keys_per_op", "16")
+        self.fs.mds_stop()
+        self.fs.mds_fail_restart()
+        self.fs.wait_for_daemons()
+
+        self.mount_a.mount()
+        self.mount_a.wait_until_mounted()
+
+        initial_fetches = self.get_dir_fetches()
+        self.assertEqual(len(self.mount_a.ls("bigdir")), file_count)
+
+        fetches = self.get_dir_fetches() - initial_fetches
+        log.info("listing took {0} dirfrag fetches".format(fetches))
+        self.assertLess(fetches, 5)
+
@@ -0,0 +1,94 @@
+
+"""
+Test that the MDS journals events from many requests with a single
+flush, and holds a flush back while events are streaming in.
+"""
+
+from textwrap import dedent
+import logging
+
+from tasks.cephfs.cephfs_test_case import CephFSTestCase
+
+log = logging.getLogger(__name__)
+
+
+class TestJournalGroupCommit(CephFSTestCase):
+    CLIENTS_REQUIRED = 2
+    MDSS_REQUIRED = 1
+
+    def _mdlog_perf(self):
+        return self.fs.mds_asok(['perf', 'dump', 'mds_log'])['mds_log']
+
+    def _jlat_histogram_total(self):
+        hist = self.fs.mds_asok(['perf', 'histogram', 'dump', 'mds_log',
+                                 'jlat_histogram'])
+        values = hist['mds_log']['jlat_histogram']['values']
+        return sum(sum(row) for row in values)
+
+    def test_batching(self):
+        """
+        That events submitted between flushes are written out together,
+        and that a flush issued directly by MDLog::flush is accounted like
+        one issued by the submit thread.
+        """
+        # Nothing may hold a flush back, so that every flush we see is
+        # one the MDS asked for
+        self.fs.mds_asok(['config', 'set',
+                          'mds_log_group_commit_max_delay', '0'])
+
+        before = self._mdlog_perf()['flush']
+        hist_before = self._jlat_histogram_total()
+
+        # Creates get an early reply, so their events are only flushed by
+        # the tick or by the explicit flush below
+        file_count = 200
+        self.mount_a.create_n_files("batch/file", file_count)
+
+        flush_data = self.fs.mds_asok(['flush', 'journal'])
+        self.assertEqual(flush_data['return_code'], 0)
+
+        after = self._mdlog_perf()['flush']
+        flushes = after['avgcount'] - before['avgcount']
+        events = after['sum'] - before['sum']
+        log.info("{0} events in {1} flushes".format(events, flushes))
+        self.assertGreaterEqual(events, file_count)
+        self.assertGreater(flushes, 0)
+        self.assertGreater(events, flushes)
+
+        # The histogram is filled in once the flushed events are safe,
+        # which 'flush journal' waits for
+        self.wait_until_true(
+            lambda: self._jlat_histogram_total() > hist_before, timeout=30)
+
+    def test_delayed_flush(self):
+        """
+        That a flush requested while other clients' events are streaming
+        in is held back, and that the held back flush still completes.
+        """
+        self.fs.mds_asok(['config', 'set',
+                          'mds_log_group_commit_max_delay', '0.05'])
+        initial_delayed = self._mdlog_perf()['flush_delayed']
+
+        # A steady stream of creates from one client...
+        stream = self.mount_b._run_python(dedent("""
+            import os
+            d = os.path.join("{path}", "stream")
+            os.mkdir(d)
+            i = 0
+            while True:
+                open(os.path.join(d, "f%d" % i), "w").close()
+                i += 1
+            """).format(path=self.mount_b.mountpoint))
+        self.mount_b.background_procs.append(stream)
+
+        # ...while the other one asks for its creates to be made durable
+        self.mount_a.create_n_files("sync/file", 50, sync=True)
+
+        self.wait_until_true(
+            lambda: self._mdlog_perf()['flush_delayed'] > initial_delayed,
+            timeout=60)
+
+        self.mount_b.kill_background(stream)
+
+        flush_data = self.fs.mds_asok(['flush', 'journal'])
+        self.assertEqual(flush_data['return_code'], 0)
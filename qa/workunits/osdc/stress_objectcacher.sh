@@ -25,4 +25,13 @@ done
 
 ceph_test_objectcacher_stress --correctness-test > /dev/null 2>&1
 
+# adaptive (ARC) replacement of clean buffers
+for READS in 0.90 0.50
+do
+    ceph_test_objectcacher_stress --ops 10000 --percent-read $READS --objects 100 --max-op-size 131072 --client-oc-size 8388608 --client-oc-adaptive --stress-test > /dev/null 2>&1
+done
+ceph_test_objectcacher_stress --correctness-test --client-oc-adaptive > /dev/null 2>&1
+ceph_test_objectcacher_stress --arc-scan-test > /dev/null 2>&1
+ceph_test_objectcacher_stress --arc-bench --ops 20000 --delay-ns 100000
+
 echo OK
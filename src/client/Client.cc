@@ -291,6 +291,7 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
 				  cct->_conf->client_oc_target_dirty,
 				  cct->_conf->client_oc_max_dirty_age,
 				  true));
+  objectcacher->set_adaptive(cct->_conf->client_oc_adaptive);
   objecter_finisher.start();
   filer.reset(new Filer(objecter, &objecter_finisher));
   objecter->enable_blacklist_events();
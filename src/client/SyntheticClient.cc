@@ -142,6 +142,12 @@ void parse_syn_options(vector<const char*>& args)
         syn_iargs.push_back( atoi(args[++i]) );
         syn_iargs.push_back( atoi(args[++i]) );
         syn_iargs.push_back( atoi(args[++i]) );
+      } else if (strcmp(args[i],"mdsreadbench") == 0) {
+        syn_modes.push_back( SYNCLIENT_MODE_MDSREADBENCH );
+        syn_iargs.push_back( atoi(args[++i]) );
+        syn_iargs.push_back( atoi(args[++i]) );
+        syn_iargs.push_back( atoi(args[++i]) );
+        syn_iargs.push_back( atoi(args[++i]) );
       } else if (strcmp(args[i],"makefiles") == 0) {
         syn_modes.push_back( SYNCLIENT_MODE_MAKEFILES );
         syn_iargs.push_back( atoi(args[++i]) );
@@ -525,6 +531,21 @@ int SyntheticClient::run()
 	did_run_me();
       }
       break;
+    case SYNCLIENT_MODE_MDSREADBENCH:
+      {
+        string sarg1 = get_sarg(0);
+        int iarg1 = iargs.front();  iargs.pop_front();
+        int iarg2 = iargs.front();  iargs.pop_front();
+        int iarg3 = iargs.front();  iargs.pop_front();
+        int iarg4 = iargs.front();  iargs.pop_front();
+        if (run_me()) {
+          dout(2) << "mdsreadbench " << sarg1 << " " << iarg1 << " " << iarg2
+		  << " " << iarg3 << " " << iarg4 << dendl;
+          mds_read_bench(sarg1.c_str(), iarg1, iarg2, iarg3, iarg4);
+        }
+	did_run_me();
+      }
+      break;
 
 
     case SYNCLIENT_MODE_THRASHLINKS:
@@ -1833,6 +1854,41 @@ int SyntheticClient::read_dirs(const char *basedir, int dirs, int files, int dep
   return 0;
 }
 
+/*
+ * Walk a tree laid out by makedirs with the same readdir + lstat pattern
+ * as readdirs, dropping our cache before every pass so that each lookup,
+ * getattr and readdir is served by the MDS.  Run from many clients at
+ * once to load an MDS with read-only metadata ops.
+ */
+int SyntheticClient::mds_read_bench(const char *basedir, int dirs, int files,
+				    int depth, int iterations)
+{
+  // one readdir plus an lstat per file in every directory of the tree
+  uint64_t ndirs = 0;
+  for (uint64_t level = 1, d = 0; d <= (uint64_t)depth; ++d, level *= dirs)
+    ndirs += level;
+  uint64_t ops_per_pass = ndirs * (1 + files);
+
+  uint64_t ops = 0;
+  utime_t elapsed;
+  for (int i = 0; i < iterations && !time_to_stop(); ++i) {
+    client->drop_caches();
+    utime_t start = ceph_clock_now();
+    if (read_dirs(basedir, dirs, files, depth) < 0)
+      return -1;
+    utime_t lat = ceph_clock_now() - start;
+    elapsed += lat;
+    ops += ops_per_pass;
+    dout(1) << "mds_read_bench pass " << i << " " << ops_per_pass
+	    << " ops in " << lat << dendl;
+  }
+
+  if (ops) {
+    dout(0) << "mds_read_bench " << ops << " ops in " << elapsed << " = "
+	    << (uint64_t)(ops / (double)elapsed) << " ops/s" << dendl;
+  }
+  return 0;
+}
 
 int SyntheticClient::make_files(int num, int count, int priv, bool more)
 {
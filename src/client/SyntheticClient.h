@@ -38,6 +38,7 @@
 #define SYNCLIENT_MODE_MAKEFILES2   12     // num count private
 #define SYNCLIENT_MODE_CREATESHARED 13     // num
 #define SYNCLIENT_MODE_OPENSHARED   14     // num count
+#define SYNCLIENT_MODE_MDSREADBENCH 15     // dirs files depth iterations
 
 #define SYNCLIENT_MODE_RMFILE      19
 #define SYNCLIENT_MODE_WRITEFILE   20
@@ -231,6 +232,8 @@ class SyntheticClient {
   int make_dirs(const char *basedir, int dirs, int files, int depth);
   int stat_dirs(const char *basedir, int dirs, int files, int depth);
   int read_dirs(const char *basedir, int dirs, int files, int depth);
+  int mds_read_bench(const char *basedir, int dirs, int files, int depth,
+		     int iterations);
   int make_files(int num, int count, int priv, bool more);
   int link_test();
 
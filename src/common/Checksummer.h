@@ -67,6 +67,45 @@ public:
     }
   }
 
+  /// how many csum blocks calculate/verify hand to an Alg at a time
+  static const size_t batch_blocks = 16;
+
+  /// crc32c of the next n (<= batch_blocks) blocks of p; blocks that sit
+  /// entirely inside one bufferptr (the usual case) go through
+  /// ceph_crc32c_multi together
+  static void crc32c_blocks(
+    uint32_t init_value,
+    size_t len,
+    size_t n,
+    bufferlist::const_iterator& p,
+    uint32_t *out
+    ) {
+    unsigned char const *data[batch_blocks];
+    unsigned lens[batch_blocks];
+    uint32_t crcs[batch_blocks];
+    size_t idx[batch_blocks];
+    size_t k = 0;
+    assert(n <= batch_blocks);
+    for (size_t i = 0; i < n; ++i) {
+      const char *d;
+      size_t l = p.get_ptr_and_advance(len, &d);
+      if (l == len) {
+	data[k] = (unsigned char const *)d;
+	lens[k] = len;
+	crcs[k] = init_value;
+	idx[k] = i;
+	++k;
+      } else {
+	// straddles a bufferptr boundary
+	out[i] = ceph_crc32c(init_value, (unsigned char const *)d, l);
+	out[i] = p.crc32c(len - l, out[i]);
+      }
+    }
+    ceph_crc32c_multi(crcs, data, lens, k);
+    for (size_t j = 0; j < k; ++j)
+      out[idx[j]] = crcs[j];
+  }
+
   struct crc32c {
     typedef uint32_t init_value_t;
     typedef __le32 value_t;
@@ -86,6 +125,19 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      bufferlist::const_iterator& p,
+      value_t *out
+      ) {
+      uint32_t crcs[batch_blocks];
+      crc32c_blocks(init_value, len, n, p, crcs);
+      for (size_t i = 0; i < n; ++i)
+	out[i] = crcs[i];
+    }
   };
 
   struct crc32c_16 {
@@ -107,6 +159,19 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      bufferlist::const_iterator& p,
+      value_t *out
+      ) {
+      uint32_t crcs[batch_blocks];
+      crc32c_blocks(init_value, len, n, p, crcs);
+      for (size_t i = 0; i < n; ++i)
+	out[i] = crcs[i] & 0xffff;
+    }
   };
 
   struct crc32c_8 {
@@ -128,6 +193,19 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      bufferlist::const_iterator& p,
+      value_t *out
+      ) {
+      uint32_t crcs[batch_blocks];
+      crc32c_blocks(init_value, len, n, p, crcs);
+      for (size_t i = 0; i < n; ++i)
+	out[i] = crcs[i] & 0xff;
+    }
   };
 
   struct xxhash32 {
@@ -157,6 +235,17 @@ public:
       }
       return XXH32_digest(state);
     }
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      bufferlist::const_iterator& p,
+      value_t *out
+      ) {
+      for (size_t i = 0; i < n; ++i)
+	out[i] = calc(state, init_value, len, p);
+    }
   };
 
   struct xxhash64 {
@@ -186,6 +275,17 @@ public:
       }
       return XXH64_digest(state);
     }
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      bufferlist::const_iterator& p,
+      value_t *out
+      ) {
+      for (size_t i = 0; i < n; ++i)
+	out[i] = calc(state, init_value, len, p);
+    }
   };
 
   template<class Alg>
@@ -221,9 +321,11 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
+    while (blocks > 0) {
+      size_t n = MIN(blocks, batch_blocks);
+      Alg::calc_blocks(state, init_value, csum_block_size, n, p, pv);
+      pv += n;
+      blocks -= n;
     }
     Alg::fini(&state);
     return 0;
@@ -249,18 +351,22 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
+    typename Alg::value_t v[batch_blocks];
     while (length > 0) {
-      typename Alg::value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+      size_t n = MIN(length / csum_block_size, batch_blocks);
+      Alg::calc_blocks(state, -1, csum_block_size, n, p, v);
+      for (size_t i = 0; i < n; ++i) {
+	if (*pv != v[i]) {
+	  if (bad_csum) {
+	    *bad_csum = v[i];
+	  }
+	  Alg::fini(&state);
+	  return pos;
 	}
-	Alg::fini(&state);
-	return pos;
+	++pv;
+	pos += csum_block_size;
+	length -= csum_block_size;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
     }
     Alg::fini(&state);
     return -1;  // no errors
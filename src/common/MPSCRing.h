@@ -0,0 +1,126 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_COMMON_MPSCRING_H
+#define CEPH_COMMON_MPSCRING_H
+
+#include <atomic>
+#include <memory>
+#include <boost/optional.hpp>
+
+#include "include/assert.h"
+
+/**
+ * Bounded lock-free multi-producer, single-consumer ring.
+ *
+ * Each cell carries a sequence number that tells producers whether it is
+ * free for the current lap and tells the consumer whether it has been
+ * published (D. Vyukov's bounded queue).  Any number of threads may push();
+ * pop() and drain() must only be called by one thread at a time, e.g.
+ * under a lock the consumers already hold.  Items pushed by one thread are
+ * popped in the order they were pushed.
+ */
+template <typename T>
+class MPSCRing {
+  struct cell_t {
+    std::atomic<size_t> seq;
+    boost::optional<T> item;
+  };
+
+  const size_t mask;
+  std::unique_ptr<cell_t[]> cells;
+
+  // keep the producer and consumer cursors off each other's cache line
+  alignas(64) std::atomic<size_t> tail = {0};  ///< next cell to claim
+  alignas(64) std::atomic<size_t> head = {0};  ///< next cell to pop
+
+public:
+  /// size is rounded up to a power of two
+  explicit MPSCRing(size_t size) : mask(_round_up(size) - 1) {
+    cells.reset(new cell_t[mask + 1]);
+    for (size_t i = 0; i <= mask; ++i)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+  MPSCRing(const MPSCRing&) = delete;
+  MPSCRing& operator=(const MPSCRing&) = delete;
+
+  size_t capacity() const {
+    return mask + 1;
+  }
+
+  /// approximate; exact only when no push or pop is in flight
+  size_t size() const {
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_acquire);
+    return t - h;
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /// push, or leave item untouched and return false if the ring is full
+  bool push(T&& item) {
+    cell_t *c;
+    size_t pos = tail.load(std::memory_order_relaxed);
+    while (true) {
+      c = &cells[pos & mask];
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+      if (dif == 0) {
+	if (tail.compare_exchange_weak(pos, pos + 1,
+				       std::memory_order_relaxed))
+	  break;
+      } else if (dif < 0) {
+	return false;
+      } else {
+	pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    c->item = std::move(item);
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// pop the oldest published item; false if there is none (yet)
+  bool pop(T *out) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    cell_t *c = &cells[pos & mask];
+    if (c->seq.load(std::memory_order_acquire) != pos + 1)
+      return false;
+    *out = std::move(*c->item);
+    c->item = boost::none;
+    c->seq.store(pos + mask + 1, std::memory_order_release);
+    head.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// pop everything published so far into f; returns the count
+  template <typename F>
+  size_t drain(F&& f) {
+    size_t n = 0;
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (true) {
+      cell_t *c = &cells[pos & mask];
+      if (c->seq.load(std::memory_order_acquire) != pos + 1)
+	break;
+      f(std::move(*c->item));
+      c->item = boost::none;
+      c->seq.store(pos + mask + 1, std::memory_order_release);
+      ++pos;
+      ++n;
+    }
+    head.store(pos, std::memory_order_release);
+    return n;
+  }
+
+private:
+  static size_t _round_up(size_t n) {
+    assert(n > 0);
+    size_t r = 1;
+    while (r < n)
+      r <<= 1;
+    return r;
+  }
+};
+
+#endif
@@ -31,6 +31,7 @@ Mutex::Mutex(const std::string &n, bool r, bool ld,
     PerfCountersBuilder b(cct, string("mutex-") + name,
 			  l_mutex_first, l_mutex_last);
     b.add_time_avg(l_mutex_wait, "wait", "Average time of mutex in locked state");
+    b.add_time_avg(l_mutex_hold, "hold", "Average time the mutex is held");
     logger = b.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
     logger->set(l_mutex_wait, 0);
@@ -114,6 +115,18 @@ out:
   ;
 }
 
+void Mutex::_note_locked() {
+  if (cct && cct->_conf->mutex_perf_counter)
+    locked_at = ceph::mono_clock::now();
+}
+
+void Mutex::_note_unlocked() {
+  if (locked_at != ceph::mono_time()) {
+    logger->tinc(l_mutex_hold, ceph::mono_clock::now() - locked_at);
+    locked_at = ceph::mono_time();
+  }
+}
+
 void Mutex::Unlock() {
   _pre_unlock();
   if (lockdep && g_lockdep) _will_unlock();
@@ -18,6 +18,7 @@
 #include "include/assert.h"
 #include "lockdep.h"
 #include "common/ceph_context.h"
+#include "common/ceph_time.h"
 
 #include <pthread.h>
 
@@ -28,6 +29,7 @@ class PerfCounters;
 enum {
   l_mutex_first = 999082,
   l_mutex_wait,
+  l_mutex_hold,
   l_mutex_last
 };
 
@@ -44,6 +46,13 @@ private:
   pthread_t locked_by;
   CephContext *cct;
   PerfCounters *logger;
+  // When instrumented and held.  Cond waits release the mutex through
+  // _pre_unlock/_post_lock, so time spent waiting on a Cond ends one
+  // hold sample and starts the next: it is not counted as hold time.
+  ceph::mono_time locked_at;
+
+  void _note_locked();
+  void _note_unlocked();
 
   // don't allow copying.
   void operator=(const Mutex &M);
@@ -90,10 +99,14 @@ public:
       locked_by = pthread_self();
     };
     nlock++;
+    if (logger && nlock == 1)
+      _note_locked();
   }
 
   void _pre_unlock() {
     assert(nlock > 0);
+    if (logger && nlock == 1)
+      _note_unlocked();
     --nlock;
     if (!recursive) {
       assert(locked_by == pthread_self());
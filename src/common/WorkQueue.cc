@@ -358,6 +358,12 @@ void ShardedThreadPool::start_threads()
 
     WorkThreadSharded *wt = new WorkThreadSharded(this, thread_index);
     ldout(cct, 10) << "start_threads creating and starting " << wt << dendl;
+    int cpu = wq->get_thread_cpu(thread_index);
+    if (cpu >= 0) {
+      ldout(cct, 10) << "start_threads pinning " << wt << " to cpu " << cpu
+		     << dendl;
+      wt->set_affinity(cpu);
+    }
     threads_shardedpool.push_back(wt);
     wt->create(thread_name.c_str());
     thread_index++;
@@ -642,6 +642,10 @@ public:
     virtual void _process(uint32_t thread_index, heartbeat_handle_d *hb ) = 0;
     virtual void return_waiting_threads() = 0;
     virtual bool is_shard_empty(uint32_t thread_index) = 0;
+    /// cpu the given worker should be pinned to, or -1 for no affinity
+    virtual int get_thread_cpu(uint32_t thread_index) {
+      return -1;
+    }
   };      
 
   template <typename T>
@@ -2508,6 +2508,75 @@ __u32 buffer::list::crc32c(__u32 crc) const
   return crc;
 }
 
+void buffer::list::crc32c_multi(const list * const *bls, uint32_t *crcs,
+				unsigned n)
+{
+  static const unsigned max_lists = 8;
+  for (unsigned base = 0; base < n; base += max_lists) {
+    unsigned m = MIN(max_lists, n - base);
+    std::list<ptr>::const_iterator pos[max_lists], end[max_lists];
+    for (unsigned i = 0; i < m; ++i) {
+      pos[i] = bls[base + i]->_buffers.begin();
+      end[i] = bls[base + i]->_buffers.end();
+    }
+
+    // one round takes the next segment of every list, so the segments
+    // handed to ceph_crc32c_multi are always independent of each other
+    while (true) {
+      unsigned char const *data[max_lists];
+      unsigned len[max_lists];
+      uint32_t crc[max_lists];
+      unsigned lane[max_lists];
+      const ptr *seg[max_lists];
+      unsigned k = 0;
+      bool more = false;
+      for (unsigned i = 0; i < m; ++i) {
+	while (pos[i] != end[i] && !pos[i]->length())
+	  ++pos[i];
+	if (pos[i] == end[i])
+	  continue;
+	more = true;
+	const ptr& p = *pos[i]++;
+	uint32_t& c = crcs[base + i];
+	pair<size_t, size_t> ofs(p.offset(), p.offset() + p.length());
+	pair<uint32_t, uint32_t> ccrc;
+	if (p.get_raw()->get_crc(ofs, &ccrc)) {
+	  // same shortcut as crc32c() above
+	  if (ccrc.first == c) {
+	    c = ccrc.second;
+	    if (buffer_track_crc)
+	      buffer_cached_crc++;
+	  } else {
+	    c = ccrc.second ^ ceph_crc32c(ccrc.first ^ c, NULL, p.length());
+	    if (buffer_track_crc)
+	      buffer_cached_crc_adjusted++;
+	  }
+	  continue;
+	}
+	if (buffer_track_crc)
+	  buffer_missed_crc++;
+	data[k] = (unsigned char*)p.c_str();
+	len[k] = p.length();
+	crc[k] = c;
+	lane[k] = base + i;
+	seg[k] = &p;
+	++k;
+      }
+      if (!more)
+	break;
+      if (!k)
+	continue;
+      ceph_crc32c_multi(crc, data, len, k);
+      for (unsigned j = 0; j < k; ++j) {
+	pair<size_t, size_t> ofs(seg[j]->offset(),
+				 seg[j]->offset() + seg[j]->length());
+	seg[j]->get_raw()->set_crc(ofs, make_pair(crcs[lane[j]], crc[j]));
+	crcs[lane[j]] = crc[j];
+      }
+    }
+  }
+}
+
 void buffer::list::invalidate_crc()
 {
   for (std::list<ptr>::const_iterator p = _buffers.begin(); p != _buffers.end(); ++p) {
@@ -233,6 +233,15 @@ OPTION(ms_async_set_affinity, OPT_BOOL, true)
 // If ms_async_affinity_cores is empty, all threads will be bind to current running
 // core
 OPTION(ms_async_affinity_cores, OPT_STR, "")
+// fast dispatch up to this many messages decoded from one read pass
+// together, dropping the connection lock once per batch
+OPTION(ms_async_rx_dispatch_batch, OPT_U32, 16)
+// gather queued outgoing messages into one sendmsg until this many bytes
+// are pending (0 sends each message with its own call)
+OPTION(ms_async_tx_coalesce_bytes, OPT_U32, 65536)
+// posix stack only: send large writes with MSG_ZEROCOPY (linux 4.14+)
+OPTION(ms_async_zerocopy_send, OPT_BOOL, false)
+OPTION(ms_async_zerocopy_min_bytes, OPT_U64, 65536) // smaller sends are always copied
 OPTION(ms_async_rdma_device_name, OPT_STR, "")
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL, false)
 OPTION(ms_async_rdma_buffer_size, OPT_INT, 128 << 10)
@@ -298,6 +307,7 @@ OPTION(mon_osd_prime_pg_temp_max_time, OPT_FLOAT, .5)  // max time to spend prim
 OPTION(mon_osd_prime_pg_temp_max_estimate, OPT_FLOAT, .25) // max estimate of pg total before we do all pgs in parallel
 OPTION(mon_osd_pool_ec_fast_read, OPT_BOOL, false) // whether turn on fast read on the pool or not
 OPTION(mon_stat_smooth_intervals, OPT_INT, 6)  // smooth stats over last N PGMap maps
+OPTION(mon_pg_stat_aggregate_threads, OPT_INT, 4)  // threads summing pool stats of large PGMap incrementals
 OPTION(mon_election_timeout, OPT_FLOAT, 5)  // on election proposer, max waiting time for all ACKs
 OPTION(mon_lease, OPT_FLOAT, 5)       // lease interval
 OPTION(mon_lease_renew_interval_factor, OPT_FLOAT, .6) // on leader, to renew the lease
@@ -399,6 +409,7 @@ OPTION(paxos_stash_full_interval, OPT_INT, 25)   // how often (in commits) to st
 OPTION(paxos_max_join_drift, OPT_INT, 10) // max paxos iterations before we must first sync the monitor stores
 OPTION(paxos_propose_interval, OPT_DOUBLE, 1.0)  // gather updates for this long before proposing a map update
 OPTION(paxos_min_wait, OPT_DOUBLE, 0.05)  // min time to gather updates for after period of inactivity
+OPTION(paxos_overlap_writes, OPT_BOOL, true)  // leader sends begin/commit to peons before its own store write lands
 OPTION(paxos_min, OPT_INT, 500)       // minimum number of paxos states to keep around
 OPTION(paxos_trim_min, OPT_INT, 250)  // number of extra proposals tolerated before trimming
 OPTION(paxos_trim_max, OPT_INT, 500) // max number of extra proposals to trim at a time
@@ -451,6 +462,7 @@ OPTION(client_oc_max_dirty, OPT_INT, 1024*1024* 100)    // MB * n  (dirty OR tx.
 OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this smallish)
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
+OPTION(client_oc_adaptive, OPT_BOOL, false)       // ARC instead of LRU for clean data
 OPTION(client_debug_getattr_caps, OPT_BOOL, false) // check if MDS reply contains wanted caps
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
@@ -493,6 +505,7 @@ OPTION(objecter_completion_locks_per_session, OPT_U64, 32) // num of completion
 OPTION(objecter_inject_no_watch_ping, OPT_BOOL, false)   // suppress watch pings
 OPTION(objecter_retry_writes_after_first_reply, OPT_BOOL, false)   // ignore the first reply for each write, and resend the osd op instead
 OPTION(objecter_debug_inject_relock_delay, OPT_BOOL, false)
+OPTION(objecter_pg_mapping, OPT_BOOL, false)  // target ops from a precalculated table of every pg (memory grows with the cluster pg count)
 
 // Max number of deletes at once in a single Filer::purge call
 OPTION(filer_max_purge_ops, OPT_U32, 10)
@@ -543,6 +556,9 @@ OPTION(mds_log_events_per_segment, OPT_INT, 1024)
 OPTION(mds_log_segment_size, OPT_INT, 0)  // segment size for mds log, default to default file_layout_t
 OPTION(mds_log_max_segments, OPT_U32, 30)
 OPTION(mds_log_max_expiring, OPT_INT, 20)
+OPTION(mds_log_group_commit_max_events, OPT_U32, 1024) // events encoded and appended per journal flush, at most
+OPTION(mds_log_group_commit_max_delay, OPT_DOUBLE, .001) // seconds to hold a flush back while events are arriving faster than this
+OPTION(mds_log_encode_threads, OPT_INT, 4)  // encode large batches of log events in parallel
 OPTION(mds_bal_export_pin, OPT_BOOL, true)  // allow clients to pin directory trees to ranks
 OPTION(mds_bal_sample_interval, OPT_DOUBLE, 3.0)  // every 3 seconds
 OPTION(mds_bal_replicate_threshold, OPT_FLOAT, 8000)
@@ -636,6 +652,10 @@ OPTION(mds_damage_table_max_entries, OPT_INT, 10000)
 // Maximum increment for client writable range, counted by number of objects
 OPTION(mds_client_writeable_range_max_inc_objs, OPT_U32, 1024)
 
+// Answer repeated getattrs on stable files from the messenger threads,
+// without taking mds_lock
+OPTION(mds_fast_getattr, OPT_BOOL, false)
+
 // verify backend can support configured max object name length
 OPTION(osd_check_max_object_name_len_on_startup, OPT_BOOL, true)
 
@@ -744,6 +764,8 @@ OPTION(osd_tier_default_cache_hit_set_grade_decay_rate, OPT_INT, 20)
 OPTION(osd_tier_default_cache_hit_set_search_last_n, OPT_INT, 1)
 
 OPTION(osd_map_dedup, OPT_BOOL, true)
+OPTION(osd_pg_mapping, OPT_BOOL, true)  // keep every pg's up/acting sets for the current map, updated incrementally
+OPTION(osd_pg_mapping_pgs_per_chunk, OPT_INT, 4096)  // pgs per work item when rebuilding that table
 OPTION(osd_map_max_advance, OPT_INT, 40) // make this < cache_size!
 OPTION(osd_map_cache_size, OPT_INT, 50)
 OPTION(osd_map_message_max, OPT_INT, 40)  // max maps per MOSDMap message
@@ -768,6 +790,17 @@ OPTION(osd_op_num_threads_per_shard_ssd, OPT_INT, 2)
 OPTION(osd_op_num_shards, OPT_INT, 0)
 OPTION(osd_op_num_shards_hdd, OPT_INT, 5)
 OPTION(osd_op_num_shards_ssd, OPT_INT, 8)
+// if > 0, fast dispatch hands ops to their shard through a lock-free ring
+// of this many slots instead of taking the shard's ordering lock
+OPTION(osd_op_shard_admission_ring_size, OPT_U32, 0)
+// cpus to pin op shards to, e.g. "2,3,4,5"; all threads of shard i run on
+// the i-th entry (wrapping around).  pair with ms_async_affinity_cores.
+OPTION(osd_op_shard_cores, OPT_STR, "")
+// let a messenger thread that shares a core with an idle op shard run a
+// fast-dispatched client read for that shard itself instead of queueing
+// it.  writes always go through the shard queue.  requires
+// osd_op_shard_cores.
+OPTION(osd_op_run_to_completion, OPT_BOOL, false)
 
 // PrioritzedQueue (prio), Weighted Priority Queue (wpq ; default),
 // mclock_opclass, mclock_client, or debug_random. "mclock_opclass"
@@ -899,6 +932,7 @@ OPTION(osd_min_pg_log_entries, OPT_U32, 3000)  // number of entries to keep in t
 OPTION(osd_max_pg_log_entries, OPT_U32, 10000) // max entries, say when degraded, before we trim
 OPTION(osd_force_recovery_pg_log_entries_factor, OPT_FLOAT, 1.3) // max entries factor before force recovery
 OPTION(osd_pg_log_trim_min, OPT_U32, 100)
+OPTION(osd_pg_log_index_on_load, OPT_BOOL, false) // build pg log indices in load_pgs, one thread per op shard, instead of on first use
 OPTION(osd_op_complaint_time, OPT_FLOAT, 30) // how many seconds old makes an op complaint-worthy
 OPTION(osd_command_max_records, OPT_INT, 256)
 OPTION(osd_max_pg_blocked_by, OPT_U32, 16)    // max peer osds to report that are blocking our progress
@@ -1056,6 +1090,8 @@ OPTION(bdev_aio_max_queue_depth, OPT_INT, 1024)
 OPTION(bdev_block_size, OPT_INT, 4096)
 OPTION(bdev_debug_aio, OPT_BOOL, false)
 OPTION(bdev_debug_aio_suicide_timeout, OPT_FLOAT, 60.0)
+OPTION(bdev_ioring, OPT_BOOL, false)  // use io_uring instead of libaio if available
+OPTION(bdev_ioring_sqthread_poll, OPT_BOOL, false)  // let a kernel thread poll the io_uring submission queue
 
 // if yes, osd will unbind all NVMe devices from kernel driver and bind them
 // to the uio_pci_generic driver. The purpose is to prevent the case where
@@ -1075,7 +1111,7 @@ OPTION(bluefs_min_flush_size, OPT_U64, 524288)  // ignore flush until its this b
 OPTION(bluefs_compact_log_sync, OPT_BOOL, false)  // sync or async log compaction?
 OPTION(bluefs_buffered_io, OPT_BOOL, false)
 OPTION(bluefs_sync_write, OPT_BOOL, false)
-OPTION(bluefs_allocator, OPT_STR, "bitmap")     // stupid | bitmap
+OPTION(bluefs_allocator, OPT_STR, "bitmap")     // stupid | bitmap | avl
 OPTION(bluefs_preextend_wal_files, OPT_BOOL, false)  // this *requires* that rocksdb has recycling enabled
 
 OPTION(bluestore_bluefs, OPT_BOOL, true)
@@ -1159,18 +1195,21 @@ OPTION(bluestore_extent_map_inline_shard_prealloc_size, OPT_U32, 256)
 OPTION(bluestore_cache_trim_interval, OPT_DOUBLE, .2)
 OPTION(bluestore_cache_trim_max_skip_pinned, OPT_U32, 64) // skip this many onodes pinned in cache before we give up
 OPTION(bluestore_cache_type, OPT_STR, "2q")   // lru, 2q
+OPTION(bluestore_cache_onode_touch_batch, OPT_U32, 64) // onode lookups skip the cache lock and queue up to this many lru promotions per shard; 0 = promote under the lock
 OPTION(bluestore_2q_cache_kin_ratio, OPT_DOUBLE, .5)    // kin page slot size / max page slot size
 OPTION(bluestore_2q_cache_kout_ratio, OPT_DOUBLE, .5)   // number of kout page slot / total number of page slot
 OPTION(bluestore_cache_size, OPT_U64, 1024*1024*1024)
 OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE, .7)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE, .2)
 OPTION(bluestore_kvbackend, OPT_STR, "rocksdb")
-OPTION(bluestore_allocator, OPT_STR, "bitmap")     // stupid | bitmap
+OPTION(bluestore_allocator, OPT_STR, "bitmap")     // stupid | bitmap | avl
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT, 128)
+OPTION(bluestore_alloc_snapshot, OPT_BOOL, false) // persist allocator state at clean umount so mount can skip the freelist scan
 OPTION(bluestore_bitmapallocator_blocks_per_zone, OPT_INT, 1024) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_bitmapallocator_span_size, OPT_INT, 1024) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_max_deferred_txc, OPT_U64, 32)
 OPTION(bluestore_rocksdb_options, OPT_STR, "compression=kNoCompression,max_write_buffer_number=4,min_write_buffer_number_to_merge=1,recycle_log_file_num=4,write_buffer_size=268435456,writable_file_max_buffer_size=0,compaction_readahead_size=2097152")
+OPTION(bluestore_rocksdb_cfs, OPT_STR, "") // space separated list of <prefix>=<options> to keep in their own rocksdb column family, e.g. "M=block_cache_size=134217728;write_buffer_size=67108864 L="; options are ';' separated rocksdb column family options plus block_cache_size
 OPTION(bluestore_fsck_on_mount, OPT_BOOL, false)
 OPTION(bluestore_fsck_on_mount_deep, OPT_BOOL, true)
 OPTION(bluestore_fsck_on_umount, OPT_BOOL, false)
@@ -1379,6 +1418,7 @@ OPTION(rados_tracing, OPT_BOOL, false) // true if LTTng-UST tracepoints should b
 OPTION(rbd_op_threads, OPT_INT, 1)
 OPTION(rbd_op_thread_timeout, OPT_INT, 60)
 OPTION(rbd_non_blocking_aio, OPT_BOOL, true) // process AIO ops from a worker thread to prevent blocking
+OPTION(rbd_read_fast_path, OPT_BOOL, false) // dispatch reads on the caller thread, without the AIO work queue, while no lock transition, write block or refresh is pending
 OPTION(rbd_cache, OPT_BOOL, true) // whether to enable caching (writeback unless rbd_cache_max_dirty is 0)
 OPTION(rbd_cache_writethrough_until_flush, OPT_BOOL, true) // whether to make writeback caching writethrough until flush is called, to be sure the user of librbd will send flushs so that writeback is safe
 OPTION(rbd_cache_size, OPT_LONGLONG, 32<<20)         // cache size in bytes
@@ -1387,7 +1427,11 @@ OPTION(rbd_cache_target_dirty, OPT_LONGLONG, 16<<20) // target dirty limit in by
 OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before writeback starts
 OPTION(rbd_cache_max_dirty_object, OPT_INT, 0)       // dirty limit for objects - set to 0 for auto calculate from rbd_cache_size
 OPTION(rbd_cache_block_writes_upfront, OPT_BOOL, false) // whether to block writes to the cache before the aio_write call completes (true), or block before the aio completion is called (false)
+OPTION(rbd_cache_adaptive, OPT_BOOL, false) // evict clean data with an adaptive (ARC) policy instead of LRU
+OPTION(rbd_persistent_cache_path, OPT_STR, "") // directory on a local SSD/pmem for a write-back log per open image - empty to disable
+OPTION(rbd_persistent_cache_size, OPT_U64, 1ULL<<30) // size in bytes of each persistent write-back log
 OPTION(rbd_concurrent_management_ops, OPT_INT, 10) // how many operations can be in flight for a management operation like deleting or resizing an image
+OPTION(rbd_concurrent_management_ops_max, OPT_INT, 0) // if above rbd_concurrent_management_ops, grow the number of in-flight management operations up to this limit while their latency stays stable
 OPTION(rbd_balance_snap_reads, OPT_BOOL, false)
 OPTION(rbd_localize_snap_reads, OPT_BOOL, false)
 OPTION(rbd_balance_parent_reads, OPT_BOOL, false)
@@ -0,0 +1,131 @@
+/*
+ * Multi-buffer crc32c for x86_64 with SSE 4.2.
+ *
+ * The crc32 instruction has a latency of 3 cycles but a throughput of
+ * one per cycle, so a single dependency chain leaves the unit two
+ * thirds idle.  crc32_iscsi_00 works around that by splitting one
+ * buffer into three parts and recombining them with PCLMUL, which only
+ * pays off for long buffers.  Here we instead run the chains of four
+ * independent buffers side by side: no recombination is needed, so it
+ * helps exactly where the single-buffer code does not, i.e. many short
+ * or medium sized segments (csum blocks, message front/middle/data).
+ */
+
+#include <string.h>
+
+#include "acconfig.h"
+#include "include/crc32c.h"
+#include "common/crc32c_intel_multi.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#define LANES 4
+
+struct crc_lane {
+	uint32_t crc;
+	unsigned char const *p;
+	unsigned left;
+	unsigned idx;
+};
+
+static inline uint64_t load64(unsigned char const *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* advance all four lanes by len bytes (a multiple of 8) */
+__attribute__((target("sse4.2")))
+static void crc32c_4way(struct crc_lane *l, unsigned len)
+{
+	uint64_t c0 = l[0].crc, c1 = l[1].crc, c2 = l[2].crc, c3 = l[3].crc;
+	unsigned char const *p0 = l[0].p, *p1 = l[1].p;
+	unsigned char const *p2 = l[2].p, *p3 = l[3].p;
+	unsigned off;
+	int i;
+
+	for (off = 0; off < len; off += 8) {
+		c0 = __builtin_ia32_crc32di(c0, load64(p0 + off));
+		c1 = __builtin_ia32_crc32di(c1, load64(p1 + off));
+		c2 = __builtin_ia32_crc32di(c2, load64(p2 + off));
+		c3 = __builtin_ia32_crc32di(c3, load64(p3 + off));
+	}
+	l[0].crc = c0;
+	l[1].crc = c1;
+	l[2].crc = c2;
+	l[3].crc = c3;
+	for (i = 0; i < LANES; i++) {
+		l[i].p += len;
+		l[i].left -= len;
+	}
+}
+
+/*
+ * Keep four buffers in flight; whenever one runs dry, its lane is
+ * refilled with the next buffer, so buffers of different sizes still
+ * share the unit.  Once fewer than four are left there is nothing to
+ * interleave with, and the tails go to the single-buffer code (which
+ * does its own 3-way split for long buffers).
+ */
+void ceph_crc32c_intel_multi(uint32_t *crcs, unsigned char const * const *data,
+			     unsigned const *len, unsigned n)
+{
+	struct crc_lane l[LANES];
+	unsigned active = 0, next = 0;
+	unsigned i, step;
+
+	for (;;) {
+		while (active < LANES && next < n) {
+			i = next++;
+			if (!data[i] || len[i] < 8) {
+				crcs[i] = ceph_crc32c(crcs[i], data[i], len[i]);
+				continue;
+			}
+			l[active].crc = crcs[i];
+			l[active].p = data[i];
+			l[active].left = len[i];
+			l[active].idx = i;
+			active++;
+		}
+		if (active < LANES)
+			break;
+
+		step = l[0].left;
+		for (i = 1; i < LANES; i++)
+			if (l[i].left < step)
+				step = l[i].left;
+		crc32c_4way(l, step & ~7u);
+
+		for (i = 0; i < active; ) {
+			if (l[i].left < 8) {
+				crcs[l[i].idx] = ceph_crc32c(l[i].crc, l[i].p,
+							     l[i].left);
+				l[i] = l[--active];
+			} else {
+				i++;
+			}
+		}
+	}
+	for (i = 0; i < active; i++)
+		crcs[l[i].idx] = ceph_crc32c(l[i].crc, l[i].p, l[i].left);
+}
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 0;
+}
+
+void ceph_crc32c_intel_multi(uint32_t *crcs, unsigned char const * const *data,
+			     unsigned const *len, unsigned n)
+{
+}
+
+#endif
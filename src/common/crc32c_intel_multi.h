@@ -0,0 +1,21 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_MULTI_H
+#define CEPH_COMMON_CRC32C_INTEL_MULTI_H
+
+#include "include/int_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the multi-buffer kernel compiled in? (runtime still needs sse 4.2) */
+extern int ceph_crc32c_intel_multi_exists(void);
+
+extern void ceph_crc32c_intel_multi(uint32_t *crcs,
+				    unsigned char const * const *data,
+				    unsigned const *len, unsigned n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,6 +19,7 @@
 #include <boost/icl/interval_map.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include "common/SubProcess.h"
+#include "common/ceph_time.h"
 
 void CrushTester::set_device_weight(int dev, float f)
 {
@@ -565,6 +566,28 @@ int CrushTester::test()
       << std::endl;
 
     for (int nr = minr; nr <= maxr; nr++) {
+      if (output_benchmark && use_crush) {
+	// time the bare mapping loop, without any of the bookkeeping below
+	vector<int> out;
+	auto start = ceph::mono_clock::now();
+	for (int x = min_x; x <= max_x; x++) {
+	  uint32_t real_x = x;
+	  if (pool_id != -1) {
+	    real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+	  }
+	  crush.do_rule(r, real_x, out, nr, weight, 0);
+	}
+	double secs = std::chrono::duration<double>(
+	  ceph::mono_clock::now() - start).count();
+	int num = max_x - min_x + 1;
+	err << "rule " << r << " (" << crush.get_rule_name(r)
+	    << ") num_rep " << nr << " benchmark: " << num << " mappings in "
+	    << secs << "s";
+	if (secs > 0)
+	  err << " (" << (uint64_t)(num / secs) << " mappings/sec)";
+	err << std::endl;
+      }
+
       vector<int> per(crush.get_max_devices());
       map<int,int> sizes;
 
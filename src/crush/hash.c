@@ -1,6 +1,7 @@
 #ifdef __KERNEL__
 # include <linux/crush/hash.h>
 #else
+# include <string.h>
 # include "hash.h"
 #endif
 
@@ -89,6 +90,62 @@ static __u32 crush_hash32_rjenkins1_5(__u32 a, __u32 b, __u32 c, __u32 d,
 	return hash;
 }
 
+#if !defined(__KERNEL__) && defined(__GNUC__)
+/*
+ * rjenkins1_3 over several values of b at once.  The mix is nothing but
+ * 32-bit sub/xor/shift, so running it lane-wise on a vector gives the
+ * same bits as the scalar version.
+ */
+typedef __u32 crush_u32x4 __attribute__((vector_size(16)));
+
+static void crush_hash32_rjenkins1_3_x4(__u32 sa, const __s32 *sb, __u32 sc,
+					__u32 *out)
+{
+	crush_u32x4 a = {sa, sa, sa, sa};
+	crush_u32x4 b;
+	crush_u32x4 c = {sc, sc, sc, sc};
+	crush_u32x4 x = {231232, 231232, 231232, 231232};
+	crush_u32x4 y = {1232, 1232, 1232, 1232};
+	crush_u32x4 hash;
+
+	memcpy(&b, sb, sizeof(b));
+	hash = a ^ b ^ c;
+	hash ^= (__u32)crush_hash_seed;
+	crush_hashmix(a, b, hash);
+	crush_hashmix(c, x, hash);
+	crush_hashmix(y, a, hash);
+	crush_hashmix(b, x, hash);
+	crush_hashmix(y, c, hash);
+	memcpy(out, &hash, sizeof(hash));
+}
+
+#if defined(__x86_64__)
+typedef __u32 crush_u32x8 __attribute__((vector_size(32)));
+
+__attribute__((target("avx2")))
+static void crush_hash32_rjenkins1_3_x8(__u32 sa, const __s32 *sb, __u32 sc,
+					__u32 *out)
+{
+	crush_u32x8 a = {sa, sa, sa, sa, sa, sa, sa, sa};
+	crush_u32x8 b;
+	crush_u32x8 c = {sc, sc, sc, sc, sc, sc, sc, sc};
+	crush_u32x8 x = {231232, 231232, 231232, 231232,
+			 231232, 231232, 231232, 231232};
+	crush_u32x8 y = {1232, 1232, 1232, 1232, 1232, 1232, 1232, 1232};
+	crush_u32x8 hash;
+
+	memcpy(&b, sb, sizeof(b));
+	hash = a ^ b ^ c;
+	hash ^= (__u32)crush_hash_seed;
+	crush_hashmix(a, b, hash);
+	crush_hashmix(c, x, hash);
+	crush_hashmix(y, a, hash);
+	crush_hashmix(b, x, hash);
+	crush_hashmix(y, c, hash);
+	memcpy(out, &hash, sizeof(hash));
+}
+#endif
+#endif
 
 __u32 crush_hash32(int type, __u32 a)
 {
@@ -120,6 +177,28 @@ __u32 crush_hash32_3(int type, __u32 a, __u32 b, __u32 c)
 	}
 }
 
+void crush_hash32_3_many(int type, __u32 a, const __s32 *b, __u32 c,
+			 __u32 *out, unsigned n)
+{
+	unsigned i = 0;
+
+#if !defined(__KERNEL__) && defined(__GNUC__)
+	if (type == CRUSH_HASH_RJENKINS1) {
+#if defined(__x86_64__)
+		if (n >= 8 && __builtin_cpu_supports("avx2")) {
+			for (; i + 8 <= n; i += 8)
+				crush_hash32_rjenkins1_3_x8(a, b + i, c,
+							    out + i);
+		}
+#endif
+		for (; i + 4 <= n; i += 4)
+			crush_hash32_rjenkins1_3_x4(a, b + i, c, out + i);
+	}
+#endif
+	for (; i < n; i++)
+		out[i] = crush_hash32_3(type, a, b[i], c);
+}
+
 __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d)
 {
 	switch (type) {
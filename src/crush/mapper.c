@@ -320,47 +320,65 @@ static inline int *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket,
   return arg->ids;
 }
 
+/*
+ * items hashed per pass: enough for the hash to run several vectors
+ * wide, small enough to stay on the stack.
+ */
+#define CRUSH_STRAW2_BATCH 32
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
 {
-	unsigned int i, high = 0;
-	unsigned int u;
+	unsigned int i, j, n, high = 0;
+	__u32 u[CRUSH_STRAW2_BATCH];
 	__s64 ln, draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         int *ids = get_choose_arg_ids(bucket, arg);
-	for (i = 0; i < bucket->h.size; i++) {
-                dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
-		if (weights[i]) {
-			u = crush_hash32_3(bucket->h.hash, x, ids[i], r);
-			u &= 0xffff;
-
-			/*
-			 * for some reason slightly less than 0x10000 produces
-			 * a slightly more accurate distribution... probably a
-			 * rounding effect.
-			 *
-			 * the natural log lookup table maps [0,0xffff]
-			 * (corresponding to real numbers [1/0x10000, 1] to
-			 * [0, 0xffffffffffff] (corresponding to real numbers
-			 * [-11.090355,0]).
-			 */
-			ln = crush_ln(u) - 0x1000000000000ll;
-
-			/*
-			 * divide by 16.16 fixed-point weight.  note
-			 * that the ln value is negative, so a larger
-			 * weight means a larger (less negative) value
-			 * for draw.
-			 */
-			draw = div64_s64(ln, weights[i]);
-		} else {
-			draw = S64_MIN;
-		}
+	for (i = 0; i < bucket->h.size; i += n) {
+		n = bucket->h.size - i;
+		if (n > CRUSH_STRAW2_BATCH)
+			n = CRUSH_STRAW2_BATCH;
+
+		/*
+		 * hash the whole batch up front, zero weights included;
+		 * the extra hashes are cheaper than breaking up the
+		 * vector.
+		 */
+		crush_hash32_3_many(bucket->h.hash, x, ids + i, r, u, n);
+
+		for (j = 0; j < n; j++) {
+			dprintk("weight 0x%x item %d\n", weights[i + j],
+				ids[i + j]);
+			if (weights[i + j]) {
+				/*
+				 * for some reason slightly less than 0x10000
+				 * produces a slightly more accurate
+				 * distribution... probably a rounding effect.
+				 *
+				 * the natural log lookup table maps [0,0xffff]
+				 * (corresponding to real numbers [1/0x10000, 1]
+				 * to [0, 0xffffffffffff] (corresponding to real
+				 * numbers [-11.090355,0]).
+				 */
+				ln = crush_ln(u[j] & 0xffff) -
+					0x1000000000000ll;
+
+				/*
+				 * divide by 16.16 fixed-point weight.  note
+				 * that the ln value is negative, so a larger
+				 * weight means a larger (less negative) value
+				 * for draw.
+				 */
+				draw = div64_s64(ln, weights[i + j]);
+			} else {
+				draw = S64_MIN;
+			}
 
-		if (i == 0 || draw > high_draw) {
-			high = i;
-			high_draw = draw;
+			if (i + j == 0 || draw > high_draw) {
+				high = i + j;
+				high_draw = draw;
+			}
 		}
 	}
 
@@ -889,6 +889,10 @@ namespace buffer CEPH_BUFFER_API {
       }
     }
     uint32_t crc32c(uint32_t crc) const;
+    /// crc32c of n independent lists at once: crcs[i] holds the initial
+    /// value for *bls[i] on entry and its crc on return
+    static void crc32c_multi(const list * const *bls, uint32_t *crcs,
+			     unsigned n);
     void invalidate_crc();
 
     // These functions return a bufferlist with a pointer to a single
@@ -90,6 +90,9 @@
 /* Defined if you have libaio */
 #cmakedefine HAVE_LIBAIO
 
+/* Defined if you have liburing */
+#cmakedefine HAVE_LIBURING
+
 /* Defined if OpenLDAP enabled */
 #cmakedefine HAVE_OPENLDAP
 
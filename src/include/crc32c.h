@@ -50,6 +50,32 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
   return ceph_crc32c_func(crc, data, length);
 }
 
+typedef void (*ceph_crc32c_multi_func_t)(uint32_t *crcs,
+					 unsigned char const * const *data,
+					 unsigned const *lengths, unsigned n);
+
+extern ceph_crc32c_multi_func_t ceph_crc32c_multi_func;
+
+extern ceph_crc32c_multi_func_t ceph_choose_crc32c_multi(void);
+
+/**
+ * calculate crc32c of n independent buffers
+ *
+ * Equivalent to crcs[i] = ceph_crc32c(crcs[i], data[i], lengths[i]) for
+ * each i, but lets the implementation interleave the buffers.
+ *
+ * @param crcs initial values on entry, results on return
+ * @param data buffer pointers (NULL means zero-filled, as above)
+ * @param lengths buffer lengths
+ * @param n number of buffers
+ */
+static inline void ceph_crc32c_multi(uint32_t *crcs,
+				     unsigned char const * const *data,
+				     unsigned const *lengths, unsigned n)
+{
+  ceph_crc32c_multi_func(crcs, data, lengths, n);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,6 +148,7 @@ namespace mempool {
   f(bluefs)			      \
   f(buffer_anon)		      \
   f(buffer_meta)		      \
+  f(mds_co)			      \
   f(osd)			      \
   f(osd_mapbl)			      \
   f(osd_pglog)			      \
@@ -11,4 +11,18 @@
 # define MSG_MORE 0
 #endif
 
+/*
+ * MSG_ZEROCOPY needs linux 4.14; older libc headers may not know about it.
+ */
+#ifdef __linux__
+# ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY 60
+# endif
+# ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY 0x4000000
+# endif
+#else
+# define MSG_ZEROCOPY 0
+#endif
+
 #endif
@@ -8,6 +8,7 @@
 #include <set>
 #include <map>
 #include <string>
+#include <vector>
 #include "include/memory.h"
 #include <boost/scoped_ptr.hpp>
 #include "include/encoding.h"
@@ -296,7 +297,8 @@ public:
   }
 
   Iterator get_iterator(const std::string &prefix) {
-    return std::make_shared<IteratorImpl>(prefix, get_iterator());
+    return std::make_shared<IteratorImpl>(prefix,
+					  _get_prefix_iterator(prefix));
   }
 
   virtual uint64_t get_estimated_size(std::map<std::string,uint64_t> &extra) = 0;
@@ -347,6 +349,22 @@ public:
     return -EOPNOTSUPP;
   }
 
+  /// A prefix whose keys are kept apart from all others (e.g. a RocksDB
+  /// column family), with backend specific tuning options for it.
+  struct ColumnFamily {
+    std::string prefix;
+    std::string options;
+
+    ColumnFamily(const std::string &prefix, const std::string &options)
+      : prefix(prefix), options(options) {}
+  };
+
+  /// Keep the given prefixes apart; this needs to be done BEFORE the DB
+  /// is opened.  Keys of an existing DB are moved over on open.
+  virtual int set_column_families(const std::vector<ColumnFamily>& cfs) {
+    return -EOPNOTSUPP;
+  }
+
   virtual void get_statistics(Formatter *f) {
     return;
   }
@@ -356,6 +374,10 @@ protected:
 			std::shared_ptr<MergeOperator> > > merge_ops;
 
   virtual WholeSpaceIterator _get_iterator() = 0;
+  /// iterator for use within one prefix; may span the whole space
+  virtual WholeSpaceIterator _get_prefix_iterator(const std::string &prefix) {
+    return _get_iterator();
+  }
 };
 
 #endif
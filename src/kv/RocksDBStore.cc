@@ -95,6 +95,37 @@ class RocksDBStore::MergeOperatorRouter : public rocksdb::AssociativeMergeOperat
 
 };
 
+//
+// Merge operator of a prefix kept in its own column family, where keys
+// carry no prefix to route on
+//
+class RocksDBStore::MergeOperatorLinker : public rocksdb::AssociativeMergeOperator {
+  std::shared_ptr<KeyValueDB::MergeOperator> mop;
+  string name;
+  public:
+  explicit MergeOperatorLinker(std::shared_ptr<KeyValueDB::MergeOperator> o)
+    : mop(o), name(o->name()) {}
+
+  const char *Name() const override {
+    return name.c_str();
+  }
+
+  bool Merge(const rocksdb::Slice& key,
+	     const rocksdb::Slice* existing_value,
+	     const rocksdb::Slice& value,
+	     std::string* new_value,
+	     rocksdb::Logger* logger) const override {
+    if (existing_value) {
+      mop->merge(existing_value->data(), existing_value->size(),
+		 value.data(), value.size(),
+		 new_value);
+    } else {
+      mop->merge_nonexistent(value.data(), value.size(), new_value);
+    }
+    return true;
+  }
+};
+
 int RocksDBStore::set_merge_operator(
   const string& prefix,
   std::shared_ptr<KeyValueDB::MergeOperator> mop)
@@ -105,6 +136,14 @@ int RocksDBStore::set_merge_operator(
   return 0;
 }
 
+int RocksDBStore::set_column_families(const std::vector<ColumnFamily>& cfs)
+{
+  // If you fail here, it's because you can't do this on an open database
+  assert(db == nullptr);
+  cf_specs = cfs;
+  return 0;
+}
+
 class CephRocksdbLogger : public rocksdb::Logger {
   CephContext *cct;
 public:
@@ -337,10 +376,26 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing)
 	   << dendl;
 
   opt.merge_operator.reset(new MergeOperatorRouter(*this));
-  status = rocksdb::DB::Open(opt, path, &db);
+
+  // every column family of an existing db has to be opened, whether or
+  // not it is still configured
+  std::vector<std::string> existing_cfs;
+  status = rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions(opt), path,
+					   &existing_cfs);
   if (!status.ok()) {
-    derr << status.ToString() << dendl;
-    return -EINVAL;
+    existing_cfs.clear();
+  }
+  if (cf_specs.empty() && existing_cfs.size() <= 1) {
+    status = rocksdb::DB::Open(opt, path, &db);
+    if (!status.ok()) {
+      derr << status.ToString() << dendl;
+      return -EINVAL;
+    }
+  } else {
+    int r = open_column_families(opt, existing_cfs);
+    if (r < 0) {
+      return r;
+    }
   }
   
   PerfCountersBuilder plb(g_ceph_context, "rocksdb", l_rocksdb_first, l_rocksdb_last);
@@ -370,6 +425,171 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing)
   return 0;
 }
 
+int RocksDBStore::create_cf_options(const string &prefix,
+				    const string &options,
+				    const rocksdb::Options &opt,
+				    rocksdb::ColumnFamilyOptions *cf_opt)
+{
+  *cf_opt = rocksdb::ColumnFamilyOptions(opt);
+
+  // the router matches on key prefixes, which keys in here do not carry
+  cf_opt->merge_operator.reset();
+  for (auto& p : merge_ops) {
+    if (p.first == prefix) {
+      cf_opt->merge_operator.reset(new MergeOperatorLinker(p.second));
+      break;
+    }
+  }
+
+  // block_cache_size gives the family a block cache of its own; all other
+  // options are handed to rocksdb
+  map<string, string> str_map;
+  int r = get_str_map(options, &str_map, ";");
+  if (r < 0) {
+    return r;
+  }
+  string rocksdb_options;
+  uint64_t block_cache_size = 0;
+  for (auto& p : str_map) {
+    if (p.first == "block_cache_size") {
+      string err;
+      block_cache_size = strict_sistrtoll(p.second.c_str(), &err);
+      if (!err.empty()) {
+	derr << __func__ << " invalid block_cache_size '" << p.second
+	     << "' for column family " << prefix << dendl;
+	return -EINVAL;
+      }
+    } else {
+      rocksdb_options += p.first + "=" + p.second + ";";
+    }
+  }
+  if (!rocksdb_options.empty()) {
+    rocksdb::Status status = rocksdb::GetColumnFamilyOptionsFromString(
+      *cf_opt, rocksdb_options, cf_opt);
+    if (!status.ok()) {
+      derr << __func__ << " invalid options '" << options
+	   << "' for column family " << prefix << ": " << status.ToString()
+	   << dendl;
+      return -EINVAL;
+    }
+  }
+  if (block_cache_size) {
+    rocksdb::BlockBasedTableOptions cf_bbt_opts = bbt_opts;
+    cf_bbt_opts.block_cache = rocksdb::NewLRUCache(
+      block_cache_size, g_conf->rocksdb_cache_shard_bits);
+    cf_opt->table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(cf_bbt_opts));
+  }
+  dout(10) << __func__ << " column family " << prefix << " options '"
+	   << options << "'" << dendl;
+  return 0;
+}
+
+int RocksDBStore::open_column_families(
+  rocksdb::Options &opt,
+  const std::vector<std::string> &existing_cfs)
+{
+  std::map<string, string> cf_options;
+  for (auto& p : existing_cfs) {
+    if (p != rocksdb::kDefaultColumnFamilyName) {
+      cf_options[p] = string();
+    }
+  }
+  for (auto& p : cf_specs) {
+    if (cf_options.count(p.prefix) == 0) {
+      dout(1) << __func__ << " creating column family " << p.prefix << dendl;
+    }
+    cf_options[p.prefix] = p.options;
+  }
+
+  std::vector<rocksdb::ColumnFamilyDescriptor> cfds;
+  cfds.push_back(rocksdb::ColumnFamilyDescriptor(
+    rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions(opt)));
+  for (auto& p : cf_options) {
+    rocksdb::ColumnFamilyOptions cf_opt;
+    int r = create_cf_options(p.first, p.second, opt, &cf_opt);
+    if (r < 0) {
+      return r;
+    }
+    cfds.push_back(rocksdb::ColumnFamilyDescriptor(p.first, cf_opt));
+  }
+
+  opt.create_missing_column_families = true;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  rocksdb::Status status = rocksdb::DB::Open(
+    rocksdb::DBOptions(opt), path, cfds, &handles, &db);
+  if (!status.ok()) {
+    derr << status.ToString() << dendl;
+    return -EINVAL;
+  }
+  assert(handles.size() == cfds.size());
+
+  // the default family is always used through the db itself
+  delete handles[0];
+  for (size_t i = 1; i < handles.size(); ++i) {
+    cf_handles[cfds[i].name] = handles[i];
+  }
+
+  for (auto& p : cf_handles) {
+    int r = migrate_column_family(p.first, p.second);
+    if (r < 0) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+int RocksDBStore::migrate_column_family(const string &prefix,
+					rocksdb::ColumnFamilyHandle *cf)
+{
+  // keys are moved in batches, each one atomically, so that an interrupted
+  // migration simply resumes on the next open
+  const unsigned max_batch_keys = 1024;
+  string start = combine_strings(prefix, string());
+  string end = past_prefix(prefix);
+  uint64_t moved = 0;
+
+  rocksdb::Iterator *it = db->NewIterator(rocksdb::ReadOptions());
+  it->Seek(rocksdb::Slice(start));
+  while (it->Valid() && it->key().compare(rocksdb::Slice(end)) < 0) {
+    rocksdb::WriteBatch bat;
+    for (unsigned i = 0;
+	 i < max_batch_keys && it->Valid() &&
+	   it->key().compare(rocksdb::Slice(end)) < 0;
+	 ++i, it->Next()) {
+      string key;
+      split_key(it->key(), nullptr, &key);
+      bat.Put(cf, rocksdb::Slice(key), it->value());
+      bat.Delete(it->key());
+      ++moved;
+    }
+    rocksdb::Status status = db->Write(rocksdb::WriteOptions(), &bat);
+    if (!status.ok()) {
+      derr << __func__ << " failed to move keys of prefix " << prefix
+	   << " to its column family: " << status.ToString() << dendl;
+      delete it;
+      return -EIO;
+    }
+  }
+  rocksdb::Status status = it->status();
+  delete it;
+  if (!status.ok()) {
+    derr << __func__ << " failed to iterate keys of prefix " << prefix
+	 << ": " << status.ToString() << dendl;
+    return -EIO;
+  }
+
+  if (moved > 0) {
+    dout(1) << __func__ << " moved " << moved << " keys of prefix " << prefix
+	    << " to its column family" << dendl;
+    rocksdb::CompactRangeOptions options;
+    rocksdb::Slice cstart(start);
+    rocksdb::Slice cend(end);
+    db->CompactRange(options, &cstart, &cend);
+  }
+  return 0;
+}
+
 int RocksDBStore::_test_init(const string& dir)
 {
   rocksdb::Options options;
@@ -386,6 +606,12 @@ RocksDBStore::~RocksDBStore()
   close();
   delete logger;
 
+  // column family handles have to go before the db
+  for (auto& p : cf_handles) {
+    delete p.second;
+  }
+  cf_handles.clear();
+
   // Ensure db is destroyed before dependent db_cache and filterpolicy
   delete db;
   db = nullptr;
@@ -585,71 +811,100 @@ RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
   db = _db;
 }
 
-void RocksDBStore::RocksDBTransactionImpl::set(
-  const string &prefix,
-  const string &k,
+void RocksDBStore::RocksDBTransactionImpl::put_bat(
+  rocksdb::ColumnFamilyHandle *cf,
+  const string &key,
   const bufferlist &to_set_bl)
 {
-  string key = combine_strings(prefix, k);
-
   // bufferlist::c_str() is non-constant, so we can't call c_str()
   if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-    bat.Put(rocksdb::Slice(key),
+    bat.Put(cf, rocksdb::Slice(key),
 	     rocksdb::Slice(to_set_bl.buffers().front().c_str(),
 			    to_set_bl.length()));
   } else {
     rocksdb::Slice key_slice(key);
     rocksdb::Slice value_slices[to_set_bl.buffers().size()];
-    bat.Put(nullptr, rocksdb::SliceParts(&key_slice, 1),
+    bat.Put(cf, rocksdb::SliceParts(&key_slice, 1),
             prepare_sliceparts(to_set_bl, value_slices));
   }
 }
 
 void RocksDBStore::RocksDBTransactionImpl::set(
   const string &prefix,
-  const char *k, size_t keylen,
+  const string &k,
   const bufferlist &to_set_bl)
 {
-  string key;
-  combine_strings(prefix, k, keylen, &key);
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    put_bat(cf, k, to_set_bl);
+  } else {
+    put_bat(nullptr, combine_strings(prefix, k), to_set_bl);
+  }
+}
 
-  // bufferlist::c_str() is non-constant, so we can't call c_str()
-  if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-    bat.Put(rocksdb::Slice(key),
-	     rocksdb::Slice(to_set_bl.buffers().front().c_str(),
-			    to_set_bl.length()));
+void RocksDBStore::RocksDBTransactionImpl::set(
+  const string &prefix,
+  const char *k, size_t keylen,
+  const bufferlist &to_set_bl)
+{
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    put_bat(cf, string(k, keylen), to_set_bl);
   } else {
-    rocksdb::Slice key_slice(key);
-    rocksdb::Slice value_slices[to_set_bl.buffers().size()];
-    bat.Put(nullptr, rocksdb::SliceParts(&key_slice, 1),
-            prepare_sliceparts(to_set_bl, value_slices));
+    string key;
+    combine_strings(prefix, k, keylen, &key);
+    put_bat(nullptr, key, to_set_bl);
   }
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const string &k)
 {
-  bat.Delete(combine_strings(prefix, k));
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    bat.Delete(cf, rocksdb::Slice(k));
+  } else {
+    bat.Delete(combine_strings(prefix, k));
+  }
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const char *k,
 						 size_t keylen)
 {
-  string key;
-  combine_strings(prefix, k, keylen, &key);
-  bat.Delete(key);
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    bat.Delete(cf, rocksdb::Slice(k, keylen));
+  } else {
+    string key;
+    combine_strings(prefix, k, keylen, &key);
+    bat.Delete(key);
+  }
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 					                 const string &k)
 {
-  bat.SingleDelete(combine_strings(prefix, k));
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    bat.SingleDelete(cf, rocksdb::Slice(k));
+  } else {
+    bat.SingleDelete(combine_strings(prefix, k));
+  }
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix)
 {
-  if (db->enable_rmrange) {
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  if (cf) {
+    // the family has no upper bound key for a range delete
+    KeyValueDB::Iterator it = db->get_iterator(prefix);
+    for (it->seek_to_first();
+	 it->valid();
+	 it->next()) {
+      bat.Delete(cf, rocksdb::Slice(it->key()));
+    }
+  } else if (db->enable_rmrange) {
     string endprefix = prefix;
     endprefix.push_back('\x01');
     bat.DeleteRange(combine_strings(prefix, string()),
@@ -668,8 +923,14 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
                                                          const string &start,
                                                          const string &end)
 {
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
   if (db->enable_rmrange) {
-    bat.DeleteRange(combine_strings(prefix, start), combine_strings(prefix, end));
+    if (cf) {
+      bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
+    } else {
+      bat.DeleteRange(combine_strings(prefix, start),
+		      combine_strings(prefix, end));
+    }
   } else {
     auto it = db->get_iterator(prefix);
     it->lower_bound(start);
@@ -677,7 +938,11 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
       if (it->key() >= end) {
         break;
       }
-      bat.Delete(combine_strings(prefix, it->key()));
+      if (cf) {
+	bat.Delete(cf, rocksdb::Slice(it->key()));
+      } else {
+	bat.Delete(combine_strings(prefix, it->key()));
+      }
       it->next();
     }
   }
@@ -688,18 +953,19 @@ void RocksDBStore::RocksDBTransactionImpl::merge(
   const string &k,
   const bufferlist &to_set_bl)
 {
-  string key = combine_strings(prefix, k);
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf_handle(prefix);
+  string key = cf ? k : combine_strings(prefix, k);
 
   // bufferlist::c_str() is non-constant, so we can't call c_str()
   if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-    bat.Merge(rocksdb::Slice(key),
+    bat.Merge(cf, rocksdb::Slice(key),
 	       rocksdb::Slice(to_set_bl.buffers().front().c_str(),
 			    to_set_bl.length()));
   } else {
     // make a copy
     rocksdb::Slice key_slice(key);
     rocksdb::Slice value_slices[to_set_bl.buffers().size()];
-    bat.Merge(nullptr, rocksdb::SliceParts(&key_slice, 1),
+    bat.Merge(cf, rocksdb::SliceParts(&key_slice, 1),
               prepare_sliceparts(to_set_bl, value_slices));
   }
 }
@@ -711,11 +977,17 @@ int RocksDBStore::get(
     std::map<string, bufferlist> *out)
 {
   utime_t start = ceph_clock_now();
+  rocksdb::ColumnFamilyHandle *cf = get_cf_handle(prefix);
   for (std::set<string>::const_iterator i = keys.begin();
        i != keys.end(); ++i) {
     std::string value;
-    std::string bound = combine_strings(prefix, *i);
-    auto status = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(bound), &value);
+    rocksdb::Status status;
+    if (cf) {
+      status = db->Get(rocksdb::ReadOptions(), cf, rocksdb::Slice(*i), &value);
+    } else {
+      std::string bound = combine_strings(prefix, *i);
+      status = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(bound), &value);
+    }
     if (status.ok()) {
       (*out)[*i].append(value);
     } else if (status.IsIOError()) {
@@ -739,8 +1011,13 @@ int RocksDBStore::get(
   int r = 0;
   string value, k;
   rocksdb::Status s;
-  k = combine_strings(prefix, key);
-  s = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(k), &value);
+  rocksdb::ColumnFamilyHandle *cf = get_cf_handle(prefix);
+  if (cf) {
+    s = db->Get(rocksdb::ReadOptions(), cf, rocksdb::Slice(key), &value);
+  } else {
+    k = combine_strings(prefix, key);
+    s = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(k), &value);
+  }
   if (s.ok()) {
     out->append(value);
   } else if (s.IsNotFound()) {
@@ -764,9 +1041,15 @@ int RocksDBStore::get(
   utime_t start = ceph_clock_now();
   int r = 0;
   string value, k;
-  combine_strings(prefix, key, keylen, &k);
   rocksdb::Status s;
-  s = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(k), &value);
+  rocksdb::ColumnFamilyHandle *cf = get_cf_handle(prefix);
+  if (cf) {
+    s = db->Get(rocksdb::ReadOptions(), cf, rocksdb::Slice(key, keylen),
+		&value);
+  } else {
+    combine_strings(prefix, key, keylen, &k);
+    s = db->Get(rocksdb::ReadOptions(), rocksdb::Slice(k), &value);
+  }
   if (s.ok()) {
     out->append(value);
   } else if (s.IsNotFound()) {
@@ -805,6 +1088,9 @@ void RocksDBStore::compact()
   logger->inc(l_rocksdb_compact);
   rocksdb::CompactRangeOptions options;
   db->CompactRange(options, nullptr, nullptr);
+  for (auto& p : cf_handles) {
+    db->CompactRange(options, p.second, nullptr, nullptr);
+  }
 }
 
 
@@ -879,6 +1165,27 @@ bool RocksDBStore::check_omap_dir(string &omap_dir)
 void RocksDBStore::compact_range(const string& start, const string& end)
 {
   rocksdb::CompactRangeOptions options;
+
+  // ranges are expressed in combined keys; one that starts within a
+  // prefix kept in its own column family is compacted there
+  if (!cf_handles.empty()) {
+    string prefix, start_key;
+    if (split_key(rocksdb::Slice(start), &prefix, &start_key) == 0) {
+      rocksdb::ColumnFamilyHandle *cf = get_cf_handle(prefix);
+      if (cf) {
+	string end_key;
+	string end_prefix;
+	bool bounded = (split_key(rocksdb::Slice(end), &end_prefix,
+				  &end_key) == 0 && end_prefix == prefix);
+	rocksdb::Slice cstart(start_key);
+	rocksdb::Slice cend(end_key);
+	db->CompactRange(options, cf, start_key.empty() ? nullptr : &cstart,
+			 bounded ? &cend : nullptr);
+	return;
+      }
+    }
+  }
+
   rocksdb::Slice cstart(start);
   rocksdb::Slice cend(end);
   db->CompactRange(options, &cstart, &cend);
@@ -1014,7 +1321,334 @@ string RocksDBStore::past_prefix(const string &prefix)
 
 RocksDBStore::WholeSpaceIterator RocksDBStore::_get_iterator()
 {
-  return std::make_shared<RocksDBWholeSpaceIteratorImpl>(
-        db->NewIterator(rocksdb::ReadOptions()));
+  if (cf_handles.empty()) {
+    return std::make_shared<RocksDBWholeSpaceIteratorImpl>(
+          db->NewIterator(rocksdb::ReadOptions()));
+  }
+
+  // one consistent view of every family
+  std::vector<string> prefixes;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  handles.push_back(db->DefaultColumnFamily());
+  for (auto& p : cf_handles) {
+    prefixes.push_back(p.first);
+    handles.push_back(p.second);
+  }
+  std::vector<rocksdb::Iterator*> dbiters;
+  rocksdb::Status status = db->NewIterators(rocksdb::ReadOptions(), handles,
+					    &dbiters);
+  assert(status.ok());
+  assert(dbiters.size() == handles.size());
+
+  std::vector<WholeSpaceIterator> cfs;
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    cfs.push_back(std::make_shared<RocksDBCFIteratorImpl>(prefixes[i],
+							  dbiters[i + 1]));
+  }
+  return std::make_shared<RocksDBMergeIteratorImpl>(
+    std::make_shared<RocksDBWholeSpaceIteratorImpl>(dbiters[0]),
+    std::move(prefixes), std::move(cfs));
+}
+
+RocksDBStore::WholeSpaceIterator RocksDBStore::_get_prefix_iterator(
+  const string &prefix)
+{
+  rocksdb::ColumnFamilyHandle *cf = get_cf_handle(prefix);
+  if (!cf) {
+    // the prefix lives in the default family alone
+    return std::make_shared<RocksDBWholeSpaceIteratorImpl>(
+          db->NewIterator(rocksdb::ReadOptions()));
+  }
+  return std::make_shared<RocksDBCFIteratorImpl>(
+        prefix, db->NewIterator(rocksdb::ReadOptions(), cf));
+}
+
+RocksDBStore::RocksDBCFIteratorImpl::~RocksDBCFIteratorImpl()
+{
+  delete dbiter;
+}
+int RocksDBStore::RocksDBCFIteratorImpl::seek_to_first()
+{
+  dbiter->SeekToFirst();
+  assert(!dbiter->status().IsIOError());
+  return dbiter->status().ok() ? 0 : -1;
+}
+int RocksDBStore::RocksDBCFIteratorImpl::seek_to_first(const string &prefix)
+{
+  return seek_to_first();
+}
+int RocksDBStore::RocksDBCFIteratorImpl::seek_to_last()
+{
+  dbiter->SeekToLast();
+  assert(!dbiter->status().IsIOError());
+  return dbiter->status().ok() ? 0 : -1;
+}
+int RocksDBStore::RocksDBCFIteratorImpl::seek_to_last(const string &prefix)
+{
+  return seek_to_last();
+}
+int RocksDBStore::RocksDBCFIteratorImpl::upper_bound(const string &prefix, const string &after)
+{
+  lower_bound(prefix, after);
+  if (valid() && dbiter->key().compare(rocksdb::Slice(after)) == 0) {
+    next();
+  }
+  return dbiter->status().ok() ? 0 : -1;
+}
+int RocksDBStore::RocksDBCFIteratorImpl::lower_bound(const string &prefix, const string &to)
+{
+  rocksdb::Slice slice_bound(to);
+  dbiter->Seek(slice_bound);
+  return dbiter->status().ok() ? 0 : -1;
+}
+bool RocksDBStore::RocksDBCFIteratorImpl::valid()
+{
+  return dbiter->Valid();
+}
+int RocksDBStore::RocksDBCFIteratorImpl::next()
+{
+  if (valid()) {
+    dbiter->Next();
+  }
+  assert(!dbiter->status().IsIOError());
+  return dbiter->status().ok() ? 0 : -1;
+}
+int RocksDBStore::RocksDBCFIteratorImpl::prev()
+{
+  if (valid()) {
+    dbiter->Prev();
+  }
+  assert(!dbiter->status().IsIOError());
+  return dbiter->status().ok() ? 0 : -1;
+}
+string RocksDBStore::RocksDBCFIteratorImpl::key()
+{
+  return dbiter->key().ToString();
+}
+pair<string,string> RocksDBStore::RocksDBCFIteratorImpl::raw_key()
+{
+  return make_pair(prefix, key());
+}
+bool RocksDBStore::RocksDBCFIteratorImpl::raw_key_is_prefixed(const string &prefix)
+{
+  // every key in the family belongs to its prefix
+  return prefix == this->prefix;
+}
+bufferlist RocksDBStore::RocksDBCFIteratorImpl::value()
+{
+  return to_bufferlist(dbiter->value());
+}
+bufferptr RocksDBStore::RocksDBCFIteratorImpl::value_as_ptr()
+{
+  rocksdb::Slice val = dbiter->value();
+  return bufferptr(val.data(), val.size());
+}
+int RocksDBStore::RocksDBCFIteratorImpl::status()
+{
+  return dbiter->status().ok() ? 0 : -1;
+}
+size_t RocksDBStore::RocksDBCFIteratorImpl::key_size()
+{
+  return dbiter->key().size();
+}
+size_t RocksDBStore::RocksDBCFIteratorImpl::value_size()
+{
+  return dbiter->value().size();
+}
+
+RocksDBStore::RocksDBMergeIteratorImpl::RocksDBMergeIteratorImpl(
+  KeyValueDB::WholeSpaceIterator main,
+  std::vector<string> &&cf_prefixes,
+  std::vector<KeyValueDB::WholeSpaceIterator> &&cfs)
+{
+  iters.push_back(main);
+  prefixes.push_back(string());
+  for (size_t i = 0; i < cfs.size(); ++i) {
+    iters.push_back(cfs[i]);
+    prefixes.push_back(cf_prefixes[i]);
+  }
+}
+// position iters[i] at the first key at or past (prefix, to).  a family
+// holds a single prefix, so it lies wholly before or after any other one.
+void RocksDBStore::RocksDBMergeIteratorImpl::position(
+  size_t i, const string &prefix, const string &to, bool inclusive)
+{
+  KeyValueDB::WholeSpaceIterator& it = iters[i];
+  if (i > 0 && prefixes[i] != prefix) {
+    if (prefixes[i] > prefix) {
+      it->seek_to_first();
+    } else {
+      it->seek_to_last();
+      it->next();
+    }
+    return;
+  }
+  if (inclusive) {
+    it->lower_bound(prefix, to);
+  } else {
+    it->upper_bound(prefix, to);
+  }
+}
+// pick the iterator at the smallest key going forward, the largest back
+void RocksDBStore::RocksDBMergeIteratorImpl::choose()
+{
+  current = -1;
+  pair<string,string> best;
+  for (size_t i = 0; i < iters.size(); ++i) {
+    if (!iters[i]->valid()) {
+      continue;
+    }
+    pair<string,string> k = iters[i]->raw_key();
+    if (current < 0 || (forward ? k < best : k > best)) {
+      current = i;
+      best = k;
+    }
+  }
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::seek_to_first()
+{
+  for (auto& it : iters) {
+    it->seek_to_first();
+  }
+  forward = true;
+  choose();
+  return status();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::seek_to_first(const string &prefix)
+{
+  return lower_bound(prefix, string());
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::seek_to_last()
+{
+  for (auto& it : iters) {
+    it->seek_to_last();
+  }
+  forward = false;
+  choose();
+  return status();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::seek_to_last(const string &prefix)
+{
+  iters[0]->seek_to_last(prefix);
+  for (size_t i = 1; i < iters.size(); ++i) {
+    if (prefixes[i] <= prefix) {
+      iters[i]->seek_to_last();
+    } else {
+      iters[i]->seek_to_last();
+      iters[i]->next();
+    }
+  }
+  forward = false;
+  choose();
+  return status();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::upper_bound(const string &prefix, const string &after)
+{
+  for (size_t i = 0; i < iters.size(); ++i) {
+    position(i, prefix, after, false);
+  }
+  forward = true;
+  choose();
+  return status();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::lower_bound(const string &prefix, const string &to)
+{
+  for (size_t i = 0; i < iters.size(); ++i) {
+    position(i, prefix, to, true);
+  }
+  forward = true;
+  choose();
+  return status();
+}
+bool RocksDBStore::RocksDBMergeIteratorImpl::valid()
+{
+  return current >= 0 && iters[current]->valid();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::next()
+{
+  if (!valid()) {
+    return status();
+  }
+  if (!forward) {
+    // the others sit before the current key: move them past it
+    pair<string,string> k = raw_key();
+    for (size_t i = 0; i < iters.size(); ++i) {
+      if ((int)i != current) {
+	position(i, k.first, k.second, false);
+      }
+    }
+    forward = true;
+  }
+  iters[current]->next();
+  choose();
+  return status();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::prev()
+{
+  if (!valid()) {
+    return status();
+  }
+  if (forward) {
+    // the others sit past the current key: move them before it
+    pair<string,string> k = raw_key();
+    for (size_t i = 0; i < iters.size(); ++i) {
+      if ((int)i == current) {
+	continue;
+      }
+      position(i, k.first, k.second, true);
+      if (iters[i]->valid()) {
+	iters[i]->prev();
+      } else {
+	iters[i]->seek_to_last();
+      }
+    }
+    forward = false;
+  }
+  iters[current]->prev();
+  choose();
+  return status();
+}
+string RocksDBStore::RocksDBMergeIteratorImpl::key()
+{
+  return iters[current]->key();
+}
+pair<string,string> RocksDBStore::RocksDBMergeIteratorImpl::raw_key()
+{
+  return iters[current]->raw_key();
+}
+bool RocksDBStore::RocksDBMergeIteratorImpl::raw_key_is_prefixed(const string &prefix)
+{
+  return iters[current]->raw_key_is_prefixed(prefix);
+}
+bufferlist RocksDBStore::RocksDBMergeIteratorImpl::value()
+{
+  return iters[current]->value();
+}
+bufferptr RocksDBStore::RocksDBMergeIteratorImpl::value_as_ptr()
+{
+  return iters[current]->value_as_ptr();
+}
+int RocksDBStore::RocksDBMergeIteratorImpl::status()
+{
+  for (auto& it : iters) {
+    int r = it->status();
+    if (r < 0) {
+      return r;
+    }
+  }
+  return 0;
+}
+size_t RocksDBStore::RocksDBMergeIteratorImpl::key_size()
+{
+  // as stored in the default family: prefix, separator and key
+  size_t size = iters[current]->key_size();
+  if (current > 0) {
+    size += prefixes[current].size() + 1;
+  }
+  return size;
+}
+size_t RocksDBStore::RocksDBMergeIteratorImpl::value_size()
+{
+  return iters[current]->value_size();
 }
 
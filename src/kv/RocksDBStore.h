@@ -10,6 +10,7 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <boost/scoped_ptr.hpp>
 #include "rocksdb/write_batch.h"
 #include "rocksdb/perf_context.h"
@@ -49,6 +50,7 @@ namespace rocksdb{
   class DB;
   class Env;
   class Cache;
+  class ColumnFamilyHandle;
   class FilterPolicy;
   class Snapshot;
   class Slice;
@@ -56,6 +58,7 @@ namespace rocksdb{
   class Iterator;
   class Logger;
   struct Options;
+  struct ColumnFamilyOptions;
   struct BlockBasedTableOptions;
 }
 
@@ -77,7 +80,19 @@ class RocksDBStore : public KeyValueDB {
 
   uint64_t cache_size = 0;
 
+  /// prefixes kept in their own column family, as configured
+  std::vector<ColumnFamily> cf_specs;
+  /// open column families by prefix (the default family is not included)
+  std::unordered_map<std::string, rocksdb::ColumnFamilyHandle*> cf_handles;
+
   int do_open(ostream &out, bool create_if_missing);
+  int open_column_families(rocksdb::Options &opt,
+			   const std::vector<std::string> &existing_cfs);
+  int create_cf_options(const std::string &prefix, const std::string &options,
+			const rocksdb::Options &opt,
+			rocksdb::ColumnFamilyOptions *cf_opt);
+  int migrate_column_family(const std::string &prefix,
+			    rocksdb::ColumnFamilyHandle *cf);
 
   // manage async compactions
   Mutex compact_queue_lock;
@@ -113,10 +128,11 @@ public:
   int init(string options_str) override;
   /// compact rocksdb for all keys with a given prefix
   void compact_prefix(const string& prefix) override {
-    compact_range(prefix, past_prefix(prefix));
+    compact_range(combine_strings(prefix, string()), past_prefix(prefix));
   }
   void compact_prefix_async(const string& prefix) override {
-    compact_range_async(prefix, past_prefix(prefix));
+    compact_range_async(combine_strings(prefix, string()),
+			past_prefix(prefix));
   }
 
   void compact_range(const string& prefix, const string& start, const string& end) override {
@@ -152,6 +168,15 @@ public:
   /// Creates underlying db if missing and opens it
   int create_and_open(ostream &out) override;
 
+  int set_column_families(const std::vector<ColumnFamily>& cfs) override;
+  rocksdb::ColumnFamilyHandle *get_cf_handle(const string &prefix) {
+    auto p = cf_handles.find(prefix);
+    if (p == cf_handles.end()) {
+      return nullptr;
+    }
+    return p->second;
+  }
+
   void close() override;
 
   void split_stats(const std::string &s, char delim, std::vector<std::string> &elems);
@@ -255,6 +280,12 @@ public:
     RocksDBStore *db;
 
     explicit RocksDBTransactionImpl(RocksDBStore *_db);
+  private:
+    void put_bat(
+      rocksdb::ColumnFamilyHandle *cf,
+      const string &k,
+      const bufferlist &bl);
+  public:
     void set(
       const string &prefix,
       const string &k,
@@ -339,6 +370,73 @@ public:
     size_t value_size() override;
   };
 
+  /// iterates a single prefix kept in its own column family, where keys
+  /// are stored without the prefix
+  class RocksDBCFIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+  protected:
+    string prefix;
+    rocksdb::Iterator *dbiter;
+  public:
+    RocksDBCFIteratorImpl(const string &prefix, rocksdb::Iterator *iter) :
+      prefix(prefix), dbiter(iter) { }
+    ~RocksDBCFIteratorImpl() override;
+
+    int seek_to_first() override;
+    int seek_to_first(const string &prefix) override;
+    int seek_to_last() override;
+    int seek_to_last(const string &prefix) override;
+    int upper_bound(const string &prefix, const string &after) override;
+    int lower_bound(const string &prefix, const string &to) override;
+    bool valid() override;
+    int next() override;
+    int prev() override;
+    string key() override;
+    pair<string,string> raw_key() override;
+    bool raw_key_is_prefixed(const string &prefix) override;
+    bufferlist value() override;
+    bufferptr value_as_ptr() override;
+    int status() override;
+    size_t key_size() override;
+    size_t value_size() override;
+  };
+
+  /// iterates the whole key space by merging the default family with the
+  /// prefixes kept in their own column families, in raw key order
+  class RocksDBMergeIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+  protected:
+    /// iters[0] covers the default family, the rest one family each
+    std::vector<KeyValueDB::WholeSpaceIterator> iters;
+    std::vector<string> prefixes;   ///< family prefix, "" for iters[0]
+    int current = -1;               ///< index of the iterator at the key
+    bool forward = true;            ///< direction of the last move
+
+    void position(size_t i, const string &prefix, const string &to,
+		  bool inclusive);
+    void choose();
+  public:
+    RocksDBMergeIteratorImpl(KeyValueDB::WholeSpaceIterator main,
+			     std::vector<string> &&prefixes,
+			     std::vector<KeyValueDB::WholeSpaceIterator> &&cfs);
+
+    int seek_to_first() override;
+    int seek_to_first(const string &prefix) override;
+    int seek_to_last() override;
+    int seek_to_last(const string &prefix) override;
+    int upper_bound(const string &prefix, const string &after) override;
+    int lower_bound(const string &prefix, const string &to) override;
+    bool valid() override;
+    int next() override;
+    int prev() override;
+    string key() override;
+    pair<string,string> raw_key() override;
+    bool raw_key_is_prefixed(const string &prefix) override;
+    bufferlist value() override;
+    bufferptr value_as_ptr() override;
+    int status() override;
+    size_t key_size() override;
+    size_t value_size() override;
+  };
+
   /// Utility
   static string combine_strings(const string &prefix, const string &value) {
     string out = prefix;
@@ -366,6 +464,7 @@ public:
   static string past_prefix(const string &prefix);
 
   class MergeOperatorRouter;
+  class MergeOperatorLinker;
   friend class MergeOperatorRouter;
   int set_merge_operator(const std::string& prefix,
 				 std::shared_ptr<KeyValueDB::MergeOperator> mop) override;
@@ -444,6 +543,7 @@ err:
 
 protected:
   WholeSpaceIterator _get_iterator() override;
+  WholeSpaceIterator _get_prefix_iterator(const string &prefix) override;
 };
 
 
@@ -3,13 +3,29 @@
 #include "librbd/AsyncObjectThrottle.h"
 #include "common/RWLock.h"
 #include "common/WorkQueue.h"
+#include "common/dout.h"
+#include "common/perf_counters.h"
 #include "librbd/AsyncRequest.h"
 #include "librbd/ImageCtx.h"
+#include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
+#include "librbd/internal.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::AsyncObjectThrottle: " << this \
+                           << " " << __func__ << ": "
 
 namespace librbd
 {
 
+namespace {
+
+// objects scanned per object map lock acquisition when skipping
+const uint64_t SKIP_BATCH_OBJECTS = 4096;
+
+} // anonymous namespace
+
 template <typename T>
 AsyncObjectThrottle<T>::AsyncObjectThrottle(
     const AsyncRequest<T>* async_request, T &image_ctx,
@@ -29,6 +45,17 @@ void AsyncObjectThrottle<T>::start_ops(uint64_t max_concurrent) {
   bool complete;
   {
     Mutex::Locker l(m_lock);
+    m_start_time = ceph::mono_clock::now();
+    m_window = std::max<uint64_t>(max_concurrent, 1);
+    if (m_image_ctx.concurrent_management_ops_max > 0 &&
+        static_cast<uint64_t>(m_image_ctx.concurrent_management_ops_max) >
+          m_window) {
+      m_max_window = m_image_ctx.concurrent_management_ops_max;
+    } else {
+      m_max_window = m_window;
+    }
+    m_image_ctx.perfcounter->set(l_librbd_mgmt_window, m_window);
+
     for (uint64_t i = 0; i < max_concurrent; ++i) {
       start_next_op();
       if (m_ret < 0 && m_current_ops == 0) {
@@ -36,6 +63,9 @@ void AsyncObjectThrottle<T>::start_ops(uint64_t max_concurrent) {
       }
     }
     complete = (m_current_ops == 0);
+    if (complete) {
+      finish();
+    }
   }
   if (complete) {
     // avoid re-entrant callback
@@ -45,7 +75,7 @@ void AsyncObjectThrottle<T>::start_ops(uint64_t max_concurrent) {
 }
 
 template <typename T>
-void AsyncObjectThrottle<T>::finish_op(int r) {
+void AsyncObjectThrottle<T>::finish_op(int r, const ceph::timespan &latency) {
   bool complete;
   {
     RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
@@ -55,8 +85,20 @@ void AsyncObjectThrottle<T>::finish_op(int r) {
       m_ret = r;
     }
 
-    start_next_op();
+    m_image_ctx.perfcounter->tinc(l_librbd_mgmt_latency, latency);
+    update_window(latency);
+
+    while (m_current_ops < m_window) {
+      uint64_t current_ops = m_current_ops;
+      start_next_op();
+      if (m_current_ops == current_ops) {
+        break;
+      }
+    }
     complete = (m_current_ops == 0);
+    if (complete) {
+      finish();
+    }
   }
   if (complete) {
     m_ctx->complete(m_ret);
@@ -77,10 +119,19 @@ void AsyncObjectThrottle<T>::start_next_op() {
       return;
     }
 
+    if (m_skip_nonexistent) {
+      skip_objects();
+      if (m_object_no >= m_end_object_no) {
+        return;
+      }
+    }
+
     uint64_t ono = m_object_no++;
     C_AsyncObjectThrottle<T> *ctx = m_context_factory(*this, ono);
 
     int r = ctx->send();
+    ++m_objects;
+    m_image_ctx.perfcounter->inc(l_librbd_mgmt_objects);
     if (r < 0) {
       m_ret = r;
       delete ctx;
@@ -98,6 +149,96 @@ void AsyncObjectThrottle<T>::start_next_op() {
   }
 }
 
+template <typename T>
+void AsyncObjectThrottle<T>::skip_objects() {
+  assert(m_lock.is_locked());
+
+  uint64_t start_object_no = m_object_no;
+  while (m_object_no < m_end_object_no) {
+    uint64_t end_object_no = std::min(m_object_no + SKIP_BATCH_OBJECTS,
+                                      m_end_object_no);
+    uint64_t object_no;
+    {
+      RWLock::RLocker snap_locker(m_image_ctx.snap_lock);
+      if (m_image_ctx.object_map == nullptr) {
+        break;
+      }
+      object_no = m_image_ctx.object_map->next_object_may_exist(
+        m_object_no, end_object_no);
+    }
+    m_object_no = object_no;
+    if (object_no < end_object_no) {
+      break;
+    }
+  }
+
+  uint64_t skipped = m_object_no - start_object_no;
+  if (skipped == 0) {
+    return;
+  }
+
+  m_skipped += skipped;
+  m_image_ctx.perfcounter->inc(l_librbd_mgmt_objects_skipped, skipped);
+  if (m_prog_ctx != NULL) {
+    m_prog_ctx->update_progress(m_object_no, m_end_object_no);
+  }
+}
+
+template <typename T>
+void AsyncObjectThrottle<T>::update_window(const ceph::timespan &latency) {
+  assert(m_lock.is_locked());
+  if (m_max_window <= 1) {
+    return;
+  }
+
+  m_round_latency += latency;
+  if (++m_round_ops < m_window) {
+    return;
+  }
+
+  ceph::timespan avg_latency = m_round_latency / m_round_ops;
+  m_round_ops = 0;
+  m_round_latency = ceph::timespan::zero();
+
+  uint64_t window = m_window;
+  if (m_base_latency == ceph::timespan::zero() ||
+      avg_latency < m_base_latency) {
+    m_base_latency = avg_latency;
+  }
+  if (avg_latency <= m_base_latency + m_base_latency / 4) {
+    if (m_window < m_max_window) {
+      ++m_window;
+    }
+  } else if (avg_latency > 2 * m_base_latency) {
+    m_window = std::max<uint64_t>(m_window / 2, 1);
+
+    // let the baseline follow a lasting slowdown so the window can
+    // recover instead of being pinned at its minimum
+    m_base_latency += (avg_latency - m_base_latency) / 8;
+  }
+
+  if (m_window != window) {
+    ldout(m_image_ctx.cct, 20) << "avg_latency=" << avg_latency
+                               << ", base_latency=" << m_base_latency
+                               << ", window=" << m_window << dendl;
+    m_image_ctx.perfcounter->set(l_librbd_mgmt_window, m_window);
+  }
+}
+
+template <typename T>
+void AsyncObjectThrottle<T>::finish() {
+  assert(m_lock.is_locked());
+
+  double elapsed = std::chrono::duration<double>(
+    ceph::mono_clock::now() - m_start_time).count();
+  ldout(m_image_ctx.cct, 10) << "r=" << m_ret << ", objects=" << m_objects
+                             << ", skipped=" << m_skipped
+                             << ", elapsed=" << elapsed << "s, "
+                             << "objects/s="
+                             << (elapsed > 0 ? m_objects / elapsed : 0)
+                             << ", window=" << m_window << dendl;
+}
+
 } // namespace librbd
 
 #ifndef TEST_F
@@ -5,6 +5,7 @@
 
 #include "include/int_types.h"
 #include "include/Context.h"
+#include "common/ceph_time.h"
 
 #include <boost/function.hpp>
 
@@ -17,7 +18,7 @@ struct ImageCtx;
 class AsyncObjectThrottleFinisher {
 public:
   virtual ~AsyncObjectThrottleFinisher() {};
-  virtual void finish_op(int r) = 0;
+  virtual void finish_op(int r, const ceph::timespan &latency) = 0;
 };
 
 template <typename ImageCtxT = ImageCtx>
@@ -25,7 +26,8 @@ class C_AsyncObjectThrottle : public Context {
 public:
   C_AsyncObjectThrottle(AsyncObjectThrottleFinisher &finisher,
                         ImageCtxT &image_ctx)
-    : m_image_ctx(image_ctx), m_finisher(finisher) {
+    : m_image_ctx(image_ctx), m_finisher(finisher),
+      m_start_time(ceph::mono_clock::now()) {
   }
 
   virtual int send() = 0;
@@ -34,13 +36,25 @@ protected:
   ImageCtxT &m_image_ctx;
 
   void finish(int r) override {
-    m_finisher.finish_op(r);
+    m_finisher.finish_op(r, ceph::mono_clock::now() - m_start_time);
   }
 
 private:
   AsyncObjectThrottleFinisher &m_finisher;
+  ceph::mono_time m_start_time;
 };
 
+/**
+ * Issues one operation per object over a range of objects, keeping a
+ * window of them in flight.
+ *
+ * If rbd_concurrent_management_ops_max is above the initial window, the
+ * window is adjusted once per round (a window's worth of completions):
+ * it grows by one while the average per-object latency stays close to the
+ * best round seen so far and is halved when latency doubles, so large
+ * operations speed up on an idle cluster without swamping a busy one.
+ */
+
 template <typename ImageCtxT = ImageCtx>
 class AsyncObjectThrottle : public AsyncObjectThrottleFinisher {
 public:
@@ -54,8 +68,13 @@ public:
 		      ProgressContext *prog_ctx, uint64_t object_no,
 		      uint64_t end_object_no);
 
+  /// skip objects the object map reports as non-existent
+  void skip_nonexistent_objects() {
+    m_skip_nonexistent = true;
+  }
+
   void start_ops(uint64_t max_concurrent);
-  void finish_op(int r) override;
+  void finish_op(int r, const ceph::timespan &latency) override;
 
 private:
   Mutex m_lock;
@@ -68,8 +87,22 @@ private:
   uint64_t m_end_object_no;
   uint64_t m_current_ops;
   int m_ret;
+  bool m_skip_nonexistent = false;
+
+  uint64_t m_window = 0;
+  uint64_t m_max_window = 0;
+  uint64_t m_round_ops = 0;
+  ceph::timespan m_round_latency = ceph::timespan::zero();
+  ceph::timespan m_base_latency = ceph::timespan::zero();
+
+  ceph::mono_time m_start_time;
+  uint64_t m_objects = 0;
+  uint64_t m_skipped = 0;
 
   void start_next_op();
+  void skip_objects();
+  void update_window(const ceph::timespan &latency);
+  void finish();
 };
 
 } // namespace librbd
@@ -24,6 +24,7 @@
 #include "librbd/operation/ResizeRequest.h"
 #include "librbd/Utils.h"
 #include "librbd/LibrbdWriteback.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/exclusive_lock/AutomaticPolicy.h"
 #include "librbd/exclusive_lock/StandardPolicy.h"
 #include "librbd/io/AioCompletion.h"
@@ -306,6 +307,7 @@ struct C_InvalidateCache : public Context {
       ldout(cct, 10) << " cache bytes " << cache_size
 	<< " -> about " << obj << " objects" << dendl;
       object_cacher->set_max_objects(obj);
+      object_cacher->set_adaptive(cache_adaptive);
 
       object_set = new ObjectCacher::ObjectSet(NULL, data_ctx.get_id(), 0);
       object_set->return_enoent = true;
@@ -363,12 +365,40 @@ struct C_InvalidateCache : public Context {
   void ImageCtx::perf_start(string name) {
     PerfCountersBuilder plb(cct, name, l_librbd_first, l_librbd_last);
 
+    // latency in nanoseconds, log2 buckets from 1usec up
+    PerfHistogramCommon::axis_config_d lat_hist_x_axis_config{
+      "Latency (usec)",
+      PerfHistogramCommon::SCALE_LOG2,
+      0,
+      1000,
+      32,
+    };
+    PerfHistogramCommon::axis_config_d lat_hist_y_axis_config{
+      "Request size (bytes)",
+      PerfHistogramCommon::SCALE_LOG2,
+      0,
+      512,
+      32,
+    };
+
     plb.add_u64_counter(l_librbd_rd, "rd", "Reads");
     plb.add_u64_counter(l_librbd_rd_bytes, "rd_bytes", "Data size in reads");
     plb.add_time_avg(l_librbd_rd_latency, "rd_latency", "Latency of reads");
+    plb.add_u64_counter_histogram(l_librbd_rd_latency_hist,
+                                  "rd_latency_histogram",
+                                  lat_hist_x_axis_config,
+                                  lat_hist_y_axis_config,
+                                  "Histogram of read latency + size");
+    plb.add_u64_counter(l_librbd_rd_fast_path, "rd_fast_path",
+                        "Reads dispatched without the AIO work queue");
     plb.add_u64_counter(l_librbd_wr, "wr", "Writes");
     plb.add_u64_counter(l_librbd_wr_bytes, "wr_bytes", "Written data");
     plb.add_time_avg(l_librbd_wr_latency, "wr_latency", "Write latency");
+    plb.add_u64_counter_histogram(l_librbd_wr_latency_hist,
+                                  "wr_latency_histogram",
+                                  lat_hist_x_axis_config,
+                                  lat_hist_y_axis_config,
+                                  "Histogram of write latency + size");
     plb.add_u64_counter(l_librbd_discard, "discard", "Discards");
     plb.add_u64_counter(l_librbd_discard_bytes, "discard_bytes", "Discarded data");
     plb.add_time_avg(l_librbd_discard_latency, "discard_latency", "Discard latency");
@@ -387,6 +417,14 @@ struct C_InvalidateCache : public Context {
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead");
     plb.add_u64_counter(l_librbd_invalidate_cache, "invalidate_cache", "Cache invalidates");
+    plb.add_u64_counter(l_librbd_mgmt_objects, "mgmt_objects",
+                        "Objects processed by management operations");
+    plb.add_u64_counter(l_librbd_mgmt_objects_skipped, "mgmt_objects_skipped",
+                        "Non-existent objects skipped by management operations");
+    plb.add_time_avg(l_librbd_mgmt_latency, "mgmt_latency",
+                     "Per-object latency of management operations");
+    plb.add_u64(l_librbd_mgmt_window, "mgmt_window",
+                "Concurrent objects in flight for management operations");
 
     perfcounter = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perfcounter);
@@ -902,6 +940,17 @@ struct C_InvalidateCache : public Context {
       // flush cache after completing all in-flight AIO ops
       on_safe = new C_FlushCache(this, on_safe);
     }
+    if (image_cache != nullptr) {
+      // destage the persistent cache log ahead of the object cache
+      Context *on_destaged = on_safe;
+      on_safe = new FunctionContext([this, on_destaged](int r) {
+          if (r < 0 || image_cache == nullptr) {
+            on_destaged->complete(r);
+            return;
+          }
+          image_cache->flush(on_destaged);
+        });
+    }
     flush_async_operations(on_safe);
   }
 
@@ -963,6 +1012,7 @@ struct C_InvalidateCache : public Context {
     ldout(cct, 20) << __func__ << dendl;
     std::map<string, bool> configs = boost::assign::map_list_of(
         "rbd_non_blocking_aio", false)(
+        "rbd_read_fast_path", false)(
         "rbd_cache", false)(
         "rbd_cache_writethrough_until_flush", false)(
         "rbd_cache_size", false)(
@@ -971,7 +1021,11 @@ struct C_InvalidateCache : public Context {
         "rbd_cache_max_dirty_age", false)(
         "rbd_cache_max_dirty_object", false)(
         "rbd_cache_block_writes_upfront", false)(
+        "rbd_cache_adaptive", false)(
+        "rbd_persistent_cache_path", false)(
+        "rbd_persistent_cache_size", false)(
         "rbd_concurrent_management_ops", false)(
+        "rbd_concurrent_management_ops_max", false)(
         "rbd_balance_snap_reads", false)(
         "rbd_localize_snap_reads", false)(
         "rbd_balance_parent_reads", false)(
@@ -1021,6 +1075,7 @@ struct C_InvalidateCache : public Context {
     } while (0);
 
     ASSIGN_OPTION(non_blocking_aio);
+    ASSIGN_OPTION(read_fast_path);
     ASSIGN_OPTION(cache);
     ASSIGN_OPTION(cache_writethrough_until_flush);
     ASSIGN_OPTION(cache_size);
@@ -1029,7 +1084,11 @@ struct C_InvalidateCache : public Context {
     ASSIGN_OPTION(cache_max_dirty_age);
     ASSIGN_OPTION(cache_max_dirty_object);
     ASSIGN_OPTION(cache_block_writes_upfront);
+    ASSIGN_OPTION(cache_adaptive);
+    ASSIGN_OPTION(persistent_cache_path);
+    ASSIGN_OPTION(persistent_cache_size);
     ASSIGN_OPTION(concurrent_management_ops);
+    ASSIGN_OPTION(concurrent_management_ops_max);
     ASSIGN_OPTION(balance_snap_reads);
     ASSIGN_OPTION(localize_snap_reads);
     ASSIGN_OPTION(balance_parent_reads);
@@ -163,6 +163,7 @@ namespace librbd {
     // Configuration
     static const string METADATA_CONF_PREFIX;
     bool non_blocking_aio;
+    bool read_fast_path;
     bool cache;
     bool cache_writethrough_until_flush;
     uint64_t cache_size;
@@ -171,7 +172,11 @@ namespace librbd {
     double cache_max_dirty_age;
     uint32_t cache_max_dirty_object;
     bool cache_block_writes_upfront;
+    bool cache_adaptive;
+    std::string persistent_cache_path;
+    uint64_t persistent_cache_size;
     uint32_t concurrent_management_ops;
+    uint32_t concurrent_management_ops_max;
     bool balance_snap_reads;
     bool localize_snap_reads;
     bool balance_parent_reads;
@@ -6,6 +6,7 @@
 
 #include "include/int_types.h"
 #include "common/Mutex.h"
+#include <atomic>
 #include <list>
 #include <string>
 #include <utility>
@@ -36,6 +37,11 @@ public:
 
   bool is_refresh_required() const;
 
+  /// lock-free: a header update was seen but has not been refreshed yet
+  bool is_update_pending() const {
+    return m_last_refresh != m_refresh_seq;
+  }
+
   int refresh();
   int refresh_if_required();
   void refresh(Context *on_finish);
@@ -108,8 +114,9 @@ private:
   mutable Mutex m_lock;
   ActionsContexts m_actions_contexts;
 
-  uint64_t m_last_refresh;
-  uint64_t m_refresh_seq;
+  // updated under m_lock, read without it by is_update_pending()
+  std::atomic<uint64_t> m_last_refresh;
+  std::atomic<uint64_t> m_refresh_seq;
 
   ImageUpdateWatchers *m_update_watchers;
 
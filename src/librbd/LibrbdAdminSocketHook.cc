@@ -2,6 +2,8 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "common/errno.h"
+#include "common/Formatter.h"
+#include "common/perf_counters.h"
 
 #include "librbd/ImageCtx.h"
 #include "librbd/LibrbdAdminSocketHook.h"
@@ -16,14 +18,14 @@ namespace librbd {
 class LibrbdAdminSocketCommand {
 public:
   virtual ~LibrbdAdminSocketCommand() {}
-  virtual bool call(stringstream *ss) = 0;
+  virtual bool call(Formatter *f, stringstream *ss) = 0;
 };
 
 class FlushCacheCommand : public LibrbdAdminSocketCommand {
 public:
   explicit FlushCacheCommand(ImageCtx *ictx) : ictx(ictx) {}
 
-  bool call(stringstream *ss) override {
+  bool call(Formatter *f, stringstream *ss) override {
     int r = flush(ictx);
     if (r < 0) {
       *ss << "flush: " << cpp_strerror(r);
@@ -40,7 +42,7 @@ struct InvalidateCacheCommand : public LibrbdAdminSocketCommand {
 public:
   explicit InvalidateCacheCommand(ImageCtx *ictx) : ictx(ictx) {}
 
-  bool call(stringstream *ss) override {
+  bool call(Formatter *f, stringstream *ss) override {
     int r = invalidate_cache(ictx);
     if (r < 0) {
       *ss << "invalidate_cache: " << cpp_strerror(r);
@@ -53,6 +55,22 @@ private:
   ImageCtx *ictx;
 };
 
+class PerfHistogramDumpCommand : public LibrbdAdminSocketCommand {
+public:
+  explicit PerfHistogramDumpCommand(ImageCtx *ictx) : ictx(ictx) {}
+
+  bool call(Formatter *f, stringstream *ss) override {
+    f->open_object_section("perf_histograms");
+    ictx->perfcounter->dump_formatted_histograms(f, false);
+    f->close_section();
+    f->flush(*ss);
+    return true;
+  }
+
+private:
+  ImageCtx *ictx;
+};
+
 LibrbdAdminSocketHook::LibrbdAdminSocketHook(ImageCtx *ictx) :
   admin_socket(ictx->cct->get_admin_socket()) {
 
@@ -77,6 +95,14 @@ LibrbdAdminSocketHook::LibrbdAdminSocketHook(ImageCtx *ictx) :
   if (r == 0) {
     commands[command] = new InvalidateCacheCommand(ictx);
   }
+
+  command = "rbd perf histogram dump " + imagename;
+  r = admin_socket->register_command(command, command, this,
+				     "dump rbd image " + imagename +
+				     " latency histograms");
+  if (r == 0) {
+    commands[command] = new PerfHistogramDumpCommand(ictx);
+  }
 }
 
 LibrbdAdminSocketHook::~LibrbdAdminSocketHook() {
@@ -91,8 +117,10 @@ bool LibrbdAdminSocketHook::call(std::string command, cmdmap_t& cmdmap,
 				 std::string format, bufferlist& out) {
   Commands::const_iterator i = commands.find(command);
   assert(i != commands.end());
+  Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
   stringstream ss;
-  bool r = i->second->call(&ss);
+  bool r = i->second->call(f, &ss);
+  delete f;
   out.append(ss);
   return r;
 }
@@ -110,6 +110,37 @@ bool ObjectMap<I>::object_may_exist(uint64_t object_no) const
   return exists;
 }
 
+template <typename I>
+uint64_t ObjectMap<I>::next_object_may_exist(uint64_t object_no,
+                                             uint64_t end_object_no) const
+{
+  assert(m_image_ctx.snap_lock.is_locked());
+
+  if (!m_image_ctx.test_features(RBD_FEATURE_OBJECT_MAP,
+                                 m_image_ctx.snap_lock)) {
+    return object_no;
+  }
+
+  bool flags_set;
+  int r = m_image_ctx.test_flags(RBD_FLAG_OBJECT_MAP_INVALID,
+                                 m_image_ctx.snap_lock, &flags_set);
+  if (r < 0 || flags_set) {
+    return object_no;
+  }
+
+  // objects past the end of the map are treated as possibly existing
+  RWLock::RLocker l(m_image_ctx.object_map_lock);
+  uint64_t start_object_no = object_no;
+  end_object_no = std::min(end_object_no, m_object_map.size());
+  while (object_no < end_object_no &&
+         m_object_map[object_no] == OBJECT_NONEXISTENT) {
+    ++object_no;
+  }
+  ldout(m_image_ctx.cct, 20) << "start_object_no=" << start_object_no
+                             << ", object_no=" << object_no << dendl;
+  return object_no;
+}
+
 template <typename I>
 bool ObjectMap<I>::update_required(uint64_t object_no, uint8_t new_state) {
   assert(m_image_ctx.object_map_lock.is_wlocked());
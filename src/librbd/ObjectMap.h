@@ -48,6 +48,8 @@ public:
   void close(Context *on_finish);
 
   bool object_may_exist(uint64_t object_no) const;
+  uint64_t next_object_may_exist(uint64_t object_no,
+                                 uint64_t end_object_no) const;
 
   void aio_save(Context *on_finish);
   void aio_resize(uint64_t new_size, uint8_t default_object_state,
@@ -57,14 +57,23 @@ public:
   template <typename I>
   C_DiffObject(I &image_ctx, librados::IoCtx &head_ctx,
                DiffContext &diff_context, const std::string &oid,
-               uint64_t offset, const std::vector<ObjectExtent> &object_extents)
+               uint64_t offset, const std::vector<ObjectExtent> &object_extents,
+               bool skip_list_snaps = false)
     : m_cct(image_ctx.cct), m_head_ctx(head_ctx),
       m_diff_context(diff_context), m_oid(oid), m_offset(offset),
-      m_object_extents(object_extents), m_snap_ret(0) {
+      m_object_extents(object_extents), m_skip_list_snaps(skip_list_snaps),
+      m_snap_ret(0) {
   }
 
   void send() {
     C_OrderedThrottle *ctx = m_diff_context.throttle.start_op(this);
+    if (m_skip_list_snaps) {
+      // the object map shows that the object was never created: only the
+      // parent overlap needs to be reported, which requires no round trip
+      ctx->complete(-ENOENT);
+      return;
+    }
+
     librados::AioCompletion *rados_completion =
       util::create_rados_callback(ctx);
 
@@ -119,6 +128,7 @@ private:
   std::string m_oid;
   uint64_t m_offset;
   std::vector<ObjectExtent> m_object_extents;
+  bool m_skip_list_snaps;
 
   librados::snap_set_t m_snap_set;
   int m_snap_ret;
@@ -290,7 +300,7 @@ int DiffIterate<I>::execute() {
   BitVector<2> object_diff_state;
   {
     RWLock::RLocker snap_locker(m_image_ctx.snap_lock);
-    if (m_whole_object && (m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
+    if ((m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
       r = diff_object_map(from_snap_id, end_snap_id, &object_diff_state);
       if (r < 0) {
         ldout(cct, 5) << "fast diff disabled" << dendl;
@@ -334,6 +344,8 @@ int DiffIterate<I>::execute() {
   uint64_t period = m_image_ctx.get_stripe_period();
   uint64_t off = m_offset;
   uint64_t left = m_length;
+  uint64_t listed_objects = 0;
+  uint64_t pruned_objects = 0;
 
   while (left > 0) {
     uint64_t period_off = off - (off % period);
@@ -351,7 +363,21 @@ int DiffIterate<I>::execute() {
          p != object_extents.end(); ++p) {
       ldout(cct, 20) << "object " << p->first << dendl;
 
-      if (fast_diff_enabled) {
+      bool skip_list_snaps = false;
+      if (fast_diff_enabled && !m_whole_object) {
+        // the object map cannot provide extents, but objects it shows as
+        // unchanged do not need to be listed
+        const uint64_t object_no = p->second.front().objectno;
+        if (object_diff_state[object_no] == OBJECT_DIFF_STATE_NONE) {
+          ++pruned_objects;
+          if (from_snap_id != 0 || diff_context.parent_diff.empty()) {
+            continue;
+          }
+          skip_list_snaps = true;
+        }
+      }
+
+      if (fast_diff_enabled && m_whole_object) {
         const uint64_t object_no = p->second.front().objectno;
         if (object_diff_state[object_no] != OBJECT_DIFF_STATE_NONE) {
           bool updated = (object_diff_state[object_no] ==
@@ -365,10 +391,14 @@ int DiffIterate<I>::execute() {
           }
         }
       } else {
+        if (!skip_list_snaps) {
+          ++listed_objects;
+        }
         C_DiffObject *diff_object = new C_DiffObject(m_image_ctx, head_ctx,
                                                      diff_context,
                                                      p->first.name, off,
-                                                     p->second);
+                                                     p->second,
+                                                     skip_list_snaps);
         diff_object->send();
 
         if (diff_context.throttle.pending_error()) {
@@ -386,6 +416,10 @@ int DiffIterate<I>::execute() {
   if (r < 0) {
     return r;
   }
+
+  ldout(cct, 10) << "diff_iterate listed " << listed_objects << " objects, "
+                 << "pruned " << pruned_objects << " via the object map"
+                 << dendl;
   return 0;
 }
 
@@ -0,0 +1,1069 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "WriteLogImageCache.h"
+#include "include/Context.h"
+#include "include/byteorder.h"
+#include "include/intarith.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "librbd/ExclusiveLock.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::WriteLogImageCache: " << this << " " \
+                           <<  __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+namespace {
+
+const uint64_t LOG_MAGIC = 0x726264776c6f6731ULL;  // "rbdwlog1"
+const uint32_t LOG_VERSION = 1;
+const uint32_t ENTRY_MAGIC = 0x776c6f65;
+const uint64_t LOG_DATA_START = 4096;   // superblock lives below
+const uint64_t LOG_ALIGN = 512;
+const uint64_t LOG_MIN_SIZE = 16 << 20;
+const uint64_t MAX_ENTRY_DATA = 1 << 20;
+const uint32_t MAX_DESTAGE_IN_FLIGHT = 32;
+const size_t DESTAGE_FLUSH_BATCH = 64;
+
+struct superblock_t {
+  ceph_le64 magic;
+  ceph_le32 version;
+  ceph_le32 crc;            // of the superblock with crc zeroed
+  ceph_le32 generation;
+  ceph_le64 size;
+  ceph_le64 head;
+  ceph_le64 head_seq;
+} __attribute__ ((packed));
+
+struct entry_header_t {
+  ceph_le32 magic;
+  ceph_le32 crc;            // of the header with crc zeroed, then the data
+  ceph_le32 generation;     // never decreases along the log
+  ceph_le64 seq;
+  ceph_le64 image_offset;
+  ceph_le64 length;
+  ceph_le32 data_len;
+  __u8 type;
+  __u8 skip_partial_discard;
+  __u8 pad[2];
+} __attribute__ ((packed));
+
+uint64_t entry_log_length(uint64_t data_len) {
+  return ROUND_UP_TO(sizeof(entry_header_t) + data_len, LOG_ALIGN);
+}
+
+bool overlaps(uint64_t offset, uint64_t length,
+              const ImageCache::Extents &image_extents) {
+  for (auto &extent : image_extents) {
+    if (offset < extent.first + extent.second &&
+        extent.first < offset + length) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+template <typename I>
+WriteLogImageCache<I>::WriteLogImageCache(I &image_ctx,
+                                          const std::string &path,
+                                          uint64_t size)
+  : m_image_ctx(image_ctx), m_image_writeback(image_ctx), m_path(path),
+    m_size(std::max(size, LOG_MIN_SIZE) & ~(LOG_ALIGN - 1)),
+    m_lock("librbd::cache::WriteLogImageCache::m_lock"), m_writer(this) {
+}
+
+template <typename I>
+WriteLogImageCache<I>::~WriteLogImageCache() {
+  stop_writer();
+  if (m_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_read(Extents &&image_extents, bufferlist *bl,
+                                     int fadvise_flags, Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  Overlay overlay;
+  int r = 0;
+  {
+    Mutex::Locker locker(m_lock);
+    std::vector<LogEntryRef> writes;
+    uint64_t barrier_seq = 0;
+    for (auto &entry : m_entries) {
+      if (entry->destaged || entry->failed || entry->type == ENTRY_WRAP ||
+          !overlaps(entry->image_offset, entry->length, image_extents)) {
+        continue;
+      }
+      if (entry->type == ENTRY_WRITE) {
+        writes.push_back(entry);
+      } else {
+        barrier_seq = entry->seq;
+      }
+    }
+
+    if (barrier_seq != 0 && m_destage_error < 0) {
+      // the barrier will not reach the image until the log is replayed:
+      // the image data underneath it is stale
+      r = m_destage_error;
+    } else if (barrier_seq != 0) {
+      // discards and writesames are not laid over the image data: let them
+      // reach the image first
+      ldout(cct, 20) << "waiting for seq " << barrier_seq << " to retire"
+                     << dendl;
+      Extents extents(image_extents);
+      m_retire_waiters.insert({barrier_seq, new FunctionContext(
+        [this, extents, bl, fadvise_flags, on_finish](int r) mutable {
+          if (r < 0) {
+            on_finish->complete(r);
+            return;
+          }
+          aio_read(std::move(extents), bl, fadvise_flags, on_finish);
+        })});
+      return;
+    }
+
+    // the log space of a live entry is not reused, so its data can be
+    // read back while m_lock is held
+    for (auto it = writes.begin(); r == 0 && it != writes.end(); ++it) {
+      bufferlist data;
+      if ((*it)->persisted) {
+        r = read_data(**it, &data);
+      } else {
+        data = (*it)->bl;
+      }
+      overlay.push_back({(*it)->image_offset, std::move(data)});
+    }
+  }
+
+  if (r < 0) {
+    ldout(cct, 5) << "failing read: " << cpp_strerror(r) << dendl;
+    on_finish->complete(r);
+    return;
+  }
+
+  if (!overlay.empty()) {
+    Extents extents(image_extents);
+    on_finish = new FunctionContext(
+      [this, extents, overlay, bl, on_finish](int r) {
+        if (r >= 0) {
+          apply_overlay(extents, overlay, bl);
+        }
+        on_finish->complete(r);
+      });
+  }
+  m_image_writeback.aio_read(std::move(image_extents), bl, fadvise_flags,
+                             on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_write(Extents &&image_extents,
+                                      bufferlist&& bl,
+                                      int fadvise_flags,
+                                      Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  std::vector<LogEntryRef> entries;
+  uint64_t bl_offset = 0;
+  for (auto &extent : image_extents) {
+    for (uint64_t off = 0; off < extent.second; ) {
+      uint64_t len = std::min(extent.second - off, MAX_ENTRY_DATA);
+      auto entry = std::make_shared<LogEntry>(ENTRY_WRITE, extent.first + off,
+                                              len);
+      // the caller may reuse its buffer once the write is acknowledged,
+      // but the entry data is needed until it is destaged
+      entry->bl.substr_of(bl, bl_offset, len);
+      entry->bl.rebuild();
+      entries.push_back(entry);
+      off += len;
+      bl_offset += len;
+    }
+  }
+  append(std::move(entries), on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_discard(uint64_t offset, uint64_t length,
+                                        bool skip_partial_discard,
+                                        Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  std::vector<LogEntryRef> entries;
+  if (length > 0) {
+    auto entry = std::make_shared<LogEntry>(ENTRY_DISCARD, offset, length);
+    entry->skip_partial_discard = skip_partial_discard;
+    entries.push_back(entry);
+  }
+  append(std::move(entries), on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "on_finish=" << on_finish << dendl;
+
+  // a persisted log entry is already stable: only wait for appends that
+  // are still queued
+  int r;
+  {
+    Mutex::Locker locker(m_lock);
+    LogEntryRef last;
+    if (!m_space_waiters.empty()) {
+      last = m_space_waiters.back();
+    } else if (!m_entries.empty()) {
+      last = m_entries.back();
+    }
+    if (last && !last->persisted && !last->failed) {
+      last->on_persist.push_back(on_finish);
+      return;
+    }
+    r = m_log_error;
+  }
+  on_finish->complete(r);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_writesame(uint64_t offset, uint64_t length,
+                                          bufferlist&& bl,
+                                          int fadvise_flags,
+                                          Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "data_len=" << bl.length() << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  std::vector<LogEntryRef> entries;
+  if (length > 0) {
+    auto entry = std::make_shared<LogEntry>(ENTRY_WRITESAME, offset, length);
+    entry->bl = bl;
+    entry->bl.rebuild();
+    entries.push_back(entry);
+  }
+  append(std::move(entries), on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::init(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 5) << "path=" << m_path << dendl;
+
+  int r = open_log();
+  if (r < 0) {
+    on_finish->complete(r);
+    return;
+  }
+  m_writer.create("rbd_wlog");
+
+  size_t pending;
+  {
+    Mutex::Locker locker(m_lock);
+    pending = m_entries.size();
+  }
+  if (pending == 0) {
+    start_destage(on_finish);
+    return;
+  }
+
+  // updates left over from a previous session can only be replayed by the
+  // lock owner
+  ldout(cct, 5) << "replaying " << pending << " logged updates" << dendl;
+  bool acquire = false;
+  {
+    RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+    if (m_image_ctx.exclusive_lock != nullptr &&
+        !m_image_ctx.exclusive_lock->is_lock_owner()) {
+      acquire = true;
+      m_image_ctx.exclusive_lock->acquire_lock(new FunctionContext(
+        [this, on_finish](int r) {
+          if (r < 0) {
+            lderr(m_image_ctx.cct) << "failed to acquire exclusive lock: "
+                                   << cpp_strerror(r) << dendl;
+            on_finish->complete(r);
+            return;
+          }
+          start_destage(on_finish);
+        }));
+    }
+  }
+  if (!acquire) {
+    start_destage(on_finish);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::shut_down(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 5) << dendl;
+
+  // the final flush can complete on the log writer, which must be joined
+  // from another thread
+  Context *ctx = new FunctionContext([this, on_finish](int r) {
+      if (r < 0) {
+        lderr(m_image_ctx.cct) << "failed to destage log, it will be "
+                               << "replayed on next open: " << cpp_strerror(r)
+                               << dendl;
+      }
+      stop_writer();
+      VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+      m_fd = -1;
+      on_finish->complete(r);
+    });
+  ctx = util::create_async_context_callback(m_image_ctx, ctx);
+
+  // the cache may be deleted once it is shut down: no destage callback
+  // may still be pending by then
+  ctx = new FunctionContext([this, ctx](int r) {
+      wait_for_destage(r, ctx);
+    });
+  flush(ctx);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::invalidate(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  // only dirty data is held: nothing to discard beyond destaging it
+  flush(on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+
+  int r;
+  {
+    Mutex::Locker locker(m_lock);
+    r = m_destage_error;
+    uint64_t last_seq = m_next_seq - 1;
+    if (r == 0 && last_seq >= m_head_seq) {
+      ldout(cct, 20) << "waiting for seq " << last_seq << " to retire"
+                     << dendl;
+      m_retire_waiters.insert({last_seq, on_finish});
+      return;
+    }
+  }
+  if (r < 0) {
+    // updates already issued to the image are still completing
+    wait_for_destage(r, on_finish);
+    return;
+  }
+  on_finish->complete(r);
+}
+
+template <typename I>
+int WriteLogImageCache<I>::open_log() {
+  CephContext *cct = m_image_ctx.cct;
+
+  m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (m_fd < 0) {
+    int r = -errno;
+    lderr(cct) << "failed to open " << m_path << ": " << cpp_strerror(r)
+               << dendl;
+    return r;
+  }
+
+  struct stat st;
+  int r = 0;
+  if (::fstat(m_fd, &st) < 0) {
+    r = -errno;
+  } else if (st.st_size == 0) {
+    r = create_log();
+  } else {
+    r = load_log();
+  }
+
+  if (r == 0) {
+    // a new generation keeps stale entries from an earlier pass over the
+    // ring from being mistaken for ones appended from now on
+    ++m_generation;
+    r = write_superblock(m_head, m_head_seq);
+    if (r == 0 && ::fsync(m_fd) < 0) {
+      r = -errno;
+    }
+  }
+  if (r < 0) {
+    lderr(cct) << "failed to initialize log " << m_path << ": "
+               << cpp_strerror(r) << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    m_fd = -1;
+  }
+  return r;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::create_log() {
+  if (::ftruncate(m_fd, m_size) < 0) {
+    return -errno;
+  }
+  m_head = m_tail = LOG_DATA_START;
+  m_head_seq = m_next_seq = 1;
+  m_destage_seq = m_head_seq;
+  return 0;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::load_log() {
+  CephContext *cct = m_image_ctx.cct;
+
+  superblock_t sb;
+  int r = safe_pread_exact(m_fd, &sb, sizeof(sb), 0);
+  if (r < 0) {
+    return r;
+  }
+  uint32_t crc = sb.crc;
+  sb.crc = 0;
+  if (sb.magic != LOG_MAGIC ||
+      crc != ceph_crc32c(0, reinterpret_cast<unsigned char*>(&sb),
+                         sizeof(sb))) {
+    lderr(cct) << m_path << " is not a valid log" << dendl;
+    return -EINVAL;
+  }
+  if (sb.version != LOG_VERSION) {
+    lderr(cct) << "unsupported log version " << sb.version << dendl;
+    return -EOPNOTSUPP;
+  }
+  if (sb.size != m_size) {
+    ldout(cct, 1) << "keeping existing log size " << sb.size << dendl;
+    m_size = sb.size;
+  }
+  if (sb.head < LOG_DATA_START || sb.head > m_size ||
+      sb.head % LOG_ALIGN != 0 || m_size % LOG_ALIGN != 0) {
+    lderr(cct) << "corrupt log superblock" << dendl;
+    return -EINVAL;
+  }
+
+  m_generation = sb.generation;
+  m_head = sb.head;
+  m_head_seq = m_next_seq = sb.head_seq;
+  m_destage_seq = m_head_seq;
+
+  uint64_t capacity = m_size - LOG_DATA_START;
+  uint64_t offset = m_head;
+  uint32_t generation = 0;
+  while (true) {
+    if (offset == m_size) {
+      offset = LOG_DATA_START;
+    }
+    LogEntryRef entry;
+    r = read_entry(offset, m_next_seq, &generation, &entry);
+    if (r < 0) {
+      return r;
+    } else if (r == 0 || m_used + entry->log_length > capacity) {
+      break;
+    }
+
+    entry->seq = m_next_seq++;
+    entry->log_offset = offset;
+    entry->persisted = true;
+    m_used += entry->log_length;
+    offset += entry->log_length;
+    m_entries.push_back(entry);
+  }
+  m_tail = offset;
+
+  ldout(cct, 10) << "head=" << m_head << ", tail=" << m_tail << ", "
+                 << "entries=" << m_entries.size() << dendl;
+  return 0;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::read_entry(uint64_t offset, uint64_t expected_seq,
+                                      uint32_t *generation,
+                                      LogEntryRef *entry) {
+  entry_header_t h;
+  int r = safe_pread_exact(m_fd, &h, sizeof(h), offset);
+  if (r == -EDOM) {
+    return 0;
+  } else if (r < 0) {
+    return r;
+  }
+
+  uint32_t data_len = h.data_len;
+  if (h.magic != ENTRY_MAGIC || h.seq != expected_seq ||
+      h.generation < *generation || h.generation > m_generation ||
+      h.type < ENTRY_WRITE || h.type > ENTRY_WRAP ||
+      data_len > MAX_ENTRY_DATA) {
+    return 0;
+  }
+  uint64_t log_length = (h.type == ENTRY_WRAP ? m_size - offset :
+                                                entry_log_length(data_len));
+  if (offset + log_length > m_size) {
+    return 0;
+  }
+
+  bufferlist bl;
+  if (data_len > 0) {
+    bufferptr bp(buffer::create(data_len));
+    r = safe_pread_exact(m_fd, bp.c_str(), data_len, offset + sizeof(h));
+    if (r == -EDOM) {
+      return 0;
+    } else if (r < 0) {
+      return r;
+    }
+    bl.append(std::move(bp));
+  }
+
+  uint32_t crc = h.crc;
+  h.crc = 0;
+  uint32_t actual = ceph_crc32c(-1, reinterpret_cast<unsigned char*>(&h),
+                                sizeof(h));
+  if (crc != bl.crc32c(actual)) {
+    // torn append
+    return 0;
+  }
+
+  *generation = h.generation;
+  entry->reset(new LogEntry(static_cast<EntryType>(h.type), h.image_offset,
+                            h.length));
+  (*entry)->skip_partial_discard = h.skip_partial_discard;
+  if (h.type != ENTRY_WRITE) {
+    // write data is read back from the log when it is needed
+    (*entry)->bl.claim(bl);
+  }
+  (*entry)->log_length = log_length;
+  return 1;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::write_superblock(uint64_t head, uint64_t head_seq) {
+  superblock_t sb;
+  memset(&sb, 0, sizeof(sb));
+  sb.magic = LOG_MAGIC;
+  sb.version = LOG_VERSION;
+  sb.generation = m_generation;
+  sb.size = m_size;
+  sb.head = head;
+  sb.head_seq = head_seq;
+  sb.crc = ceph_crc32c(0, reinterpret_cast<unsigned char*>(&sb), sizeof(sb));
+  return safe_pwrite(m_fd, &sb, sizeof(sb), 0);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::encode_entry(const LogEntry &entry,
+                                         bufferlist *bl) const {
+  entry_header_t h;
+  memset(&h, 0, sizeof(h));
+  h.magic = ENTRY_MAGIC;
+  h.generation = m_generation;
+  h.seq = entry.seq;
+  h.image_offset = entry.image_offset;
+  h.length = entry.length;
+  h.data_len = entry.bl.length();
+  h.type = entry.type;
+  h.skip_partial_discard = entry.skip_partial_discard;
+
+  uint32_t crc = ceph_crc32c(-1, reinterpret_cast<unsigned char*>(&h),
+                             sizeof(h));
+  h.crc = entry.bl.crc32c(crc);
+
+  bl->append(reinterpret_cast<const char*>(&h), sizeof(h));
+  bl->append(entry.bl);
+  if (entry.type != ENTRY_WRAP) {
+    bl->append_zero(entry.log_length - sizeof(h) - entry.bl.length());
+  }
+}
+
+template <typename I>
+int WriteLogImageCache<I>::read_data(const LogEntry &entry, bufferlist *bl) {
+  assert(entry.type == ENTRY_WRITE && entry.persisted);
+  bufferptr bp(buffer::create(entry.length));
+  int r = safe_pread_exact(m_fd, bp.c_str(), entry.length,
+                           entry.log_offset + sizeof(entry_header_t));
+  if (r < 0) {
+    return r;
+  }
+  bl->append(std::move(bp));
+  return 0;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::append(std::vector<LogEntryRef> &&entries,
+                                   Context *on_finish) {
+  if (entries.empty()) {
+    on_finish->complete(0);
+    return;
+  }
+
+  // entries are persisted in order: the last one completes the request
+  entries.back()->on_persist.push_back(on_finish);
+
+  int r;
+  {
+    Mutex::Locker locker(m_lock);
+    r = _get_error();
+    if (r == 0) {
+      for (auto &entry : entries) {
+        if (!m_space_waiters.empty() || !_place(entry)) {
+          m_space_waiters.push_back(entry);
+        }
+      }
+      m_cond.Signal();
+      return;
+    }
+  }
+  on_finish->complete(r);
+}
+
+template <typename I>
+bool WriteLogImageCache<I>::_place(const LogEntryRef &entry) {
+  assert(m_lock.is_locked());
+
+  uint64_t length = entry_log_length(entry->bl.length());
+  uint64_t capacity = m_size - LOG_DATA_START;
+  if (m_tail == m_size) {
+    m_tail = LOG_DATA_START;
+  }
+  uint64_t wrap = 0;
+  if (m_tail + length > m_size) {
+    wrap = m_size - m_tail;
+  }
+  if (m_used + wrap + length > capacity) {
+    return false;
+  }
+
+  if (wrap > 0) {
+    _place_entry(std::make_shared<LogEntry>(ENTRY_WRAP, 0, 0), wrap);
+    m_tail = LOG_DATA_START;
+  }
+  _place_entry(entry, length);
+  return true;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_place_entry(const LogEntryRef &entry,
+                                         uint64_t log_length) {
+  entry->seq = m_next_seq++;
+  entry->log_offset = m_tail;
+  entry->log_length = log_length;
+  m_tail += log_length;
+  m_used += log_length;
+  m_entries.push_back(entry);
+  m_append_queue.push_back(entry);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_place_space_waiters() {
+  assert(m_lock.is_locked());
+  while (!m_space_waiters.empty() && _place(m_space_waiters.front())) {
+    m_space_waiters.pop_front();
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::writer_entry() {
+  CephContext *cct = m_image_ctx.cct;
+
+  m_lock.Lock();
+  while (true) {
+    if (m_append_queue.empty() && !m_head_dirty) {
+      if (m_stopping) {
+        break;
+      }
+      m_cond.Wait(m_lock);
+      continue;
+    }
+
+    // group commit everything queued so far behind a single sync
+    std::deque<LogEntryRef> batch;
+    batch.swap(m_append_queue);
+    bool write_head = m_head_dirty;
+    uint64_t head = m_head;
+    uint64_t head_seq = m_head_seq;
+    uint64_t retired = m_retired;
+    m_head_dirty = false;
+    m_retired = 0;
+    int r = m_log_error;
+    m_lock.Unlock();
+
+    if (r == 0) {
+      bufferlist bl;
+      uint64_t bl_offset = 0;
+      for (auto &entry : batch) {
+        if (bl.length() > 0 && bl_offset + bl.length() != entry->log_offset) {
+          r = bl.write_fd(m_fd, bl_offset);
+          bl.clear();
+          if (r < 0) {
+            break;
+          }
+        }
+        if (bl.length() == 0) {
+          bl_offset = entry->log_offset;
+        }
+        encode_entry(*entry, &bl);
+      }
+      if (r == 0 && bl.length() > 0) {
+        r = bl.write_fd(m_fd, bl_offset);
+      }
+      if (r == 0 && write_head) {
+        r = write_superblock(head, head_seq);
+      }
+      if (r == 0 && ::fdatasync(m_fd) < 0) {
+        r = -errno;
+      }
+    }
+    ldout(cct, 20) << "synced " << batch.size() << " entries, "
+                   << "head=" << (write_head ? head : 0) << ": r=" << r
+                   << dendl;
+
+    DestageWork work;
+    m_lock.Lock();
+    if (r < 0 && m_log_error == 0) {
+      lderr(cct) << "failed to write log: " << cpp_strerror(r) << dendl;
+      m_log_error = r;
+    }
+    if (m_log_error == 0 && write_head) {
+      m_used -= retired;
+    }
+    int error = _get_error();
+    if (error == 0) {
+      if (write_head) {
+        _place_space_waiters();
+      }
+    } else {
+      // nothing will be retired to make room for them
+      for (auto &entry : m_space_waiters) {
+        for (auto ctx : entry->on_persist) {
+          work.finished.push_back({ctx, error});
+        }
+      }
+      m_space_waiters.clear();
+    }
+    for (auto &entry : batch) {
+      if (m_log_error == 0) {
+        entry->persisted = true;
+        if (entry->type == ENTRY_WRITE) {
+          entry->bl.clear();
+        }
+      } else {
+        // the update was failed back to the caller: it must not reach the
+        // image either
+        entry->failed = true;
+        entry->bl.clear();
+      }
+      for (auto ctx : entry->on_persist) {
+        work.finished.push_back({ctx, m_log_error});
+      }
+      entry->on_persist.clear();
+    }
+    _destage(&work);
+    m_lock.Unlock();
+
+    destage(work);
+    m_lock.Lock();
+  }
+  m_lock.Unlock();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::stop_writer() {
+  if (!m_writer.is_started()) {
+    return;
+  }
+  {
+    Mutex::Locker locker(m_lock);
+    m_stopping = true;
+    m_cond.Signal();
+  }
+  m_writer.join();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::start_destage(Context *on_finish) {
+  DestageWork work;
+  {
+    Mutex::Locker locker(m_lock);
+    m_destage_enabled = true;
+    _destage(&work);
+  }
+  destage(work);
+  on_finish->complete(0);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_destage(DestageWork *work) {
+  assert(m_lock.is_locked());
+  if (!m_destage_enabled || m_destage_error < 0) {
+    return;
+  }
+
+  // strictly in log order; an update waits for any in-flight update to an
+  // overlapping extent so the image sees them in the same order
+  while (m_destage_in_flight < MAX_DESTAGE_IN_FLIGHT &&
+         m_destage_seq < m_next_seq) {
+    assert(!m_entries.empty() && m_destage_seq >= m_entries.front()->seq);
+    LogEntryRef entry = m_entries[m_destage_seq - m_entries.front()->seq];
+    if (!entry->persisted && !entry->failed) {
+      break;
+    }
+    if (entry->type == ENTRY_WRAP || entry->failed) {
+      m_destage_unflushed.push_back(entry);
+      ++m_destage_seq;
+      continue;
+    }
+    if (m_destage_extents.intersects(entry->image_offset, entry->length)) {
+      break;
+    }
+    m_destage_extents.insert(entry->image_offset, entry->length);
+    ++m_destage_in_flight;
+    ++m_destage_seq;
+    work->entries.push_back(entry);
+  }
+
+  if (!m_destage_flushing && !m_destage_unflushed.empty() &&
+      (m_destage_in_flight == 0 ||
+       m_destage_unflushed.size() >= DESTAGE_FLUSH_BATCH)) {
+    m_destage_flushing = true;
+    work->to_flush.swap(m_destage_unflushed);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::destage(DestageWork &work) {
+  for (auto &entry : work.entries) {
+    Context *ctx = new FunctionContext([this, entry](int r) {
+        handle_destage(entry, r);
+      });
+    switch (entry->type) {
+    case ENTRY_WRITE:
+      {
+        // the entry is not retired before it is destaged, so its log
+        // space still holds the data
+        bufferlist bl;
+        int r = read_data(*entry, &bl);
+        if (r < 0) {
+          lderr(m_image_ctx.cct) << "failed to read seq " << entry->seq
+                                 << " from the log: " << cpp_strerror(r)
+                                 << dendl;
+          ctx->complete(r);
+          break;
+        }
+        m_image_writeback.aio_write({{entry->image_offset, entry->length}},
+                                    std::move(bl), 0, ctx);
+      }
+      break;
+    case ENTRY_DISCARD:
+      m_image_writeback.aio_discard(entry->image_offset, entry->length,
+                                    entry->skip_partial_discard, ctx);
+      break;
+    case ENTRY_WRITESAME:
+      {
+        bufferlist bl(entry->bl);
+        m_image_writeback.aio_writesame(entry->image_offset, entry->length,
+                                        std::move(bl), 0, ctx);
+      }
+      break;
+    default:
+      assert(false);
+    }
+  }
+
+  if (!work.to_flush.empty()) {
+    // destaged writes may still sit in the object cache
+    auto entries = std::make_shared<std::list<LogEntryRef> >();
+    entries->swap(work.to_flush);
+    Context *ctx = new FunctionContext([this, entries](int r) {
+        handle_destage_flush(*entries, r);
+      });
+    if (m_image_ctx.object_cacher != nullptr) {
+      m_image_ctx.flush_cache(ctx);
+    } else {
+      ctx->complete(0);
+    }
+  }
+
+  for (auto &c : work.finished) {
+    c.first->complete(c.second);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::handle_destage(const LogEntryRef &entry, int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "seq=" << entry->seq << ": r=" << r << dendl;
+
+  DestageWork work;
+  {
+    Mutex::Locker locker(m_lock);
+    assert(m_destage_in_flight > 0);
+    --m_destage_in_flight;
+    m_destage_extents.erase(entry->image_offset, entry->length);
+    if (r < 0) {
+      lderr(cct) << "failed to destage seq " << entry->seq << ": "
+                 << cpp_strerror(r) << dendl;
+      _fail_destage(r, &work.finished);
+    } else {
+      m_destage_unflushed.push_back(entry);
+    }
+    _destage(&work);
+    _complete_idle_waiters(&work.finished);
+  }
+  destage(work);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::handle_destage_flush(
+    std::list<LogEntryRef> &entries, int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "entries=" << entries.size() << ": r=" << r << dendl;
+
+  DestageWork work;
+  {
+    Mutex::Locker locker(m_lock);
+    m_destage_flushing = false;
+    if (r < 0) {
+      lderr(cct) << "failed to flush destaged updates: " << cpp_strerror(r)
+                 << dendl;
+      _fail_destage(r, &work.finished);
+    } else {
+      for (auto &entry : entries) {
+        entry->destaged = true;
+      }
+      _retire(&work.finished);
+      _destage(&work);
+    }
+    _complete_idle_waiters(&work.finished);
+  }
+  destage(work);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_retire(Completions *finished) {
+  assert(m_lock.is_locked());
+
+  bool retired = false;
+  while (!m_entries.empty() && m_entries.front()->destaged) {
+    m_retired += m_entries.front()->log_length;
+    m_entries.pop_front();
+    retired = true;
+  }
+  if (!retired) {
+    return;
+  }
+
+  if (m_entries.empty()) {
+    m_head = m_tail;
+    m_head_seq = m_next_seq;
+  } else {
+    m_head = m_entries.front()->log_offset;
+    m_head_seq = m_entries.front()->seq;
+  }
+  // the space is reused only once the writer has persisted the new head
+  m_head_dirty = true;
+  m_cond.Signal();
+
+  auto end = m_retire_waiters.lower_bound(m_head_seq);
+  for (auto it = m_retire_waiters.begin(); it != end; ++it) {
+    finished->push_back({it->second, 0});
+  }
+  m_retire_waiters.erase(m_retire_waiters.begin(), end);
+}
+
+template <typename I>
+int WriteLogImageCache<I>::_get_error() const {
+  assert(m_lock.is_locked());
+  return m_log_error != 0 ? m_log_error : m_destage_error;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_fail_destage(int r, Completions *finished) {
+  assert(m_lock.is_locked());
+
+  // logged updates stay in place to be replayed on the next open; nothing
+  // is retired anymore, but updates still in flight to the image must
+  // complete before the waiters may tear the cache down
+  if (m_destage_error == 0) {
+    m_destage_error = r;
+  }
+  for (auto &waiter : m_retire_waiters) {
+    m_idle_waiters.push_back({waiter.second, r});
+  }
+  m_retire_waiters.clear();
+  for (auto &entry : m_space_waiters) {
+    for (auto ctx : entry->on_persist) {
+      finished->push_back({ctx, r});
+    }
+  }
+  m_space_waiters.clear();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::wait_for_destage(int r, Context *on_finish) {
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_destage_in_flight > 0 || m_destage_flushing) {
+      m_idle_waiters.push_back({on_finish, r});
+      return;
+    }
+  }
+  on_finish->complete(r);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::_complete_idle_waiters(Completions *finished) {
+  assert(m_lock.is_locked());
+  if (m_destage_in_flight == 0 && !m_destage_flushing) {
+    finished->splice(finished->end(), m_idle_waiters);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::apply_overlay(
+    const Extents &image_extents, const Overlay &overlay,
+    bufferlist *bl) const {
+  uint64_t total = 0;
+  for (auto &extent : image_extents) {
+    total += extent.second;
+  }
+  if (bl->length() < total) {
+    bl->append_zero(total - bl->length());
+  }
+
+  bufferptr bp(buffer::create(total));
+  bl->copy(0, total, bp.c_str());
+
+  // later entries land on top of earlier ones
+  uint64_t buffer_offset = 0;
+  for (auto &extent : image_extents) {
+    for (auto &data : overlay) {
+      uint64_t start = std::max(extent.first, data.first);
+      uint64_t end = std::min(extent.first + extent.second,
+                              data.first + data.second.length());
+      if (start >= end) {
+        continue;
+      }
+      data.second.copy(start - data.first, end - start,
+                       bp.c_str() + buffer_offset + (start - extent.first));
+    }
+    buffer_offset += extent.second;
+  }
+
+  bl->clear();
+  bl->append(std::move(bp));
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::WriteLogImageCache<librbd::ImageCtx>;
@@ -0,0 +1,199 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
+#define CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
+
+#include "ImageCache.h"
+#include "ImageWriteback.h"
+#include "include/buffer.h"
+#include "include/interval_set.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace cache {
+
+/**
+ * Client-side write-back image cache persisted in a local log
+ *
+ * Updates are appended to a ring-buffer log file on a local SSD/pmem
+ * device and acknowledged once the log has been synced, so a write costs
+ * a local fdatasync instead of a round trip to the OSDs.  Concurrent
+ * appends are group committed by a single writer thread.  Logged updates
+ * are destaged to the image in log order in the background and retired
+ * from the log once they are stable in RADOS; after a crash, init()
+ * replays whatever had not been retired.  Reads are served from the image
+ * with any overlapping logged data laid on top.
+ *
+ * Write data is only held in memory until it is persisted: destaging and
+ * overlay reads read it back from the log, so memory use does not grow
+ * with the size of the log.
+ *
+ * Destaging issues ordinary image writes, so the exclusive lock must be
+ * held (and journaling must not be used) while the cache is active.
+ */
+template <typename ImageCtxT = librbd::ImageCtx>
+class WriteLogImageCache : public ImageCache {
+public:
+  WriteLogImageCache(ImageCtxT &image_ctx, const std::string &path,
+                     uint64_t size);
+  ~WriteLogImageCache() override;
+
+  /// client AIO methods
+  void aio_read(Extents&& image_extents, ceph::bufferlist *bl,
+                int fadvise_flags, Context *on_finish) override;
+  void aio_write(Extents&& image_extents, ceph::bufferlist&& bl,
+                 int fadvise_flags, Context *on_finish) override;
+  void aio_discard(uint64_t offset, uint64_t length,
+                   bool skip_partial_discard, Context *on_finish) override;
+  void aio_flush(Context *on_finish) override;
+  void aio_writesame(uint64_t offset, uint64_t length,
+                     ceph::bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) override;
+
+  /// internal state methods
+  void init(Context *on_finish) override;
+  void shut_down(Context *on_finish) override;
+
+  void invalidate(Context *on_finish) override;
+  void flush(Context *on_finish) override;
+
+private:
+  enum EntryType {
+    ENTRY_WRITE = 1,
+    ENTRY_DISCARD,
+    ENTRY_WRITESAME,
+    ENTRY_WRAP,       ///< rest of the ring is unused, continue at its start
+  };
+
+  struct LogEntry {
+    EntryType type;
+    uint64_t image_offset;
+    uint64_t length;
+    bool skip_partial_discard = false;
+    ceph::bufferlist bl;          ///< writesame pattern, or write data
+                                  ///< until it is persisted
+
+    uint64_t seq = 0;
+    uint64_t log_offset = 0;
+    uint64_t log_length = 0;      ///< header + data, aligned
+
+    bool persisted = false;
+    bool failed = false;          ///< its log write failed, never destaged
+    bool destaged = false;        ///< stable in the image, may be retired
+    std::list<Context*> on_persist;
+
+    LogEntry(EntryType type, uint64_t image_offset, uint64_t length)
+      : type(type), image_offset(image_offset), length(length) {
+    }
+  };
+  typedef std::shared_ptr<LogEntry> LogEntryRef;
+  typedef std::list<std::pair<Context*, int> > Completions;
+  typedef std::vector<std::pair<uint64_t, ceph::bufferlist> > Overlay;
+
+  class LogWriter : public Thread {
+  public:
+    explicit LogWriter(WriteLogImageCache *cache) : m_cache(cache) {
+    }
+    void *entry() override {
+      m_cache->writer_entry();
+      return nullptr;
+    }
+  private:
+    WriteLogImageCache *m_cache;
+  };
+
+  /// destage work collected under m_lock and issued without it
+  struct DestageWork {
+    std::vector<LogEntryRef> entries;
+    std::list<LogEntryRef> to_flush;
+    Completions finished;
+  };
+
+  ImageCtxT &m_image_ctx;
+  ImageWriteback<ImageCtxT> m_image_writeback;
+  std::string m_path;
+  uint64_t m_size;              ///< end of the ring
+  int m_fd = -1;
+  uint32_t m_generation = 0;    ///< bumped on every open of the log
+
+  Mutex m_lock;
+  Cond m_cond;
+  LogWriter m_writer;
+  bool m_stopping = false;
+  int m_log_error = 0;          ///< sticky: the log can no longer be trusted
+
+  uint64_t m_head = 0;          ///< log offset of the oldest live entry
+  uint64_t m_head_seq = 0;      ///< seq of the oldest live entry
+  uint64_t m_tail = 0;          ///< log offset of the next append
+  uint64_t m_next_seq = 1;
+  uint64_t m_used = 0;          ///< ring bytes between head and tail
+  uint64_t m_retired = 0;       ///< freed once the new head is persisted
+  bool m_head_dirty = false;
+
+  std::deque<LogEntryRef> m_entries;        ///< live entries, in seq order
+  std::deque<LogEntryRef> m_append_queue;   ///< placed, not yet written
+  std::deque<LogEntryRef> m_space_waiters;  ///< not placed, log is full
+
+  bool m_destage_enabled = false;
+  int m_destage_error = 0;      ///< sticky: updates are replayed on reopen
+  uint64_t m_destage_seq = 1;               ///< next seq to destage
+  uint32_t m_destage_in_flight = 0;
+  interval_set<uint64_t> m_destage_extents; ///< image extents in flight
+  std::list<LogEntryRef> m_destage_unflushed;
+  bool m_destage_flushing = false;
+  Completions m_idle_waiters;   ///< waiting for destage I/O to drain
+
+  /// waiters for every entry up to (and including) a seq to be retired
+  std::multimap<uint64_t, Context*> m_retire_waiters;
+
+  int open_log();
+  int create_log();
+  int load_log();
+  int read_entry(uint64_t offset, uint64_t expected_seq, uint32_t *generation,
+                 LogEntryRef *entry);
+  int write_superblock(uint64_t head, uint64_t head_seq);
+  void encode_entry(const LogEntry &entry, ceph::bufferlist *bl) const;
+  int read_data(const LogEntry &entry, ceph::bufferlist *bl);
+
+  void append(std::vector<LogEntryRef> &&entries, Context *on_finish);
+  bool _place(const LogEntryRef &entry);
+  void _place_entry(const LogEntryRef &entry, uint64_t log_length);
+  void _place_space_waiters();
+
+  void writer_entry();
+
+  void stop_writer();
+
+  void start_destage(Context *on_finish);
+  void _destage(DestageWork *work);
+  void destage(DestageWork &work);
+  void handle_destage(const LogEntryRef &entry, int r);
+  void handle_destage_flush(std::list<LogEntryRef> &entries, int r);
+  void _retire(Completions *finished);
+  void _fail_destage(int r, Completions *finished);
+  void wait_for_destage(int r, Context *on_finish);
+  void _complete_idle_waiters(Completions *finished);
+  int _get_error() const;
+
+  void apply_overlay(const Extents &image_extents,
+                     const Overlay &overlay,
+                     ceph::bufferlist *bl) const;
+};
+
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::WriteLogImageCache<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
@@ -36,7 +36,13 @@ private:
    * SHUT_DOWN_UPDATE_WATCHERS
    *    |
    *    v
-   * SHUT_DOWN_AIO_WORK_QUEUE . . .
+   * SHUT_DOWN_AIO_WORK_QUEUE
+   *    |
+   *    v
+   * SHUT_DOWN_IMAGE_CACHE (skip if none)
+   *    |
+   *    v
+   *  (exclusive lock) . . . . . .
    *    |                         . (exclusive lock disabled)
    *    v                         v
    * SHUT_DOWN_EXCLUSIVE_LOCK   FLUSH
@@ -85,6 +91,9 @@ private:
   void send_shut_down_io_queue();
   void handle_shut_down_io_queue(int r);
 
+  void send_shut_down_image_cache();
+  void handle_shut_down_image_cache(int r);
+
   void send_shut_down_exclusive_lock();
   void handle_shut_down_exclusive_lock(int r);
 
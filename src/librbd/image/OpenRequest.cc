@@ -5,8 +5,10 @@
 #include "common/dout.h"
 #include "common/errno.h"
 #include "cls/rbd/cls_rbd_client.h"
+#include "include/stringify.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/WriteLogImageCache.h"
 #include "librbd/image/CloseRequest.h"
 #include "librbd/image/RefreshRequest.h"
 #include "librbd/image/SetSnapRequest.h"
@@ -535,8 +537,7 @@ Context *OpenRequest<I>::handle_refresh(int *result) {
 template <typename I>
 Context *OpenRequest<I>::send_set_snap(int *result) {
   if (m_image_ctx->snap_name.empty()) {
-    *result = 0;
-    return m_on_finish;
+    return send_init_image_cache(result);
   }
 
   CephContext *cct = m_image_ctx->cct;
@@ -565,6 +566,54 @@ Context *OpenRequest<I>::handle_set_snap(int *result) {
   return m_on_finish;
 }
 
+template <typename I>
+Context *OpenRequest<I>::send_init_image_cache(int *result) {
+  CephContext *cct = m_image_ctx->cct;
+  *result = 0;
+  if (m_image_ctx->persistent_cache_path.empty() || m_image_ctx->read_only) {
+    return m_on_finish;
+  }
+
+  // destaging relies on the exclusive lock, and cached writes would bypass
+  // the journal
+  if (!m_image_ctx->test_features(RBD_FEATURE_EXCLUSIVE_LOCK) ||
+      m_image_ctx->test_features(RBD_FEATURE_JOURNALING)) {
+    ldout(cct, 1) << "persistent cache requires exclusive-lock and no "
+                  << "journaling: disabled" << dendl;
+    return m_on_finish;
+  }
+
+  ldout(cct, 10) << this << " " << __func__ << dendl;
+
+  std::string path = m_image_ctx->persistent_cache_path + "/rbd-" +
+                     stringify(m_image_ctx->md_ctx.get_id()) + "." +
+                     m_image_ctx->id + ".wlog";
+  m_image_ctx->image_cache = new cache::WriteLogImageCache<I>(
+    *m_image_ctx, path, m_image_ctx->persistent_cache_size);
+
+  using klass = OpenRequest<I>;
+  m_image_ctx->image_cache->init(
+    create_context_callback<klass, &klass::handle_init_image_cache>(this));
+  return nullptr;
+}
+
+template <typename I>
+Context *OpenRequest<I>::handle_init_image_cache(int *result) {
+  CephContext *cct = m_image_ctx->cct;
+  ldout(cct, 10) << __func__ << ": r=" << *result << dendl;
+
+  if (*result < 0) {
+    lderr(cct) << "failed to initialize persistent cache: "
+               << cpp_strerror(*result) << dendl;
+    delete m_image_ctx->image_cache;
+    m_image_ctx->image_cache = nullptr;
+    send_close_image(*result);
+    return nullptr;
+  }
+
+  return m_on_finish;
+}
+
 template <typename I>
 void OpenRequest<I>::send_close_image(int error_result) {
   CephContext *cct = m_image_ctx->cct;
@@ -67,6 +67,9 @@ private:
    *                                             SET_SNAP (skip if no snap)
    *                                                |
    *                                                v
+   *                                             INIT_IMAGE_CACHE (skip if
+   *                                                |    disabled or snap)
+   *                                                v
    *                                             <finish>
    *                                                ^
    *     (on error)                                 |
@@ -126,6 +129,9 @@ private:
   Context *send_set_snap(int *result);
   Context *handle_set_snap(int *result);
 
+  Context *send_init_image_cache(int *result);
+  Context *handle_init_image_cache(int *result);
+
   void send_close_image(int error_result);
   Context *handle_close_image(int *result);
 
@@ -23,9 +23,12 @@ enum {
   l_librbd_rd,               // read ops
   l_librbd_rd_bytes,         // bytes read
   l_librbd_rd_latency,       // average latency
+  l_librbd_rd_latency_hist,  // latency x size histogram
+  l_librbd_rd_fast_path,     // reads dispatched on the caller thread
   l_librbd_wr,
   l_librbd_wr_bytes,
   l_librbd_wr_latency,
+  l_librbd_wr_latency_hist,
   l_librbd_discard,
   l_librbd_discard_bytes,
   l_librbd_discard_latency,
@@ -50,6 +53,11 @@ enum {
 
   l_librbd_invalidate_cache,
 
+  l_librbd_mgmt_objects,         // objects processed by management ops
+  l_librbd_mgmt_objects_skipped, // objects skipped via the object map
+  l_librbd_mgmt_latency,         // per-object latency of management ops
+  l_librbd_mgmt_window,          // current management op concurrency
+
   l_librbd_last,
 };
 
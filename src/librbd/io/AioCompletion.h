@@ -55,6 +55,7 @@ struct AioCompletion {
   ImageCtx *ictx;
   utime_t start_time;
   aio_type_t aio_type;
+  uint64_t io_bytes = 0;    ///< request size, for the latency histograms
 
   ReadResult read_result;
 
@@ -28,7 +28,7 @@ ImageRequestWQ::ImageRequestWQ(ImageCtx *image_ctx, const string &name,
     m_lock(util::unique_lock_name("ImageRequestWQ::m_lock", this)),
     m_write_blockers(0), m_in_progress_writes(0), m_queued_reads(0),
     m_queued_writes(0), m_in_flight_ops(0), m_refresh_in_progress(false),
-    m_shutdown(false), m_on_shutdown(nullptr) {
+    m_on_shutdown(nullptr) {
   CephContext *cct = m_image_ctx.cct;
   ldout(cct, 5) << "ictx=" << image_ctx << dendl;
   tp->add_work_queue(this);
@@ -138,6 +138,12 @@ void ImageRequestWQ::aio_read(AioCompletion *c, uint64_t off, uint64_t len,
   if (native_async && m_image_ctx.event_socket.is_valid()) {
     c->set_event_notify(true);
   }
+  c->io_bytes = len;
+
+  if (try_aio_read_fast_path(c, off, len, read_result, op_flags, trace)) {
+    trace.event("finish");
+    return;
+  }
 
   if (!start_in_flight_op(c)) {
     return;
@@ -184,6 +190,7 @@ void ImageRequestWQ::aio_write(AioCompletion *c, uint64_t off, uint64_t len,
   if (native_async && m_image_ctx.event_socket.is_valid()) {
     c->set_event_notify(true);
   }
+  c->io_bytes = len;
 
   if (!start_in_flight_op(c)) {
     return;
@@ -312,6 +319,7 @@ void ImageRequestWQ::shut_down(Context *on_shutdown) {
     RWLock::WLocker locker(m_lock);
     assert(!m_shutdown);
     m_shutdown = true;
+    ++m_io_epoch;
 
     CephContext *cct = m_image_ctx.cct;
     ldout(cct, 5) << __func__ << ": in_flight=" << m_in_flight_ops.load()
@@ -345,6 +353,7 @@ void ImageRequestWQ::block_writes(Context *on_blocked) {
   {
     RWLock::WLocker locker(m_lock);
     ++m_write_blockers;
+    ++m_io_epoch;
     ldout(cct, 5) << &m_image_ctx << ", " << "num="
                   << m_write_blockers << dendl;
     if (!m_write_blocker_contexts.empty() || m_in_progress_writes > 0) {
@@ -384,6 +393,7 @@ void ImageRequestWQ::set_require_lock_on_read() {
 
   RWLock::WLocker locker(m_lock);
   m_require_lock_on_read = true;
+  ++m_io_epoch;
 }
 
 void ImageRequestWQ::clear_require_lock_on_read() {
@@ -506,22 +516,74 @@ int ImageRequestWQ::start_in_flight_op(AioCompletion *c) {
 }
 
 void ImageRequestWQ::finish_in_flight_op() {
+  if (--m_in_flight_ops > 0) {
+    return;
+  }
+
+  // a read on the fast path is counted without the lock, possibly after
+  // shut down found no IO in flight: only the op that shut down is
+  // waiting for hands it off
   Context *on_shutdown;
   {
-    RWLock::RLocker locker(m_lock);
-    if (--m_in_flight_ops > 0 || !m_shutdown) {
+    RWLock::WLocker locker(m_lock);
+    if (!m_shutdown || m_on_shutdown == nullptr) {
       return;
     }
     on_shutdown = m_on_shutdown;
+    m_on_shutdown = nullptr;
   }
 
   CephContext *cct = m_image_ctx.cct;
   ldout(cct, 5) << "completing shut down" << dendl;
 
-  assert(on_shutdown != nullptr);
   m_image_ctx.flush(on_shutdown);
 }
 
+bool ImageRequestWQ::is_read_fast_path_blocked() const {
+  // a closed image fails the read on the queued path
+  return (m_shutdown || m_write_blockers > 0 || m_queued_writes > 0 ||
+          m_require_lock_on_read || m_image_ctx.state->is_update_pending());
+}
+
+bool ImageRequestWQ::try_aio_read_fast_path(AioCompletion *c, uint64_t off,
+                                            uint64_t len,
+                                            ReadResult &read_result,
+                                            int op_flags,
+                                            const ZTracer::Trace &trace) {
+  if (!m_image_ctx.read_fast_path) {
+    return false;
+  }
+
+  uint64_t epoch = m_io_epoch;
+  if (is_read_fast_path_blocked()) {
+    return false;
+  }
+
+  // a lock transition or refresh holds owner_lock for write: let the work
+  // queue wait for it instead of the caller
+  if (!m_image_ctx.owner_lock.try_get_read()) {
+    return false;
+  }
+
+  // shut down bumps the epoch before checking for in-flight IO, so either
+  // it sees this op or the op sees the new epoch and m_shutdown
+  m_in_flight_ops++;
+  if (m_io_epoch != epoch || is_read_fast_path_blocked()) {
+    m_image_ctx.owner_lock.put_read();
+    finish_in_flight_op();
+    return false;
+  }
+
+  c->start_op();
+  ImageRequest<>::aio_read(&m_image_ctx, c, {{off, len}},
+                           std::move(read_result), op_flags, trace);
+  m_image_ctx.owner_lock.put_read();
+  m_image_ctx.perfcounter->inc(l_librbd_rd_fast_path);
+
+  finish_in_flight_op();
+  return true;
+}
+
 bool ImageRequestWQ::is_lock_required() const {
   assert(m_image_ctx.owner_lock.is_locked());
   if (m_image_ctx.exclusive_lock == NULL) {
@@ -7,6 +7,7 @@
 #include "include/Context.h"
 #include "common/RWLock.h"
 #include "common/WorkQueue.h"
+#include "common/zipkin_trace.h"
 
 #include <list>
 #include <atomic>
@@ -97,16 +98,20 @@ private:
   ImageCtx &m_image_ctx;
   mutable RWLock m_lock;
   Contexts m_write_blocker_contexts;
-  uint32_t m_write_blockers;
-  bool m_require_lock_on_read = false;
+  std::atomic<uint32_t> m_write_blockers;
+  std::atomic<bool> m_require_lock_on_read { false };
   std::atomic<unsigned> m_in_progress_writes { 0 };
   std::atomic<unsigned> m_queued_reads { 0 };
   std::atomic<unsigned> m_queued_writes { 0 };
   std::atomic<unsigned> m_in_flight_ops { 0 };
 
+  // bumped before anything that must not race with a read dispatched on
+  // the caller thread: write blocking, lock-on-read and shut down
+  std::atomic<uint64_t> m_io_epoch { 0 };
+
   bool m_refresh_in_progress;
 
-  bool m_shutdown;
+  std::atomic<bool> m_shutdown { false };
   Context *m_on_shutdown;
 
   inline bool writes_empty() const {
@@ -120,6 +125,11 @@ private:
   int start_in_flight_op(AioCompletion *c);
   void finish_in_flight_op();
 
+  bool is_read_fast_path_blocked() const;
+  bool try_aio_read_fast_path(AioCompletion *c, uint64_t off, uint64_t len,
+                              ReadResult &read_result, int op_flags,
+                              const ZTracer::Trace &trace);
+
   void queue(ImageRequest<ImageCtx> *req);
 
   void handle_refreshed(int r, ImageRequest<ImageCtx> *req);
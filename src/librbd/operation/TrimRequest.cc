@@ -227,6 +227,7 @@ void TrimRequest<I>::send_remove_objects() {
   AsyncObjectThrottle<I> *throttle = new AsyncObjectThrottle<I>(
     this, image_ctx, context_factory, ctx, &m_prog_ctx, m_delete_start,
     m_num_objects);
+  throttle->skip_nonexistent_objects();
   throttle->start_ops(image_ctx.concurrent_management_ops);
 }
 
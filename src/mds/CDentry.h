@@ -24,6 +24,7 @@
 #include "include/types.h"
 #include "include/buffer_fwd.h"
 #include "include/lru.h"
+#include "include/mempool.h"
 #include "include/elist.h"
 #include "include/filepath.h"
 
@@ -49,6 +50,7 @@ bool operator<(const CDentry& l, const CDentry& r);
 // dentry
 class CDentry : public MDSCacheObject, public LRUObject, public Counter<CDentry> {
 public:
+  MEMPOOL_CLASS_HELPERS();
   friend class CDir;
 
   struct linkage_t {
@@ -87,6 +89,7 @@ public:
   static const int STATE_EVALUATINGSTRAY = (1<<4);
   static const int STATE_PURGINGPINNED =  (1<<5);
   static const int STATE_BOTTOMLRU =    (1<<6);
+  static const int STATE_FETCHPINNED =  (1<<7);
   // stray dentry needs notification of releasing reference
   static const int STATE_STRAY =	STATE_NOTIFYREF;
   static const int MASK_STATE_IMPORT_KEPT = STATE_BOTTOMLRU;
@@ -96,6 +99,7 @@ public:
   static const int PIN_FRAGMENTING = -2;  // containing dir is refragmenting
   static const int PIN_PURGING =      3;
   static const int PIN_SCRUBPARENT =  4;
+  static const int PIN_FETCHING =    -5;  // containing dir is still fetching
 
   static const unsigned EXPORT_NONCE = 1;
 
@@ -129,6 +133,7 @@ public:
     case PIN_FRAGMENTING: return "fragmenting";
     case PIN_PURGING: return "purging";
     case PIN_SCRUBPARENT: return "scrubparent";
+    case PIN_FETCHING: return "fetching";
     default: return generic_pin_name(p);
     }
   }
@@ -30,6 +30,7 @@
 #include "common/bloom_filter.hpp"
 #include "include/Context.h"
 #include "common/Clock.h"
+#include "common/errno.h"
 
 #include "osdc/Objecter.h"
 
@@ -464,6 +465,8 @@ void CDir::remove_dentry(CDentry *dn)
     dn->put(CDentry::PIN_FRAGMENTING);
     dn->state_clear(CDentry::STATE_FRAGMENTING);
   }    
+  if (dn->state_test(CDentry::STATE_FETCHPINNED))
+    _fetch_unpin_dentry(dn);
 
   if (dn->get_linkage()->is_null()) {
     if (dn->last == CEPH_NOSNAP)
@@ -1534,29 +1537,17 @@ void CDir::fetch(MDSInternalContextBase *c, const std::set<dentry_key_t>& keys)
 }
 
 class C_IO_Dir_OMAP_FetchedMore : public CDirIOContext {
-  MDSInternalContextBase *fin;
+  version_t ondisk_version;
+  bool purge_snaps;
 public:
-  bufferlist hdrbl;
   bool more = false;
-  map<string, bufferlist> omap;      ///< carry-over from before
-  map<string, bufferlist> omap_more; ///< new batch
+  map<string, bufferlist> omap;
   int ret;
-  C_IO_Dir_OMAP_FetchedMore(CDir *d, MDSInternalContextBase *f) :
-    CDirIOContext(d), fin(f), ret(0) { }
-  void finish(int r) {
-    // merge results
-    if (omap.empty()) {
-      omap.swap(omap_more);
-    } else {
-      omap.insert(omap_more.begin(), omap_more.end());
-    }
-    if (more) {
-      dir->_omap_fetch_more(hdrbl, omap, fin);
-    } else {
-      dir->_omap_fetched(hdrbl, omap, !fin, r);
-      if (fin)
-	fin->complete(r);
-    }
+  C_IO_Dir_OMAP_FetchedMore(CDir *d, version_t v, bool p) :
+    CDirIOContext(d), ondisk_version(v), purge_snaps(p), ret(0) { }
+  void finish(int r) override {
+    if (r >= 0) r = ret;
+    dir->_omap_fetched_more(omap, ondisk_version, purge_snaps, more, r);
   }
 };
 
@@ -1577,13 +1568,9 @@ public:
       dir->inode->verify_diri_backtrace(btbl, ret3);
     if (r >= 0) r = ret1;
     if (r >= 0) r = ret2;
-    if (more) {
-      dir->_omap_fetch_more(hdrbl, omap, fin);
-    } else {
-      dir->_omap_fetched(hdrbl, omap, !fin, r);
-      if (fin)
-	fin->complete(r);
-    }
+    dir->_omap_fetched(hdrbl, omap, !fin, more, r);
+    if (fin)
+      fin->complete(r);
   }
 };
 
@@ -1620,22 +1607,19 @@ void CDir::_omap_fetch(MDSInternalContextBase *c, const std::set<dentry_key_t>&
 			     new C_OnFinisher(fin, cache->mds->finisher));
 }
 
-void CDir::_omap_fetch_more(
-  bufferlist& hdrbl,
-  map<string, bufferlist>& omap,
-  MDSInternalContextBase *c)
+void CDir::_omap_fetch_more(const string& start_after,
+			    version_t ondisk_version, bool purge_snaps)
 {
   // we have more omap keys to fetch!
   object_t oid = get_ondisk_object();
   object_locator_t oloc(cache->mds->mdsmap->get_metadata_pool());
-  C_IO_Dir_OMAP_FetchedMore *fin = new C_IO_Dir_OMAP_FetchedMore(this, c);
-  fin->hdrbl.claim(hdrbl);
-  fin->omap.swap(omap);
+  C_IO_Dir_OMAP_FetchedMore *fin =
+    new C_IO_Dir_OMAP_FetchedMore(this, ondisk_version, purge_snaps);
   ObjectOperation rd;
-  rd.omap_get_vals(fin->omap.rbegin()->first,
+  rd.omap_get_vals(start_after,
 		   "", /* filter prefix */
 		   g_conf->mds_dir_keys_per_op,
-		   &fin->omap_more,
+		   &fin->omap,
 		   &fin->more,
 		   &fin->ret);
   cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0,
@@ -1813,8 +1797,14 @@ CDentry *CDir::_load_dentry(
   return dn;
 }
 
+/*
+ * A full fetch of a large dirfrag arrives in chunks of mds_dir_keys_per_op
+ * keys.  Each chunk is loaded into the cache as soon as it arrives, with
+ * the read of the next one already issued, so that neither the raw omap
+ * of the whole dirfrag nor one long mds_lock hold is needed to load it.
+ */
 void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
-			 bool complete, int r)
+			 bool complete, bool more, int r)
 {
   LogChannelRef clog = cache->mds->clog;
   dout(10) << "_fetched header " << hdrbl.length() << " bytes "
@@ -1873,8 +1863,6 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
     }
   }
 
-  list<CInode*> undef_inodes;
-
   // purge stale snaps?
   // only if we have past_parents open!
   bool force_dirty = false;
@@ -1893,6 +1881,53 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
     }
   }
 
+  if (more) {
+    assert(complete);
+    _omap_fetch_more(omap.rbegin()->first, got_fnode.version, snaps != NULL);
+  }
+  _omap_load(omap, complete, got_fnode.version, snaps, force_dirty, more);
+  if (!more)
+    _omap_fetch_finish(complete);
+}
+
+void CDir::_omap_fetched_more(map<string, bufferlist>& omap,
+			      version_t ondisk_version, bool purge_snaps,
+			      bool more, int r)
+{
+  dout(10) << "_fetched_more " << omap.size() << " keys for " << *this
+	   << (more ? ", more to come" : "") << dendl;
+
+  assert(is_auth());
+  assert(!is_frozen());
+
+  if (r < 0) {
+    dout(0) << "_fetched_more got " << cpp_strerror(r) << " for " << *this
+	    << dendl;
+    cache->mds->clog->error() << "dir " << dirfrag() << " object vanished "
+			      << "while it was being fetched; some files may "
+			      << "be lost (" << get_path() << ")";
+    go_bad(true);
+    return;
+  }
+
+  const set<snapid_t> *snaps = NULL;
+  if (purge_snaps)
+    snaps = &inode->find_snaprealm()->get_snaps();
+
+  if (more && !omap.empty())
+    _omap_fetch_more(omap.rbegin()->first, ondisk_version, purge_snaps);
+  _omap_load(omap, true, ondisk_version, snaps, false,
+	     more && !omap.empty());
+  if (!more || omap.empty())
+    _omap_fetch_finish(true);
+}
+
+void CDir::_omap_load(map<string, bufferlist>& omap, bool complete,
+		      version_t ondisk_version, const set<snapid_t> *snaps,
+		      bool force_dirty, bool pin)
+{
+  list<CInode*> undef_inodes;
+
   unsigned pos = omap.size() - 1;
   for (map<string, bufferlist>::reverse_iterator p = omap.rbegin();
        p != omap.rend();
@@ -1929,6 +1964,11 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
       inode->mdcache->touch_dentry(dn);
     }
 
+    // more chunks to come: trimming this one now would leave the dir
+    // incomplete once they are in
+    if (dn && pin)
+      _fetch_pin_dentry(dn);
+
     /** clean underwater item?
      * Underwater item is something that is dirty in our cache from
      * journal replay, but was previously flushed to disk before the
@@ -1943,13 +1983,13 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
      */
     if (committed_version == 0 &&     
 	dn &&
-	dn->get_version() <= got_fnode.version &&
+	dn->get_version() <= ondisk_version &&
 	dn->is_dirty()) {
       dout(10) << "_fetched  had underwater dentry " << *dn << ", marking clean" << dendl;
       dn->mark_clean();
 
       if (dn->get_linkage()->is_primary()) {
-	assert(dn->get_linkage()->get_inode()->get_version() <= got_fnode.version);
+	assert(dn->get_linkage()->get_inode()->get_version() <= ondisk_version);
 	dout(10) << "_fetched  had underwater inode " << *dn->get_linkage()->get_inode() << ", marking clean" << dendl;
 	dn->get_linkage()->get_inode()->mark_clean();
       }
@@ -1958,18 +1998,6 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
 
   //cache->mds->logger->inc("newin", num_new_inodes_loaded);
 
-  // mark complete, !fetching
-  if (complete) {
-    wanted_items.clear();
-    mark_complete();
-    state_clear(STATE_FETCHING);
-
-    if (scrub_infop && scrub_infop->need_scrub_local) {
-      scrub_infop->need_scrub_local = false;
-      scrub_local();
-    }
-  }
-
   // open & force frags
   while (!undef_inodes.empty()) {
     CInode *in = undef_inodes.front();
@@ -1981,6 +2009,51 @@ void CDir::_omap_fetched(bufferlist& hdrbl, map<string, bufferlist>& omap,
   // dirty myself to remove stale snap dentries
   if (force_dirty && !inode->mdcache->is_readonly())
     log_mark_dirty();
+}
+
+void CDir::_fetch_pin_dentry(CDentry *dn)
+{
+  if (dn->state_test(CDentry::STATE_FETCHPINNED))
+    return;
+  dn->get(CDentry::PIN_FETCHING);
+  dn->state_set(CDentry::STATE_FETCHPINNED);
+  state_set(STATE_DNPINNEDFETCH);
+  cache->num_fetch_pinned_dentries++;
+}
+
+void CDir::_fetch_unpin_dentry(CDentry *dn)
+{
+  assert(cache->num_fetch_pinned_dentries > 0);
+  cache->num_fetch_pinned_dentries--;
+  dn->state_clear(CDentry::STATE_FETCHPINNED);
+  dn->put(CDentry::PIN_FETCHING);
+}
+
+void CDir::_fetch_unpin_dentries()
+{
+  if (!state_test(STATE_DNPINNEDFETCH))
+    return;
+  state_clear(STATE_DNPINNEDFETCH);
+  for (auto p = items.begin(); p != items.end(); ++p) {
+    if (p->second->state_test(CDentry::STATE_FETCHPINNED))
+      _fetch_unpin_dentry(p->second);
+  }
+}
+
+void CDir::_omap_fetch_finish(bool complete)
+{
+  // mark complete, !fetching
+  if (complete) {
+    _fetch_unpin_dentries();
+    wanted_items.clear();
+    mark_complete();
+    state_clear(STATE_FETCHING);
+
+    if (scrub_infop && scrub_infop->need_scrub_local) {
+      scrub_infop->need_scrub_local = false;
+      scrub_local();
+    }
+  }
 
   auth_unpin(this);
 
@@ -1996,6 +2069,7 @@ void CDir::_go_bad()
     set_version(1);
   state_set(STATE_BADFRAG);
   // mark complete, !fetching
+  _fetch_unpin_dentries();
   mark_complete();
   state_clear(STATE_FETCHING);
   auth_unpin(this);
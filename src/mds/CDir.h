@@ -20,6 +20,7 @@
 #include "include/counter.h"
 #include "include/types.h"
 #include "include/buffer_fwd.h"
+#include "include/mempool.h"
 #include "common/bloom_filter.hpp"
 #include "common/config.h"
 #include "common/DecayCounter.h"
@@ -82,6 +83,7 @@ public:
   static const unsigned STATE_COMMITTING =    (1<< 6);   // mid-commit
   static const unsigned STATE_FETCHING =      (1<< 7);   // currenting fetching
   static const unsigned STATE_CREATING =      (1<< 8);
+  static const unsigned STATE_DNPINNEDFETCH = (1<< 9);   // dentries pinned by a fetch
   static const unsigned STATE_IMPORTBOUND =   (1<<10);
   static const unsigned STATE_EXPORTBOUND =   (1<<11);
   static const unsigned STATE_EXPORTING =     (1<<12);
@@ -220,7 +222,7 @@ private:
   void log_mark_dirty();
 
 public:
-  typedef std::map<dentry_key_t, CDentry*> map_t;
+  typedef mempool::mds_co::map<dentry_key_t, CDentry*> map_t;
 
   class scrub_info_t {
   public:
@@ -596,9 +598,8 @@ protected:
   compact_set<string> wanted_items;
 
   void _omap_fetch(MDSInternalContextBase *fin, const std::set<dentry_key_t>& keys);
-  void _omap_fetch_more(
-    bufferlist& hdrbl, std::map<std::string, bufferlist>& omap,
-    MDSInternalContextBase *fin);
+  void _omap_fetch_more(const std::string& start_after,
+			version_t ondisk_version, bool purge_snaps);
   CDentry *_load_dentry(
       const std::string &key,
       const std::string &dname,
@@ -625,7 +626,17 @@ protected:
   void go_bad(bool complete);
 
   void _omap_fetched(bufferlist& hdrbl, std::map<std::string, bufferlist>& omap,
-		     bool complete, int r);
+		     bool complete, bool more, int r);
+  void _omap_fetched_more(std::map<std::string, bufferlist>& omap,
+			  version_t ondisk_version, bool purge_snaps,
+			  bool more, int r);
+  void _omap_load(std::map<std::string, bufferlist>& omap, bool complete,
+		  version_t ondisk_version, const std::set<snapid_t> *snaps,
+		  bool force_dirty, bool pin);
+  void _omap_fetch_finish(bool complete);
+  void _fetch_pin_dentry(CDentry *dn);
+  void _fetch_unpin_dentry(CDentry *dn);
+  void _fetch_unpin_dentries();
 
   // -- commit --
   compact_map<version_t, std::list<MDSInternalContextBase*> > waiting_for_commit;
@@ -375,6 +375,7 @@ inode_t *CInode::project_inode(map<string,bufferptr> *px)
   }
 
   projected_inode_t &pi = *projected_nodes.back();
+  mdcache->mds->stat_cache.invalidate(ino());
 
   if (px) {
     pi.xattrs = px;
@@ -400,6 +401,7 @@ void CInode::pop_and_dirty_projected_inode(LogSegment *ls)
 
   mark_dirty(projected_nodes.front()->inode->version, ls);
   inode = *projected_nodes.front()->inode;
+  mdcache->mds->stat_cache.invalidate(ino());
 
   if (inode.is_backtrace_updated())
     _mark_dirty_parent(ls, old_pool != inode.layout.pool_id);
@@ -1841,6 +1843,15 @@ void CInode::clear_scatter_dirty()
   dirfragtreelock.remove_dirty();
 }
 
+void CInode::lock_state_changed(SimpleLock *lock)
+{
+  // a getattr reply published while every lock was stable may no
+  // longer be what the regular path would send.  the cache is only
+  // active with mds_fast_getattr set.
+  if (is_file() && mdcache->mds->stat_cache.is_active())
+    mdcache->mds->stat_cache.invalidate(ino());
+}
+
 void CInode::clear_dirty_scattered(int type)
 {
   dout(10) << "clear_dirty_scattered " << type << " on " << *this << dendl;
@@ -2823,6 +2834,7 @@ Capability *CInode::add_client_cap(client_t client, Session *session, SnapRealm
 void CInode::remove_client_cap(client_t client)
 {
   assert(client_caps.count(client) == 1);
+  mdcache->mds->stat_cache.invalidate(ino());
   Capability *cap = client_caps[client];
   
   cap->item_session_caps.remove_myself();
@@ -3083,7 +3095,8 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
 			     SnapRealm *dir_realm,
 			     snapid_t snapid,
 			     unsigned max_bytes,
-			     int getattr_caps)
+			     int getattr_caps,
+			     bool peek)
 {
   client_t client = session->info.inst.name.num();
   assert(snapid);
@@ -3132,13 +3145,17 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
 
   SnapRealm *realm = find_snaprealm();
 
-  bool no_caps = !valid ||
+  // a peek encodes the stat without issuing caps or updating any
+  // client state, so it can be replayed later (see InodeStatCache)
+  bool no_caps = peek ||
+		 !valid ||
 		 session->is_stale() ||
 		 (dir_realm && realm != dir_realm) ||
 		 is_frozen() ||
 		 state_test(CInode::STATE_EXPORTINGCAPS);
   if (no_caps)
     dout(20) << "encode_inodestat no caps"
+	     << (peek?", peek":"")
 	     << (!valid?", !valid":"")
 	     << (session->is_stale()?", session stale ":"")
 	     << ((dir_realm && realm != dir_realm)?", snaprealm differs ":"")
@@ -3189,16 +3206,17 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
   bufferlist inline_data;
   if (file_i->inline_data.version == CEPH_INLINE_NONE) {
     inline_version = CEPH_INLINE_NONE;
-  } else if ((!cap && !no_caps) ||
-	     (cap && cap->client_inline_version < file_i->inline_data.version) ||
-	     (getattr_caps & CEPH_CAP_FILE_RD)) { // client requests inline data
+  } else if (!peek &&
+	     ((!cap && !no_caps) ||
+	      (cap && cap->client_inline_version < file_i->inline_data.version) ||
+	      (getattr_caps & CEPH_CAP_FILE_RD))) { // client requests inline data
     inline_version = file_i->inline_data.version;
     if (file_i->inline_data.length() > 0)
       inline_data = file_i->inline_data.get_data();
   }
 
   // nest (do same as file... :/)
-  if (cap) {
+  if (cap && !peek) {
     cap->last_rbytes = file_i->rstat.rbytes;
     cap->last_rsize = file_i->rstat.rsize();
   }
@@ -3215,9 +3233,10 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
   // xattr
   bufferlist xbl;
   version_t xattr_version;
-  if ((!cap && !no_caps) ||
-      (cap && cap->client_xattr_version < xattr_i->xattr_version) ||
-      (getattr_caps & CEPH_CAP_XATTR_SHARED)) { // client requests xattrs
+  if (!peek &&
+      ((!cap && !no_caps) ||
+       (cap && cap->client_xattr_version < xattr_i->xattr_version) ||
+       (getattr_caps & CEPH_CAP_XATTR_SHARED))) { // client requests xattrs
     if (!pxattrs)
       pxattrs = pxattr ? get_projected_xattrs() : &xattrs;
     ::encode(*pxattrs, xbl);
@@ -3288,7 +3307,7 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
       issue = cap->pending();
       dout(10) << "encode_inodestat issuing " << ccap_string(issue)
 	       << " seq " << cap->get_last_seq() << dendl;
-    } else if (cap && cap->is_new() && !dir_realm) {
+    } else if (!peek && cap && cap->is_new() && !dir_realm) {
       // alway issue new caps to client, otherwise the caps get lost
       assert(cap->is_stale());
       issue = cap->pending() | CEPH_CAP_PIN;
@@ -3630,6 +3649,9 @@ void CInode::finish_export(utime_t now)
 {
   state &= MASK_STATE_EXPORT_KEPT;
 
+  // the importer is auth now, and may change us
+  mdcache->mds->stat_cache.invalidate(ino());
+
   pop.zero(now);
 
   // just in case!
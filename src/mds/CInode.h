@@ -831,7 +831,7 @@ public:
   // for giving to clients
   int encode_inodestat(bufferlist& bl, Session *session, SnapRealm *realm,
 		       snapid_t snapid=CEPH_NOSNAP, unsigned max_bytes=0,
-		       int getattr_wants=0);
+		       int getattr_wants=0, bool peek=false);
   void encode_cap_message(MClientCaps *m, Capability *cap);
 
 
@@ -881,6 +881,7 @@ public:
   void _finish_frag_update(CDir *dir, MutationRef& mut);
 
   void clear_dirty_scattered(int type) override;
+  void lock_state_changed(SimpleLock *lock) override;
   bool is_dirty_scattered();
   void clear_scatter_dirty();  // on rejoin ack
 
@@ -0,0 +1,150 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "InodeStatCache.h"
+
+#include "messages/MClientRequest.h"
+#include "messages/MClientReply.h"
+
+InodeStatCache::InodeStatCache()
+  : active(false)
+{
+}
+
+InodeStatCache::~InodeStatCache()
+{
+}
+
+bool InodeStatCache::is_fast_getattr(const MClientRequest *req)
+{
+  // xattrs are only encoded when the client asks for them, and a
+  // replayed, retried or forwarded request needs the session's
+  // completed request bookkeeping: leave all of those to the Server.
+  return req->get_op() == CEPH_MDS_OP_GETATTR &&
+    req->get_source().is_client() &&
+    !(req->get_flags() & CEPH_MDS_FLAG_REPLAY) &&
+    req->get_num_fwd() == 0 &&
+    req->get_retry_attempt() == 0 &&
+    req->releases.empty() &&
+    req->get_filepath().depth() == 0 &&
+    !(req->head.args.getattr.mask & CEPH_CAP_XATTR_SHARED);
+}
+
+void InodeStatCache::publish(inodeno_t ino, client_t client,
+			     const Reply &reply)
+{
+  if (!active)
+    return;
+  Shard &s = shard_of(ino);
+  Mutex::Locker l(s.lock);
+  s.inodes[ino][client] = reply;
+}
+
+bool InodeStatCache::contains(inodeno_t ino, client_t client) const
+{
+  if (!active)
+    return false;
+  const Shard &s = shard_of(ino);
+  Mutex::Locker l(s.lock);
+  auto p = s.inodes.find(ino);
+  return p != s.inodes.end() && p->second.count(client);
+}
+
+MClientReply *InodeStatCache::build_reply(MClientRequest *req)
+{
+  if (!active)
+    return NULL;
+  inodeno_t ino = req->get_filepath().get_ino();
+  client_t client = req->get_source().num();
+
+  Shard &s = shard_of(ino);
+  Mutex::Locker l(s.lock);
+  auto p = s.inodes.find(ino);
+  if (p == s.inodes.end())
+    return NULL;
+  auto q = p->second.find(client);
+  if (q == p->second.end())
+    return NULL;
+  s.hits[ino]++;
+
+  MClientReply *reply = new MClientReply(req, 0);
+  reply->snapbl = q->second.snapbl;
+  reply->head.is_dentry = 0;
+  reply->head.is_target = 1;
+  bufferlist trace = q->second.trace;
+  reply->set_trace(trace);
+  reply->set_mdsmap_epoch(q->second.mdsmap_epoch);
+  return reply;
+}
+
+void InodeStatCache::invalidate(inodeno_t ino)
+{
+  if (!active)
+    return;
+  Shard &s = shard_of(ino);
+  Mutex::Locker l(s.lock);
+  s.inodes.erase(ino);
+}
+
+void InodeStatCache::invalidate_client(client_t client)
+{
+  if (!active)
+    return;
+  for (unsigned i = 0; i < NUM_SHARDS; i++) {
+    Mutex::Locker l(shards[i].lock);
+    for (auto p = shards[i].inodes.begin(); p != shards[i].inodes.end(); ) {
+      p->second.erase(client);
+      if (p->second.empty())
+	shards[i].inodes.erase(p++);
+      else
+	++p;
+    }
+  }
+}
+
+void InodeStatCache::clear()
+{
+  for (unsigned i = 0; i < NUM_SHARDS; i++) {
+    Mutex::Locker l(shards[i].lock);
+    shards[i].inodes.clear();
+  }
+}
+
+void InodeStatCache::set_active(bool a)
+{
+  if (active == a)
+    return;
+  active = a;
+  if (!a)
+    clear();
+}
+
+void InodeStatCache::take_hits(std::map<inodeno_t, uint64_t> *hits)
+{
+  for (unsigned i = 0; i < NUM_SHARDS; i++) {
+    Mutex::Locker l(shards[i].lock);
+    for (auto &p : shards[i].hits)
+      (*hits)[p.first] += p.second;
+    shards[i].hits.clear();
+  }
+}
+
+size_t InodeStatCache::size() const
+{
+  size_t n = 0;
+  for (unsigned i = 0; i < NUM_SHARDS; i++) {
+    Mutex::Locker l(shards[i].lock);
+    for (auto &p : shards[i].inodes)
+      n += p.second.size();
+  }
+  return n;
+}
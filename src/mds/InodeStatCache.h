@@ -0,0 +1,99 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MDS_INODESTATCACHE_H
+#define CEPH_MDS_INODESTATCACHE_H
+
+#include <atomic>
+#include <map>
+
+#include "include/types.h"
+#include "include/buffer.h"
+#include "common/Mutex.h"
+#include "mdstypes.h"
+
+class MClientRequest;
+class MClientReply;
+
+/**
+ * Replies to getattr on inodes that are stable for a given client, so
+ * that repeated stats of such an inode can be answered by the messenger
+ * threads without taking mds_lock.
+ *
+ * Entries are published by Server::handle_client_getattr, under
+ * mds_lock, when a client that already holds caps on a regular file
+ * stats it while every lock that feeds the reply is in LOCK_SYNC.  The
+ * MDS invalidates the inode, again under mds_lock, before anything that
+ * could change the reply (projecting the inode, a lock state change,
+ * export, removal from the cache, a snaprealm change) becomes visible to
+ * any client, so a reply served from here is never older than one the
+ * client could have had from the regular path.
+ *
+ * The map is split into shards with one lock each, chosen by inode
+ * number, so readers of different inodes do not contend.  Hits are
+ * counted per inode so the MDS can feed them back into the balancer.
+ */
+class InodeStatCache {
+public:
+  struct Reply {
+    bufferlist snapbl;
+    bufferlist trace;
+    epoch_t mdsmap_epoch;
+    Reply() : mdsmap_epoch(0) {}
+  };
+
+  InodeStatCache();
+  ~InodeStatCache();
+
+  /// a request that may be answered from the cache, if published
+  static bool is_fast_getattr(const MClientRequest *req);
+
+  void publish(inodeno_t ino, client_t client, const Reply &reply);
+  bool contains(inodeno_t ino, client_t client) const;
+  /// build the reply to @req from the cache, or return NULL
+  MClientReply *build_reply(MClientRequest *req);
+
+  void invalidate(inodeno_t ino);
+  void invalidate_client(client_t client);
+  void clear();
+
+  /// only publish and serve while the rank is active
+  void set_active(bool a);
+  bool is_active() const { return active; }
+
+  /// collect and reset the per-inode hit counts
+  void take_hits(std::map<inodeno_t, uint64_t> *hits);
+
+  size_t size() const;
+
+private:
+  struct Shard {
+    mutable Mutex lock;
+    std::map<inodeno_t, std::map<client_t, Reply> > inodes;
+    std::map<inodeno_t, uint64_t> hits;  ///< survive invalidation
+    Shard() : lock("InodeStatCache::Shard::lock") {}
+  };
+
+  static const unsigned NUM_SHARDS = 32;
+
+  Shard shards[NUM_SHARDS];
+  std::atomic<bool> active;
+
+  Shard &shard_of(inodeno_t ino) {
+    return shards[ino.val % NUM_SHARDS];
+  }
+  const Shard &shard_of(inodeno_t ino) const {
+    return shards[ino.val % NUM_SHARDS];
+  }
+};
+
+#endif
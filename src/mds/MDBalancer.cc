@@ -1056,13 +1056,14 @@ void MDBalancer::find_exports(CDir *dir,
 
 }
 
-void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
+void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who,
+			   double amount)
 {
   // hit inode
-  in->pop.get(type).hit(now, mds->mdcache->decayrate);
+  in->pop.get(type).hit(now, mds->mdcache->decayrate, amount);
 
   if (in->get_parent_dn())
-    hit_dir(now, in->get_parent_dn()->get_dir(), type, who);
+    hit_dir(now, in->get_parent_dn()->get_dir(), type, who, amount);
 }
 
 void MDBalancer::maybe_fragment(CDir *dir, bool hot)
@@ -282,6 +282,8 @@ void MDCache::remove_inode(CInode *o)
 { 
   dout(14) << "remove_inode " << *o << dendl;
 
+  mds->stat_cache.invalidate(o->ino());
+
   if (o->get_parent_dn()) {
     // FIXME: multiple parents?
     CDentry *dn = o->get_parent_dn();
@@ -6473,8 +6475,11 @@ bool MDCache::trim(int max, int count)
     bottom_lru.lru_insert_mid(dn);
   unexpirables.clear();
 
-  // trim dentries from the LRU: only enough to satisfy `max`,
-  while (lru.lru_get_size() + unexpirable > (unsigned)max) {
+  // trim dentries from the LRU: only enough to satisfy `max`.  dentries
+  // pinned by dirfrag fetches still in flight sit in the pintail and do
+  // not count against it until the fetch is done.
+  while ((int64_t)lru.lru_get_size() - (int64_t)num_fetch_pinned_dentries +
+	 unexpirable > max) {
     CDentry *dn = static_cast<CDentry*>(lru.lru_expire());
     if (!dn) {
       break;
@@ -9304,6 +9309,10 @@ void MDCache::do_realm_invalidate_and_update_notify(CInode *in, int snapop, bool
 {
   dout(10) << "do_realm_invalidate_and_update_notify " << *in->snaprealm << " " << *in << dendl;
 
+  // cached getattr replies carry the snap trace of their realm
+  if (mds->stat_cache.is_active())
+    mds->stat_cache.clear();
+
   vector<inodeno_t> split_inos;
   vector<inodeno_t> split_realms;
 
@@ -76,6 +76,27 @@ void MDLog::create_logger()
 
   plb.add_u64_counter(l_mdl_replayed, "replayed", "Events replayed");
 
+  PerfHistogramCommon::axis_config_d lat_x_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    100,
+    24,
+  };
+  PerfHistogramCommon::axis_config_d events_y_axis_config{
+    "Events per flush",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    1,
+    16,
+  };
+  plb.add_u64_avg(l_mdl_flush, "flush", "Events per journal flush");
+  plb.add_u64_counter(l_mdl_flush_delayed, "flush_delayed",
+      "Flushes held back to gather more events");
+  plb.add_u64_counter_histogram(l_mdl_jlat_hist, "jlat_histogram",
+      lat_x_axis_config, events_y_axis_config,
+      "Histogram of submit to safe latency + events per flush");
+
   // logger
   logger = plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
@@ -175,7 +196,13 @@ void MDLog::create(MDSInternalContextBase *c)
   logger->set(l_mdl_expos, journaler->get_expire_pos());
   logger->set(l_mdl_wrpos, journaler->get_write_pos());
 
+  _start_submit_thread();
+}
+
+void MDLog::_start_submit_thread()
+{
   submit_thread.create("md_submit");
+  encode_tp.start();
 }
 
 void MDLog::open(MDSInternalContextBase *c)
@@ -186,7 +213,7 @@ void MDLog::open(MDSInternalContextBase *c)
   recovery_thread.set_completion(c);
   recovery_thread.create("md_recov_open");
 
-  submit_thread.create("md_submit");
+  _start_submit_thread();
   // either append() or replay() will follow.
 }
 
@@ -285,7 +312,13 @@ void MDLog::_submit_entry(LogEvent *le, MDSLogContextBase *c)
 
   le->_segment = ls;
   le->update_segment();
-  le->set_stamp(ceph_clock_now());
+  utime_t now = ceph_clock_now();
+  le->set_stamp(now);
+  if (last_submit_stamp != utime_t()) {
+    double gap = std::min(1.0, (double)(now - last_submit_stamp));
+    submit_interval += (gap - submit_interval) / 8;
+  }
+  last_submit_stamp = now;
 
   mdsmap_up_features = mds->mdsmap->get_up_features();
   pending_events[ls->seq].push_back(PendingEvent(le, c));
@@ -344,75 +377,209 @@ public:
   }
 };
 
+/*
+ * Records how long the events of one group commit took to become safe,
+ * measured from the submission of the oldest of them.  This only touches
+ * the perf counters, so it runs straight from the finisher, without
+ * mds_lock.
+ */
+class C_MDL_GroupCommitted : public Context {
+  PerfCounters *logger;
+  uint64_t num_events;
+  utime_t stamp;
+
+  void finish(int r) override {
+    if (r == 0) {
+      utime_t lat = ceph_clock_now() - stamp;
+      logger->hinc(l_mdl_jlat_hist, lat.to_nsec() / 1000, num_events);
+    }
+  }
+
+public:
+  C_MDL_GroupCommitted(PerfCounters *l, uint64_t n, utime_t s)
+    : logger(l), num_events(n), stamp(s) {}
+};
+
+/*
+ * Move queued events, in segment order, into the batch, up to
+ * mds_log_group_commit_max_events.  Returns true if a flush was requested
+ * by any of them.  Lists emptied here stay behind until the next call,
+ * so that trim() still sees their segments as busy while the batch is
+ * being written.
+ */
+bool MDLog::_take_pending_events(vector<PendingEvent> *batch)
+{
+  assert(submit_mutex.is_locked_by_me());
+  size_t max = MAX(1u, g_conf->mds_log_group_commit_max_events);
+  bool flush = false;
+  auto it = pending_events.begin();
+  while (it != pending_events.end() && it->second.empty())
+    pending_events.erase(it++);
+  for (; it != pending_events.end() && batch->size() < max; ++it) {
+    list<PendingEvent>& events = it->second;
+    submitting_seq = it->first;
+    while (!events.empty() && batch->size() < max) {
+      flush |= events.front().flush;
+      batch->push_back(events.front());
+      events.pop_front();
+    }
+  }
+  if (flush || batch->size() < max)
+    flush_pending = false;
+  return flush;
+}
+
+/*
+ * Holding a requested flush back only pays if more events are likely to
+ * arrive before the delay runs out.
+ */
+bool MDLog::_should_delay_flush() const
+{
+  double delay = g_conf->mds_log_group_commit_max_delay;
+  if (!flush_pending || delay <= 0 || submit_interval * 2 >= delay)
+    return false;
+  size_t queued = 0;
+  for (auto& p : pending_events)
+    queued += p.second.size();
+  return queued < g_conf->mds_log_group_commit_max_events;
+}
+
+void MDLog::EncodeWQ::encode(const EncodeJob *job)
+{
+  const vector<PendingEvent>& batch = *job->batch;
+  for (size_t i = job->first; i < batch.size(); i += job->stride) {
+    if (batch[i].le)
+      batch[i].le->encode_with_header((*job->bls)[i], job->features);
+  }
+}
+
+void MDLog::encode_events(const vector<PendingEvent>& batch,
+			  uint64_t features, vector<bufferlist> *bls)
+{
+  size_t n = batch.size();
+  bls->resize(n);
+
+  // handing events to the pool only pays for itself on a large batch
+  const size_t EVENTS_PER_ENCODE_JOB = 64;
+  size_t num_jobs = MIN((size_t)MAX(1, g_conf->mds_log_encode_threads),
+			n / EVENTS_PER_ENCODE_JOB);
+  if (num_jobs <= 1) {
+    EncodeJob job = { &batch, bls, features, 0, 1 };
+    EncodeWQ::encode(&job);
+    return;
+  }
+
+  vector<EncodeJob> jobs(num_jobs);
+  for (size_t j = 0; j < num_jobs; ++j) {
+    jobs[j] = { &batch, bls, features, j, num_jobs };
+    encode_wq.queue(&jobs[j]);
+  }
+  encode_wq.drain();
+}
+
+/*
+ * Events are taken from the queue in batches: each batch is encoded
+ * (outside of submit_mutex, and in parallel when it is large), appended
+ * to the journal, and then flushed at most once, so that requests that
+ * arrive together share a single RADOS write.  When a flush is asked for
+ * while events are streaming in, it is held back for up to
+ * mds_log_group_commit_max_delay so that they can join it.
+ */
 void MDLog::_submit_thread()
 {
   dout(10) << "_submit_thread start" << dendl;
 
   submit_mutex.Lock();
 
+  utime_t flush_deadline;
   while (!mds->is_daemon_stopping()) {
     if (g_conf->mds_log_pause) {
       submit_cond.Wait(submit_mutex);
       continue;
     }
 
-    map<uint64_t,list<PendingEvent> >::iterator it = pending_events.begin();
-    if (it == pending_events.end()) {
+    if (pending_events.empty()) {
       submit_cond.Wait(submit_mutex);
       continue;
     }
 
-    if (it->second.empty()) {
-      pending_events.erase(it);
-      continue;
+    if (_should_delay_flush()) {
+      utime_t now = ceph_clock_now();
+      if (flush_deadline == utime_t()) {
+	utime_t delay;
+	delay.set_from_double(g_conf->mds_log_group_commit_max_delay);
+	flush_deadline = now + delay;
+	dout(20) << "_submit_thread holding flush until " << flush_deadline
+		 << ", submit interval " << submit_interval << dendl;
+	if (logger)
+	  logger->inc(l_mdl_flush_delayed);
+      }
+      if (now < flush_deadline) {
+	submit_cond.WaitInterval(submit_mutex, flush_deadline - now);
+	continue;
+      }
     }
+    flush_deadline = utime_t();
+
+    vector<PendingEvent> events;
+    bool flush = _take_pending_events(&events);
+    if (events.empty())
+      continue;
 
     int64_t features = mdsmap_up_features;
-    PendingEvent data = it->second.front();
-    it->second.pop_front();
+    uint64_t num_events = 0;
+    utime_t oldest_stamp = unflushed_stamp;
+    for (auto& data : events) {
+      if (data.le) {
+	if (!unflushed && !num_events)
+	  oldest_stamp = data.le->get_stamp();
+	++num_events;
+      }
+    }
+    uint64_t flush_events = unflushed + num_events;
+    submitting = true;
 
     submit_mutex.Unlock();
 
-    if (data.le) {
-      LogEvent *le = data.le;
-      LogSegment *ls = le->_segment;
-      // encode it, with event type
-      bufferlist bl;
-      le->encode_with_header(bl, features);
+    vector<bufferlist> bls;
+    encode_events(events, features, &bls);
 
-      uint64_t write_pos = journaler->get_write_pos();
+    for (size_t i = 0; i < events.size(); ++i) {
+      PendingEvent& data = events[i];
+      if (data.le) {
+	LogEvent *le = data.le;
+	LogSegment *ls = le->_segment;
+	bufferlist& bl = bls[i];
 
-      le->set_start_off(write_pos);
-      if (le->get_type() == EVENT_SUBTREEMAP)
-	ls->offset = write_pos;
+	uint64_t write_pos = journaler->get_write_pos();
 
-      dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
-	      << " : " << *le << dendl;
+	le->set_start_off(write_pos);
+	if (le->get_type() == EVENT_SUBTREEMAP)
+	  ls->offset = write_pos;
 
-      // journal it.
-      const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
-      ls->end = new_write_pos;
+	dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
+		<< " : " << *le << dendl;
 
-      MDSLogContextBase *fin;
-      if (data.fin) {
-	fin = dynamic_cast<MDSLogContextBase*>(data.fin);
-	assert(fin);
-	fin->set_write_pos(new_write_pos);
-      } else {
-	fin = new C_MDL_Flushed(this, new_write_pos);
-      }
+	// journal it.
+	const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
+	ls->end = new_write_pos;
 
-      journaler->wait_for_flush(fin);
+	MDSLogContextBase *fin;
+	if (data.fin) {
+	  fin = dynamic_cast<MDSLogContextBase*>(data.fin);
+	  assert(fin);
+	  fin->set_write_pos(new_write_pos);
+	} else {
+	  fin = new C_MDL_Flushed(this, new_write_pos);
+	}
 
-      if (data.flush)
-	journaler->flush();
+	journaler->wait_for_flush(fin);
 
-      if (logger)
-	logger->set(l_mdl_wrpos, ls->end);
+	if (logger)
+	  logger->set(l_mdl_wrpos, ls->end);
 
-      delete le;
-    } else {
-      if (data.fin) {
+	delete le;
+      } else if (data.fin) {
 	MDSInternalContextBase* fin =
 		dynamic_cast<MDSInternalContextBase*>(data.fin);
 	assert(fin);
@@ -420,15 +587,28 @@ void MDLog::_submit_thread()
 	fin2->set_write_pos(journaler->get_write_pos());
 	journaler->wait_for_flush(fin2);
       }
-      if (data.flush)
-	journaler->flush();
+    }
+
+    if (flush) {
+      dout(10) << "_submit_thread flushing " << flush_events << " events"
+	       << dendl;
+      if (flush_events && logger) {
+	journaler->wait_for_flush(
+	  new C_MDL_GroupCommitted(logger, flush_events, oldest_stamp));
+	logger->inc(l_mdl_flush, flush_events);
+      }
+      journaler->flush();
     }
 
     submit_mutex.Lock();
-    if (data.flush)
+    submitting = false;
+    if (flush) {
       unflushed = 0;
-    else if (data.le)
-      unflushed++;
+    } else if (num_events) {
+      if (!unflushed)
+	unflushed_stamp = oldest_stamp;
+      unflushed += num_events;
+    }
   }
 
   submit_mutex.Unlock();
@@ -439,8 +619,8 @@ void MDLog::wait_for_safe(MDSInternalContextBase *c)
   submit_mutex.Lock();
 
   bool no_pending = true;
-  if (!pending_events.empty()) {
-    pending_events.rbegin()->second.push_back(PendingEvent(NULL, c));
+  if (!pending_events.empty() || submitting) {
+    _pending_tail().push_back(PendingEvent(NULL, c));
     no_pending = false;
     submit_cond.Signal();
   }
@@ -455,18 +635,29 @@ void MDLog::flush()
 {
   submit_mutex.Lock();
 
+  uint64_t flush_events = unflushed;
+  utime_t oldest_stamp = unflushed_stamp;
   bool do_flush = unflushed > 0;
   unflushed = 0;
-  if (!pending_events.empty()) {
-    pending_events.rbegin()->second.push_back(PendingEvent(NULL, NULL, true));
+  if (!pending_events.empty() || submitting) {
+    _pending_tail().push_back(PendingEvent(NULL, NULL, true));
+    flush_pending = true;
     do_flush = false;
     submit_cond.Signal();
   }
 
   submit_mutex.Unlock();
 
-  if (do_flush)
+  if (do_flush) {
+    // everything submitted so far was appended without a flush; account
+    // for it the way the submit thread does for its own
+    if (logger) {
+      journaler->wait_for_flush(
+	new C_MDL_GroupCommitted(logger, flush_events, oldest_stamp));
+      logger->inc(l_mdl_flush, flush_events);
+    }
     journaler->flush();
+  }
 }
 
 void MDLog::kick_submitter()
@@ -506,6 +697,7 @@ void MDLog::shutdown()
 
       submit_thread.join();
     }
+    encode_tp.stop();
   }
 
   // Replay thread can be stuck inside e.g. Journaler::wait_for_readable,
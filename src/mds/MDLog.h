@@ -35,6 +35,9 @@ enum {
   l_mdl_rdpos,
   l_mdl_jlat,
   l_mdl_replayed,
+  l_mdl_flush,
+  l_mdl_flush_delayed,
+  l_mdl_jlat_hist,
   l_mdl_last,
 };
 
@@ -43,6 +46,8 @@ enum {
 
 #include "common/Thread.h"
 #include "common/Cond.h"
+#include "common/WorkQueue.h"
+#include "global/global_context.h"
 
 #include "LogSegment.h"
 
@@ -70,6 +75,7 @@ protected:
   int num_events; // in events
 
   int unflushed;
+  utime_t unflushed_stamp;  // submit time of the oldest unflushed event
 
   bool capped;
 
@@ -139,6 +145,23 @@ protected:
   Mutex submit_mutex;
   Cond submit_cond;
 
+  bool flush_pending;       // a flush request is queued
+  // the submit thread is writing a batch taken from segment submitting_seq
+  // out to the journal; later waiters must queue up behind it
+  bool submitting;
+  uint64_t submitting_seq;
+
+  // moving average of the time between submitted events, used to decide
+  // whether holding back a flush is likely to pick up more events
+  utime_t last_submit_stamp;
+  double submit_interval;
+
+  list<PendingEvent>& _pending_tail() {
+    if (pending_events.empty())
+      return pending_events[submitting_seq];
+    return pending_events.rbegin()->second;
+  }
+
   void set_safe_pos(uint64_t pos)
   {
     Mutex::Locker l(submit_mutex);
@@ -148,6 +171,10 @@ protected:
   friend class MDSLogContextBase;
 
   void _submit_thread();
+  bool _take_pending_events(vector<PendingEvent> *batch);
+  bool _should_delay_flush() const;
+  void encode_events(const vector<PendingEvent>& batch, uint64_t features,
+		     vector<bufferlist> *bls);
   class SubmitThread : public Thread {
     MDLog *log;
   public:
@@ -159,6 +186,49 @@ protected:
   } submit_thread;
   friend class SubmitThread;
 
+  // Large batches are encoded on a pool that runs alongside the submit
+  // thread: each job encodes every stride'th event from first on.
+  struct EncodeJob {
+    const vector<PendingEvent> *batch;
+    vector<bufferlist> *bls;
+    uint64_t features;
+    size_t first, stride;
+  };
+  ThreadPool encode_tp;
+  struct EncodeWQ : public ThreadPool::WorkQueue<EncodeJob> {
+    std::deque<EncodeJob*> q;
+
+    explicit EncodeWQ(ThreadPool *tp)
+      : ThreadPool::WorkQueue<EncodeJob>("MDLog::EncodeWQ", 0, 0, tp) {}
+
+    bool _enqueue(EncodeJob *job) override {
+      q.push_back(job);
+      return true;
+    }
+    void _dequeue(EncodeJob *job) override {
+      ceph_abort();
+    }
+    EncodeJob *_dequeue() override {
+      if (q.empty())
+	return nullptr;
+      EncodeJob *job = q.front();
+      q.pop_front();
+      return job;
+    }
+    static void encode(const EncodeJob *job);
+    void _process(EncodeJob *job, ThreadPool::TPHandle &handle) override {
+      encode(job);
+    }
+    bool _empty() override {
+      return q.empty();
+    }
+    void _clear() override {
+      assert(q.empty());
+    }
+  } encode_wq;
+
+  void _start_submit_thread();
+
 public:
   const std::set<LogSegment*> &get_expiring_segments() const
   {
@@ -205,7 +275,16 @@ public:
                       event_seq(0), expiring_events(0), expired_events(0),
 		      mdsmap_up_features(0),
                       submit_mutex("MDLog::submit_mutex"),
+                      flush_pending(false),
+                      submitting(false),
+                      submitting_seq(0),
+                      submit_interval(1.0),
                       submit_thread(this),
+                      encode_tp(g_ceph_context, "MDLog::encode_tp",
+				"tp_mdlog_enc",
+				MAX(1, g_conf->mds_log_encode_threads),
+				"mds_log_encode_threads"),
+                      encode_wq(&encode_tp),
                       cur_event(NULL) { }		  
   ~MDLog();
 
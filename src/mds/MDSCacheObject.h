@@ -387,6 +387,7 @@ protected:
   virtual void finish_lock_waiters(int type, uint64_t mask, int r=0) { ceph_abort(); }
   virtual void add_lock_waiter(int type, uint64_t mask, MDSInternalContextBase *c) { ceph_abort(); }
   virtual bool is_lock_waiting(int type, uint64_t mask) { ceph_abort(); return false; }
+  virtual void lock_state_changed(SimpleLock *lock) {}
 
   virtual void clear_dirty_scattered(int type) { ceph_abort(); }
 
@@ -53,6 +53,8 @@
 #include "messages/MGenericMessage.h"
 
 #include "messages/MMonCommand.h"
+#include "messages/MClientRequest.h"
+#include "messages/MClientReply.h"
 #include "messages/MCommand.h"
 #include "messages/MCommandReply.h"
 
@@ -87,7 +89,7 @@ public:
 // cons/des
 MDSDaemon::MDSDaemon(const std::string &n, Messenger *m, MonClient *mc) :
   Dispatcher(m->cct),
-  mds_lock("MDSDaemon::mds_lock"),
+  mds_lock("MDSDaemon::mds_lock", false, true, false, m->cct),
   stopping(false),
   timer(m->cct, mds_lock),
   beacon(m->cct, mc, n),
@@ -353,6 +355,7 @@ const char** MDSDaemon::get_tracked_conf_keys() const
     "mds_op_history_size", "mds_op_history_duration",
     "mds_enable_op_tracker",
     "mds_log_pause",
+    "mds_fast_getattr",
     // clog & admin clog
     "clog_to_monitors",
     "clog_to_syslog",
@@ -930,7 +933,7 @@ void MDSDaemon::handle_mds_map(MMDSMap *m)
     // Did I previously not hold a rank?  Initialize!
     if (mds_rank == NULL) {
       mds_rank = new MDSRankDispatcher(whoami, mds_lock, clog,
-          timer, beacon, mdsmap, messenger, monc,
+          timer, beacon, stat_cache, mdsmap, messenger, monc,
           new FunctionContext([this](int r){respawn();}),
           new FunctionContext([this](int r){suicide();}));
       dout(10) <<  __func__ << ": initializing MDS rank "
@@ -1108,6 +1111,41 @@ bool MDSDaemon::ms_dispatch(Message *m)
   }
 }
 
+/*
+ * A getattr that the rank has published a reply for is answered here,
+ * without mds_lock.  Everything else, including a getattr whose entry
+ * was invalidated since ms_can_fast_dispatch looked, takes the regular
+ * path.
+ */
+bool MDSDaemon::ms_can_fast_dispatch(const Message *m) const
+{
+  if (m->get_type() != CEPH_MSG_CLIENT_REQUEST ||
+      !g_conf->mds_fast_getattr ||
+      !stat_cache.is_active())
+    return false;
+  const MClientRequest *req = static_cast<const MClientRequest*>(m);
+  return InodeStatCache::is_fast_getattr(req) &&
+    stat_cache.contains(req->get_filepath().get_ino(),
+			req->get_source().num());
+}
+
+void MDSDaemon::ms_fast_dispatch(Message *m)
+{
+  MClientRequest *req = static_cast<MClientRequest*>(m);
+  MClientReply *reply = NULL;
+  if (!beacon.is_laggy())
+    reply = stat_cache.build_reply(req);
+  if (!reply) {
+    dout(10) << __func__ << " no cached reply for " << *req << dendl;
+    if (!ms_dispatch(m))
+      m->put();
+    return;
+  }
+  dout(10) << __func__ << " " << *req << dendl;
+  req->get_connection()->send_message(reply);
+  req->put();
+}
+
 bool MDSDaemon::ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new)
 {
   dout(10) << "MDSDaemon::ms_get_authorizer type="
@@ -38,6 +38,7 @@
 #include "MDSMap.h"
 
 #include "Beacon.h"
+#include "InodeStatCache.h"
 
 
 #define CEPH_MDS_PROTOCOL    30 /* cluster internal */
@@ -75,6 +76,10 @@ class MDSDaemon : public Dispatcher, public md_config_obs_t {
  protected:
   Beacon  beacon;
 
+  // Shared with the rank, which fills it under mds_lock; answered from
+  // the messenger threads in ms_fast_dispatch.
+  InodeStatCache stat_cache;
+
   AuthAuthorizeHandlerRegistry *authorize_handler_cluster_registry;
   AuthAuthorizeHandlerRegistry *authorize_handler_service_registry;
 
@@ -122,6 +127,9 @@ class MDSDaemon : public Dispatcher, public md_config_obs_t {
 
  private:
   bool ms_dispatch(Message *m) override;
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override;
+  void ms_fast_dispatch(Message *m) override;
   bool ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new) override;
   bool ms_verify_authorizer(Connection *con, int peer_type,
 			       int protocol, bufferlist& authorizer_data, bufferlist& authorizer_reply,
@@ -48,6 +48,7 @@ MDSRank::MDSRank(
     LogChannelRef &clog_,
     SafeTimer &timer_,
     Beacon &beacon_,
+    InodeStatCache &stat_cache_,
     MDSMap *& mdsmap_,
     Messenger *msgr,
     MonClient *monc_,
@@ -60,7 +61,7 @@ MDSRank::MDSRank(
     objecter(new Objecter(g_ceph_context, msgr, monc_, nullptr, 0, 0)),
     server(NULL), mdcache(NULL), locker(NULL), mdlog(NULL),
     balancer(NULL), scrubstack(NULL),
-    damage_table(whoami_),
+    damage_table(whoami_), stat_cache(stat_cache_),
     inotable(NULL), snapserver(NULL), snapclient(NULL),
     sessionmap(this), logger(NULL), mlogger(NULL),
     op_tracker(g_ceph_context, g_conf->mds_enable_op_tracker,
@@ -283,6 +284,7 @@ void MDSRankDispatcher::tick()
     server->reconnect_tick();
 
   if (is_active()) {
+    server->account_fast_getattrs();
     balancer->tick();
     mdcache->find_stale_fragment_freeze();
     mdcache->migrator->find_stale_export_freeze();
@@ -333,6 +335,7 @@ void MDSRankDispatcher::shutdown()
   // out if it is.
   assert(stopping == false);
   stopping = true;
+  stat_cache.set_active(false);
 
   dout(1) << __func__ << ": shutting down rank " << whoami << dendl;
 
@@ -1564,6 +1567,11 @@ void MDSRankDispatcher::handle_mds_map(
     incarnation = mdsmap->get_inc_gid(mds_gid);
   }
 
+  // cached getattr replies carry the map epoch, and are only answered
+  // while we are active
+  stat_cache.clear();
+  stat_cache.set_active(is_active() && g_conf->mds_fast_getattr);
+
   version_t epoch = m->get_epoch();
 
   // note source's map version
@@ -2777,12 +2785,13 @@ MDSRankDispatcher::MDSRankDispatcher(
     LogChannelRef &clog_,
     SafeTimer &timer_,
     Beacon &beacon_,
+    InodeStatCache &stat_cache_,
     MDSMap *& mdsmap_,
     Messenger *msgr,
     MonClient *monc_,
     Context *respawn_hook_,
     Context *suicide_hook_)
-  : MDSRank(whoami_, mds_lock_, clog_, timer_, beacon_, mdsmap_,
+  : MDSRank(whoami_, mds_lock_, clog_, timer_, beacon_, stat_cache_, mdsmap_,
       msgr, monc_, respawn_hook_, suicide_hook_)
 {}
 
@@ -23,6 +23,7 @@
 #include "messages/MCommand.h"
 
 #include "Beacon.h"
+#include "InodeStatCache.h"
 #include "DamageTable.h"
 #include "MDSMap.h"
 #include "SessionMap.h"
@@ -160,6 +161,9 @@ class MDSRank {
     ScrubStack   *scrubstack;
     DamageTable  damage_table;
 
+    // getattr replies MDSDaemon answers without mds_lock
+    InodeStatCache &stat_cache;
+
 
     InoTable     *inotable;
 
@@ -208,6 +212,8 @@ class MDSRank {
                             const std::set <std::string> &changed)
     {
       purge_queue.handle_conf_change(conf, changed, *mdsmap);
+      if (changed.count("mds_fast_getattr"))
+        stat_cache.set_active(is_active() && conf->mds_fast_getattr);
     }
 
   protected:
@@ -292,6 +298,7 @@ class MDSRank {
         LogChannelRef &clog_,
         SafeTimer &timer_,
         Beacon &beacon_,
+        InodeStatCache &stat_cache_,
         MDSMap *& mdsmap_,
         Messenger *msgr,
         MonClient *monc_,
@@ -560,6 +567,7 @@ public:
       LogChannelRef &clog_,
       SafeTimer &timer_,
       Beacon &beacon_,
+      InodeStatCache &stat_cache_,
       MDSMap *& mdsmap_,
       Messenger *msgr,
       MonClient *monc_,
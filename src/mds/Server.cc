@@ -132,6 +132,8 @@ void Server::create_logger()
       "Request type lookup snapshot");
   plb.add_u64_counter(l_mdss_req_getattr, "req_getattr",
       "Request type get attribute");
+  plb.add_u64_counter(l_mdss_req_getattr_fast, "req_getattr_fast",
+      "Get attribute requests answered without mds_lock");
   plb.add_u64_counter(l_mdss_req_setattr, "req_setattr",
       "Request type set attribute");
   plb.add_u64_counter(l_mdss_req_setlayout, "req_setlayout",
@@ -3048,9 +3050,75 @@ void Server::handle_client_getattr(MDRequestRef& mdr, bool is_lookup)
   mdr->tracei = ref;
   if (is_lookup)
     mdr->tracedn = mdr->dn[0].back();
+  else
+    publish_getattr(mdr, ref);
   respond_to_request(mdr, 0);
 }
 
+/*
+ * Let MDSDaemon answer this client's next getattrs on @in without
+ * mds_lock.  Only regular files the client already holds caps on, with
+ * every lock feeding the reply in LOCK_SYNC, qualify: nothing about such
+ * an inode can change without projecting it or moving a lock, and both
+ * invalidate the entry.  The stat is encoded as a peek, with no caps in
+ * the reply, so sending it again has no side effects.
+ */
+void Server::publish_getattr(MDRequestRef& mdr, CInode *in)
+{
+  MClientRequest *req = mdr->client_request;
+  Session *session = mdr->session;
+  if (!g_conf->mds_fast_getattr ||
+      !mds->stat_cache.is_active() ||
+      !InodeStatCache::is_fast_getattr(req) ||
+      mdr->snapid != CEPH_NOSNAP ||
+      !session || !session->is_open() ||
+      !session->auth_caps.allow_all())
+    return;
+
+  if (!in->is_file() || !in->is_auth() || in->is_projected() ||
+      in->is_frozen() || in->is_freezing() ||
+      in->state_test(CInode::STATE_EXPORTINGCAPS) ||
+      in->inode.inline_data.version != CEPH_INLINE_NONE ||
+      in->get_loner() >= 0)
+    return;
+
+  if (in->authlock.get_state() != LOCK_SYNC ||
+      in->linklock.get_state() != LOCK_SYNC ||
+      in->filelock.get_state() != LOCK_SYNC ||
+      in->xattrlock.get_state() != LOCK_SYNC)
+    return;
+
+  Capability *cap = in->get_client_cap(session->get_client());
+  if (!cap || cap->is_new() || cap->is_stale())
+    return;
+
+  InodeStatCache::Reply reply;
+  reply.snapbl = in->find_snaprealm()->get_snap_trace();
+  in->encode_inodestat(reply.trace, session, NULL, CEPH_NOSNAP, 0, 0, true);
+  reply.mdsmap_epoch = mds->mdsmap->get_epoch();
+  dout(20) << __func__ << " " << *in << dendl;
+  mds->stat_cache.publish(in->ino(), session->get_client(), reply);
+}
+
+/*
+ * Fold the getattrs MDSDaemon answered from the stat cache back into
+ * the request counters and the balancer's popularity.
+ */
+void Server::account_fast_getattrs()
+{
+  map<inodeno_t, uint64_t> hits;
+  mds->stat_cache.take_hits(&hits);
+  utime_t now = ceph_clock_now();
+  for (map<inodeno_t, uint64_t>::iterator p = hits.begin();
+       p != hits.end();
+       ++p) {
+    logger->inc(l_mdss_req_getattr_fast, p->second);
+    CInode *in = mdcache->get_inode(p->first);
+    if (in)
+      mds->balancer->hit_inode(now, in, META_POP_IRD, -1, p->second);
+  }
+}
+
 struct C_MDS_LookupIno2 : public ServerContext {
   MDRequestRef mdr;
   C_MDS_LookupIno2(Server *s, MDRequestRef& r) : ServerContext(s), mdr(r) {}
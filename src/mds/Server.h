@@ -64,6 +64,7 @@ enum {
   l_mdss_req_rmsnap,
   l_mdss_req_renamesnap,
   l_mdss_dispatch_slave_request,
+  l_mdss_req_getattr_fast,
   l_mdss_last,
 };
 
@@ -190,6 +191,8 @@ public:
 
   // requests on existing inodes.
   void handle_client_getattr(MDRequestRef& mdr, bool is_lookup);
+  void publish_getattr(MDRequestRef& mdr, CInode *in);
+  void account_fast_getattrs();
   void handle_client_lookup_ino(MDRequestRef& mdr,
 				bool want_parent, bool want_dentry);
   void _lookup_ino_2(MDRequestRef& mdr, int r);
@@ -469,6 +469,8 @@ void SessionMap::decode_legacy(bufferlist::iterator &p)
 
 uint64_t SessionMap::set_state(Session *session, int s) {
   if (session->state != s) {
+    if (session->info.inst.name.is_client())
+      mds->stat_cache.invalidate_client(session->get_client());
     session->set_state(s);
     auto by_state_entry = by_state.find(s);
     if (by_state_entry == by_state.end())
@@ -600,6 +602,8 @@ void SessionMap::remove_session(Session *s)
   dout(10) << __func__ << " s=" << s << " name=" << s->info.inst.name << dendl;
 
   s->trim_completed_requests(0);
+  if (s->info.inst.name.is_client())
+    mds->stat_cache.invalidate_client(s->get_client());
   s->item_session_list.remove_myself();
   session_map.erase(s->info.inst.name);
   dirty_sessions.erase(s->info.inst.name);
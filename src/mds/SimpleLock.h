@@ -318,6 +318,7 @@ public:
   int get_state() const { return state; }
   int set_state(int s) { 
     state = s; 
+    parent->lock_state_changed(this);
     //assert(!is_stable() || gather_set.size() == 0);  // gather should be empty in stable states.
     return s;
   }
@@ -328,6 +329,7 @@ public:
     } else {
       state = s;
     }
+    get_parent()->lock_state_changed(this);
     if (is_stable())
       take_waiting(SimpleLock::WAIT_ALL, waiters);
   }
@@ -23,7 +23,8 @@
 #define dout_prefix *_dout << "mgr " << __func__ << " "
 
 ClusterState::ClusterState(MonClient *monc_, Objecter *objecter_)
-  : monc(monc_), objecter(objecter_), lock("ClusterState"), pgservice(pg_map)
+  : monc(monc_), objecter(objecter_), lock("ClusterState"), pgservice(pg_map),
+    pg_digest(std::make_shared<PGMapDigest>())
 {}
 
 void ClusterState::set_objecter(Objecter *objecter_)
@@ -79,10 +80,12 @@ void ClusterState::ingest_pgstats(MPGStats *stats)
     }
     // In case we already heard about more recent stats from this PG
     // from another OSD
-    if (pg_map.pg_stat[pgid].get_version_pair() > pg_stats.get_version_pair()) {
+    auto q = pg_map.pg_stat.find(pgid);
+    if (q != pg_map.pg_stat.end() &&
+	q->second.get_version_pair() > pg_stats.get_version_pair()) {
       dout(15) << " had " << pgid << " from "
-	       << pg_map.pg_stat[pgid].reported_epoch << ":"
-               << pg_map.pg_stat[pgid].reported_seq << dendl;
+	       << q->second.reported_epoch << ":"
+               << q->second.reported_seq << dendl;
       continue;
     }
 
@@ -109,6 +112,10 @@ void ClusterState::update_delta_stats()
 
   pg_map.apply_incremental(g_ceph_context, pending_inc);
   pending_inc = PGMap::Incremental();
+
+  objecter->with_osdmap([this](const OSDMap &osd_map) {
+      publish_pg_digest(osd_map);
+    });
 }
 
 void ClusterState::notify_osdmap(const OSDMap &osd_map)
@@ -147,7 +154,18 @@ void ClusterState::notify_osdmap(const OSDMap &osd_map)
 
   pg_map.apply_incremental(g_ceph_context, pending_inc);
   pending_inc = PGMap::Incremental();
+  publish_pg_digest(osd_map);
   // TODO: Complete the separation of PG state handling so
   // that a cut-down set of functionality remains in PGMonitor
   // while the full-blown PGMap lives only here.
 }
+
+void ClusterState::publish_pg_digest(const OSDMap &osd_map)
+{
+  assert(lock.is_locked_by_me());
+
+  pg_map.get_rules_avail(osd_map, &pg_map.avail_space_by_rule);
+  std::shared_ptr<const PGMapDigest> digest =
+    std::make_shared<PGMapDigest>(pg_map);
+  std::atomic_store(&pg_digest, digest);
+}
@@ -44,6 +44,12 @@ protected:
 
   PGMapStatService pgservice;
 
+  /// pg_map's digest as of the last applied incremental; swapped
+  /// atomically so readers need not take the lock
+  std::shared_ptr<const PGMapDigest> pg_digest;
+
+  void publish_pg_digest(const OSDMap &osd_map);
+
   bufferlist health_json;
   bufferlist mon_status_json;
 
@@ -54,6 +60,10 @@ public:
 
   void update_delta_stats();
 
+  std::shared_ptr<const PGMapDigest> get_pg_digest() const {
+    return std::atomic_load(&pg_digest);
+  }
+
   const bufferlist &get_health() const {return health_json;}
   const bufferlist &get_mon_status() const {return mon_status_json;}
 
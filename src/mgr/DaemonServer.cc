@@ -850,15 +850,17 @@ void DaemonServer::send_report()
 
       // FIXME: reporting health detail here might be a bad idea?
       cluster_state.with_osdmap([&](const OSDMap& osdmap) {
-	  // FIXME: no easy way to get mon features here.  this will do for
-	  // now, though, as long as we don't make a backward-incompat change.
-	  pg_map.encode_digest(osdmap, m->get_data(), CEPH_FEATURES_ALL);
 	  dout(10) << pg_map << dendl;
 	  pg_map.get_health(g_ceph_context, osdmap,
 			    m->health_summary,
 			    &m->health_detail);
 	});
     });
+  // the digest was published by update_delta_stats(); encode it without
+  // holding up pg stat ingestion.
+  // FIXME: no easy way to get mon features here.  this will do for
+  // now, though, as long as we don't make a backward-incompat change.
+  cluster_state.get_pg_digest()->encode(m->get_data(), CEPH_FEATURES_ALL);
   // TODO? We currently do not notify the PyModules
   // TODO: respect needs_send, so we send the report only if we are asked to do
   //       so, or the state is updated.
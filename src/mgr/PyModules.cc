@@ -233,12 +233,10 @@ PyObject *PyModules::get_python(const std::string &what)
   } else if (what == "df") {
     PyFormatter f;
 
-    cluster_state.with_osdmap([this, &f](const OSDMap &osd_map){
-      cluster_state.with_pgmap(
-          [&osd_map, &f](const PGMap &pg_map) {
-        pg_map.dump_fs_stats(nullptr, &f, true);
-        pg_map.dump_pool_stats_full(osd_map, nullptr, &f, true);
-      });
+    auto digest = cluster_state.get_pg_digest();
+    cluster_state.with_osdmap([&digest, &f](const OSDMap &osd_map){
+      digest->dump_fs_stats(nullptr, &f, true);
+      digest->dump_pool_stats_full(osd_map, nullptr, &f, true);
     });
     return f.get();
   } else if (what == "osd_stats") {
@@ -11,6 +11,7 @@
 
 #include "osd/osd_types.h"
 #include "osd/OSDMap.h"
+#include "common/WorkQueue.h"
 
 #define dout_context g_ceph_context
 
@@ -1044,6 +1045,9 @@ void PGMap::Incremental::generate_test_instances(list<PGMap::Incremental*>& o)
 
 // --
 
+// smallest share of an incremental's pg updates worth a thread of its own
+static const size_t PG_STAT_UPDATES_PER_SHARD = 4096;
+
 void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
 {
   assert(inc.version == version+1);
@@ -1069,23 +1073,55 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
   if (ratios_changed)
     redo_full_sets();
 
+  // large batches have their pool sums computed up front by several
+  // threads; the loop below then only maintains the counts and indexes.
+  unsigned num_shards = 1;
+  if (cct && cct->_conf->mon_pg_stat_aggregate_threads > 1) {
+    num_shards = MIN((size_t)cct->_conf->mon_pg_stat_aggregate_threads,
+		     inc.pg_stat_updates.size() / PG_STAT_UPDATES_PER_SHARD);
+  }
+  bool sharded = num_shards > 1;
+  if (sharded) {
+    map<int64_t,pool_stat_t> pool_delta;
+    sum_pg_stat_updates(cct, inc, num_shards, &pool_delta);
+    for (auto& p : pool_delta) {
+      if (pg_pool_sum_old.count(p.first) == 0)
+	pg_pool_sum_old[p.first] = pg_pool_sum[p.first];
+      pg_pool_sum[p.first].add(p.second);
+      pg_sum.add(p.second);
+    }
+  }
+
   for (auto p = inc.pg_stat_updates.begin();
        p != inc.pg_stat_updates.end();
        ++p) {
     const pg_t &update_pg(p->first);
     const pg_stat_t &update_stat(p->second);
 
-    if (pg_pool_sum_old.count(update_pg.pool()) == 0)
+    if (!sharded && pg_pool_sum_old.count(update_pg.pool()) == 0)
       pg_pool_sum_old[update_pg.pool()] = pg_pool_sum[update_pg.pool()];
 
+    bool sameosds = false;
     auto t = pg_stat.find(update_pg);
     if (t == pg_stat.end()) {
       pg_stat.insert(make_pair(update_pg, update_stat));
     } else {
-      stat_pg_sub(update_pg, t->second);
+      // most reports leave the mapping alone; keep the osd indexes as is
+      sameosds =
+	t->second.acting == update_stat.acting &&
+	t->second.up == update_stat.up &&
+	t->second.up_primary == update_stat.up_primary &&
+	t->second.blocked_by == update_stat.blocked_by;
+      if (sharded)
+	stat_pg_sub_counts(update_pg, t->second, sameosds);
+      else
+	stat_pg_sub(update_pg, t->second, sameosds);
       t->second = update_stat;
     }
-    stat_pg_add(update_pg, update_stat);
+    if (sharded)
+      stat_pg_add_counts(update_pg, update_stat, sameosds);
+    else
+      stat_pg_add(update_pg, update_stat, sameosds);
   }
   assert(osd_stat.size() == osd_epochs.size());
   for (auto p = inc.get_osd_stat_updates().begin();
@@ -1318,7 +1354,21 @@ void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
 {
   pg_pool_sum[pgid.pool()].add(s);
   pg_sum.add(s);
+  stat_pg_add_counts(pgid, s, sameosds);
+}
 
+void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
+                        bool sameosds)
+{
+  pg_pool_sum[pgid.pool()].sub(s);
+  pg_sum.sub(s);
+  if (stat_pg_sub_counts(pgid, s, sameosds))
+    pg_pool_sum.erase(pgid.pool());
+}
+
+void PGMap::stat_pg_add_counts(const pg_t &pgid, const pg_stat_t &s,
+			       bool sameosds)
+{
   num_pg++;
   num_pg_by_state[s.state]++;
   num_pg_by_pool[pgid.pool()]++;
@@ -1361,23 +1411,19 @@ void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
   }
 }
 
-void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
-                        bool sameosds)
+/// @return true if that was the last pg of its pool
+bool PGMap::stat_pg_sub_counts(const pg_t &pgid, const pg_stat_t &s,
+			       bool sameosds)
 {
-  pool_stat_t& ps = pg_pool_sum[pgid.pool()];
-  ps.sub(s);
-  pg_sum.sub(s);
-
   num_pg--;
   int end = --num_pg_by_state[s.state];
   assert(end >= 0);
   if (end == 0)
     num_pg_by_state.erase(s.state);
   end = --num_pg_by_pool[pgid.pool()];
-  if (end == 0) {
+  bool pool_empty = end == 0;
+  if (pool_empty)
     num_pg_by_pool.erase(pgid.pool());
-    pg_pool_sum.erase(pgid.pool());
-  }
 
   if ((s.state & PG_STATE_CREATING) &&
       s.parent_split_bits == 0) {
@@ -1400,7 +1446,7 @@ void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
   }
 
   if (sameosds)
-    return;
+    return pool_empty;
 
   for (auto p = s.blocked_by.begin();
        p != s.blocked_by.end();
@@ -1436,6 +1482,7 @@ void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
     if (it != num_pg_by_osd.end() && it->second.primary > 0)
       it->second.primary--;
   }
+  return pool_empty;
 }
 
 void PGMap::stat_pg_update(const pg_t pgid, pg_stat_t& s,
@@ -1461,6 +1508,112 @@ void PGMap::stat_pg_update(const pg_t pgid, pg_stat_t& s,
   stat_pg_add(pgid, n, sameosds);
 }
 
+namespace {
+
+/// the threads summing large incrementals, started once per context
+class PGStatSumThreadPool : public ThreadPool {
+public:
+  explicit PGStatSumThreadPool(CephContext *cct)
+    : ThreadPool(cct, "PGMap::sum_tp", "tp_pgmap_sum",
+		 cct->_conf->mon_pg_stat_aggregate_threads,
+		 "mon_pg_stat_aggregate_threads") {
+    start();
+  }
+  ~PGStatSumThreadPool() override {
+    stop();
+  }
+};
+
+} // anonymous namespace
+
+/**
+ * Sum the pool stat changes carried by a batch of pg stat updates
+ *
+ * Nothing is modified here, so the batch is split into contiguous ranges
+ * that are summed on the context's PGMap::sum_tp against the current
+ * pg_stat; the per-shard deltas are merged into @p pool_delta at the end.
+ */
+void PGMap::sum_pg_stat_updates(CephContext *cct, const Incremental& inc,
+				unsigned num_shards,
+				map<int64_t,pool_stat_t> *pool_delta) const
+{
+  typedef mempool::pgmap::map<pg_t,pg_stat_t>::const_iterator update_iter;
+
+  struct Shard {
+    size_t begin, end;
+    map<int64_t,pool_stat_t> delta;
+  };
+
+  struct SumWQ : public ThreadPool::WorkQueue<Shard> {
+    const PGMap& pg_map;
+    const vector<update_iter>& updates;
+    std::deque<Shard*> q;
+
+    SumWQ(const PGMap& pg_map, const vector<update_iter>& updates,
+	  ThreadPool *tp)
+      : ThreadPool::WorkQueue<Shard>("PGMap::SumWQ", 0, 0, tp),
+	pg_map(pg_map), updates(updates) {}
+
+    bool _enqueue(Shard *shard) override {
+      q.push_back(shard);
+      return true;
+    }
+    void _dequeue(Shard *shard) override {
+      ceph_abort();
+    }
+    Shard *_dequeue() override {
+      if (q.empty())
+	return nullptr;
+      Shard *shard = q.front();
+      q.pop_front();
+      return shard;
+    }
+    void _process(Shard *shard, ThreadPool::TPHandle &handle) override {
+      for (size_t i = shard->begin; i < shard->end; ++i) {
+	auto& d = shard->delta[updates[i]->first.pool()];
+	d.add(updates[i]->second);
+	auto t = pg_map.pg_stat.find(updates[i]->first);
+	if (t != pg_map.pg_stat.end())
+	  d.sub(t->second);
+      }
+    }
+    bool _empty() override {
+      return q.empty();
+    }
+    void _clear() override {
+      assert(q.empty());
+    }
+  };
+
+  vector<update_iter> updates;
+  updates.reserve(inc.pg_stat_updates.size());
+  for (auto p = inc.pg_stat_updates.begin();
+       p != inc.pg_stat_updates.end();
+       ++p) {
+    updates.push_back(p);
+  }
+
+  PGStatSumThreadPool *tp;
+  cct->lookup_or_create_singleton_object<PGStatSumThreadPool>(
+    tp, "mon::PGMap::sum_tp");
+
+  vector<Shard> shards(num_shards);
+  {
+    SumWQ wq(*this, updates, tp);
+    for (unsigned i = 0; i < num_shards; ++i) {
+      shards[i].begin = updates.size() * i / num_shards;
+      shards[i].end = updates.size() * (i + 1) / num_shards;
+      wq.queue(&shards[i]);
+    }
+    wq.drain();
+  }
+
+  for (auto& shard : shards) {
+    for (auto& p : shard.delta)
+      (*pool_delta)[p.first].add(p.second);
+  }
+}
+
 void PGMap::stat_osd_add(int osd, const osd_stat_t &s)
 {
   num_osd++;
@@ -344,6 +344,14 @@ public:
 
   epoch_t calc_min_last_epoch_clean() const;
 
+  void stat_pg_add_counts(const pg_t &pgid, const pg_stat_t &s,
+			  bool sameosds);
+  bool stat_pg_sub_counts(const pg_t &pgid, const pg_stat_t &s,
+			  bool sameosds);
+  void sum_pg_stat_updates(CephContext *cct, const Incremental& inc,
+			   unsigned num_shards,
+			   map<int64_t,pool_stat_t> *pool_delta) const;
+
  public:
 
   mempool::pgmap::set<pg_t> creating_pgs;
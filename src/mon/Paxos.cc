@@ -95,6 +95,7 @@ void Paxos::init_logger()
   pcb.add_u64_avg(l_paxos_begin_keys, "begin_keys", "Keys in transaction on begin");
   pcb.add_u64_avg(l_paxos_begin_bytes, "begin_bytes", "Data in transaction on begin");
   pcb.add_time_avg(l_paxos_begin_latency, "begin_latency", "Latency of begin operation");
+  pcb.add_u64_avg(l_paxos_begin_proposals, "begin_proposals", "Proposals coalesced into each begin");
   pcb.add_u64_counter(l_paxos_commit, "commit",
       "Commits", "cmt");
   pcb.add_u64_avg(l_paxos_commit_keys, "commit_keys", "Keys in transaction on commit");
@@ -655,6 +656,14 @@ void Paxos::begin(bufferlist& v)
   logger->inc(l_paxos_begin);
   logger->inc(l_paxos_begin_keys, t->get_keys());
   logger->inc(l_paxos_begin_bytes, t->get_bytes());
+
+  // the peons may write the value while we do: their accepts cannot be
+  // handled before we return, by which time our own copy is stable.
+  bool overlap = g_conf->paxos_overlap_writes &&
+    mon->get_quorum().size() > 1;
+  if (overlap)
+    send_begin();
+
   utime_t start = ceph_clock_now();
 
   get_store()->apply_transaction(t);
@@ -671,6 +680,22 @@ void Paxos::begin(bufferlist& v)
   }
 
   // ask others to accept it too!
+  if (!overlap)
+    send_begin();
+
+  // set timeout event
+  accept_timeout_event = new C_MonContext(mon, [this](int r) {
+      if (r == -ECANCELED)
+	return;
+      accept_timeout();
+    });
+  mon->timer.add_event_after(g_conf->mon_accept_timeout_factor *
+			     g_conf->mon_lease,
+			     accept_timeout_event);
+}
+
+void Paxos::send_begin()
+{
   for (set<int>::const_iterator p = mon->get_quorum().begin();
        p != mon->get_quorum().end();
        ++p) {
@@ -685,16 +710,6 @@ void Paxos::begin(bufferlist& v)
     
     mon->messenger->send_message(begin, mon->monmap->get_inst(*p));
   }
-
-  // set timeout event
-  accept_timeout_event = new C_MonContext(mon, [this](int r) {
-      if (r == -ECANCELED)
-	return;
-      accept_timeout();
-    });
-  mon->timer.add_event_after(g_conf->mon_accept_timeout_factor *
-			     g_conf->mon_lease,
-			     accept_timeout_event);
 }
 
 // peon
@@ -849,6 +864,12 @@ void Paxos::commit_start()
 
   get_store()->queue_transaction(t, new C_Committed(this));
 
+  // the whole quorum has accepted the value, so it is chosen; with
+  // overlapped writes the peons commit it alongside our own write.
+  commit_sent = g_conf->paxos_overlap_writes;
+  if (commit_sent)
+    send_commit(last_committed + 1);
+
   if (is_updating_previous())
     state = STATE_WRITING_PREVIOUS;
   else if (is_updating())
@@ -885,20 +906,9 @@ void Paxos::commit_finish()
   _sanity_check_store();
 
   // tell everyone
-  for (set<int>::const_iterator p = mon->get_quorum().begin();
-       p != mon->get_quorum().end();
-       ++p) {
-    if (*p == mon->rank) continue;
-
-    dout(10) << " sending commit to mon." << *p << dendl;
-    MMonPaxos *commit = new MMonPaxos(mon->get_epoch(), MMonPaxos::OP_COMMIT,
-				      ceph_clock_now());
-    commit->values[last_committed] = new_value;
-    commit->pn = accepted_pn;
-    commit->last_committed = last_committed;
-
-    mon->messenger->send_message(commit, mon->monmap->get_inst(*p));
-  }
+  if (!commit_sent)
+    send_commit(last_committed);
+  commit_sent = false;
 
   assert(g_conf->paxos_kill_at != 9);
 
@@ -925,6 +935,23 @@ void Paxos::commit_finish()
   }
 }
 
+void Paxos::send_commit(version_t v)
+{
+  for (set<int>::const_iterator p = mon->get_quorum().begin();
+       p != mon->get_quorum().end();
+       ++p) {
+    if (*p == mon->rank) continue;
+
+    dout(10) << " sending commit to mon." << *p << dendl;
+    MMonPaxos *commit = new MMonPaxos(mon->get_epoch(), MMonPaxos::OP_COMMIT,
+				      ceph_clock_now());
+    commit->values[v] = new_value;
+    commit->pn = accepted_pn;
+    commit->last_committed = v;
+
+    mon->messenger->send_message(commit, mon->monmap->get_inst(*p));
+  }
+}
 
 void Paxos::handle_commit(MonOpRequestRef op)
 {
@@ -1057,12 +1084,16 @@ void Paxos::finish_round()
   // ok, now go active!
   state = STATE_ACTIVE;
 
+  // whatever the waiters propose goes out together below, rather than
+  // the first of them starting a round the others then queue behind.
+  plug();
   dout(20) << __func__ << " waiting_for_acting" << dendl;
   finish_contexts(g_ceph_context, waiting_for_active);
   dout(20) << __func__ << " waiting_for_readable" << dendl;
   finish_contexts(g_ceph_context, waiting_for_readable);
   dout(20) << __func__ << " waiting_for_writeable" << dendl;
   finish_contexts(g_ceph_context, waiting_for_writeable);
+  unplug();
   
   dout(10) << __func__ << " done w/ waiters, state " << get_statename(state) << dendl;
 
@@ -1521,6 +1552,7 @@ void Paxos::propose_pending()
 
   pending_proposal.reset();
 
+  logger->inc(l_paxos_begin_proposals, pending_finishers.size());
   committing_finishers.swap(pending_finishers);
   state = STATE_UPDATING;
   begin(bl);
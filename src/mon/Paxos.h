@@ -134,6 +134,7 @@ enum {
   l_paxos_begin_keys,
   l_paxos_begin_bytes,
   l_paxos_begin_latency,
+  l_paxos_begin_proposals,
   l_paxos_commit,
   l_paxos_commit_keys,
   l_paxos_commit_bytes,
@@ -615,9 +616,16 @@ private:
   bool trimming;
 
   /**
-   * true if we want trigger_propose to *not* propose (yet)
+   * non-zero if we want trigger_propose to *not* propose (yet); plugs
+   * nest, so a service may plug while finish_round() holds its own.
    */
-  bool plugged = false;
+  unsigned plugged = 0;
+
+  /**
+   * true if the peons were told to commit the value being written before
+   * our own commit became durable (see paxos_overlap_writes)
+   */
+  bool commit_sent = false;
 
   /**
    * @defgroup Paxos_h_callbacks Callback classes.
@@ -796,6 +804,8 @@ private:
    * @param value The value being proposed to the quorum
    */
   void begin(bufferlist& value);
+  /// send the value being proposed to the rest of the quorum
+  void send_begin();
   /**
    * Accept or decline (by ignoring) a proposal from the Leader.
    *
@@ -880,6 +890,7 @@ private:
    */
   void commit_start();
   void commit_finish();   ///< finish a commit after txn becomes durable
+  void send_commit(version_t v);  ///< tell the quorum @p v is committed
   /**
    * Commit the new value to stable storage as being the latest available
    * version.
@@ -1201,15 +1212,14 @@ public:
   }
 
   bool is_plugged() const {
-    return plugged;
+    return plugged > 0;
   }
   void plug() {
-    assert(plugged == false);
-    plugged = true;
+    ++plugged;
   }
   void unplug() {
-    assert(plugged == true);
-    plugged = false;
+    assert(plugged > 0);
+    --plugged;
   }
 
   // read
@@ -206,6 +206,7 @@ void PaxosService::propose_pending()
    *	   Paxos.
    */
   MonitorDBStore::TransactionRef t = paxos->get_pending_transaction();
+  uint64_t bytes = t->get_bytes();
 
   if (should_stash_full())
     encode_full(t);
@@ -216,6 +217,9 @@ void PaxosService::propose_pending()
   if (format_version > 0) {
     t->put(get_service_name(), "format_version", format_version);
   }
+  bytes = t->get_bytes() - bytes;
+  logger->inc(l_paxos_service_propose);
+  logger->inc(l_paxos_service_propose_bytes, bytes);
 
   // apply to paxos
   proposing = true;
@@ -231,19 +235,26 @@ void PaxosService::propose_pending()
    */
   class C_Committed : public Context {
     PaxosService *ps;
+    utime_t start;
+    uint64_t bytes;
   public:
-    explicit C_Committed(PaxosService *p) : ps(p) { }
+    C_Committed(PaxosService *p, uint64_t bytes)
+      : ps(p), start(ceph_clock_now()), bytes(bytes) { }
     void finish(int r) override {
       ps->proposing = false;
-      if (r >= 0)
+      if (r >= 0) {
+	utime_t lat = ceph_clock_now() - start;
+	ps->logger->tinc(l_paxos_service_propose_latency, lat);
+	ps->logger->hinc(l_paxos_service_propose_latency_hist,
+			 lat.to_nsec() / 1000, bytes);
 	ps->_active();
-      else if (r == -ECANCELED || r == -EAGAIN)
+      } else if (r == -ECANCELED || r == -EAGAIN)
 	return;
       else
 	assert(0 == "bad return value for C_Committed");
     }
   };
-  paxos->queue_pending_finisher(new C_Committed(this));
+  paxos->queue_pending_finisher(new C_Committed(this, bytes));
   paxos->trigger_propose();
 }
 
@@ -354,6 +365,38 @@ void PaxosService::_active()
 }
 
 
+void PaxosService::init_logger()
+{
+  PerfHistogramCommon::axis_config_d lat_x_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    1000,
+    24,
+  };
+  PerfHistogramCommon::axis_config_d size_y_axis_config{
+    "Proposal size (bytes)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    64,
+    24,
+  };
+
+  PerfCountersBuilder pcb(g_ceph_context, "paxos_" + service_name,
+			  l_paxos_service_first, l_paxos_service_last);
+  pcb.add_u64_counter(l_paxos_service_propose, "propose", "Proposals");
+  pcb.add_u64_avg(l_paxos_service_propose_bytes, "propose_bytes",
+		  "Data added to the paxos transaction per proposal");
+  pcb.add_time_avg(l_paxos_service_propose_latency, "propose_latency",
+		   "Latency from proposal to commit");
+  pcb.add_u64_counter_histogram(l_paxos_service_propose_latency_hist,
+				"propose_latency_histogram",
+				lat_x_axis_config, size_y_axis_config,
+				"Histogram of proposal latency + size");
+  logger = pcb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(logger);
+}
+
 void PaxosService::shutdown()
 {
   cancel_events();
@@ -367,6 +410,12 @@ void PaxosService::shutdown()
   finish_contexts(g_ceph_context, waiting_for_finished_proposal, -EAGAIN);
 
   on_shutdown();
+
+  if (logger) {
+    g_ceph_context->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    logger = nullptr;
+  }
 }
 
 void PaxosService::maybe_trim()
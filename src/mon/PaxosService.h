@@ -23,6 +23,15 @@
 class Monitor;
 class Paxos;
 
+enum {
+  l_paxos_service_first = 45900,
+  l_paxos_service_propose,
+  l_paxos_service_propose_bytes,
+  l_paxos_service_propose_latency,
+  l_paxos_service_propose_latency_hist,
+  l_paxos_service_last,
+};
+
 /**
  * A Paxos Service is an abstraction that easily allows one to obtain an
  * association between a Monitor and a Paxos class, in order to implement any
@@ -71,6 +80,9 @@ protected:
    * runs out and fires.
    */
   Context *proposal_timer;
+
+  /// per-service proposal counters, "paxos_<service_name>"
+  PerfCounters *logger = nullptr;
   /**
    * If the implementation class has anything pending to be proposed to Paxos,
    * then have_pending should be true; otherwise, false.
@@ -140,6 +152,8 @@ public:
 
   virtual ~PaxosService() {}
 
+  void init_logger();
+
   /**
    * Get the service's name.
    *
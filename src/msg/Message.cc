@@ -209,7 +209,9 @@ void Message::encode(uint64_t features, int crcflags)
     if (header.compat_version == 0)
       header.compat_version = header.version;
   }
-  if (crcflags & MSG_CRC_HEADER)
+  if ((crcflags & MSG_CRC_HEADER) && (crcflags & MSG_CRC_DATA))
+    calc_front_and_data_crc();
+  else if (crcflags & MSG_CRC_HEADER)
     calc_front_crc();
 
   // update envelope
@@ -222,7 +224,8 @@ void Message::encode(uint64_t features, int crcflags)
   footer.flags = CEPH_MSG_FOOTER_COMPLETE;
 
   if (crcflags & MSG_CRC_DATA) {
-    calc_data_crc();
+    if (!(crcflags & MSG_CRC_HEADER))
+      calc_data_crc();
 
 #ifdef ENCODE_DUMP
     bufferlist bl;
@@ -280,9 +283,17 @@ Message *decode_message(CephContext *cct, int crcflags,
 			bufferlist& data, Connection* conn)
 {
   // verify crc
+  bool check_data_crc = (crcflags & MSG_CRC_DATA) &&
+    (footer.flags & CEPH_MSG_FOOTER_NOCRC) == 0;
+  __u32 data_crc = 0;
   if (crcflags & MSG_CRC_HEADER) {
-    __u32 front_crc = front.crc32c(0);
-    __u32 middle_crc = middle.crc32c(0);
+    // the data crc rides along with front and middle when we need it
+    const bufferlist *bls[] = { &front, &middle, &data };
+    uint32_t crcs[] = { 0, 0, 0 };
+    bufferlist::crc32c_multi(bls, crcs, check_data_crc ? 3 : 2);
+    __u32 front_crc = crcs[0];
+    __u32 middle_crc = crcs[1];
+    data_crc = crcs[2];
 
     if (front_crc != footer.front_crc) {
       if (cct) {
@@ -303,18 +314,17 @@ Message *decode_message(CephContext *cct, int crcflags,
       return 0;
     }
   }
-  if (crcflags & MSG_CRC_DATA) {
-    if ((footer.flags & CEPH_MSG_FOOTER_NOCRC) == 0) {
-      __u32 data_crc = data.crc32c(0);
-      if (data_crc != footer.data_crc) {
-	if (cct) {
-	  ldout(cct, 0) << "bad crc in data " << data_crc << " != exp " << footer.data_crc << dendl;
-	  ldout(cct, 20) << " ";
-	  data.hexdump(*_dout);
-	  *_dout << dendl;
-	}
-	return 0;
+  if (check_data_crc) {
+    if (!(crcflags & MSG_CRC_HEADER))
+      data_crc = data.crc32c(0);
+    if (data_crc != footer.data_crc) {
+      if (cct) {
+	ldout(cct, 0) << "bad crc in data " << data_crc << " != exp " << footer.data_crc << dendl;
+	ldout(cct, 20) << " ";
+	data.hexdump(*_dout);
+	*_dout << dendl;
       }
+      return 0;
     }
   }
 
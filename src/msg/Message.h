@@ -421,6 +421,14 @@ public:
   void calc_data_crc() {
     footer.data_crc = data.crc32c(0);
   }
+  void calc_front_and_data_crc() {
+    const bufferlist *bls[] = { &payload, &middle, &data };
+    uint32_t crcs[] = { 0, 0, 0 };
+    bufferlist::crc32c_multi(bls, crcs, 3);
+    footer.front_crc = crcs[0];
+    footer.middle_crc = crcs[1];
+    footer.data_crc = crcs[2];
+  }
 
   virtual int get_cost() const {
     return data.length();
@@ -188,6 +188,10 @@ ssize_t AsyncConnection::read_bulk(char *buf, unsigned len)
     ldout(async_msgr->cct, 1) << __func__ << " peer close file descriptor "
                               << cs.fd() << dendl;
     return -1;
+  } else {
+    // credit the messages decoded out of the previous read
+    logger->inc(l_msgr_recv_messages_per_read, recv_msgs);
+    recv_msgs = 0;
   }
   return nread;
 }
@@ -209,6 +213,19 @@ ssize_t AsyncConnection::_try_send(bool more)
     ldout(async_msgr->cct, 1) << __func__ << " send error: " << cpp_strerror(r) << dendl;
     return r;
   }
+  logger->inc(l_msgr_send_messages_per_write, outcoming_msgs);
+  outcoming_msgs = 0;
+
+  uint64_t zerocopy, copied;
+  cs.collect_send_stats(&zerocopy, &copied);
+  if (zerocopy) {
+    send_zerocopy_bytes += zerocopy;
+    logger->inc(l_msgr_send_zerocopy_bytes, zerocopy);
+  }
+  if (copied) {
+    send_copied_bytes += copied;
+    logger->inc(l_msgr_send_copied_bytes, copied);
+  }
 
   ldout(async_msgr->cct, 10) << __func__ << " sent bytes " << r
                              << " remaining bytes " << outcoming_bl.length() << dendl;
@@ -771,12 +788,22 @@ void AsyncConnection::process()
           }
           state = STATE_OPEN;
 
+          ++recv_msgs;
           logger->inc(l_msgr_recv_messages);
           logger->inc(l_msgr_recv_bytes, cur_msg_size + sizeof(ceph_msg_header) + sizeof(ceph_msg_footer));
 
           async_msgr->ms_fast_preprocess(message);
-          auto fast_dispatch_time = ceph::mono_clock::now();
-          logger->tinc(l_msgr_running_recv_time, fast_dispatch_time - recv_start_time);
+          if (async_msgr->ms_can_fast_dispatch(message) && !delay_state) {
+            // keep going while the read buffer holds more messages and
+            // hand them over together
+            fast_dispatch_batch.push_back(message);
+            if (fast_dispatch_batch.size() >=
+                async_msgr->cct->_conf->ms_async_rx_dispatch_batch)
+              _flush_fast_dispatch(&recv_start_time);
+            break;
+          }
+          // preserve arrival order relative to the batch
+          _flush_fast_dispatch(&recv_start_time);
           if (delay_state) {
             utime_t release = message->get_recv_stamp();
             double delay_period = 0;
@@ -787,13 +814,6 @@ void AsyncConnection::process()
                                         << message << " " << *message << dendl;
             }
             delay_state->queue(delay_period, release, message);
-          } else if (async_msgr->ms_can_fast_dispatch(message)) {
-            lock.unlock();
-            dispatch_queue->fast_dispatch(message);
-            recv_start_time = ceph::mono_clock::now();
-            logger->tinc(l_msgr_running_fast_dispatch_time,
-                         recv_start_time - fast_dispatch_time);
-            lock.lock();
           } else {
             dispatch_queue->enqueue(message, message->get_priority(), conn_id);
           }
@@ -804,6 +824,7 @@ void AsyncConnection::process()
       case STATE_OPEN_TAG_CLOSE:
         {
           ldout(async_msgr->cct, 20) << __func__ << " got CLOSE" << dendl;
+          _flush_fast_dispatch(&recv_start_time);
           _stop();
           return ;
         }
@@ -842,16 +863,43 @@ void AsyncConnection::process()
     }
   } while (prev_state != state);
 
-  if (need_dispatch_writer && is_connected())
+  _flush_fast_dispatch(&recv_start_time);
+
+  if (need_dispatch_writer && is_connected() && !write_pending.exchange(true))
     center->dispatch_event_external(write_handler);
 
   logger->tinc(l_msgr_running_recv_time, ceph::mono_clock::now() - recv_start_time);
   return;
 
  fail:
+  _flush_fast_dispatch(&recv_start_time);
   fault();
 }
 
+// called with lock held; drops it while the messages are dispatched
+void AsyncConnection::_flush_fast_dispatch(
+  ceph::mono_clock::time_point *recv_start_time)
+{
+  if (fast_dispatch_batch.empty())
+    return;
+  vector<Message*> batch;
+  batch.swap(fast_dispatch_batch);
+  logger->inc(l_msgr_recv_dispatch_batch, batch.size());
+  auto fast_dispatch_time = ceph::mono_clock::now();
+  logger->tinc(l_msgr_running_recv_time, fast_dispatch_time - *recv_start_time);
+  lock.unlock();
+  for (auto m : batch)
+    dispatch_queue->fast_dispatch(m);
+  *recv_start_time = ceph::mono_clock::now();
+  logger->tinc(l_msgr_running_fast_dispatch_time,
+               *recv_start_time - fast_dispatch_time);
+  lock.lock();
+  // keep the capacity for the next batch
+  batch.clear();
+  if (fast_dispatch_batch.empty())
+    fast_dispatch_batch.swap(batch);
+}
+
 ssize_t AsyncConnection::_process_connection()
 {
   ssize_t r = 0;
@@ -890,6 +938,8 @@ ssize_t AsyncConnection::_process_connection()
         SocketOptions opts;
         opts.priority = async_msgr->get_socket_priority();
         opts.connect_bind_addr = msgr->get_myaddr();
+        if (async_msgr->cct->_conf->ms_async_zerocopy_send)
+          opts.zerocopy_min_bytes = async_msgr->cct->_conf->ms_async_zerocopy_min_bytes;
         r = worker->connect(get_peer_addr(), opts, &cs);
         if (r < 0)
           goto fail;
@@ -1953,7 +2003,8 @@ int AsyncConnection::send_message(Message *m)
     m->trace.event("async enqueueing message");
     out_q[m->get_priority()].emplace_back(std::move(bl), m);
     ldout(async_msgr->cct, 15) << __func__ << " inline write is denied, reschedule m=" << m << dendl;
-    if (can_write != WriteStatus::REPLACING)
+    // replies queued while a write is already pending ride along with it
+    if (can_write != WriteStatus::REPLACING && !write_pending.exchange(true))
       center->dispatch_event_external(write_handler);
   }
   return 0;
@@ -2148,7 +2199,8 @@ void AsyncConnection::_stop()
   if (delay_state)
     delay_state->flush();
 
-  ldout(async_msgr->cct, 2) << __func__ << dendl;
+  ldout(async_msgr->cct, 2) << __func__ << " sent zerocopy " << send_zerocopy_bytes
+                            << " copied " << send_copied_bytes << dendl;
   std::lock_guard<std::mutex> l(write_lock);
 
   reset_recv_state();
@@ -2269,7 +2321,13 @@ ssize_t AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
   logger->inc(l_msgr_send_bytes, outcoming_bl.length() - original_bl_len);
   ldout(async_msgr->cct, 20) << __func__ << " sending " << m->get_seq()
                              << " " << m << dendl;
-  ssize_t rc = _try_send(more);
+  ++outcoming_msgs;
+  ssize_t rc = 0;
+  // if more messages are queued behind this one, let them share a
+  // sendmsg; the caller flushes once the queue is drained
+  if (!more ||
+      outcoming_bl.length() >= async_msgr->cct->_conf->ms_async_tx_coalesce_bytes)
+    rc = _try_send(more);
   if (rc < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " error sending " << m << ", "
                               << cpp_strerror(rc) << dendl;
@@ -2432,6 +2490,8 @@ void AsyncConnection::handle_write()
   ldout(async_msgr->cct, 10) << __func__ << dendl;
   ssize_t r = 0;
 
+  write_pending = false;
+
   write_lock.lock();
   if (can_write == WriteStatus::CANWRITE) {
     if (keepalive) {
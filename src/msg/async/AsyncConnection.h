@@ -75,6 +75,7 @@ class AsyncConnection : public Connection {
   void handle_ack(uint64_t seq);
   void _append_keepalive_or_ack(bool ack=false, utime_t *t=NULL);
   ssize_t write_message(Message *m, bufferlist& bl, bool more);
+  void _flush_fast_dispatch(ceph::mono_clock::time_point *recv_start_time);
   void inject_delay();
   ssize_t _reply_accept(char tag, ceph_msg_connect &connect, ceph_msg_connect_reply &reply,
                     bufferlist &authorizer_reply) {
@@ -306,7 +307,12 @@ class AsyncConnection : public Connection {
 
   // lockfree, only used in own thread
   bufferlist outcoming_bl;
+  unsigned outcoming_msgs = 0;  // messages appended since the last send
+  unsigned recv_msgs = 0;       // messages decoded since the last read
   bool open_write = false;
+  // bytes the socket sent zero-copy vs. copied over this connection's life
+  uint64_t send_zerocopy_bytes = 0;
+  uint64_t send_copied_bytes = 0;
 
   std::mutex write_lock;
   enum class WriteStatus {
@@ -316,11 +322,16 @@ class AsyncConnection : public Connection {
     CLOSED
   };
   std::atomic<WriteStatus> can_write;
+  // write_handler is queued on the center and has not started yet, so
+  // send_message need not queue it again
+  std::atomic<bool> write_pending{false};
   list<Message*> sent; // the first bufferlist need to inject seq
   map<int, list<pair<bufferlist, Message*> > > out_q;  // priority queue for outbound msgs
   bool keepalive;
 
   std::mutex lock;
+  // decoded messages waiting to be fast dispatched together (under lock)
+  vector<Message*> fast_dispatch_batch;
   utime_t backoff;         // backoff time
   EventCallbackRef read_handler;
   EventCallbackRef write_handler;
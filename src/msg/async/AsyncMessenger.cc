@@ -165,6 +165,8 @@ void Processor::accept()
   opts.nodelay = msgr->cct->_conf->ms_tcp_nodelay;
   opts.rcbuf_size = msgr->cct->_conf->ms_tcp_rcvbuf;
   opts.priority = msgr->get_socket_priority();
+  if (msgr->cct->_conf->ms_async_zerocopy_send)
+    opts.zerocopy_min_bytes = msgr->cct->_conf->ms_async_zerocopy_min_bytes;
   while (true) {
     entity_addr_t addr;
     ConnectedSocket cli_socket;
@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -36,6 +40,123 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#ifdef __linux__
+# ifndef SO_EE_ORIGIN_ZEROCOPY
+#  define SO_EE_ORIGIN_ZEROCOPY 5
+# endif
+# ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#  define SO_EE_CODE_ZEROCOPY_COPIED 1
+# endif
+#endif
+
+/*
+ * MSG_ZEROCOPY: the kernel sends straight out of our pages, so the
+ * buffers must stay alive until it tells us (on the socket error queue)
+ * that it is done with them.  Every sendmsg() call made with the flag
+ * gets the next 32-bit sequence number; completions arrive as ranges.
+ */
+struct zerocopy_pin_t {
+  uint32_t last_seq;  ///< released once the kernel completes this one
+  uint64_t bytes;     ///< bytes handed over with MSG_ZEROCOPY
+  bufferlist bl;      ///< holds the pages until then
+};
+
+// release the pins covered by the completions queued on fd.  returns
+// true if the kernel reported that it copied instead.
+static bool reap_zerocopy_completions(int fd, std::deque<zerocopy_pin_t> *pinned,
+                                      uint64_t *zerocopy_bytes,
+                                      uint64_t *copied_bytes)
+{
+  bool any_copied = false;
+#if defined(__linux__)
+  while (!pinned->empty()) {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t r = ::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      break;   // EAGAIN: nothing has completed yet
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+        continue;
+      struct sock_extended_err *serr =
+        reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      bool copied = serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+      uint32_t hi = serr->ee_data;
+      while (!pinned->empty() &&
+             (int32_t)(pinned->front().last_seq - hi) <= 0) {
+        if (copied)
+          *copied_bytes += pinned->front().bytes;
+        else
+          *zerocopy_bytes += pinned->front().bytes;
+        pinned->pop_front();
+      }
+      any_copied |= copied;
+    }
+  }
+#endif
+  return any_copied;
+}
+
+/*
+ * A socket closed while zero-copy sends were still in flight.  The
+ * kernel may still (re)transmit out of those pages, so the fd stays
+ * open and the buffers pinned until their completions arrive.  The
+ * connection is shut down first, so that happens once the peer acks
+ * the data or TCP gives up on it; the completions raise EPOLLERR,
+ * which the event loop reports as readable.
+ */
+class PosixZeroCopyOrphan : public EventCallback {
+  EventCenter *center;
+  int fd;
+  std::deque<zerocopy_pin_t> pinned;
+  bool registered = false;
+
+  void abort() {
+    // reset the connection: the kernel drops its queued segments, so
+    // nothing goes out of the pages after we let go of them
+    struct linger l;
+    l.l_onoff = 1;
+    l.l_linger = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+    ::close(fd);
+    delete this;
+  }
+
+ public:
+  PosixZeroCopyOrphan(EventCenter *c, int f, std::deque<zerocopy_pin_t> &&p)
+    : center(c), fd(f), pinned(std::move(p)) {}
+
+  void do_request(int fd_or_id) override {
+    if (!registered) {
+      // dispatched from close(); an event center that is going away
+      // runs its pending external events from its destructor
+      if (!center->in_thread() ||
+          center->create_file_event(fd, EVENT_READABLE, this) < 0) {
+        abort();
+        return;
+      }
+      registered = true;
+    }
+    uint64_t zerocopy_bytes = 0, copied_bytes = 0;
+    reap_zerocopy_completions(fd, &pinned, &zerocopy_bytes, &copied_bytes);
+    if (pinned.empty()) {
+      center->delete_file_event(fd, EVENT_READABLE);
+      ::close(fd);
+      delete this;
+    }
+  }
+};
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
@@ -47,9 +168,36 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   bool sigpipe_unblock;
 #endif
 
+  EventCenter *center;
+  uint64_t zerocopy_min_bytes = 0;  ///< 0: do not use MSG_ZEROCOPY
+  uint32_t zerocopy_next_seq = 0;
+  std::deque<zerocopy_pin_t> zerocopy_pinned;
+  uint64_t stat_zerocopy_bytes = 0;
+  uint64_t stat_copied_bytes = 0;
+
+  void enable_zerocopy(uint64_t min_bytes) {
+#if defined(__linux__)
+    int one = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+      zerocopy_min_bytes = min_bytes;
+#endif
+  }
+
+  void reap_zerocopy() {
+    // the kernel fell back to copying (loopback, no scatter-gather on
+    // the device, ...); the notifications are pure overhead then.
+    if (reap_zerocopy_completions(_fd, &zerocopy_pinned, &stat_zerocopy_bytes,
+                                  &stat_copied_bytes))
+      zerocopy_min_bytes = 0;
+  }
+
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected,
+                                    EventCenter *c, uint64_t zerocopy_min_bytes = 0)
+      : handler(h), _fd(f), sa(sa), connected(connected), center(c) {
+    if (zerocopy_min_bytes)
+      enable_zerocopy(zerocopy_min_bytes);
+  }
 
   int is_connected() override {
     if (connected)
@@ -71,6 +219,10 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    // completions also wake us up as EPOLLERR, which the event loop
+    // reports as readable
+    if (!zerocopy_pinned.empty())
+      reap_zerocopy();
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
@@ -141,7 +293,10 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occured
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // with MSG_ZEROCOPY in flags, *zc_calls and *zc_sent count the calls
+  // (and their bytes) that the kernel will report completions for
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+                            int flags, unsigned *zc_calls, size_t *zc_sent)
   {
     suppress_sigpipe();
 
@@ -149,9 +304,9 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     while (1) {
       ssize_t r;
   #if defined(MSG_NOSIGNAL)
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags | MSG_NOSIGNAL | (more ? MSG_MORE : 0));
   #else
-      r = ::sendmsg(fd, &msg, (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags | (more ? MSG_MORE : 0));
   #endif /* defined(MSG_NOSIGNAL) */
 
       if (r < 0) {
@@ -159,10 +314,18 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
           continue;
         } else if (errno == EAGAIN) {
           break;
+        } else if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+          // out of optmem for notifications; copy this time
+          flags &= ~MSG_ZEROCOPY;
+          continue;
         }
         return -errno;
       }
 
+      if (flags & MSG_ZEROCOPY) {
+        ++*zc_calls;
+        *zc_sent += r;
+      }
       sent += r;
       if (len == sent) break;
 
@@ -184,7 +347,11 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(bufferlist &bl, bool more) override {
+    if (!zerocopy_pinned.empty())
+      reap_zerocopy();
+
     size_t sent_bytes = 0;
+    size_t zc_sent = 0;
     std::list<bufferptr>::const_iterator pb = bl.buffers().begin();
     uint64_t left_pbrs = bl.buffers().size();
     while (left_pbrs) {
@@ -205,9 +372,24 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         size--;
       }
 
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
-      if (r < 0)
+      int flags = 0;
+      if (zerocopy_min_bytes && msglen >= zerocopy_min_bytes)
+        flags |= MSG_ZEROCOPY;
+      unsigned zc_calls = 0;
+      size_t batch_zc_sent = 0;
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+                             flags, &zc_calls, &batch_zc_sent);
+      zerocopy_next_seq += zc_calls;
+      zc_sent += batch_zc_sent;
+      if (r < 0) {
+        // whatever went out zero-copy before the error is still the
+        // kernel's until it completes; the caller drops bl on error
+        if (zc_sent)
+          zerocopy_pinned.push_back(
+            zerocopy_pin_t{zerocopy_next_seq - 1, zc_sent, bl});
         return r;
+      }
+      stat_copied_bytes += r - batch_zc_sent;
 
       // "r" is the remaining length
       sent_bytes += r;
@@ -222,16 +404,38 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+      if (zc_sent) {
+        zerocopy_pinned.push_back(
+          zerocopy_pin_t{zerocopy_next_seq - 1, zc_sent, bufferlist()});
+        zerocopy_pinned.back().bl.swap(swapped);
       }
     }
 
     return static_cast<ssize_t>(sent_bytes);
   }
+  void collect_send_stats(uint64_t *zerocopy, uint64_t *copied) override {
+    *zerocopy = stat_zerocopy_bytes;
+    *copied = stat_copied_bytes;
+    stat_zerocopy_bytes = 0;
+    stat_copied_bytes = 0;
+  }
   void shutdown() override {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+    if (!zerocopy_pinned.empty())
+      reap_zerocopy();
+    if (!zerocopy_pinned.empty()) {
+      // the kernel still owns some of our pages; keep them (and the fd
+      // their completions arrive on) until it is done with them
+      ::shutdown(_fd, SHUT_RDWR);
+      center->dispatch_event_external(
+        new PosixZeroCopyOrphan(center, _fd, std::move(zerocopy_pinned)));
+      zerocopy_pinned.clear();
+      return;
+    }
     ::close(_fd);
   }
   int fd() const override {
@@ -283,7 +487,9 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(
+    new PosixConnectedSocketImpl(handler, *out, sd, true, &w->center,
+                                 opt.zerocopy_min_bytes));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -351,7 +557,9 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(
+        new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, &center,
+                                     opts.zerocopy_min_bytes)));
   return 0;
 }
 
@@ -369,3 +577,23 @@ PosixNetworkStack::PosixNetworkStack(CephContext *c, const string &t)
       lderr(cct) << __func__ << " failed to parse " << corestr << " in " << cct->_conf->ms_async_affinity_cores << dendl;
   }
 }
+
+void PosixNetworkStack::spawn_worker(unsigned i, std::function<void ()> &&func)
+{
+  threads.resize(i+1);
+  threads[i] = std::thread(func);
+  int cpu = get_cpuid(i);
+  if (!cct->_conf->ms_async_set_affinity || cpu < 0)
+    return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  int r = pthread_setaffinity_np(threads[i].native_handle(),
+				 sizeof(cpuset), &cpuset);
+  if (r)
+    lderr(cct) << __func__ << " failed to bind worker " << i << " to cpu "
+	       << cpu << ": " << cpp_strerror(r) << dendl;
+  else
+    ldout(cct, 10) << __func__ << " bound worker " << i << " to cpu " << cpu
+		   << dendl;
+}
@@ -31,6 +31,12 @@ class ConnectedSocketImpl {
   virtual ssize_t read(char*, size_t) = 0;
   virtual ssize_t zero_copy_read(bufferptr&) = 0;
   virtual ssize_t send(bufferlist &bl, bool more) = 0;
+  /// bytes sent since the last call, split into those the kernel sent
+  /// straight out of our buffers and those it had to copy
+  virtual void collect_send_stats(uint64_t *zerocopy, uint64_t *copied) {
+    *zerocopy = 0;
+    *copied = 0;
+  }
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
@@ -42,6 +48,7 @@ struct SocketOptions {
   bool nodelay = true;
   int rcbuf_size = 0;
   int priority = -1;
+  uint64_t zerocopy_min_bytes = 0;  ///< 0 disables zero-copy send
   entity_addr_t connect_bind_addr;
 };
 
@@ -103,6 +110,10 @@ class ConnectedSocket {
   ssize_t send(bufferlist &bl, bool more) {
     return _csi->send(bl, more);
   }
+  /// Gets and resets the zero-copy vs. copied send byte counts.
+  void collect_send_stats(uint64_t *zerocopy, uint64_t *copied) {
+    _csi->collect_send_stats(zerocopy, copied);
+  }
   /// Disables output to the socket.
   ///
   /// Current or future writes that have not been successfully flushed
@@ -191,6 +202,8 @@ enum {
   l_msgr_send_messages,
   l_msgr_recv_bytes,
   l_msgr_send_bytes,
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_copied_bytes,
   l_msgr_created_connections,
   l_msgr_active_connections,
 
@@ -199,6 +212,10 @@ enum {
   l_msgr_running_recv_time,
   l_msgr_running_fast_dispatch_time,
 
+  l_msgr_recv_messages_per_read,
+  l_msgr_send_messages_per_write,
+  l_msgr_recv_dispatch_batch,
+
   l_msgr_last,
 };
 
@@ -231,6 +248,8 @@ class Worker {
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes");
     plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network received bytes");
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent without copying (MSG_ZEROCOPY)");
+    plb.add_u64_counter(l_msgr_send_copied_bytes, "msgr_send_copied_bytes", "Network bytes copied into socket buffers");
     plb.add_u64_counter(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
     plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
 
@@ -239,6 +258,10 @@ class Worker {
     plb.add_time(l_msgr_running_recv_time, "msgr_running_recv_time", "The total time of message receiving");
     plb.add_time(l_msgr_running_fast_dispatch_time, "msgr_running_fast_dispatch_time", "The total time of fast dispatch");
 
+    plb.add_u64_avg(l_msgr_recv_messages_per_read, "msgr_recv_messages_per_read", "Messages decoded per socket read");
+    plb.add_u64_avg(l_msgr_send_messages_per_write, "msgr_send_messages_per_write", "Messages carried per socket write");
+    plb.add_u64_avg(l_msgr_recv_dispatch_batch, "msgr_recv_dispatch_batch", "Messages fast dispatched per connection lock release");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
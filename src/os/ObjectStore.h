@@ -1530,6 +1530,7 @@ public:
   }
 
   virtual void get_db_statistics(Formatter *f) { }
+  virtual void dump_allocator_stats(Formatter *f) { }
   virtual void generate_db_histogram(Formatter *f) { }
   virtual void flush_cache() { }
   virtual void dump_perf_counters(Formatter *f) {}
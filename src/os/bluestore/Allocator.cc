@@ -4,6 +4,7 @@
 #include "Allocator.h"
 #include "StupidAllocator.h"
 #include "BitMapAllocator.h"
+#include "AvlAllocator.h"
 #include "common/debug.h"
 
 #define dout_subsys ceph_subsys_bluestore
@@ -15,8 +16,24 @@ Allocator *Allocator::create(CephContext* cct, string type,
     return new StupidAllocator(cct);
   } else if (type == "bitmap") {
     return new BitMapAllocator(cct, size, block_size);
+  } else if (type == "avl") {
+    return new AvlAllocator(cct);
   }
   lderr(cct) << "Allocator::" << __func__ << " unknown alloc type "
 	     << type << dendl;
   return nullptr;
 }
+
+double Allocator::get_fragmentation(uint64_t alloc_unit)
+{
+  assert(alloc_unit);
+  uint64_t num_extents = 0;
+  uint64_t free_blocks = 0;
+  foreach([&](uint64_t offset, uint64_t length) {
+      ++num_extents;
+      free_blocks += length / alloc_unit;
+    });
+  if (free_blocks <= 1 || num_extents <= 1)
+    return 0.0;
+  return std::min(1.0, (double)(num_extents - 1) / (free_blocks - 1));
+}
@@ -13,6 +13,7 @@
 #define CEPH_OS_BLUESTORE_ALLOCATOR_H
 
 #include <ostream>
+#include <functional>
 #include "include/assert.h"
 #include "os/bluestore/bluestore_types.h"
 
@@ -48,11 +49,20 @@ public:
 
   virtual void dump() = 0;
 
+  /// enumerate free extents (in no particular order).  the allocator
+  /// is locked for the duration, so notify must not call back into it.
+  virtual void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) = 0;
+
   virtual void init_add_free(uint64_t offset, uint64_t length) = 0;
   virtual void init_rm_free(uint64_t offset, uint64_t length) = 0;
 
   virtual uint64_t get_free() = 0;
 
+  /// fragmentation score in [0, 1]: 0 when all free space is a single
+  /// extent, 1 when every free alloc_unit is its own extent
+  virtual double get_fragmentation(uint64_t alloc_unit);
+
   virtual void shutdown() = 0;
   static Allocator *create(CephContext* cct, string type, int64_t size,
 			   int64_t block_size);
@@ -0,0 +1,355 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <limits>
+
+#include "AvlAllocator.h"
+#include "bluestore_types.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef dout_prefix
+#define dout_prefix *_dout << "avlalloc "
+
+namespace {
+  // frees a segment once it has been unlinked from both trees
+  struct dispose_rs {
+    template <typename T>
+    void operator()(T* p) {
+      delete p;
+    }
+  };
+}
+
+AvlAllocator::AvlAllocator(CephContext* cct)
+  : cct(cct),
+    num_free(0),
+    num_reserved(0),
+    last_alloc(0)
+{
+}
+
+AvlAllocator::~AvlAllocator()
+{
+  range_size_tree.clear();
+  range_tree.clear_and_dispose(dispose_rs{});
+}
+
+uint64_t AvlAllocator::_aligned_start(const range_seg_t& rs, uint64_t unit)
+{
+  return ROUND_UP_TO(rs.start, unit);
+}
+
+uint64_t AvlAllocator::_aligned_len(const range_seg_t& rs, uint64_t unit)
+{
+  uint64_t start = _aligned_start(rs, unit);
+  if (start >= rs.end)
+    return 0;
+  return rs.end - start;
+}
+
+AvlAllocator::range_tree_t::iterator AvlAllocator::_find_containing(
+  uint64_t offset)
+{
+  range_seg_t probe{offset, offset};
+  auto p = range_tree.upper_bound(probe);
+  if (p == range_tree.begin())
+    return range_tree.end();
+  --p;
+  if (p->end <= offset)
+    return range_tree.end();
+  return p;
+}
+
+void AvlAllocator::_add_to_tree(uint64_t start, uint64_t size)
+{
+  assert(size != 0);
+  uint64_t end = start + size;
+  dout(30) << __func__ << " 0x" << std::hex << start << "~" << size
+	   << std::dec << dendl;
+
+  range_seg_t probe{start, end};
+  auto rs_after = range_tree.upper_bound(probe);
+  auto rs_before = range_tree.end();
+  if (rs_after != range_tree.begin())
+    rs_before = std::prev(rs_after);
+
+  // the freed range must not overlap anything that is already free
+  assert(rs_before == range_tree.end() || rs_before->end <= start);
+  assert(rs_after == range_tree.end() || rs_after->start >= end);
+
+  bool merge_before = (rs_before != range_tree.end() &&
+		       rs_before->end == start);
+  bool merge_after = (rs_after != range_tree.end() &&
+		      rs_after->start == end);
+
+  if (merge_before && merge_after) {
+    range_size_tree.erase(range_size_tree.iterator_to(*rs_before));
+    range_size_tree.erase(range_size_tree.iterator_to(*rs_after));
+    rs_before->end = rs_after->end;
+    range_tree.erase_and_dispose(rs_after, dispose_rs{});
+    range_size_tree.insert(*rs_before);
+  } else if (merge_before) {
+    range_size_tree.erase(range_size_tree.iterator_to(*rs_before));
+    rs_before->end = end;
+    range_size_tree.insert(*rs_before);
+  } else if (merge_after) {
+    range_size_tree.erase(range_size_tree.iterator_to(*rs_after));
+    // nothing lies between us and rs_after, so offset order is unchanged
+    rs_after->start = start;
+    range_size_tree.insert(*rs_after);
+  } else {
+    range_seg_t *rs = new range_seg_t{start, end};
+    range_tree.insert(*rs);
+    range_size_tree.insert(*rs);
+  }
+}
+
+void AvlAllocator::_remove_from_tree(uint64_t start, uint64_t size)
+{
+  uint64_t end = start + size;
+  dout(30) << __func__ << " 0x" << std::hex << start << "~" << size
+	   << std::dec << dendl;
+
+  auto rs = _find_containing(start);
+  assert(rs != range_tree.end());
+  assert(rs->end >= end);
+
+  bool left_over = (rs->start != start);
+  bool right_over = (rs->end != end);
+
+  range_size_tree.erase(range_size_tree.iterator_to(*rs));
+
+  if (left_over && right_over) {
+    range_seg_t *tail = new range_seg_t{end, rs->end};
+    rs->end = start;
+    range_tree.insert(std::next(rs), *tail);
+    range_size_tree.insert(*tail);
+    range_size_tree.insert(*rs);
+  } else if (left_over) {
+    rs->end = start;
+    range_size_tree.insert(*rs);
+  } else if (right_over) {
+    rs->start = end;
+    range_size_tree.insert(*rs);
+  } else {
+    range_tree.erase_and_dispose(rs, dispose_rs{});
+  }
+}
+
+bool AvlAllocator::_try_hint(uint64_t hint, uint64_t want, uint64_t unit,
+			     uint64_t *offset)
+{
+  auto rs = _find_containing(hint);
+  if (rs == range_tree.end()) {
+    range_seg_t probe{hint, hint};
+    rs = range_tree.upper_bound(probe);
+    if (rs == range_tree.end())
+      return false;
+  }
+  uint64_t start = ROUND_UP_TO(MAX(hint, rs->start), unit);
+  if (start < rs->end && rs->end - start >= want) {
+    *offset = start;
+    return true;
+  }
+  return false;
+}
+
+bool AvlAllocator::_pick_best_fit(uint64_t want, uint64_t unit,
+				  uint64_t *offset)
+{
+  // any segment of at least want + unit - 1 bytes fits regardless of its
+  // alignment, so this scan only ever walks the few candidates that are
+  // long enough but may be misaligned.
+  range_seg_t probe{0, want};
+  for (auto rs = range_size_tree.lower_bound(probe);
+       rs != range_size_tree.end();
+       ++rs) {
+    if (_aligned_len(*rs, unit) >= want) {
+      *offset = _aligned_start(*rs, unit);
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t AvlAllocator::_allocate_int(
+  uint64_t want, uint64_t unit, int64_t hint,
+  uint64_t *offset, uint64_t *length)
+{
+  dout(10) << __func__ << " want 0x" << std::hex << want
+	   << " unit 0x" << unit
+	   << " hint 0x" << hint << std::dec
+	   << dendl;
+  want = MAX(unit, want);
+
+  if (hint && _try_hint(hint, want, unit, offset)) {
+    *length = want;
+  } else if (_pick_best_fit(want, unit, offset)) {
+    *length = want;
+  } else {
+    // nothing is big enough; hand out the largest aligned piece we have
+    // and let the caller come back for the rest.
+    bool found = false;
+    for (auto rs = range_size_tree.rbegin();
+	 rs != range_size_tree.rend() && rs->length() >= unit;
+	 ++rs) {
+      uint64_t len = _aligned_len(*rs, unit);
+      len -= len % unit;
+      if (len >= unit) {
+	*offset = _aligned_start(*rs, unit);
+	*length = len;
+	found = true;
+	break;
+      }
+    }
+    if (!found)
+      return -ENOSPC;
+  }
+
+  dout(30) << __func__ << " got 0x" << std::hex << *offset << "~" << *length
+	   << std::dec << dendl;
+  _remove_from_tree(*offset, *length);
+  num_free -= *length;
+  num_reserved -= *length;
+  assert(num_free >= 0);
+  assert(num_reserved >= 0);
+  last_alloc = *offset + *length;
+  return 0;
+}
+
+int AvlAllocator::reserve(uint64_t need)
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(10) << __func__ << " need 0x" << std::hex << need
+	   << " num_free 0x" << num_free
+	   << " num_reserved 0x" << num_reserved << std::dec << dendl;
+  if ((int64_t)need > num_free - num_reserved)
+    return -ENOSPC;
+  num_reserved += need;
+  return 0;
+}
+
+void AvlAllocator::unreserve(uint64_t unused)
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(10) << __func__ << " unused 0x" << std::hex << unused
+	   << " num_free 0x" << num_free
+	   << " num_reserved 0x" << num_reserved << std::dec << dendl;
+  assert(num_reserved >= (int64_t)unused);
+  num_reserved -= unused;
+}
+
+int64_t AvlAllocator::allocate(
+  uint64_t want_size,
+  uint64_t alloc_unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  mempool::bluestore_alloc::vector<AllocExtent> *extents)
+{
+  uint64_t allocated_size = 0;
+
+  if (max_alloc_size == 0) {
+    max_alloc_size = want_size;
+  }
+  // AllocExtent::length is 32 bits wide
+  uint64_t max_extent = std::numeric_limits<uint32_t>::max();
+  max_extent -= max_extent % alloc_unit;
+  max_alloc_size = MIN(max_alloc_size, max_extent);
+
+  ExtentList block_list = ExtentList(extents, 1, max_alloc_size);
+
+  std::lock_guard<std::mutex> l(lock);
+  while (allocated_size < want_size) {
+    uint64_t offset = 0, length = 0;
+    int r = _allocate_int(MIN(max_alloc_size, (want_size - allocated_size)),
+			  alloc_unit, hint, &offset, &length);
+    if (r != 0) {
+      break;
+    }
+    block_list.add_extents(offset, length);
+    allocated_size += length;
+    hint = offset + length;
+  }
+
+  if (allocated_size == 0) {
+    return -ENOSPC;
+  }
+  return allocated_size;
+}
+
+void AvlAllocator::release(
+  uint64_t offset, uint64_t length)
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(10) << __func__ << " 0x" << std::hex << offset << "~" << length
+	   << std::dec << dendl;
+  _add_to_tree(offset, length);
+  num_free += length;
+}
+
+uint64_t AvlAllocator::get_free()
+{
+  std::lock_guard<std::mutex> l(lock);
+  return num_free;
+}
+
+double AvlAllocator::get_fragmentation(uint64_t alloc_unit)
+{
+  assert(alloc_unit);
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t num_extents = range_tree.size();
+  uint64_t free_blocks = num_free / alloc_unit;
+  if (free_blocks <= 1 || num_extents <= 1)
+    return 0.0;
+  return std::min(1.0, (double)(num_extents - 1) / (free_blocks - 1));
+}
+
+void AvlAllocator::dump()
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(0) << __func__ << " " << range_tree.size() << " extents" << dendl;
+  for (auto& rs : range_tree) {
+    dout(0) << __func__ << "  0x" << std::hex << rs.start << "~"
+	    << rs.length() << std::dec << dendl;
+  }
+}
+
+void AvlAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  std::lock_guard<std::mutex> l(lock);
+  for (auto& rs : range_tree) {
+    notify(rs.start, rs.length());
+  }
+}
+
+void AvlAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(10) << __func__ << " 0x" << std::hex << offset << "~" << length
+	   << std::dec << dendl;
+  _add_to_tree(offset, length);
+  num_free += length;
+}
+
+void AvlAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  std::lock_guard<std::mutex> l(lock);
+  dout(10) << __func__ << " 0x" << std::hex << offset << "~" << length
+	   << std::dec << dendl;
+  _remove_from_tree(offset, length);
+  num_free -= length;
+  assert(num_free >= 0);
+}
+
+void AvlAllocator::shutdown()
+{
+  dout(1) << __func__ << dendl;
+  std::lock_guard<std::mutex> l(lock);
+  range_size_tree.clear();
+  range_tree.clear_and_dispose(dispose_rs{});
+  num_free = 0;
+  num_reserved = 0;
+}
@@ -0,0 +1,122 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OS_BLUESTORE_AVLALLOCATOR_H
+#define CEPH_OS_BLUESTORE_AVLALLOCATOR_H
+
+#include <mutex>
+#include <boost/intrusive/avl_set.hpp>
+
+#include "Allocator.h"
+#include "os/bluestore/bluestore_types.h"
+
+/*
+ * Extent-tree allocator.
+ *
+ * Every free extent is a single range_seg_t linked into two AVL trees:
+ * one ordered by offset, used to find neighbours when merging on release
+ * and to honour the allocation hint, and one ordered by (length, offset),
+ * used to find the smallest extent that satisfies a request.  Both
+ * lookups are O(log n) in the number of free extents, independent of the
+ * device size.
+ */
+class AvlAllocator : public Allocator {
+  struct range_seg_t {
+    uint64_t start;   ///< starting offset of this segment
+    uint64_t end;     ///< ending offset (non-inclusive)
+
+    range_seg_t(uint64_t start, uint64_t end)
+      : start{start},
+	end{end}
+    {}
+    uint64_t length() const {
+      return end - start;
+    }
+
+    boost::intrusive::avl_set_member_hook<> offset_hook;
+    boost::intrusive::avl_set_member_hook<> size_hook;
+
+    struct before_t {
+      bool operator()(const range_seg_t& lhs, const range_seg_t& rhs) const {
+	return lhs.start < rhs.start;
+      }
+    };
+    struct shorter_t {
+      bool operator()(const range_seg_t& lhs, const range_seg_t& rhs) const {
+	if (lhs.length() != rhs.length())
+	  return lhs.length() < rhs.length();
+	return lhs.start < rhs.start;
+      }
+    };
+  };
+
+  typedef boost::intrusive::member_hook<
+    range_seg_t,
+    boost::intrusive::avl_set_member_hook<>,
+    &range_seg_t::offset_hook> offset_hook_t;
+  typedef boost::intrusive::avl_set<
+    range_seg_t,
+    boost::intrusive::compare<range_seg_t::before_t>,
+    offset_hook_t> range_tree_t;
+
+  typedef boost::intrusive::member_hook<
+    range_seg_t,
+    boost::intrusive::avl_set_member_hook<>,
+    &range_seg_t::size_hook> size_hook_t;
+  typedef boost::intrusive::avl_multiset<
+    range_seg_t,
+    boost::intrusive::compare<range_seg_t::shorter_t>,
+    size_hook_t> range_size_tree_t;
+
+  CephContext* cct;
+  std::mutex lock;
+
+  range_tree_t range_tree;            ///< free extents by offset
+  range_size_tree_t range_size_tree;  ///< free extents by (length, offset)
+
+  int64_t num_free;     ///< total bytes in freelist
+  int64_t num_reserved; ///< reserved bytes
+
+  uint64_t last_alloc;
+
+  void _add_to_tree(uint64_t start, uint64_t size);
+  void _remove_from_tree(uint64_t start, uint64_t size);
+  range_tree_t::iterator _find_containing(uint64_t offset);
+
+  bool _try_hint(uint64_t hint, uint64_t want, uint64_t unit,
+		 uint64_t *offset);
+  bool _pick_best_fit(uint64_t want, uint64_t unit, uint64_t *offset);
+  int64_t _allocate_int(uint64_t want, uint64_t unit, int64_t hint,
+			uint64_t *offset, uint64_t *length);
+
+  static uint64_t _aligned_start(const range_seg_t& rs, uint64_t unit);
+  static uint64_t _aligned_len(const range_seg_t& rs, uint64_t unit);
+
+public:
+  AvlAllocator(CephContext* cct);
+  ~AvlAllocator() override;
+
+  int reserve(uint64_t need) override;
+  void unreserve(uint64_t unused) override;
+
+  int64_t allocate(
+    uint64_t want_size, uint64_t alloc_unit, uint64_t max_alloc_size,
+    int64_t hint, mempool::bluestore_alloc::vector<AllocExtent> *extents) override;
+
+  void release(
+    uint64_t offset, uint64_t length) override;
+
+  uint64_t get_free() override;
+  double get_fragmentation(uint64_t alloc_unit) override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  void shutdown() override;
+};
+
+#endif
@@ -537,6 +537,13 @@ void BitMapZone::dump_state(CephContext* const cct, int& count)
 }
 
 
+void BitMapZone::foreach_bmap(std::function<void(bmap_t)> f)
+{
+  for (auto& bmap : m_bmap_vec) {
+    f(bmap.atomic_fetch());
+  }
+}
+
 /*
  * BitMapArea Leaf and non-Leaf functions.
  */
@@ -925,6 +932,18 @@ void BitMapAreaIN::dump_state(CephContext* const cct, int& count)
   }
 }
 
+void BitMapAreaIN::foreach_bmap(std::function<void(bmap_t)> f)
+{
+  BitMapArea *child = NULL;
+
+  BmapEntityListIter iter = BmapEntityListIter(
+        &m_child_list, 0, false);
+
+  while ((child = static_cast<BitMapArea *>(iter.next()))) {
+    child->foreach_bmap(f);
+  }
+}
+
 /*
  * BitMapArea Leaf
  */
@@ -1418,3 +1437,12 @@ void BitAllocator::dump()
   dump_state(cct, count);
   serial_unlock(); 
 }
+
+void BitAllocator::foreach_bmap(std::function<void(bmap_t)> f)
+{
+  // every alloc/free path holds the tree lock shared, so holding it
+  // exclusive gives a consistent view of all zones.
+  lock_excl();
+  BitMapAreaIN::foreach_bmap(f);
+  unlock();
+}
@@ -14,6 +14,7 @@
 #include <pthread.h>
 #include <mutex>
 #include <atomic>
+#include <functional>
 #include <vector>
 #include "include/intarith.h"
 #include "os/bluestore/bluestore_types.h"
@@ -246,6 +247,8 @@ public:
   int64_t get_index();
   int64_t get_level();
   virtual void dump_state(CephContext* cct, int& count) = 0;
+  /// call f for each bitmap word, in block order
+  virtual void foreach_bmap(std::function<void(bmap_t)> f) = 0;
   BitMapArea(CephContext*) { }
   virtual ~BitMapArea() { }
 };
@@ -380,6 +383,7 @@ public:
 
   void free_blocks(int64_t start_block, int64_t num_blocks) override;
   void dump_state(CephContext* cct, int& count) override;
+  void foreach_bmap(std::function<void(bmap_t)> f) override;
 };
 
 class BitMapAreaIN: public BitMapArea{
@@ -457,6 +461,7 @@ public:
   virtual void free_blocks_int(int64_t start_block, int64_t num_blocks);
   void free_blocks(int64_t start_block, int64_t num_blocks) override;
   void dump_state(CephContext* cct, int& count) override;
+  void foreach_bmap(std::function<void(bmap_t)> f) override;
 };
 
 class BitMapAreaLeaf: public BitMapAreaIN{
@@ -564,6 +569,7 @@ public:
       return m_stats;
   }
   void dump();
+  void foreach_bmap(std::function<void(bmap_t)> f) override;
 };
 
 #endif //End of file
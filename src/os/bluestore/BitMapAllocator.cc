@@ -168,6 +168,41 @@ void BitMapAllocator::dump()
   m_bit_alloc->dump();
 }
 
+void BitMapAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  // zones may be padded past the end of the device; those trailing
+  // blocks are permanently marked used, but be careful anyway.
+  int64_t max_block = m_total_size / m_block_size;
+  int64_t block = 0;
+  int64_t run_start = 0;
+  int64_t run_len = 0;
+  auto flush = [&]() {
+    if (run_len) {
+      notify(run_start * m_block_size, run_len * m_block_size);
+      run_len = 0;
+    }
+  };
+  m_bit_alloc->foreach_bmap([&](bmap_t bits) {
+    if (bits == BmapEntry::full_bmask()) {
+      flush();
+      block += BmapEntry::size();
+      return;
+    }
+    for (int i = 0; i < BmapEntry::size(); ++i, ++block) {
+      if ((bits & BmapEntry::bit_mask(i)) || block >= max_block) {
+	flush();
+      } else {
+	if (!run_len) {
+	  run_start = block;
+	}
+	++run_len;
+      }
+    }
+  });
+  flush();
+}
+
 void BitMapAllocator::init_add_free(uint64_t offset, uint64_t length)
 {
   dout(10) << __func__ << " instance " << (uint64_t) this
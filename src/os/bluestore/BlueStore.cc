@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 #include "include/cpp-btree/btree_set.h"
 
@@ -24,6 +25,7 @@
 #include "include/compat.h"
 #include "include/intarith.h"
 #include "include/stringify.h"
+#include "include/str_map.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
 #include "Allocator.h"
@@ -66,6 +68,7 @@ const string PREFIX_OMAP = "M";    // u64 + keyname -> value
 const string PREFIX_DEFERRED = "L";  // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";   // u64 offset -> u64 length (freelist)
 const string PREFIX_SHARED_BLOB = "X"; // u64 offset -> shared_blob_t
+const string PREFIX_ALLOC_SNAPSHOT = "A"; // u32 chunk -> (u64 offset, u64 length)*
 
 // write a label in the first block.  always use this size.  note that
 // bluefs makes a matching assumption about the location of its
@@ -777,9 +780,78 @@ BlueStore::Cache *BlueStore::Cache::create(CephContext* cct, string type,
   return c;
 }
 
+BlueStore::Cache::Cache(CephContext* cct)
+  : cct(cct), logger(nullptr)
+{
+  touch_ring_size = cct->_conf->bluestore_cache_onode_touch_batch;
+  if (touch_ring_size) {
+    touch_ring.reset(new std::atomic<Onode*>[touch_ring_size]);
+    for (size_t i = 0; i < touch_ring_size; ++i) {
+      touch_ring[i] = nullptr;
+    }
+  }
+}
+
+BlueStore::Cache::~Cache()
+{
+  // the subclass (and its lru) is gone by now, so queued promotions can
+  // only be dropped, not applied; just release their refs.
+  for (size_t i = 0; i < touch_ring_size; ++i) {
+    Onode *o = touch_ring[i].exchange(nullptr);
+    if (o) {
+      o->put();
+    }
+  }
+}
+
+void BlueStore::Cache::lock_timed()
+{
+  if (lock.try_lock()) {
+    return;
+  }
+  utime_t start = ceph_clock_now();
+  lock.lock();
+  logger->tinc(l_bluestore_cache_lock_wait_lat, ceph_clock_now() - start);
+}
+
+void BlueStore::Cache::touch_onode_deferred(const OnodeRef& o)
+{
+  Onode *on = o.get();
+  on->get();
+  size_t slot = touch_pos++ % touch_ring_size;
+  Onode *old = touch_ring[slot].exchange(on);
+  if (old) {
+    // the ring wrapped before anyone drained it; forget that promotion.
+    // old is either still in our lru (and onode_map holds a ref) or has
+    // already been unlinked, so this is never the last ref of a cached
+    // onode.
+    old->put();
+  }
+  logger->inc(l_bluestore_onode_touch_deferred);
+}
+
+void BlueStore::Cache::_drain_touches()
+{
+  for (size_t i = 0; i < touch_ring_size; ++i) {
+    Onode *o = touch_ring[i].exchange(nullptr);
+    if (!o) {
+      continue;
+    }
+    // the onode may have been trimmed or removed since it was queued.
+    // it cannot be in another shard's lru: split_cache drains us before
+    // moving onodes away.
+    if (o->lru_item.is_linked()) {
+      OnodeRef ref(o);
+      _touch_onode(ref);
+    }
+    o->put();
+  }
+}
+
 void BlueStore::Cache::trim_all()
 {
   std::lock_guard<std::recursive_mutex> l(lock);
+  _drain_touches();
   _trim(0, 0);
 }
 
@@ -789,7 +861,9 @@ void BlueStore::Cache::trim(
   float target_data_ratio,
   float bytes_per_onode)
 {
-  std::lock_guard<std::recursive_mutex> l(lock);
+  lock_timed();
+  std::lock_guard<std::recursive_mutex> l(lock, std::adopt_lock);
+  _drain_touches();
   uint64_t current_meta = _get_num_onodes() * bytes_per_onode;
   uint64_t current_buffer = _get_buffer_bytes();
   uint64_t current = current_meta + current_buffer;
@@ -1506,7 +1580,9 @@ void BlueStore::BufferSpace::split(Cache* cache, size_t pos, BlueStore::BufferSp
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
-  std::lock_guard<std::recursive_mutex> l(cache->lock);
+  cache->lock_timed();
+  std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
+  RWLock::WLocker ml(map_lock);
   auto p = onode_map.find(oid);
   if (p != onode_map.end()) {
     ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
@@ -1522,25 +1598,54 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
-  std::lock_guard<std::recursive_mutex> l(cache->lock);
   ldout(cache->cct, 30) << __func__ << dendl;
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
-  if (p == onode_map.end()) {
+  if (!cache->touch_ring_size) {
+    // promote under the cache lock
+    cache->lock_timed();
+    std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
+    RWLock::RLocker ml(map_lock);
+    auto p = onode_map.find(oid);
+    if (p == onode_map.end()) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
+      cache->logger->inc(l_bluestore_onode_misses);
+      return OnodeRef();
+    }
+    ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
+			  << dendl;
+    cache->_touch_onode(p->second);
+    cache->logger->inc(l_bluestore_onode_hits);
+    return p->second;
+  }
+
+  // lock-free (wrt the cache shard) lookup; the promotion is applied in
+  // batch the next time the shard is trimmed.
+  OnodeRef o;
+  {
+    RWLock::RLocker ml(map_lock);
+    auto p = onode_map.find(oid);
+    if (p != onode_map.end()) {
+      o = p->second;
+    }
+  }
+  if (!o) {
     ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
     cache->logger->inc(l_bluestore_onode_misses);
     return OnodeRef();
   }
-  ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
-			<< dendl;
-  cache->_touch_onode(p->second);
+  ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << o << dendl;
+  cache->touch_onode_deferred(o);
   cache->logger->inc(l_bluestore_onode_hits);
-  return p->second;
+  return o;
 }
 
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
   ldout(cache->cct, 10) << __func__ << dendl;
+  // queued promotions may hold the last refs to our (already trimmed)
+  // onodes; drop them while the collection is still around.
+  cache->_drain_touches();
+  RWLock::WLocker ml(map_lock);
   for (auto &p : onode_map) {
     cache->_rm_onode(p.second);
   }
@@ -1550,6 +1655,7 @@ void BlueStore::OnodeSpace::clear()
 bool BlueStore::OnodeSpace::empty()
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker ml(map_lock);
   return onode_map.empty();
 }
 
@@ -1560,6 +1666,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_other::string& new_okey)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(map_lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -1591,6 +1698,7 @@ void BlueStore::OnodeSpace::rename(
 bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker ml(map_lock);
   ldout(cache->cct, 20) << __func__ << dendl;
   for (auto& i : onode_map) {
     if (f(i.second)) {
@@ -3220,6 +3328,12 @@ void BlueStore::Collection::split_cache(
   std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
   std::lock_guard<std::recursive_mutex> l2(dest->cache->lock, std::adopt_lock);
 
+  // queued lru promotions must not outlive the onodes' move to another
+  // shard; see Cache::_drain_touches
+  cache->_drain_touches();
+  RWLock::WLocker ml(onode_map.map_lock);
+  RWLock::WLocker ml2(dest->onode_map.map_lock);
+
   int destbits = dest->cnode.bits;
   spg_t destpg;
   bool is_pg = dest->cid.is_pg(&destpg);
@@ -3792,6 +3906,11 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_shard_misses,
 		    "bluestore_onode_shard_misses",
 		    "Sum for onode-shard lookups missed in the cache");
+  b.add_u64_counter(l_bluestore_onode_touch_deferred,
+		    "bluestore_onode_touch_deferred",
+		    "Sum for onode lru promotions queued without the cache lock");
+  b.add_time_avg(l_bluestore_cache_lock_wait_lat, "cache_lock_wait_lat",
+		 "Average wait for a contended cache shard lock");
   b.add_u64(l_bluestore_extents, "bluestore_extents",
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "bluestore_blobs",
@@ -3804,6 +3923,12 @@ void BlueStore::_init_logger()
     "Sum for bytes of read hit in the cache");
   b.add_u64(l_bluestore_buffer_miss_bytes, "bluestore_buffer_miss_bytes",
     "Sum for bytes of read missed in the cache");
+  b.add_u64_counter(l_bluestore_read_zero_copy_bytes,
+		    "bluestore_read_zero_copy_bytes",
+		    "Bytes of reads returned by reference to cached data or "
+		    "the shared zero buffer");
+  b.add_u64_counter(l_bluestore_read_copy_bytes, "bluestore_read_copy_bytes",
+		    "Bytes of reads returned from newly decompressed buffers");
 
   b.add_u64_counter(l_bluestore_write_big, "bluestore_write_big",
 		    "Large aligned writes into fresh blobs");
@@ -3838,6 +3963,9 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_gc_merged, "bluestore_gc_merged",
 		    "Sum for extents that have been merged due to garbage "
 		    "collection");
+  b.add_u64_counter(l_bluestore_alloc_snapshot_loaded,
+		    "bluestore_alloc_snapshot_loaded",
+		    "Mounts that loaded the allocator from a snapshot");
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -4173,7 +4301,7 @@ void BlueStore::_close_fm()
   fm = NULL;
 }
 
-int BlueStore::_open_alloc()
+int BlueStore::_open_alloc(bool use_snapshot)
 {
   assert(alloc == NULL);
   assert(bdev->get_size());
@@ -4187,6 +4315,30 @@ int BlueStore::_open_alloc()
     return -EINVAL;
   }
 
+  if (use_snapshot) {
+    int r = _load_alloc_snapshot();
+    if (r != -ENOENT) {
+      // the snapshot must not outlive the first change to the allocator,
+      // or a crash would bring it back stale.  the kv thread drops it
+      // with the first transaction it commits; until then every txc is
+      // routed through it (see _txc_state_proc).
+      alloc_snapshot_stale = true;
+    }
+    if (r == 0) {
+      logger->inc(l_bluestore_alloc_snapshot_loaded);
+      return 0;
+    }
+    if (r != -ENOENT) {
+      derr << __func__ << " ignoring allocator snapshot: " << cpp_strerror(r)
+	   << dendl;
+      alloc->shutdown();
+      delete alloc;
+      alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
+				bdev->get_size(),
+				min_alloc_size);
+    }
+  }
+
   uint64_t num = 0, bytes = 0;
 
   dout(1) << __func__ << " opening allocation metadata" << dendl;
@@ -4220,6 +4372,145 @@ void BlueStore::_close_alloc()
   alloc = NULL;
 }
 
+// free extents are stored this many to a key under PREFIX_ALLOC_SNAPSHOT
+static const uint64_t ALLOC_SNAPSHOT_EXTENTS_PER_KEY = 65536;
+
+int BlueStore::_load_alloc_snapshot()
+{
+  bufferlist hbl;
+  int r = db->get(PREFIX_SUPER, "alloc_snapshot", &hbl);
+  if (r < 0 || hbl.length() == 0) {
+    dout(10) << __func__ << " no allocator snapshot" << dendl;
+    return -ENOENT;
+  }
+
+  utime_t start = ceph_clock_now();
+  bluestore_alloc_snapshot_t h;
+  try {
+    bufferlist::iterator p = hbl.begin();
+    ::decode(h, p);
+  } catch (buffer::error& e) {
+    derr << __func__ << " unable to decode allocator snapshot header" << dendl;
+    return -EIO;
+  }
+  dout(10) << __func__ << " " << h << dendl;
+  if (h.size != bdev->get_size() ||
+      h.min_alloc_size != min_alloc_size) {
+    derr << __func__ << " " << h << " does not match device size 0x"
+	 << std::hex << bdev->get_size() << " min_alloc_size 0x"
+	 << min_alloc_size << std::dec << dendl;
+    return -ESTALE;
+  }
+
+  // decode and verify everything before touching the allocator
+  vector<pair<uint64_t,uint64_t>> extents;
+  extents.reserve(h.num_extents);
+  uint32_t crc = -1;
+  uint32_t chunk = 0;
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_ALLOC_SNAPSHOT);
+  for (it->lower_bound(string()); it->valid(); it->next(), ++chunk) {
+    string expected;
+    _key_encode_u32(chunk, &expected);
+    if (it->key() != expected) {
+      derr << __func__ << " missing chunk " << chunk << dendl;
+      return -EIO;
+    }
+    bufferlist bl = it->value();
+    crc = bl.crc32c(crc);
+    try {
+      bufferlist::iterator p = bl.begin();
+      while (!p.end()) {
+	uint64_t offset, length;
+	::decode(offset, p);
+	::decode(length, p);
+	extents.push_back(make_pair(offset, length));
+      }
+    } catch (buffer::error& e) {
+      derr << __func__ << " unable to decode chunk " << chunk << dendl;
+      return -EIO;
+    }
+  }
+  if (chunk != h.num_chunks ||
+      extents.size() != h.num_extents ||
+      crc != h.crc) {
+    derr << __func__ << " " << h << " does not match content: " << chunk
+	 << " chunks, " << extents.size() << " extents, crc 0x" << std::hex
+	 << crc << std::dec << dendl;
+    return -EIO;
+  }
+
+  uint64_t bytes = 0;
+  for (auto& e : extents) {
+    alloc->init_add_free(e.first, e.second);
+    bytes += e.second;
+  }
+  if (bytes != h.free || alloc->get_free() != h.free) {
+    derr << __func__ << " " << h << " loaded 0x" << std::hex << bytes
+	 << ", allocator has 0x" << alloc->get_free() << std::dec
+	 << " free" << dendl;
+    return -EIO;
+  }
+
+  // bluefs_extents were already excluded when the snapshot was taken
+  dout(1) << __func__ << " loaded " << pretty_si_t(bytes)
+	  << " in " << extents.size() << " extents from snapshot in "
+	  << (ceph_clock_now() - start) << dendl;
+  return 0;
+}
+
+void BlueStore::_remove_alloc_snapshot(KeyValueDB::Transaction t)
+{
+  dout(10) << __func__ << dendl;
+  t->rmkey(PREFIX_SUPER, "alloc_snapshot");
+  t->rmkeys_by_prefix(PREFIX_ALLOC_SNAPSHOT);
+}
+
+int BlueStore::_save_alloc_snapshot()
+{
+  utime_t start = ceph_clock_now();
+  bluestore_alloc_snapshot_t h;
+  h.size = bdev->get_size();
+  h.min_alloc_size = min_alloc_size;
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys_by_prefix(PREFIX_ALLOC_SNAPSHOT);
+  bufferlist bl;
+  uint64_t n = 0;
+  auto flush_chunk = [&]() {
+    string key;
+    _key_encode_u32(h.num_chunks, &key);
+    h.crc = bl.crc32c(h.crc);
+    t->set(PREFIX_ALLOC_SNAPSHOT, key, bl);
+    ++h.num_chunks;
+    bl.clear();
+    n = 0;
+  };
+  alloc->foreach([&](uint64_t offset, uint64_t length) {
+      ::encode(offset, bl);
+      ::encode(length, bl);
+      ++h.num_extents;
+      h.free += length;
+      if (++n == ALLOC_SNAPSHOT_EXTENTS_PER_KEY) {
+	flush_chunk();
+      }
+    });
+  if (n) {
+    flush_chunk();
+  }
+
+  bufferlist hbl;
+  ::encode(h, hbl);
+  t->set(PREFIX_SUPER, "alloc_snapshot", hbl);
+  int r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(1) << __func__ << " " << h << " in " << (ceph_clock_now() - start)
+	  << dendl;
+  return 0;
+}
+
 int BlueStore::_open_fsid(bool create)
 {
   assert(fsid_fd < 0);
@@ -4604,8 +4895,10 @@ int BlueStore::_open_db(bool create)
 
   db->set_cache_size(cct->_conf->bluestore_cache_size * cache_kv_ratio);
 
-  if (kv_backend == "rocksdb")
+  if (kv_backend == "rocksdb") {
     options = cct->_conf->bluestore_rocksdb_options;
+    _setup_column_families();
+  }
   db->init(options);
   if (create)
     r = db->create_and_open(err);
@@ -4633,6 +4926,34 @@ free_bluefs:
   return r;
 }
 
+void BlueStore::_setup_column_families()
+{
+  map<string,string> cf_map;
+  get_str_map(cct->_conf->bluestore_rocksdb_cfs, &cf_map, " \t");
+  if (cf_map.empty()) {
+    return;
+  }
+
+  // the superblock and the small, hot freelist and statfs keys stay in
+  // the default column family
+  static const set<string> cf_prefixes = {
+    PREFIX_OBJ, PREFIX_OMAP, PREFIX_DEFERRED, PREFIX_SHARED_BLOB
+  };
+  vector<KeyValueDB::ColumnFamily> cfs;
+  for (auto& p : cf_map) {
+    if (cf_prefixes.count(p.first) == 0) {
+      derr << __func__ << " ignoring column family for prefix '" << p.first
+	   << "'" << dendl;
+      continue;
+    }
+    cfs.emplace_back(p.first, p.second);
+  }
+  if (!cfs.empty()) {
+    dout(10) << __func__ << " " << cct->_conf->bluestore_rocksdb_cfs << dendl;
+    db->set_column_families(cfs);
+  }
+}
+
 void BlueStore::_close_db()
 {
   assert(db);
@@ -5232,7 +5553,7 @@ int BlueStore::_mount(bool kv_only)
   if (r < 0)
     goto out_db;
 
-  r = _open_alloc();
+  r = _open_alloc(true);
   if (r < 0)
     goto out_fm;
 
@@ -5298,6 +5619,12 @@ int BlueStore::umount()
   dout(20) << __func__ << " closing" << dendl;
 
   mounted = false;
+  if (cct->_conf->bluestore_alloc_snapshot) {
+    // everything is committed and the kv thread is gone, so the
+    // allocator is quiescent and in sync with the freelist.
+    _save_alloc_snapshot();
+  }
+  alloc_snapshot_stale = false;
   _close_alloc();
   _close_fm();
   _close_db();
@@ -6254,6 +6581,22 @@ struct region_t {
 typedef list<region_t> regions2read_t;
 typedef map<BlueStore::BlobRef, regions2read_t> blobs2read_t;
 
+// holes are filled with references to this instead of fresh zeroed
+// buffers.  it is shared by every read, so it is mapped read-only: a
+// consumer that writes into a read result in place faults here instead of
+// corrupting the holes of all later reads.
+static const bufferptr& get_zero_buffer()
+{
+  static const bufferptr zero_bp = [] {
+    const unsigned len = 64 * 1024;
+    void *p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+		     -1, 0);
+    assert(p != MAP_FAILED);
+    return bufferptr(buffer::create_static(len, static_cast<char*>(p)));
+  }();
+  return zero_bp;
+}
+
 int BlueStore::_do_read(
   Collection *c,
   OnodeRef o,
@@ -6297,6 +6640,7 @@ int BlueStore::_do_read(
   _dump_onode(o);
 
   ready_regions_t ready_regions;
+  uint64_t shared = 0;  // bytes returned by reference to cache or zeros
 
   // build blob-wise list to of stuff read (that isn't cached)
   blobs2read_t blobs2read;
@@ -6336,6 +6680,7 @@ int BlueStore::_do_read(
 	  pc->first == b_off) {
 	l = pc->second.length();
 	ready_regions[pos].claim(pc->second);
+	shared += l;
 	dout(30) << __func__ << "    use cache 0x" << std::hex << pos << ": 0x"
 		 << b_off << "~" << l << std::dec << dendl;
 	++pc;
@@ -6441,6 +6786,7 @@ int BlueStore::_do_read(
   logger->tinc(l_bluestore_read_wait_aio_lat, ceph_clock_now() - start);
 
   // enumerate and decompress desired blobs
+  uint64_t copied = 0;
   auto p = compressed_blob_bls.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
   while (b2r_it != blobs2read.end()) {
@@ -6465,6 +6811,7 @@ int BlueStore::_do_read(
       for (auto& i : b2r_it->second) {
 	ready_regions[i.logical_offset].substr_of(
 	  raw_bl, i.blob_xoffset, i.length);
+	copied += i.length;
       }
     } else {
       for (auto& reg : b2r_it->second) {
@@ -6506,13 +6853,21 @@ int BlueStore::_do_read(
       dout(30) << __func__ << " assemble 0x" << std::hex << pos
 	       << ": zeros for 0x" << (pos + offset) << "~" << l
 	       << std::dec << dendl;
-      bl.append_zero(l);
+      const bufferptr& zero_bp = get_zero_buffer();
       pos += l;
+      shared += l;
+      while (l > 0) {
+	unsigned zl = MIN(l, zero_bp.length());
+	bl.append(zero_bp, 0, zl);
+	l -= zl;
+      }
     }
   }
   assert(bl.length() == length);
   assert(pos == length);
   assert(pr == pr_end);
+  logger->inc(l_bluestore_read_zero_copy_bytes, shared);
+  logger->inc(l_bluestore_read_copy_bytes, copied);
   r = bl.length();
   return r;
 }
@@ -7539,6 +7894,19 @@ void BlueStore::get_db_statistics(Formatter *f)
   db->get_statistics(f);
 }
 
+void BlueStore::dump_allocator_stats(Formatter *f)
+{
+  f->open_object_section("allocator");
+  if (alloc) {
+    f->dump_string("type", cct->_conf->bluestore_allocator);
+    f->dump_unsigned("free", alloc->get_free());
+    f->dump_unsigned("min_alloc_size", min_alloc_size);
+    f->dump_float("fragmentation_rating",
+		  alloc->get_fragmentation(min_alloc_size));
+  }
+  f->close_section();
+}
+
 BlueStore::TransContext *BlueStore::_txc_create(OpSequencer *osr)
 {
   TransContext *txc = new TransContext(cct, osr);
@@ -7634,6 +8002,9 @@ void BlueStore::_txc_state_proc(TransContext *txc)
 	} else if (txc->osr->txc_with_unstable_io) {
 	  dout(20) << __func__ << " prior txc(s) with unstable ios "
 		   << txc->osr->txc_with_unstable_io.load() << dendl;
+	} else if (alloc_snapshot_stale) {
+	  dout(20) << __func__ << " allocator snapshot not yet removed,"
+		   << " submit via kv thread" << dendl;
 	} else if (cct->_conf->bluestore_debug_randomize_serial_transaction &&
 		   rand() % cct->_conf->bluestore_debug_randomize_serial_transaction
 		   == 0) {
@@ -8265,6 +8636,13 @@ void BlueStore::_kv_sync_thread()
 	t->set(PREFIX_SUPER, "blobid_max", bl);
 	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
       }
+      bool removed_alloc_snapshot = false;
+      if (alloc_snapshot_stale) {
+	KeyValueDB::Transaction t =
+	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
+	_remove_alloc_snapshot(t);
+	removed_alloc_snapshot = true;
+      }
       for (auto txc : kv_submitting) {
 	assert(txc->state == TransContext::STATE_KV_QUEUED);
 	txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
@@ -8337,6 +8715,9 @@ void BlueStore::_kv_sync_thread()
       int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(synct);
       assert(r == 0);
 
+      if (removed_alloc_snapshot) {
+	alloc_snapshot_stale = false;
+      }
       if (new_nid_max) {
 	nid_max = new_nid_max;
 	dout(10) << __func__ << " nid_max now " << nid_max << dendl;
@@ -96,12 +96,16 @@ enum {
   l_bluestore_onode_misses,
   l_bluestore_onode_shard_hits,
   l_bluestore_onode_shard_misses,
+  l_bluestore_onode_touch_deferred,
+  l_bluestore_cache_lock_wait_lat,
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_buffers,
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_read_zero_copy_bytes,
+  l_bluestore_read_copy_bytes,
   l_bluestore_write_big,
   l_bluestore_write_big_bytes,
   l_bluestore_write_big_blobs,
@@ -116,6 +120,7 @@ enum {
   l_bluestore_blob_split,
   l_bluestore_extent_compress,
   l_bluestore_gc_merged,
+  l_bluestore_alloc_snapshot_loaded,
   l_bluestore_last
 };
 
@@ -1035,10 +1040,25 @@ public:
     std::atomic<uint64_t> num_extents = {0};
     std::atomic<uint64_t> num_blobs = {0};
 
+    /// lru promotions queued by lookups that did not take the lock.
+    /// lossy: a slot that is overwritten before it is drained simply
+    /// drops that promotion.
+    std::unique_ptr<std::atomic<Onode*>[]> touch_ring;
+    size_t touch_ring_size = 0;
+    std::atomic<uint64_t> touch_pos = {0};
+
     static Cache *create(CephContext* cct, string type, PerfCounters *logger);
 
-    Cache(CephContext* cct) : cct(cct), logger(nullptr) {}
-    virtual ~Cache() {}
+    Cache(CephContext* cct);
+    virtual ~Cache();
+
+    /// take lock, accounting for any time spent waiting for it
+    void lock_timed();
+
+    /// queue an lru promotion for o without taking lock
+    void touch_onode_deferred(const OnodeRef& o);
+    /// apply (and release) queued promotions
+    void _drain_touches();
 
     virtual void _add_onode(OnodeRef& o, int level) = 0;
     virtual void _rm_onode(OnodeRef& o) = 0;
@@ -1284,13 +1304,19 @@ public:
   private:
     Cache *cache;
 
+    /// protect onode_map.  lookups only read-lock this (and not the
+    /// cache lock); modifications take cache->lock and then this.
+    RWLock map_lock;
+
     /// forward lookups
     mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
 
     friend class Collection; // for split_cache()
 
   public:
-    OnodeSpace(Cache *c) : cache(c) {}
+    OnodeSpace(Cache *c)
+      : cache(c),
+	map_lock("BlueStore::OnodeSpace::map_lock", false, false) {}
     ~OnodeSpace() {
       clear();
     }
@@ -1298,6 +1324,7 @@ public:
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
     void remove(const ghobject_t& oid) {
+      RWLock::WLocker l(map_lock);
       onode_map.erase(oid);
     }
     void rename(OnodeRef& o, const ghobject_t& old_oid,
@@ -1824,6 +1851,7 @@ private:
   std::atomic<uint64_t> nid_max = {0};
   std::atomic<uint64_t> blobid_last = {0};
   std::atomic<uint64_t> blobid_max = {0};
+  std::atomic<bool> alloc_snapshot_stale = {false}; ///< on-disk snapshot not yet removed
 
   Throttle throttle_bytes;          ///< submit to commit
   Throttle throttle_deferred_bytes;  ///< submit to deferred complete
@@ -1955,11 +1983,15 @@ private:
   int _open_bdev(bool create);
   void _close_bdev();
   int _open_db(bool create);
+  void _setup_column_families();
   void _close_db();
   int _open_fm(bool create);
   void _close_fm();
-  int _open_alloc();
+  int _open_alloc(bool use_snapshot = false);
   void _close_alloc();
+  int _load_alloc_snapshot();
+  void _remove_alloc_snapshot(KeyValueDB::Transaction t);
+  int _save_alloc_snapshot();
   int _open_collections(int *errors=0);
   void _close_collections();
 
@@ -2142,6 +2174,7 @@ public:
   }
 
   void get_db_statistics(Formatter *f) override;
+  void dump_allocator_stats(Formatter *f) override;
   void generate_db_histogram(Formatter *f) override;
   void _flush_cache();
   void flush_cache() override;
@@ -40,13 +40,23 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv)
     size(0), block_size(0),
     fs(NULL), aio(false), dio(false),
     debug_lock("KernelDevice::debug_lock"),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     aio_callback(cb),
     aio_callback_priv(cbpriv),
     aio_stop(false),
     aio_thread(this),
     injecting_crash(0)
 {
+  if (cct->_conf->bdev_ioring && ioring_queue_t::supported()) {
+    io_queue.reset(new ioring_queue_t(
+      cct->_conf->bdev_aio_max_queue_depth,
+      cct->_conf->bdev_ioring_sqthread_poll));
+  } else {
+    if (cct->_conf->bdev_ioring) {
+      derr << __func__ << " io_uring not supported by this build or kernel,"
+	   << " falling back to libaio" << dendl;
+    }
+    io_queue.reset(new aio_queue_t(cct->_conf->bdev_aio_max_queue_depth));
+  }
 }
 
 int KernelDevice::_lock()
@@ -308,13 +318,21 @@ int KernelDevice::_aio_start()
 {
   if (aio) {
     dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    std::vector<int> fds = { fd_direct, fd_buffered };
+    int r = io_queue->init(fds);
+    if (r < 0 && dynamic_cast<ioring_queue_t*>(io_queue.get())) {
+      derr << __func__ << " io_uring init failed: " << cpp_strerror(r)
+	   << ", falling back to libaio" << dendl;
+      io_queue.reset(new aio_queue_t(cct->_conf->bdev_aio_max_queue_depth));
+      r = io_queue->init(fds);
+    }
     if (r < 0) {
       if (r == -EAGAIN) {
 	derr << __func__ << " io_setup(2) failed with EAGAIN; "
 	     << "try increasing /proc/sys/fs/aio-max-nr" << dendl;
       } else {
-	derr << __func__ << " io_setup(2) failed: " << cpp_strerror(r) << dendl;
+	derr << __func__ << " io queue init failed: " << cpp_strerror(r)
+	     << dendl;
       }
       return r;
     }
@@ -330,7 +348,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -342,7 +360,7 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = 16;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
@@ -512,8 +530,8 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
-  r = aio_queue.submit_batch(ioc->running_aios.begin(), ioc->running_aios.end(), 
-				 ioc->num_running.load(), priv, &retries);
+  r = io_queue->submit_batch(ioc->running_aios.begin(), ioc->running_aios.end(),
+			     ioc->num_running.load(), priv, &retries);
   
   if (retries)
     derr << __func__ << " retries " << retries << dendl;
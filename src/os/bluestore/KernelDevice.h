@@ -19,6 +19,7 @@
 
 #include "os/fs/FS.h"
 #include "os/fs/aio.h"
+#include "os/fs/io_uring.h"
 #include "include/interval_set.h"
 
 #include "BlockDevice.h"
@@ -37,7 +38,7 @@ class KernelDevice : public BlockDevice {
   std::atomic<bool> io_since_flush = {false};
   std::mutex flush_mutex;
 
-  aio_queue_t aio_queue;
+  std::unique_ptr<io_queue_t> io_queue;
   aio_callback_t aio_callback;
   void *aio_callback_priv;
   bool aio_stop;
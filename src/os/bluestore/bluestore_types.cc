@@ -92,6 +92,41 @@ ostream& operator<<(ostream& out, const bluestore_bdev_label_t& l)
 	     << " desc " << l.description << ")";
 }
 
+// bluestore_alloc_snapshot_t
+
+void bluestore_alloc_snapshot_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("size", size);
+  f->dump_unsigned("min_alloc_size", min_alloc_size);
+  f->dump_unsigned("num_extents", num_extents);
+  f->dump_unsigned("free", free);
+  f->dump_unsigned("num_chunks", num_chunks);
+  f->dump_unsigned("crc", crc);
+}
+
+void bluestore_alloc_snapshot_t::generate_test_instances(
+  list<bluestore_alloc_snapshot_t*>& o)
+{
+  o.push_back(new bluestore_alloc_snapshot_t);
+  o.push_back(new bluestore_alloc_snapshot_t);
+  o.back()->size = 1ull << 40;
+  o.back()->min_alloc_size = 65536;
+  o.back()->num_extents = 3;
+  o.back()->free = 0x30000;
+  o.back()->num_chunks = 1;
+  o.back()->crc = 0x1234;
+}
+
+ostream& operator<<(ostream& out, const bluestore_alloc_snapshot_t& s)
+{
+  return out << "alloc_snapshot(size 0x" << std::hex << s.size
+	     << " min_alloc_size 0x" << s.min_alloc_size
+	     << " free 0x" << s.free << std::dec
+	     << " in " << s.num_extents << " extents"
+	     << " / " << s.num_chunks << " chunks"
+	     << " crc 0x" << std::hex << s.crc << std::dec << ")";
+}
+
 // cnode_t
 
 void bluestore_cnode_t::dump(Formatter *f) const
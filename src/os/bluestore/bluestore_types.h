@@ -45,6 +45,32 @@ WRITE_CLASS_ENCODER(bluestore_bdev_label_t)
 
 ostream& operator<<(ostream& out, const bluestore_bdev_label_t& l);
 
+/// header of the allocator state persisted at clean umount
+struct bluestore_alloc_snapshot_t {
+  uint64_t size = 0;            ///< device size
+  uint64_t min_alloc_size = 0;  ///< allocation unit
+  uint64_t num_extents = 0;     ///< free extents
+  uint64_t free = 0;            ///< free bytes
+  uint32_t num_chunks = 0;      ///< number of extent chunk keys
+  uint32_t crc = -1;            ///< crc32c over all chunk payloads
+
+  DENC(bluestore_alloc_snapshot_t, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.size, p);
+    denc(v.min_alloc_size, p);
+    denc(v.num_extents, p);
+    denc(v.free, p);
+    denc(v.num_chunks, p);
+    denc(v.crc, p);
+    DENC_FINISH(p);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<bluestore_alloc_snapshot_t*>& o);
+};
+WRITE_CLASS_DENC(bluestore_alloc_snapshot_t)
+
+ostream& operator<<(ostream& out, const bluestore_alloc_snapshot_t& s);
+
 /// collection metadata
 struct bluestore_cnode_t {
   uint32_t bits;   ///< how many bits of coll pgid are significant
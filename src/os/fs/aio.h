@@ -52,21 +52,34 @@ typedef boost::intrusive::list<
     boost::intrusive::list_member_hook<>,
     &aio_t::queue_item> > aio_list_t;
 
-struct aio_queue_t {
+/// interface shared by the libaio and io_uring submission queues
+struct io_queue_t {
+  typedef list<aio_t>::iterator aio_iter;
+
+  virtual ~io_queue_t() {}
+
+  /// set up the queue; fds are the descriptors that will be used for io
+  virtual int init(std::vector<int> &fds) = 0;
+  virtual void shutdown() = 0;
+  virtual int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+			   void *priv, int *retries) = 0;
+  virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+};
+
+struct aio_queue_t : public io_queue_t {
   int max_iodepth;
   io_context_t ctx;
 
-  typedef list<aio_t>::iterator aio_iter;
-
   explicit aio_queue_t(unsigned max_iodepth)
     : max_iodepth(max_iodepth),
       ctx(0) {
   }
-  ~aio_queue_t() {
+  ~aio_queue_t() override {
     assert(ctx == 0);
   }
 
-  int init() {
+  int init(std::vector<int> &fds) override {
+    (void)fds;
     assert(ctx == 0);
     int r = io_setup(max_iodepth, &ctx);
     if (r < 0) {
@@ -77,7 +90,7 @@ struct aio_queue_t {
     }
     return r;
   }
-  void shutdown() {
+  void shutdown() override {
     if (ctx) {
       int r = io_destroy(ctx);
       assert(r == 0);
@@ -86,9 +99,9 @@ struct aio_queue_t {
   }
 
   int submit(aio_t &aio, int *retries);
-  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size, 
-		   void *priv, int *retries);
-  int get_next_completed(int timeout_ms, aio_t **paio, int max);
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
 };
 
 #endif
@@ -0,0 +1,248 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "io_uring.h"
+
+#if defined(HAVE_LIBAIO)
+
+#if defined(HAVE_LIBURING)
+
+#include <liburing.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "include/compat.h"
+
+struct ioring_data {
+  struct io_uring io_uring;
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds;  ///< raw fd -> index in registered file table
+};
+
+static void init_sqe(ioring_data *d, struct io_uring_sqe *sqe, aio_t *io)
+{
+  auto p = d->fixed_fds.find(io->fd);
+  assert(p != d->fixed_fds.end());
+  int fixed_fd = p->second;
+
+  switch (io->iocb.aio_lio_opcode) {
+  case IO_CMD_PWRITEV:
+    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0], io->iov.size(),
+			 io->offset);
+    break;
+  case IO_CMD_PREAD:
+    io_uring_prep_read(sqe, fixed_fd, io->iocb.u.c.buf, io->iocb.u.c.nbytes,
+		       io->offset);
+    break;
+  default:
+    assert(0 == "unsupported aio opcode");
+  }
+  io_uring_sqe_set_data(sqe, io);
+  io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+static int ioring_get_cqe(ioring_data *d, unsigned max, aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+  unsigned head;
+  unsigned nr = 0;
+
+  io_uring_for_each_cqe(ring, head, cqe) {
+    aio_t *io = static_cast<aio_t*>(io_uring_cqe_get_data(cqe));
+    io->rval = cqe->res;
+    paio[nr++] = io;
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+  return nr;
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+  : iodepth(iodepth_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  assert(!d);
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  int r = io_uring_queue_init(16, &ring, 0);
+  if (r < 0)
+    return false;
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  assert(!d);
+  unsigned flags = 0;
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  d.reset(new ioring_data);
+  int r = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (r < 0) {
+    d.reset();
+    return r;
+  }
+
+  r = io_uring_register_files(&d->io_uring, &fds[0], fds.size());
+  if (r < 0)
+    goto out_ring;
+  for (unsigned i = 0; i < fds.size(); ++i)
+    d->fixed_fds[fds[i]] = i;
+
+  d->epoll_fd = epoll_create1(0);
+  if (d->epoll_fd < 0) {
+    r = -errno;
+    goto out_ring;
+  }
+  {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    r = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+    if (r < 0) {
+      r = -errno;
+      goto out_epoll;
+    }
+  }
+  return 0;
+
+ out_epoll:
+  VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+ out_ring:
+  io_uring_queue_exit(&d->io_uring);
+  d.reset();
+  return r;
+}
+
+void ioring_queue_t::shutdown()
+{
+  if (d) {
+    VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+    io_uring_queue_exit(&d->io_uring);
+    d.reset();
+  }
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  (void)aios_size;
+  // 2^16 * 125us = ~8 seconds, so max sleep is ~16 seconds
+  int attempts = 16;
+  int delay = 125;
+  struct io_uring *ring = &d->io_uring;
+  int submitted = 0;
+
+  std::lock_guard<std::mutex> l(sq_mutex);
+  aio_iter cur = beg;
+  while (true) {
+    // fill as much of the submission ring as we can ...
+    for (; cur != end; ++cur) {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+      if (!sqe)
+	break;
+      cur->priv = priv;
+      init_sqe(d.get(), sqe, &*cur);
+    }
+    // ... and hand it to the kernel with a single syscall
+    int r = io_uring_submit(ring);
+    if (r < 0) {
+      // EBUSY/EAGAIN: completion ring is backed up; give the aio
+      // thread a chance to reap before trying again.
+      if ((r == -EAGAIN || r == -EBUSY) && attempts-- > 0) {
+	usleep(delay);
+	delay *= 2;
+	(*retries)++;
+	continue;
+      }
+      return r;
+    }
+    submitted += r;
+    if (cur == end)
+      break;
+  }
+  return submitted;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  while (true) {
+    {
+      std::lock_guard<std::mutex> l(cq_mutex);
+      int events = ioring_get_cqe(d.get(), max, paio);
+      if (events)
+	return events;
+    }
+    struct epoll_event ev;
+    int r = epoll_wait(d->epoll_fd, &ev, 1, timeout_ms);
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      return -errno;
+    }
+    if (r == 0)
+      return 0;
+  }
+}
+
+#else // HAVE_LIBURING
+
+// built without liburing: supported() is false, and a queue that is
+// constructed anyway refuses to start so that the caller falls back to
+// libaio.
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+  : iodepth(iodepth_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  return -EOPNOTSUPP;
+}
+
+void ioring_queue_t::shutdown()
+{
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  return -EOPNOTSUPP;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  return -EOPNOTSUPP;
+}
+
+#endif // HAVE_LIBURING
+
+#endif // HAVE_LIBAIO
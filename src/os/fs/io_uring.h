@@ -0,0 +1,48 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "acconfig.h"
+
+#include "aio.h"
+
+#if defined(HAVE_LIBAIO)
+
+#include <memory>
+#include <mutex>
+
+struct ioring_data;
+
+/**
+ * io_uring based implementation of io_queue_t
+ *
+ * All aios of a batch are placed on the submission ring and handed to
+ * the kernel with a single io_uring_enter(2).  The block device fds are
+ * registered with the ring up front so the kernel can skip the per-io
+ * fget/fput.  Completions are reaped directly from the shared
+ * completion ring; we only sleep (in epoll_wait) when it is empty.
+ */
+struct ioring_queue_t : public io_queue_t {
+  std::unique_ptr<ioring_data> d;
+  unsigned iodepth = 0;
+  bool sq_thread = false;
+
+  std::mutex sq_mutex;
+  std::mutex cq_mutex;
+
+  ioring_queue_t(unsigned iodepth_, bool sq_thread_);
+  ~ioring_queue_t() override;
+
+  /// true if this build and the running kernel can use io_uring
+  static bool supported();
+
+  int init(std::vector<int> &fds) override;
+  void shutdown() override;
+
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
+};
+
+#endif
@@ -139,6 +139,7 @@
 
 #include "common/cmdparse.h"
 #include "include/str_list.h"
+#include "common/strtol.h"
 #include "include/util.h"
 
 #include "include/assert.h"
@@ -218,6 +219,9 @@ OSDService::OSDService(OSD *osd) :
   publish_lock("OSDService::publish_lock"),
   pre_publish_lock("OSDService::pre_publish_lock"),
   max_oldest_map(0),
+  pg_mapping_lock("OSDService::pg_mapping_lock"),
+  pg_mapper(osd->cct, &osd->peering_tp),
+  pg_mapping_job_lock("OSDService::pg_mapping_job_lock"),
   peer_map_epoch_lock("OSDService::peer_map_epoch_lock"),
   sched_scrub_lock("OSDService::sched_scrub_lock"), scrubs_pending(0),
   scrubs_active(0),
@@ -581,6 +585,171 @@ void OSDService::activate_map()
   agent_lock.Unlock();
 }
 
+struct C_PGMappingBuilt : public Context {
+  OSDService *service;
+  ParallelPGMapper::Job *job;
+  C_PGMappingBuilt(OSDService *s, ParallelPGMapper::Job *j)
+    : service(s), job(j) {}
+  void finish(int r) override {
+    service->pg_mapping_job_finished(job, r);
+  }
+};
+
+void OSDService::update_pg_mapping(const OSDMapRef& oldmap,
+				   const OSDMapRef& newmap)
+{
+  if (!cct->_conf->osd_pg_mapping) {
+    shutdown_pg_mapping();
+    RWLock::WLocker l(pg_mapping_lock);
+    pg_mapping.reset();
+    return;
+  }
+  std::shared_ptr<ParallelPGMapper::Job> job;
+  {
+    Mutex::Locker l(pg_mapping_job_lock);
+    pg_mapping_want = newmap;
+    if (pg_mapping_job) {
+      // it catches up with pg_mapping_want when it finishes
+      dout(10) << __func__ << " e" << newmap->get_epoch()
+	       << " waiting for rebuild of e"
+	       << pg_mapping_job_map->get_epoch() << dendl;
+      return;
+    }
+    bool incremental;
+    {
+      RWLock::RLocker l(pg_mapping_lock);
+      incremental = pg_mapping && oldmap &&
+	pg_mapping->get_epoch() == oldmap->get_epoch() &&
+	pg_mapping->can_update_incrementally(*oldmap, *newmap);
+    }
+    if (incremental) {
+      // only the pgs the maps' differences can have moved; cheap enough
+      // to do in place
+      utime_t start = ceph_clock_now();
+      RWLock::WLocker l(pg_mapping_lock);
+      uint64_t n = pg_mapping->update(*oldmap, *newmap);
+      dout(10) << __func__ << " e" << newmap->get_epoch()
+	       << " recalculated " << n << " pgs in "
+	       << (ceph_clock_now() - start) << dendl;
+      return;
+    }
+    job = _start_pg_mapping_job(newmap);
+  }
+  _queue_pg_mapping_job(job);
+}
+
+std::shared_ptr<ParallelPGMapper::Job> OSDService::_start_pg_mapping_job(
+  const OSDMapRef& map)
+{
+  assert(pg_mapping_job_lock.is_locked_by_me());
+  dout(10) << __func__ << " e" << map->get_epoch() << dendl;
+  {
+    // lookups go to the OSDMap until the new table is in
+    RWLock::WLocker l(pg_mapping_lock);
+    pg_mapping.reset();
+  }
+  pg_mapping_next.reset(new OSDMapMapping(false));
+  pg_mapping_job_map = map;
+  pg_mapping_job = pg_mapping_next->start_update(
+    *map, pg_mapper, cct->_conf->osd_pg_mapping_pgs_per_chunk);
+  return pg_mapping_job;
+}
+
+void OSDService::_queue_pg_mapping_job(
+  std::shared_ptr<ParallelPGMapper::Job> job)
+{
+  // without pg_mapping_job_lock: if the job is already done, this
+  // completes the context right here.  our ref keeps the job alive
+  // should shutdown_pg_mapping() cancel it meanwhile.
+  assert(!pg_mapping_job_lock.is_locked_by_me());
+  job->set_finish_event(new C_PGMappingBuilt(this, job.get()));
+}
+
+void OSDService::pg_mapping_job_finished(ParallelPGMapper::Job *job, int r)
+{
+  std::shared_ptr<ParallelPGMapper::Job> next;
+  std::unique_ptr<OSDMapMapping> m;
+  {
+    Mutex::Locker l(pg_mapping_job_lock);
+    if (r < 0 || pg_mapping_job.get() != job) {
+      // canceled
+      return;
+    }
+    OSDMapRef built = pg_mapping_job_map;
+    dout(10) << __func__ << " e" << built->get_epoch() << " built in "
+	     << job->get_duration() << dendl;
+    pg_mapping_job.reset();
+    pg_mapping_job_map.reset();
+    m.swap(pg_mapping_next);
+
+    // catch up with the maps consumed while we were building
+    if (pg_mapping_want->get_epoch() != built->get_epoch()) {
+      if (!m->can_update_incrementally(*built, *pg_mapping_want)) {
+	next = _start_pg_mapping_job(pg_mapping_want);
+      } else {
+	uint64_t n = m->update(*built, *pg_mapping_want);
+	dout(10) << __func__ << " caught up to e"
+		 << pg_mapping_want->get_epoch() << ", recalculated " << n
+		 << " pgs" << dendl;
+      }
+    }
+    if (!next) {
+      RWLock::WLocker l(pg_mapping_lock);
+      pg_mapping.swap(m);
+    }
+  }
+  if (next) {
+    _queue_pg_mapping_job(next);
+  }
+  // the table we replaced goes away here, outside the locks
+}
+
+void OSDService::shutdown_pg_mapping()
+{
+  std::shared_ptr<ParallelPGMapper::Job> job;
+  std::unique_ptr<OSDMapMapping> m;
+  OSDMapRef job_map;  // shards still running use it until abort() returns
+  {
+    Mutex::Locker l(pg_mapping_job_lock);
+    job.swap(pg_mapping_job);
+    m.swap(pg_mapping_next);
+    job_map.swap(pg_mapping_job_map);
+    pg_mapping_want.reset();
+  }
+  if (job) {
+    dout(10) << __func__ << " canceling rebuild " << job.get() << dendl;
+    job->abort();
+  }
+}
+
+void OSDService::pg_to_up_acting_osds(const OSDMapRef& osdmap, pg_t pgid,
+				      vector<int> *up, int *up_primary,
+				      vector<int> *acting, int *acting_primary)
+{
+  {
+    RWLock::RLocker l(pg_mapping_lock);
+    if (pg_mapping &&
+	pg_mapping->get_epoch() == osdmap->get_epoch() &&
+	pg_mapping->try_get(pgid, up, up_primary, acting, acting_primary)) {
+      return;
+    }
+  }
+  osdmap->pg_to_up_acting_osds(pgid, up, up_primary, acting, acting_primary);
+}
+
+bool OSDService::get_primary_shard(const OSDMapRef& osdmap, pg_t pgid,
+				   spg_t *out)
+{
+  {
+    RWLock::RLocker l(pg_mapping_lock);
+    if (pg_mapping &&
+	pg_mapping->get_epoch() == osdmap->get_epoch()) {
+      return pg_mapping->get_primary_shard(pgid, out);
+    }
+  }
+  return osdmap->get_primary_shard(pgid, out);
+}
+
 class AgentTimeoutCB : public Context {
   PGRef pg;
 public:
@@ -2185,6 +2354,8 @@ bool OSD::asok_command(string admin_command, cmdmap_t& cmdmap, string format,
     f->close_section();
   } else if (admin_command == "dump_objectstore_kv_stats") {
     store->get_db_statistics(f);
+  } else if (admin_command == "dump_objectstore_alloc_stats") {
+    store->dump_allocator_stats(f);
   } else if (admin_command == "dump_scrubs") {
     service.dumps_scrub(f);
   } else if (admin_command == "calc_objectstore_db_histogram") {
@@ -2555,6 +2726,7 @@ int OSD::init()
   service.init();
   service.publish_map(osdmap);
   service.publish_superblock(superblock);
+  service.update_pg_mapping(OSDMapRef(), osdmap);
   service.max_oldest_map = superblock.oldest_map;
 
   osd_lock.Unlock();
@@ -2720,6 +2892,12 @@ void OSD::final_init()
 				     "print statistics of kvdb which used by bluestore");
   assert(r == 0);
 
+  r = admin_socket->register_command("dump_objectstore_alloc_stats",
+				     "dump_objectstore_alloc_stats",
+				     asok_hook,
+				     "print free space and fragmentation of the objectstore allocator");
+  assert(r == 0);
+
   r = admin_socket->register_command("dump_scrubs",
 				     "dump_scrubs",
 				     asok_hook,
@@ -3095,6 +3273,29 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_admit_lockfree, "op_wq_admit_lockfree",
+    "Ops handed to their shard through the lock-free admission ring");
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_admit_full, "op_wq_admit_full",
+    "Ops that found the shard admission ring full");
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_lock_contended, "op_wq_lock_contended",
+    "Enqueues that had to wait for the shard ordering lock");
+  osd_plb.add_u64_avg(
+    l_osd_op_wq_drain_batch, "op_wq_drain_batch",
+    "Ops moved from the admission ring per drain");
+  osd_plb.add_time_avg(
+    l_osd_op_wq_admit_lat, "op_wq_admit_latency",
+    "Time from op receipt until it reached the shard priority queue "
+    "through the admission ring");
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_inline, "op_wq_inline",
+    "Ops run to completion on the messenger thread that received them");
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_inline_remote, "op_wq_inline_remote",
+    "Ops queued because their shard is owned by another core");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -3137,6 +3338,47 @@ void OSD::create_recoverystate_perf()
   rs_perf.add_time_avg(rs_waitupthru_latency, "waitupthru_latency", "Waitupthru recovery state latency");
   rs_perf.add_time_avg(rs_notrecovering_latency, "notrecovering_latency", "Notrecovering recovery state latency");
 
+  // peering phase latency against the length of the pg log, which is
+  // what most of the peering work scales with
+  PerfHistogramCommon::axis_config_d rs_hist_lat_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2, ///< Latency in logarithmic scale
+    0,                               ///< Start at 0
+    100000,                          ///< Quantization unit is 100usec
+    32,                              ///< Enough to cover very slow peering
+  };
+  PerfHistogramCommon::axis_config_d rs_hist_log_axis_config{
+    "PG log entries",
+    PerfHistogramCommon::SCALE_LOG2, ///< Log length in logarithmic scale
+    0,                               ///< Start at 0
+    64,                              ///< Quantization unit is 64 entries
+    16,                              ///< Enough to cover any sane pg log
+  };
+  rs_perf.add_u64_counter_histogram(
+    rs_peering_lat_log_hist, "peering_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of peering latency + pg log entries");
+  rs_perf.add_u64_counter_histogram(
+    rs_getinfo_lat_log_hist, "getinfo_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of getinfo latency + pg log entries");
+  rs_perf.add_u64_counter_histogram(
+    rs_getlog_lat_log_hist, "getlog_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of getlog latency + pg log entries");
+  rs_perf.add_u64_counter_histogram(
+    rs_getmissing_lat_log_hist, "getmissing_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of getmissing latency + pg log entries");
+  rs_perf.add_u64_counter_histogram(
+    rs_waitupthru_lat_log_hist, "waitupthru_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of waitupthru latency + pg log entries");
+  rs_perf.add_u64_counter_histogram(
+    rs_activating_lat_log_hist, "activating_latency_log_entries_histogram",
+    rs_hist_lat_axis_config, rs_hist_log_axis_config,
+    "Histogram of activating latency + pg log entries");
+
   recoverystate_perf = rs_perf.create_perf_counters();
   cct->get_perfcounters_collection()->add(recoverystate_perf);
 }
@@ -3210,6 +3452,7 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("set_heap_property");
   cct->get_admin_socket()->unregister_command("get_heap_property");
   cct->get_admin_socket()->unregister_command("dump_objectstore_kv_stats");
+  cct->get_admin_socket()->unregister_command("dump_objectstore_alloc_stats");
   cct->get_admin_socket()->unregister_command("calc_objectstore_db_histogram");
   cct->get_admin_socket()->unregister_command("flush_store_cache");
   cct->get_admin_socket()->unregister_command("dump_pgstate_history");
@@ -3235,6 +3478,7 @@ int OSD::shutdown()
   heartbeat_lock.Unlock();
   heartbeat_thread.join();
 
+  service.shutdown_pg_mapping();
   peering_tp.drain();
   peering_wq.clear();
   peering_tp.stop();
@@ -3786,6 +4030,7 @@ void OSD::load_pgs()
   }
 
   bool has_upgraded = false;
+  vector<PG*> loaded;
 
   for (vector<coll_t>::iterator it = ls.begin();
        it != ls.end();
@@ -3893,12 +4138,16 @@ void OSD::load_pgs()
       store->apply_transaction(pg->osr.get(), std::move(t));
     }
     pg->unlock();
+    loaded.push_back(pg);
   }
   {
     RWLock::RLocker l(pg_map_lock);
     dout(0) << "load_pgs opened " << pg_map.size() << " pgs" << dendl;
   }
 
+  if (cct->_conf->osd_pg_log_index_on_load)
+    index_pg_logs(loaded);
+
   // clean up old infos object?
   if (has_upgraded && store->exists(coll_t::meta(), OSD::make_infos_oid())) {
     dout(1) << __func__ << " removing legacy infos object" << dendl;
@@ -3915,6 +4164,62 @@ void OSD::load_pgs()
   build_past_intervals_parallel();
 }
 
+/*
+ * The pg log indices are normally built lazily, by whichever op shard
+ * first looks something up in a pg's log.  When asked to, build them all
+ * here instead, on a short-lived pool with a thread per op shard, so that
+ * the first round of peering does not pay for it.  We run before the
+ * OSD's own thread pools are started.
+ */
+void OSD::index_pg_logs(const vector<PG*>& pgs)
+{
+  struct IndexWQ : public ThreadPool::WorkQueue<PG> {
+    std::deque<PG*> q;
+
+    explicit IndexWQ(ThreadPool *tp)
+      : ThreadPool::WorkQueue<PG>("OSD::IndexWQ", 0, 0, tp) {}
+
+    bool _enqueue(PG *pg) override {
+      q.push_back(pg);
+      return true;
+    }
+    void _dequeue(PG *pg) override {
+      ceph_abort();
+    }
+    PG *_dequeue() override {
+      if (q.empty())
+	return nullptr;
+      PG *pg = q.front();
+      q.pop_front();
+      return pg;
+    }
+    void _process(PG *pg, ThreadPool::TPHandle &handle) override {
+      pg->lock();
+      pg->pg_log.index();
+      pg->unlock();
+    }
+    bool _empty() override {
+      return q.empty();
+    }
+    void _clear() override {
+      assert(q.empty());
+    }
+  };
+
+  unsigned num_threads = get_num_op_shards();
+  utime_t start = ceph_clock_now();
+  ThreadPool tp(cct, "OSD::index_tp", "tp_osd_index", num_threads);
+  IndexWQ wq(&tp);
+  for (auto pg : pgs)
+    wq.queue(pg);
+  tp.start();
+  wq.drain();
+  tp.stop();
+  dout(0) << __func__ << " indexed " << pgs.size() << " pg logs with "
+	  << num_threads << " threads in " << (ceph_clock_now() - start)
+	  << dendl;
+}
+
 
 /*
  * build past_intervals efficiently on old, degraded, and buried
@@ -6715,7 +7020,7 @@ void OSD::dispatch_session_waiting(Session *session, OSDMapRef osdmap)
     if (m->get_type() == CEPH_MSG_OSD_OP) {
       pg_t actual_pgid = osdmap->raw_pg_to_pg(
 	static_cast<const MOSDOp*>(m)->get_pg());
-      if (!osdmap->get_primary_shard(actual_pgid, &pgid)) {
+      if (!service.get_primary_shard(osdmap, actual_pgid, &pgid)) {
 	continue;
       }
     } else {
@@ -6759,11 +7064,12 @@ void OSD::ms_fast_dispatch(Message *m)
 
   if (m->get_connection()->has_features(CEPH_FEATUREMASK_RESEND_ON_SPLIT) ||
       m->get_type() != CEPH_MSG_OSD_OP) {
-    // queue it directly
+    // queue it directly (or run it here, if this core owns its shard)
     enqueue_op(
       static_cast<MOSDFastDispatchOp*>(m)->get_spg(),
       op,
-      static_cast<MOSDFastDispatchOp*>(m)->get_map_epoch());
+      static_cast<MOSDFastDispatchOp*>(m)->get_map_epoch(),
+      cct->_conf->osd_op_run_to_completion && op_may_run_inline(m));
   } else {
     // legacy client, and this is an MOSDOp (the *only* fast dispatch
     // message that didn't have an explicit spg_t); we need to map
@@ -7461,10 +7767,19 @@ void OSD::handle_osd_map(MOSDMap *m)
 
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
-        bool got = get_map_bl(e - 1, obl);
-        assert(got);
-	o->decode(obl);
+	// start from the previous epoch in the cache, if we can, rather
+	// than decoding it again; the unchanged sections stay shared.
+	OSDMapRef prev;
+	if (cct->_conf->osd_map_dedup)
+	  prev = service.try_get_map(e - 1);
+	if (prev) {
+	  o->shallow_copy_from(*prev);
+	} else {
+	  bufferlist obl;
+	  bool got = get_map_bl(e - 1, obl);
+	  assert(got);
+	  o->decode(obl);
+	}
       }
 
       OSDMap::Incremental inc;
@@ -7620,6 +7935,7 @@ void OSD::_committed_osd_maps(epoch_t first, epoch_t last, MOSDMap *m)
       outstanding_pg_stats.clear();
     }
 
+    service.update_pg_mapping(osdmap, newmap);
     osdmap = newmap;
     epoch_t up_epoch;
     epoch_t boot_epoch;
@@ -7919,8 +8235,8 @@ bool OSD::advance_pg(
 
     vector<int> newup, newacting;
     int up_primary, acting_primary;
-    nextmap->pg_to_up_acting_osds(
-      pg->info.pgid.pgid,
+    service.pg_to_up_acting_osds(
+      nextmap, pg->info.pgid.pgid,
       &newup, &up_primary,
       &newacting, &acting_primary);
     pg->handle_advance_map(
@@ -9188,7 +9504,21 @@ bool OSD::op_is_discardable(const MOSDOp *op)
   return false;
 }
 
-void OSD::enqueue_op(spg_t pg, OpRequestRef& op, epoch_t epoch)
+bool OSD::op_may_run_inline(const Message *m)
+{
+  // only client reads: anything that writes queues a transaction, and the
+  // objectstore may block the submitter on its throttles, which would
+  // stall every connection served by this messenger thread.  replica ops,
+  // pushes and the like all write.
+  if (m->get_type() != CEPH_MSG_OSD_OP)
+    return false;
+  const MOSDOp *op = static_cast<const MOSDOp*>(m);
+  return op->has_flag(CEPH_OSD_FLAG_READ) &&
+    !op->has_flag(CEPH_OSD_FLAG_WRITE);
+}
+
+void OSD::enqueue_op(spg_t pg, OpRequestRef& op, epoch_t epoch,
+		     bool may_run_inline)
 {
   utime_t latency = ceph_clock_now() - op->get_req()->get_recv_stamp();
   dout(15) << "enqueue_op " << op << " prio " << op->get_req()->get_priority()
@@ -9201,7 +9531,10 @@ void OSD::enqueue_op(spg_t pg, OpRequestRef& op, epoch_t epoch)
   op->osd_trace.keyval("cost", op->get_req()->get_cost());
   op->mark_queued_for_pg();
   logger->tinc(l_osd_op_before_queue_op_lat, latency);
-  op_shardedwq.queue(make_pair(pg, PGQueueable(op, epoch)));
+  auto item = make_pair(pg, PGQueueable(op, epoch));
+  if (may_run_inline && op_shardedwq.try_run_inline(item))
+    return;
+  op_shardedwq.queue(std::move(item));
 }
 
 
@@ -9832,6 +10165,46 @@ void OSD::ShardedOpWQ::clear_pg_slots()
   }
 }
 
+OSD::ShardedOpWQ::~ShardedOpWQ()
+{
+  while (!shard_list.empty()) {
+    if (shard_list.back()->inline_hb)
+      osd->cct->get_heartbeat_map()->remove_worker(
+	shard_list.back()->inline_hb);
+    delete shard_list.back();
+    shard_list.pop_back();
+  }
+}
+
+void OSD::ShardedOpWQ::_init_shard_cores()
+{
+  CephContext *cct = osd->cct;
+  vector<string> corestrs;
+  get_str_vec(cct->_conf->osd_op_shard_cores, corestrs);
+  vector<int> cores;
+  for (auto& corestr : corestrs) {
+    string err;
+    int core = strict_strtol(corestr.c_str(), 10, &err);
+    if (err.empty() && core >= 0)
+      cores.push_back(core);
+    else
+      lderr(cct) << __func__ << " failed to parse " << corestr << " in "
+		 << cct->_conf->osd_op_shard_cores << dendl;
+  }
+  if (cores.empty())
+    return;
+  for (uint32_t i = 0; i < num_shards; ++i) {
+    ShardData *sdata = shard_list[i];
+    sdata->cpu = cores[i % cores.size()];
+    if (cct->_conf->osd_op_run_to_completion) {
+      char name[48];
+      snprintf(name, sizeof(name), "OSD::ShardedOpWQ::inline.%u", i);
+      sdata->inline_hb = cct->get_heartbeat_map()->add_worker(
+	name, pthread_self());
+    }
+  }
+}
+
 #undef dout_prefix
 #define dout_prefix *_dout << "osd." << osd->whoami << " op_wq(" << shard_index << ") "
 
@@ -9843,6 +10216,8 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->sdata_op_ordering_lock.Lock();
+  if (sdata->admission)
+    _drain_admission(sdata);
   if (sdata->pqueue->empty()) {
     dout(20) << __func__ << " empty q, waiting" << dendl;
     // optimistically sleep a moment; maybe another work item will come along.
@@ -9850,10 +10225,19 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       osd->cct->_conf->threadpool_default_timeout, 0);
     sdata->sdata_lock.Lock();
     sdata->sdata_op_ordering_lock.Unlock();
-    sdata->sdata_cond.WaitInterval(sdata->sdata_lock,
-      utime_t(osd->cct->_conf->threadpool_empty_queue_max_wait, 0));
+    ++sdata->num_waiters;
+    // pairs with the fence in _enqueue: either it sees us waiting, or we
+    // see what it pushed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!sdata->admission || sdata->admission->empty()) {
+      sdata->sdata_cond.WaitInterval(sdata->sdata_lock,
+	utime_t(osd->cct->_conf->threadpool_empty_queue_max_wait, 0));
+    }
+    --sdata->num_waiters;
     sdata->sdata_lock.Unlock();
     sdata->sdata_op_ordering_lock.Lock();
+    if (sdata->admission)
+      _drain_admission(sdata);
     if (sdata->pqueue->empty()) {
       sdata->sdata_op_ordering_lock.Unlock();
       return;
@@ -10017,6 +10401,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   ThreadPool::TPHandle tp_handle(osd->cct, hb, timeout_interval,
 				 suicide_interval);
+  ++sdata->num_ops;
   qi->run(osd, pg, tp_handle);
 
   {
@@ -10033,24 +10418,109 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   pg->unlock();
 }
 
+void OSD::ShardedOpWQ::_drain_admission(ShardData *sdata)
+{
+  assert(sdata->sdata_op_ordering_lock.is_locked_by_me());
+  utime_t now;
+  size_t n = sdata->admission->drain(
+    [&](pair<spg_t, PGQueueable>&& item) {
+      if (now.is_zero())
+	now = ceph_clock_now();
+      osd->logger->tinc(l_osd_op_wq_admit_lat,
+			now - item.second.get_start_time());
+      sdata->_enqueue(std::move(item), osd->op_prio_cutoff);
+    });
+  if (n)
+    osd->logger->inc(l_osd_op_wq_drain_batch, n);
+}
+
+bool OSD::ShardedOpWQ::try_run_inline(pair<spg_t, PGQueueable>& item)
+{
+  uint32_t shard_index = item.first.hash_to_shard(shard_list.size());
+  ShardData *sdata = shard_list[shard_index];
+  if (!sdata->inline_hb)
+    return false;
+  if (sched_getcpu() != sdata->cpu) {
+    osd->logger->inc(l_osd_op_wq_inline_remote);
+    return false;
+  }
+  bool expected = false;
+  if (!sdata->inline_busy.compare_exchange_strong(expected, true))
+    return false;
+
+  // only take the op if nothing could be ahead of it: the shard has
+  // nothing queued, and the pg is cached, idle and lockable right now.
+  // holding the ordering lock while we try the pg lock keeps _process
+  // from slipping an older op for this pg in between.
+  PGRef pg;
+  sdata->sdata_op_ordering_lock.Lock();
+  if (sdata->admission)
+    _drain_admission(sdata);
+  if (sdata->pqueue->empty() && !osd->is_stopping()) {
+    auto p = sdata->pg_slots.find(item.first);
+    if (p != sdata->pg_slots.end() &&
+	p->second.pg &&
+	!p->second.waiting_for_pg &&
+	p->second.to_process.empty() &&
+	p->second.num_running == 0 &&
+	p->second.pg->try_lock()) {
+      pg = p->second.pg;
+    }
+  }
+  sdata->sdata_op_ordering_lock.Unlock();
+  if (!pg) {
+    sdata->inline_busy = false;
+    return false;
+  }
+
+  dout(20) << __func__ << " " << item.first << " item " << item.second
+	   << " pg " << pg << " on cpu " << sdata->cpu << dendl;
+  ThreadPool::TPHandle tp_handle(osd->cct, sdata->inline_hb,
+				 timeout_interval, suicide_interval);
+  tp_handle.reset_tp_timeout();
+  ++sdata->num_ops;
+  ++sdata->num_inline_ops;
+  osd->logger->inc(l_osd_op_wq_inline);
+  item.second.run(osd, pg, tp_handle);
+  pg->unlock();
+  osd->cct->get_heartbeat_map()->clear_timeout(sdata->inline_hb);
+  sdata->inline_busy = false;
+  return true;
+}
+
 void OSD::ShardedOpWQ::_enqueue(pair<spg_t, PGQueueable> item) {
   uint32_t shard_index =
     item.first.hash_to_shard(shard_list.size());
 
   ShardData* sdata = shard_list[shard_index];
   assert (NULL != sdata);
-  unsigned priority = item.second.get_priority();
-  unsigned cost = item.second.get_cost();
-  sdata->sdata_op_ordering_lock.Lock();
-
   dout(20) << __func__ << " " << item.first << " " << item.second << dendl;
-  if (priority >= osd->op_prio_cutoff)
-    sdata->pqueue->enqueue_strict(
-      item.second.get_owner(), priority, item);
-  else
-    sdata->pqueue->enqueue(
-      item.second.get_owner(),
-      priority, cost, item);
+
+  if (sdata->admission) {
+    if (sdata->admission->push(std::move(item))) {
+      osd->logger->inc(l_osd_op_wq_admit_lockfree);
+      // pairs with the fence in _process
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sdata->num_waiters.load()) {
+	sdata->sdata_lock.Lock();
+	sdata->sdata_cond.SignalOne();
+	sdata->sdata_lock.Unlock();
+      }
+      return;
+    }
+    // full; fall back to the locked path below
+    osd->logger->inc(l_osd_op_wq_admit_full);
+  }
+
+  if (!sdata->sdata_op_ordering_lock.TryLock()) {
+    osd->logger->inc(l_osd_op_wq_lock_contended);
+    sdata->sdata_op_ordering_lock.Lock();
+  }
+  if (sdata->admission) {
+    // whatever is still in the ring was queued before us
+    _drain_admission(sdata);
+  }
+  sdata->_enqueue(item, osd->op_prio_cutoff);
   sdata->sdata_op_ordering_lock.Unlock();
 
   sdata->sdata_lock.Lock();
@@ -31,6 +31,7 @@
 
 #include "os/ObjectStore.h"
 #include "OSDCap.h" 
+#include "OSDMapMapping.h"
  
 #include "auth/KeyRing.h"
 #include "osd/ClassHandler.h"
@@ -55,6 +56,7 @@ using namespace std;
 #include "common/sharedptr_registry.hpp"
 #include "common/WeightedPriorityQueue.h"
 #include "common/PrioritizedQueue.h"
+#include "common/MPSCRing.h"
 #include "osd/mClockOpClassQueue.h"
 #include "osd/mClockClientQueue.h"
 #include "messages/MOSDOp.h"
@@ -177,6 +179,14 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_op_wq_admit_lockfree,
+  l_osd_op_wq_admit_full,
+  l_osd_op_wq_lock_contended,
+  l_osd_op_wq_drain_batch,
+  l_osd_op_wq_admit_lat,
+  l_osd_op_wq_inline,
+  l_osd_op_wq_inline_remote,
+
   l_osd_last,
 };
 
@@ -214,6 +224,12 @@ enum {
   rs_getmissing_latency,
   rs_waitupthru_latency,
   rs_notrecovering_latency,
+  rs_peering_lat_log_hist,
+  rs_getinfo_lat_log_hist,
+  rs_getlog_lat_log_hist,
+  rs_getmissing_lat_log_hist,
+  rs_waitupthru_lat_log_hist,
+  rs_activating_lat_log_hist,
   rs_last,
 };
 
@@ -479,6 +495,38 @@ public:
   }
 
   void activate_map();
+
+private:
+  /// every pg's up/acting sets for the newest map we have consumed
+  RWLock pg_mapping_lock;
+  std::unique_ptr<OSDMapMapping> pg_mapping;
+
+  /// full rebuilds run on the peering tp, outside osd_lock
+  ParallelPGMapper pg_mapper;
+  Mutex pg_mapping_job_lock;  ///< protects the rest; before pg_mapping_lock
+  std::shared_ptr<ParallelPGMapper::Job> pg_mapping_job;
+  std::unique_ptr<OSDMapMapping> pg_mapping_next;  ///< built by pg_mapping_job
+  OSDMapRef pg_mapping_job_map;  ///< the map pg_mapping_next is built for
+  OSDMapRef pg_mapping_want;     ///< newest map passed to update_pg_mapping()
+
+  std::shared_ptr<ParallelPGMapper::Job> _start_pg_mapping_job(
+    const OSDMapRef& map);
+  void _queue_pg_mapping_job(std::shared_ptr<ParallelPGMapper::Job> job);
+  void pg_mapping_job_finished(ParallelPGMapper::Job *job, int r);
+  friend struct C_PGMappingBuilt;
+
+public:
+  /// bring pg_mapping from oldmap (null if none) to newmap
+  void update_pg_mapping(const OSDMapRef& oldmap, const OSDMapRef& newmap);
+  /// cancel any rebuild in flight; before the peering tp stops
+  void shutdown_pg_mapping();
+  /// osdmap->pg_to_up_acting_osds(), from pg_mapping if it matches osdmap
+  void pg_to_up_acting_osds(const OSDMapRef& osdmap, pg_t pgid,
+			    vector<int> *up, int *up_primary,
+			    vector<int> *acting, int *acting_primary);
+  /// osdmap->get_primary_shard(), from pg_mapping if it matches osdmap
+  bool get_primary_shard(const OSDMapRef& osdmap, pg_t pgid, spg_t *out);
+
   /// map epochs reserved below
   map<epoch_t, unsigned> map_reservations;
 
@@ -1608,6 +1656,11 @@ private:
    *
    * Multiple worker threads can operate on each shard.
    *
+   * If osd_op_shard_admission_ring_size is set, fast dispatch pushes into
+   * the shard's admission ring instead, and _process moves whatever is in
+   * the ring to the pqueue back (in order) each time it takes the
+   * ordering lock.  Everything else still goes through the pqueue.
+   *
    * Under normal circumstances, num_running == to_proces.size().  There are
    * two times when that is not true: (1) when waiting_for_pg == true and
    * to_process is accumulating requests that are waiting for the pg to be
@@ -1649,6 +1702,38 @@ private:
       /// priority queue
       std::unique_ptr<OpQueue< pair<spg_t, PGQueueable>, entity_inst_t>> pqueue;
 
+      /// lock-free admission path from fast dispatch [optional]; drained
+      /// into pqueue under sdata_op_ordering_lock
+      std::unique_ptr<MPSCRing<pair<spg_t, PGQueueable>>> admission;
+
+      /// _process threads sleeping (or about to) on sdata_cond; lets
+      /// lock-free producers skip sdata_lock when nobody needs waking
+      std::atomic<unsigned> num_waiters = {0};
+
+      /// core this shard's threads are pinned to, or -1
+      int cpu = -1;
+
+      /// set while a messenger thread on our core runs one of our ops
+      /// (osd_op_run_to_completion); inline_hb covers that thread meanwhile
+      std::atomic<bool> inline_busy = {false};
+      heartbeat_handle_d *inline_hb = nullptr;
+
+      /// ops run for this shard, and how many of those ran inline
+      std::atomic<uint64_t> num_ops = {0};
+      std::atomic<uint64_t> num_inline_ops = {0};
+
+      void _enqueue(pair<spg_t, PGQueueable> item, unsigned cutoff) {
+	unsigned priority = item.second.get_priority();
+	unsigned cost = item.second.get_cost();
+	if (priority >= cutoff)
+	  pqueue->enqueue_strict(
+	    item.second.get_owner(), priority, item);
+	else
+	  pqueue->enqueue(
+	    item.second.get_owner(),
+	    priority, cost, item);
+      }
+
       void _enqueue_front(pair<spg_t, PGQueueable> item, unsigned cutoff) {
 	unsigned priority = item.second.get_priority();
 	unsigned cost = item.second.get_cost();
@@ -1665,10 +1750,14 @@ private:
       ShardData(
 	string lock_name, string ordering_lock,
 	uint64_t max_tok_per_prio, uint64_t min_cost, CephContext *cct,
-	io_queue opqueue)
+	io_queue opqueue, size_t admission_ring_size)
 	: sdata_lock(lock_name.c_str(), false, true, false, cct),
 	  sdata_op_ordering_lock(ordering_lock.c_str(), false, true,
 				 false, cct) {
+	if (admission_ring_size) {
+	  admission.reset(
+	    new MPSCRing<pair<spg_t, PGQueueable>>(admission_ring_size));
+	}
 	if (opqueue == io_queue::weightedpriority) {
 	  pqueue = std::unique_ptr
 	    <WeightedPriorityQueue<pair<spg_t,PGQueueable>,entity_inst_t>>(
@@ -1711,16 +1800,24 @@ private:
 	ShardData* one_shard = new ShardData(
 	  lock_name, order_lock,
 	  osd->cct->_conf->osd_op_pq_max_tokens_per_priority, 
-	  osd->cct->_conf->osd_op_pq_min_cost, osd->cct, osd->op_queue);
+	  osd->cct->_conf->osd_op_pq_min_cost, osd->cct, osd->op_queue,
+	  osd->cct->_conf->osd_op_shard_admission_ring_size);
 	shard_list.push_back(one_shard);
       }
+      _init_shard_cores();
     }
-    ~ShardedOpWQ() override {
-      while (!shard_list.empty()) {
-	delete shard_list.back();
-	shard_list.pop_back();
-      }
-    }
+    ~ShardedOpWQ() override;
+
+    /// move everything in the admission ring to the pqueue back
+    void _drain_admission(ShardData *sdata);
+
+    /// assign osd_op_shard_cores to shards
+    void _init_shard_cores();
+
+    /// run item on the calling thread if it is on the core that owns the
+    /// item's shard and nothing else is queued or running for that shard.
+    /// returns false (item untouched) if it has to be queued instead.
+    bool try_run_inline(pair<spg_t, PGQueueable>& item);
 
     /// wake any pg waiters after a PG is created/instantiated
     void wake_pg_waiters(spg_t pgid);
@@ -1762,6 +1859,11 @@ private:
 	sdata->sdata_op_ordering_lock.Lock();
 	f->open_object_section(lock_name);
 	sdata->pqueue->dump(f);
+	if (sdata->admission)
+	  f->dump_unsigned("admission_ring", sdata->admission->size());
+	f->dump_int("cpu", sdata->cpu);
+	f->dump_unsigned("ops", sdata->num_ops);
+	f->dump_unsigned("inline_ops", sdata->num_inline_ops);
 	f->close_section();
 	sdata->sdata_op_ordering_lock.Unlock();
       }
@@ -1800,12 +1902,18 @@ private:
       ShardData* sdata = shard_list[shard_index];
       assert(NULL != sdata);
       Mutex::Locker l(sdata->sdata_op_ordering_lock);
-      return sdata->pqueue->empty();
+      return sdata->pqueue->empty() &&
+	(!sdata->admission || sdata->admission->empty());
+    }
+
+    int get_thread_cpu(uint32_t thread_index) override {
+      return shard_list[thread_index % num_shards]->cpu;
     }
   } op_shardedwq;
 
 
-  void enqueue_op(spg_t pg, OpRequestRef& op, epoch_t epoch);
+  void enqueue_op(spg_t pg, OpRequestRef& op, epoch_t epoch,
+		  bool may_run_inline = false);
   void dequeue_op(
     PGRef pg, OpRequestRef op,
     ThreadPool::TPHandle &handle);
@@ -1980,6 +2088,7 @@ protected:
     PG::CephPeeringEvtRef evt);
   
   void load_pgs();
+  void index_pg_logs(const vector<PG*>& pgs);
   void build_past_intervals_parallel();
 
   /// build initial pg history and intervals on create
@@ -2411,6 +2520,8 @@ public:
 
   /// check if we can throw out op from a disconnected client
   static bool op_is_discardable(const MOSDOp *m);
+  /// check if op can run on the messenger thread without ever blocking it
+  static bool op_may_run_inline(const Message *m);
 
 public:
   OSDService service;
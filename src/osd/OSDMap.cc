@@ -1103,6 +1103,9 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
+  _unshare(osd_addrs);
+  _unshare(osd_uuid);
+  _unshare(osd_primary_affinity);
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_back_addr.resize(m);
@@ -1468,26 +1471,31 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
     n->osd_addrs = o->osd_addrs;
   }
 
-  // does crush match?
-  bufferlist oc, nc;
-  ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  // does crush match?  (maps built with shallow_copy_from may already
+  // share it, and encoding two crush maps is not cheap)
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (o->pg_temp != n->pg_temp && *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (o->primary_temp != n->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (o->osd_uuid != n->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
 }
@@ -1665,6 +1673,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
+      _unshare(osd_uuid);
+      _unshare(osd_addrs);
       (*osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
       osd_xinfo[osd] = osd_xinfo_t();
@@ -1679,6 +1689,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     }
   }
 
+  if (!inc.new_up_client.empty() || !inc.new_up_cluster.empty())
+    _unshare(osd_addrs);
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_addrs->client_addr[client.first].reset(new entity_addr_t(client.second));
@@ -1716,10 +1728,14 @@ int OSDMap::apply_incremental(const Incremental &inc)
     osd_xinfo[xinfo.first] = xinfo.second;
 
   // uuid
+  if (!inc.new_uuid.empty())
+    _unshare(osd_uuid);
   for (const auto &uuid : inc.new_uuid)
     (*osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    _unshare(pg_temp);
   for (const auto &pg : inc.new_pg_temp) {
     if (pg.second.empty())
       pg_temp->erase(pg.first);
@@ -1731,6 +1747,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     pg_temp->rebuild();
   }
 
+  if (!inc.new_primary_temp.empty())
+    _unshare(primary_temp);
   for (const auto &pg : inc.new_primary_temp) {
     if (pg.second == -1)
       primary_temp->erase(pg.first);
@@ -2100,11 +2118,14 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
-  bool raw_pg_to_pg) const
+  bool raw_pg_to_pg,
+  vector<int> *raw_out) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool ||
       (!raw_pg_to_pg && pg.ps() >= pool->get_pg_num())) {
+    if (raw_out)
+      raw_out->clear();
     if (up)
       up->clear();
     if (up_primary)
@@ -2122,8 +2143,10 @@ void OSDMap::_pg_to_up_acting_osds(
   int _acting_primary;
   ps_t pps;
   _get_temp_osds(*pool, pg, &_acting, &_acting_primary);
-  if (_acting.empty() || up || up_primary) {
+  if (_acting.empty() || up || up_primary || raw_out) {
     _pg_to_raw_osds(*pool, pg, &raw, &pps);
+    if (raw_out)
+      *raw_out = raw;
     _apply_upmap(*pool, pg, &raw);
     _raw_to_up_osds(*pool, raw, &_up);
     _up_primary = _pick_primary(_up);
@@ -2444,6 +2467,21 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
   crc_defined = true;
 }
 
+void OSDMap::_unshare_for_decode()
+{
+  // decode overwrites these wholesale, so fresh empty ones will do
+  if (!crush.unique())
+    crush = std::make_shared<CrushWrapper>();
+  if (!pg_temp.unique())
+    pg_temp = std::make_shared<PGTempMap>();
+  if (!primary_temp.unique())
+    primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
+  if (!osd_uuid.unique())
+    osd_uuid = std::make_shared<mempool::osdmap::vector<uuid_d>>();
+  if (!osd_addrs.unique())
+    osd_addrs = std::make_shared<addrs_s>();
+}
+
 void OSDMap::decode(bufferlist& bl)
 {
   auto p = bl.begin();
@@ -2583,6 +2621,8 @@ void OSDMap::decode(bufferlist::iterator& bl)
   size_t tail_offset = 0;
   bufferlist crc_front, crc_tail;
 
+  _unshare_for_decode();
+
   DECODE_START_LEGACY_COMPAT_LEN(8, 7, 7, bl); // wrapper
   if (struct_v < 7) {
     int struct_v_size = sizeof(struct_v);
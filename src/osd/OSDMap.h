@@ -557,6 +557,15 @@ private:
 
   void _calc_up_osd_features();
 
+  /// take a private copy of a section that is still shared with
+  /// another epoch before changing it (see shallow_copy_from)
+  template <typename T>
+  static void _unshare(ceph::shared_ptr<T>& p) {
+    if (p && !p.unique())
+      p.reset(new T(*p));
+  }
+  void _unshare_for_decode();
+
  public:
   bool have_crc() const { return crc_defined; }
   uint32_t get_crc() const { return crc; }
@@ -566,6 +575,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -607,6 +617,17 @@ public:
     // allocate a new CrushWrapper, though.
   }
 
+  /**
+   * Copy o, sharing its crush map, pg_temp, primary_temp, uuids, addrs
+   * and primary affinity rather than duplicating them.  apply_incremental()
+   * and decode() copy a shared section before changing it, so o is never
+   * affected; the other setters do not, so use deepish_copy_from() for a
+   * map you mean to edit by hand.
+   */
+  void shallow_copy_from(const OSDMap& o) {
+    *this = o;
+  }
+
   // map info
   const uuid_d& get_fsid() const { return fsid; }
   void set_fsid(uuid_d& f) { fsid = f; }
@@ -720,6 +741,8 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
+    else
+      _unshare(osd_primary_affinity);
     (*osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
@@ -1090,7 +1113,8 @@ private:
    */
   void _pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_primary,
                              vector<int> *acting, int *acting_primary,
-			     bool raw_pg_to_pg = true) const;
+			     bool raw_pg_to_pg = true,
+			     vector<int> *raw = nullptr) const;
 
 public:
   /***
@@ -1124,6 +1148,17 @@ public:
                             vector<int> *acting, int *acting_primary) const {
     _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary);
   }
+  /**
+   * pg_to_up_acting_osds(), also returning the raw CRUSH output (before
+   * any pg_upmap) that up was derived from.  Used to tell which pgs an
+   * osd state change can move.
+   */
+  void pg_to_raw_up_acting_osds(pg_t pg, vector<int> *raw,
+				vector<int> *up, int *up_primary,
+				vector<int> *acting, int *acting_primary) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary,
+			  true, raw);
+  }
   void pg_to_up_acting_osds(pg_t pg, vector<int>& up, vector<int>& acting) const {
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
@@ -12,9 +12,25 @@ MEMPOOL_DEFINE_OBJECT_FACTORY(OSDMapMapping, osdmapmapping,
 			      osdmap_mapping);
 
 // ensure that we have a PoolMappings for each pool and that
-// the dimensions (pg_num and size) match up.
-void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
+// the dimensions (pg_num and size) and placement inputs match up.
+void OSDMapMapping::_init_mappings(const OSDMap& osdmap,
+				   std::set<int64_t> *recreated)
 {
+  // a pg_temp or pg_upmap may list more osds than the pool size (e.g.,
+  // right after the size is reduced); make room for those.
+  map<int64_t,unsigned> width;
+  for (auto& p : osdmap.get_pools()) {
+    width[p.first] = p.second.get_size();
+  }
+  for (auto& p : *osdmap.pg_temp) {
+    unsigned& w = width[p.first.pool()];
+    w = MAX(w, p.second.size());
+  }
+  for (auto& p : osdmap.pg_upmap) {
+    unsigned& w = width[p.first.pool()];
+    w = MAX(w, p.second.size());
+  }
+
   num_pgs = 0;
   auto q = pools.begin();
   for (auto& p : osdmap.get_pools()) {
@@ -24,9 +40,9 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
       q = pools.erase(q);
     }
     if (q != pools.end() && q->first == p.first) {
-      if (q->second.pg_num != p.second.get_pg_num() ||
-	  q->second.size != p.second.get_size()) {
-	// pg_num changed
+      if (!q->second.same_placement(p.second) ||
+	  q->second.width < width[p.first]) {
+	// pg_num, size or placement changed
 	q = pools.erase(q);
       } else {
 	// keep it
@@ -34,8 +50,10 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 	continue;
       }
     }
-    pools.emplace(p.first, PoolMapping(p.second.get_size(),
-				       p.second.get_pg_num()));
+    pools.emplace(p.first, PoolMapping(p.second, width[p.first]));
+    if (recreated) {
+      recreated->insert(p.first);
+    }
   }
   pools.erase(q, pools.end());
   assert(pools.size() == osdmap.get_pools().size());
@@ -56,6 +74,232 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+uint64_t OSDMapMapping::update(const OSDMap& osdmap,
+			       const OSDMap::Incremental& inc)
+{
+  if (!epoch ||
+      epoch + 1 != inc.epoch ||
+      osdmap.get_epoch() != inc.epoch ||
+      inc.fullmap.length() ||
+      inc.crush.length()) {
+    update(osdmap);
+    return num_pgs;
+  }
+  std::set<pg_t> pgs;
+  for (auto& p : inc.new_pg_temp) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    pgs.insert(p.first);
+  }
+  pgs.insert(inc.old_pg_upmap.begin(), inc.old_pg_upmap.end());
+  pgs.insert(inc.old_pg_upmap_items.begin(), inc.old_pg_upmap_items.end());
+  return _update_changed(osdmap, pgs);
+}
+
+namespace {
+  // call f(key) for every key that is only in a, only in b, or has a
+  // different value in each.  a and b are sorted by key.
+  template <typename M, typename F>
+  void diff_keys(const M& a, const M& b, F&& f)
+  {
+    auto p = a.begin();
+    auto q = b.begin();
+    while (p != a.end() || q != b.end()) {
+      if (q == b.end() || (p != a.end() && p->first < q->first)) {
+	f(p->first);
+	++p;
+      } else if (p == a.end() || q->first < p->first) {
+	f(q->first);
+	++q;
+      } else {
+	if (!(p->second == q->second)) {
+	  f(p->first);
+	}
+	++p;
+	++q;
+      }
+    }
+  }
+
+  bool same_crush(const OSDMap& a, const OSDMap& b)
+  {
+    if (a.crush == b.crush) {
+      return true;
+    }
+    bufferlist abl, bbl;
+    ::encode(*a.crush, abl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    ::encode(*b.crush, bbl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    return abl.contents_equal(bbl);
+  }
+}
+
+uint64_t OSDMapMapping::update(const OSDMap& oldmap, const OSDMap& newmap)
+{
+  if (!epoch ||
+      epoch != oldmap.get_epoch() ||
+      !same_crush(oldmap, newmap)) {
+    update(newmap);
+    return num_pgs;
+  }
+  std::set<pg_t> pgs;
+  auto changed = [&pgs](pg_t pgid) {
+    pgs.insert(pgid);
+  };
+  if (oldmap.pg_temp != newmap.pg_temp) {
+    diff_keys(*oldmap.pg_temp, *newmap.pg_temp, changed);
+  }
+  if (oldmap.primary_temp != newmap.primary_temp) {
+    diff_keys(*oldmap.primary_temp, *newmap.primary_temp, changed);
+  }
+  diff_keys(oldmap.pg_upmap, newmap.pg_upmap, changed);
+  diff_keys(oldmap.pg_upmap_items, newmap.pg_upmap_items, changed);
+  return _update_changed(newmap, pgs);
+}
+
+void OSDMapMapping::_snap_osd_info(const OSDMap& osdmap)
+{
+  osd_info.resize(osdmap.get_max_osd());
+  for (int o = 0; o < osdmap.get_max_osd(); ++o) {
+    osd_info_t& i = osd_info[o];
+    i.exists = osdmap.exists(o);
+    i.up = osdmap.is_up(o);
+    i.weight = osdmap.get_weight(o);
+    i.primary_affinity = osdmap.get_primary_affinity(o);
+  }
+}
+
+// osds that went up or down, or whose weight or primary affinity went
+// down, only move the pgs that crush (or an upmap or pg_temp) already put
+// on them.  one being created, destroyed or weighted up can pull in any
+// pg at all, which we cannot bound.
+bool OSDMapMapping::_find_dirty_osds(const OSDMap& osdmap,
+				     std::vector<bool> *dirty) const
+{
+  dirty->assign(osdmap.get_max_osd(), false);
+  for (int o = 0; o < MAX(osdmap.get_max_osd(), (int)osd_info.size()); ++o) {
+    osd_info_t now;
+    if (o < osdmap.get_max_osd()) {
+      now.exists = osdmap.exists(o);
+      now.up = osdmap.is_up(o);
+      now.weight = osdmap.get_weight(o);
+      now.primary_affinity = osdmap.get_primary_affinity(o);
+    }
+    osd_info_t then;
+    if (o < (int)osd_info.size()) {
+      then = osd_info[o];
+    }
+    if (now.exists != then.exists ||
+	now.weight > then.weight ||
+	(!now.exists && now.weight != then.weight)) {
+      return false;
+    }
+    if (now.up != then.up ||
+	now.weight != then.weight ||
+	now.primary_affinity != then.primary_affinity) {
+      (*dirty)[o] = true;
+    }
+  }
+  return true;
+}
+
+bool OSDMapMapping::can_update_incrementally(const OSDMap& oldmap,
+					     const OSDMap& newmap) const
+{
+  std::vector<bool> dirty_osds;
+  return
+    epoch &&
+    epoch == oldmap.get_epoch() &&
+    same_crush(oldmap, newmap) &&
+    _find_dirty_osds(newmap, &dirty_osds);
+}
+
+// recompute whatever may map differently in osdmap than in the map we
+// were built from.  pgs holds the pgs whose pg_temp, primary_temp or
+// upmap entries changed; pool and osd changes are found by comparing
+// against what we recorded the last time around.
+uint64_t OSDMapMapping::_update_changed(const OSDMap& osdmap,
+					std::set<pg_t>& pgs)
+{
+  std::vector<bool> dirty_osds;
+  if (!_find_dirty_osds(osdmap, &dirty_osds)) {
+    update(osdmap);
+    return num_pgs;
+  }
+  bool any_dirty_osd = std::find(dirty_osds.begin(), dirty_osds.end(),
+				 true) != dirty_osds.end();
+  auto is_dirty = [&dirty_osds](int osd) {
+    return osd >= 0 && osd < (int)dirty_osds.size() && dirty_osds[osd];
+  };
+
+  if (any_dirty_osd) {
+    for (auto& p : *osdmap.pg_temp) {
+      for (auto osd : p.second) {
+	if (is_dirty(osd)) {
+	  pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto& p : osdmap.pg_upmap) {
+      for (auto osd : p.second) {
+	if (is_dirty(osd)) {
+	  pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto& p : osdmap.pg_upmap_items) {
+      for (auto& q : p.second) {
+	if (is_dirty(q.first) || is_dirty(q.second)) {
+	  pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+  }
+
+  std::set<int64_t> recreated;
+  _init_mappings(osdmap, &recreated);
+
+  uint64_t n = 0;
+  for (auto& p : pools) {
+    PoolMapping& pm = p.second;
+    if (recreated.count(p.first)) {
+      _update_range(osdmap, p.first, 0, pm.pg_num);
+      n += pm.pg_num;
+      continue;
+    }
+    auto q = pgs.lower_bound(pg_t(0, p.first));
+    for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+      bool dirty = false;
+      if (q != pgs.end() && q->pool() == (uint64_t)p.first && q->ps() == ps) {
+	dirty = true;
+	++q;
+      } else if (any_dirty_osd) {
+	const int32_t *row = pm.row(ps);
+	const int32_t *raw = pm.row_raw(row);
+	for (int i = 0; i < row[4] && !dirty; ++i) {
+	  dirty = is_dirty(raw[i]);
+	}
+      }
+      if (dirty) {
+	_update_range(osdmap, p.first, ps, ps + 1);
+	++n;
+      }
+    }
+  }
+
+  _finish(osdmap);
+  return n;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -70,10 +314,11 @@ void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
     pg_t pgid(0, p.first);
     for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
       pgid.set_ps(ps);
-      int32_t *row = &p.second.table[p.second.row_size() * ps];
+      const int32_t *row = p.second.row(ps);
+      const int32_t *acting = p.second.row_acting(row);
       for (int i = 0; i < row[2]; ++i) {
-	if (row[4 + i] != CRUSH_ITEM_NONE) {
-	  acting_rmap[row[4 + i]].push_back(pgid);
+	if (acting[i] != CRUSH_ITEM_NONE) {
+	  acting_rmap[acting[i]].push_back(pgid);
 	}
       }
       //for (int i = 0; i < row[3]; ++i) {
@@ -85,7 +330,10 @@ void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 
 void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
-  _build_rmap(osdmap);
+  if (build_rmap) {
+    _build_rmap(osdmap);
+  }
+  _snap_osd_info(osdmap);
   epoch = osdmap.get_epoch();
 }
 
@@ -112,13 +360,12 @@ void OSDMapMapping::_update_range(
   assert(pg_begin <= pg_end);
   assert(pg_end <= i->second.pg_num);
   for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    vector<int> up, acting;
+    vector<int> up, acting, raw;
     int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
+    osdmap.pg_to_raw_up_acting_osds(
       pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+      &raw, &up, &up_primary, &acting, &acting_primary);
+    i->second.set(ps, up, up_primary, acting, acting_primary, raw);
   }
 }
 
@@ -7,12 +7,12 @@
 
 #include <vector>
 #include <map>
+#include <set>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -176,6 +176,16 @@ private:
 
     unsigned size = 0;
     unsigned pg_num = 0;
+    unsigned pg_num_mask = 0;
+    unsigned width = 0;   ///< room per osd set; > size if a pg_temp is longer
+    bool ec = false;
+
+    // the rest of the placement inputs; a pool update that leaves these
+    // alone (snaps, quotas, flags, ...) does not move any pg
+    unsigned pgp_num = 0;
+    int crush_rule = -1;
+    bool hashpspool = false;
+
     mempool::osdmap_mapping::vector<int32_t> table;
 
     size_t row_size() const {
@@ -184,39 +194,64 @@ private:
 	1 + // up_primary
 	1 + // num acting
 	1 + // num up
-	size + // acting
-	size;  // up
+	1 + // num raw
+	width + // acting
+	width + // up
+	width;  // raw (crush output before upmap)
     }
 
-    PoolMapping(int s, int p)
-      : size(s),
-	pg_num(p),
+    PoolMapping(const pg_pool_t& pi, unsigned w)
+      : size(pi.get_size()),
+	pg_num(pi.get_pg_num()),
+	pg_num_mask(pi.get_pg_num_mask()),
+	width(w),
+	ec(pi.is_erasure()),
+	pgp_num(pi.get_pgp_num()),
+	crush_rule(pi.get_crush_rule()),
+	hashpspool(pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL)),
 	table(pg_num * row_size()) {
     }
 
+    bool same_placement(const pg_pool_t& pi) const {
+      return
+	size == pi.get_size() &&
+	pg_num == pi.get_pg_num() &&
+	ec == pi.is_erasure() &&
+	pgp_num == pi.get_pgp_num() &&
+	crush_rule == pi.get_crush_rule() &&
+	hashpspool == pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    }
+
+    const int32_t *row(size_t ps) const {
+      return &table[row_size() * ps];
+    }
+    const int32_t *row_acting(const int32_t *row) const {
+      return row + 5;
+    }
+    const int32_t *row_up(const int32_t *row) const {
+      return row + 5 + width;
+    }
+    const int32_t *row_raw(const int32_t *row) const {
+      return row + 5 + 2 * width;
+    }
+
     void get(size_t ps,
 	     std::vector<int> *up,
 	     int *up_primary,
 	     std::vector<int> *acting,
 	     int *acting_primary) const {
-      const int32_t *row = &table[row_size() * ps];
+      const int32_t *r = row(ps);
       if (acting_primary) {
-	*acting_primary = row[0];
+	*acting_primary = r[0];
       }
       if (up_primary) {
-	*up_primary = row[1];
+	*up_primary = r[1];
       }
       if (acting) {
-	acting->resize(row[2]);
-	for (int i = 0; i < row[2]; ++i) {
-	  (*acting)[i] = row[4 + i];
-	}
+	acting->assign(row_acting(r), row_acting(r) + r[2]);
       }
       if (up) {
-	up->resize(row[3]);
-	for (int i = 0; i < row[3]; ++i) {
-	  (*up)[i] = row[4 + size + i];
-	}
+	up->assign(row_up(r), row_up(r) + r[3]);
       }
     }
 
@@ -224,35 +259,51 @@ private:
 	     const std::vector<int>& up,
 	     int up_primary,
 	     const std::vector<int>& acting,
-	     int acting_primary) {
-      int32_t *row = &table[row_size() * ps];
-      row[0] = acting_primary;
-      row[1] = up_primary;
-      row[2] = acting.size();
-      row[3] = up.size();
-      for (int i = 0; i < row[2]; ++i) {
-	row[4 + i] = acting[i];
-      }
-      for (int i = 0; i < row[3]; ++i) {
-	row[4 + size + i] = up[i];
-      }
+	     int acting_primary,
+	     const std::vector<int>& raw) {
+      assert(up.size() <= width);
+      assert(acting.size() <= width);
+      assert(raw.size() <= width);
+      int32_t *r = &table[row_size() * ps];
+      r[0] = acting_primary;
+      r[1] = up_primary;
+      r[2] = acting.size();
+      r[3] = up.size();
+      r[4] = raw.size();
+      std::copy(acting.begin(), acting.end(), r + 5);
+      std::copy(up.begin(), up.end(), r + 5 + width);
+      std::copy(raw.begin(), raw.end(), r + 5 + 2 * width);
     }
   };
 
+  /// the per-osd inputs to the mapping, as of epoch
+  struct osd_info_t {
+    bool exists = false;
+    bool up = false;
+    uint32_t weight = 0;
+    uint32_t primary_affinity = CEPH_OSD_DEFAULT_PRIMARY_AFFINITY;
+  };
+
   mempool::osdmap_mapping::map<int64_t,PoolMapping> pools;
   mempool::osdmap_mapping::vector<
     mempool::osdmap_mapping::vector<pg_t>> acting_rmap;  // osd -> pg
   //unused: mempool::osdmap_mapping::vector<std::vector<pg_t>> up_rmap;  // osd -> pg
-  epoch_t epoch;
+  mempool::osdmap_mapping::vector<osd_info_t> osd_info;
+  bool build_rmap;
+  epoch_t epoch = 0;
   uint64_t num_pgs = 0;
 
-  void _init_mappings(const OSDMap& osdmap);
+  void _init_mappings(const OSDMap& osdmap,
+		      std::set<int64_t> *recreated = nullptr);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
     unsigned pg_begin, unsigned pg_end);
+  uint64_t _update_changed(const OSDMap& osdmap, std::set<pg_t>& pgs);
+  bool _find_dirty_osds(const OSDMap& osdmap, std::vector<bool> *dirty) const;
 
   void _build_rmap(const OSDMap& osdmap);
+  void _snap_osd_info(const OSDMap& osdmap);
 
   void _start(const OSDMap& osdmap) {
     _init_mappings(osdmap);
@@ -278,6 +329,13 @@ private:
   };
 
 public:
+  /**
+   * @param with_rmap also maintain the osd -> acting pgs reverse map.  It
+   * is about as large as the table itself, and only the mon needs it.
+   */
+  explicit OSDMapMapping(bool with_rmap = true)
+    : build_rmap(with_rmap) {}
+
   void get(pg_t pgid,
 	   std::vector<int> *up,
 	   int *up_primary,
@@ -289,7 +347,52 @@ public:
     p->second.get(pgid.ps(), up, up_primary, acting, acting_primary);
   }
 
+  /**
+   * Look up a raw or actual pgid, as OSDMap::pg_to_up_acting_osds() would
+   * for the map of our epoch.
+   *
+   * @return false if the pool is not in the table
+   */
+  bool try_get(pg_t pgid,
+	       std::vector<int> *up,
+	       int *up_primary,
+	       std::vector<int> *acting,
+	       int *acting_primary) const {
+    auto p = pools.find(pgid.pool());
+    if (p == pools.end() || p->second.pg_num == 0) {
+      return false;
+    }
+    unsigned ps = ceph_stable_mod(pgid.ps(), p->second.pg_num,
+				  p->second.pg_num_mask);
+    p->second.get(ps, up, up_primary, acting, acting_primary);
+    return true;
+  }
+
+  /// table version of OSDMap::get_primary_shard()
+  bool get_primary_shard(pg_t pgid, spg_t *out) const {
+    auto p = pools.find(pgid.pool());
+    if (p == pools.end() || p->second.pg_num == 0) {
+      return false;
+    }
+    if (!p->second.ec) {
+      *out = spg_t(pgid);
+      return true;
+    }
+    unsigned ps = ceph_stable_mod(pgid.ps(), p->second.pg_num,
+				  p->second.pg_num_mask);
+    const int32_t *row = p->second.row(ps);
+    const int32_t *acting = p->second.row_acting(row);
+    for (int i = 0; i < row[2]; ++i) {
+      if (acting[i] == row[0]) {
+	*out = spg_t(pgid, shard_id_t(i));
+	return true;
+      }
+    }
+    return false;
+  }
+
   const mempool::osdmap_mapping::vector<pg_t>& get_osd_acting_pgs(unsigned osd) {
+    assert(build_rmap);
     assert(osd < acting_rmap.size());
     return acting_rmap[osd];
   }
@@ -303,6 +406,28 @@ public:
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
 
+  /**
+   * Bring a table built for epoch inc.epoch - 1 up to map, which is that
+   * map with inc applied.  Only the pools and pgs that inc can have moved
+   * are recomputed; anything we cannot bound (a new crush map, an osd
+   * marked in or created) falls back to a full update.
+   *
+   * @return the number of pgs recomputed
+   */
+  uint64_t update(const OSDMap& map, const OSDMap::Incremental& inc);
+
+  /**
+   * Same, for callers that hold the map the table was built for rather
+   * than the incrementals.  The maps need not be consecutive.
+   *
+   * @return the number of pgs recomputed
+   */
+  uint64_t update(const OSDMap& oldmap, const OSDMap& newmap);
+
+  /// @return true if update(oldmap, newmap) need not recompute every pg
+  bool can_update_incrementally(const OSDMap& oldmap,
+				const OSDMap& newmap) const;
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
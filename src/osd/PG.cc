@@ -364,6 +364,17 @@ void PG::lock(bool no_lockdep) const
   dout(30) << "lock" << dendl;
 }
 
+bool PG::try_lock() const
+{
+  if (!_lock.TryLock())
+    return false;
+  assert(!dirty_info);
+  assert(!dirty_big_info);
+
+  dout(30) << "try_lock" << dendl;
+  return true;
+}
+
 std::string PG::gen_prefix() const
 {
   stringstream out;
@@ -3304,8 +3315,11 @@ void PG::log_weirdness()
 			<< pg_log.get_log().log.begin()->version << ","
 			 << pg_log.get_log().log.rbegin()->version << "]";
   }
-  
-  if (pg_log.get_log().caller_ops.size() > pg_log.get_log().log.size()) {
+
+  // caller_ops is built on first lookup, so there is nothing to check
+  // until then
+  if (pg_log.get_log().is_indexed(PGLOG_INDEXED_CALLER_OPS) &&
+      pg_log.get_log().caller_ops.size() > pg_log.get_log().log.size()) {
     osd->clog->error() << info.pgid
 		      << " caller_ops.size " << pg_log.get_log().caller_ops.size()
 		       << " > log size " << pg_log.get_log().log.size();
@@ -6237,6 +6251,8 @@ void PG::RecoveryState::Peering::exit()
 
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_peering_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_peering_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
 }
 
 
@@ -6627,6 +6643,8 @@ void PG::RecoveryState::Activating::exit()
   PG *pg = context< RecoveryMachine >().pg;
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_activating_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_activating_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
 }
 
 PG::RecoveryState::WaitLocalRecoveryReserved::WaitLocalRecoveryReserved(my_context ctx)
@@ -7526,6 +7544,8 @@ void PG::RecoveryState::GetInfo::exit()
   PG *pg = context< RecoveryMachine >().pg;
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_getinfo_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_getinfo_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
   pg->blocked_by.clear();
   pg->publish_stats_to_osd();
 }
@@ -7661,6 +7681,8 @@ void PG::RecoveryState::GetLog::exit()
   PG *pg = context< RecoveryMachine >().pg;
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_getlog_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_getlog_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
   pg->blocked_by.clear();
   pg->publish_stats_to_osd();
 }
@@ -7972,6 +7994,8 @@ void PG::RecoveryState::GetMissing::exit()
   PG *pg = context< RecoveryMachine >().pg;
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_getmissing_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_getmissing_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
   pg->blocked_by.clear();
   pg->publish_stats_to_osd();
 }
@@ -8018,6 +8042,8 @@ void PG::RecoveryState::WaitUpThru::exit()
   PG *pg = context< RecoveryMachine >().pg;
   utime_t dur = ceph_clock_now() - enter_time;
   pg->osd->recoverystate_perf->tinc(rs_waitupthru_latency, dur);
+  pg->osd->recoverystate_perf->hinc(rs_waitupthru_lat_log_hist, dur.to_nsec(),
+				       pg->pg_log.get_log().log.size());
 }
 
 /*----RecoveryState::RecoveryMachine Methods-----*/
@@ -142,7 +142,7 @@ public:
       indexed_data(0),
       rollback_info_trimmed_to_riter(log.rbegin()) {
       reset_rollback_info_trimmed_to_riter();
-      index();
+      // the indices are built on first use; see logged_object() et al
     }
 
     IndexedLog(const IndexedLog &rhs) :
@@ -237,6 +237,13 @@ public:
       last_requested = 0;
     }
 
+    const ceph::unordered_map<hobject_t,pg_log_entry_t*> &get_objects() const {
+      if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
+         index_objects();
+      }
+      return objects;
+    }
+
     bool logged_object(const hobject_t& oid) const {
       if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
          index_objects();
@@ -362,6 +369,10 @@ public:
       indexed_data |= to_index;
     }
 
+    bool is_indexed(__u16 what = PGLOG_INDEXED_ALL) const {
+      return (indexed_data & what) == what;
+    }
+
     void index_objects() const {
       index(PGLOG_INDEXED_OBJECTS);
     }
@@ -793,8 +804,8 @@ protected:
 		       << dendl;
 
     ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
-    if (objiter != log.objects.end() &&
+      log.get_objects().find(hoid);
+    if (objiter != log.get_objects().end() &&
 	objiter->second->version >= first_divergent_update) {
       /// Case 1)
       ldpp_dout(dpp, 10) << __func__ << ": more recent entry found: "
@@ -1406,10 +1406,10 @@ void ReplicatedBackend::prepare_pull(
 	     << " at version " << pmissing.get_items().find(soid)->second.have
 	     << " rather than at version " << v << dendl;
     v = pmissing.get_items().find(soid)->second.have;
-    assert(get_parent()->get_log().get_log().objects.count(soid) &&
-	   (get_parent()->get_log().get_log().objects.find(soid)->second->op ==
+    assert(get_parent()->get_log().get_log().get_objects().count(soid) &&
+	   (get_parent()->get_log().get_log().get_objects().find(soid)->second->op ==
 	    pg_log_entry_t::LOST_REVERT) &&
-	   (get_parent()->get_log().get_log().objects.find(
+	   (get_parent()->get_log().get_log().get_objects().find(
 	     soid)->second->reverting_to ==
 	    v));
   }
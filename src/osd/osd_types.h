@@ -2024,6 +2024,13 @@ struct pool_stat_t {
     up -= o.up.size();
     acting -= o.acting.size();
   }
+  void add(const pool_stat_t& o) {
+    stats.add(o.stats);
+    log_size += o.log_size;
+    ondisk_log_size += o.ondisk_log_size;
+    up += o.up;
+    acting += o.acting;
+  }
 
   bool is_zero() const {
     return (stats.is_zero() &&
@@ -37,6 +37,7 @@ class ObjectCacher::C_ReadFinish : public Context {
   bool trust_enoent;
   ceph_tid_t tid;
   ZTracer::Trace trace;
+  ceph::mono_time issued;
 
 public:
   bufferlist bl;
@@ -44,11 +45,13 @@ public:
 	       uint64_t l, const ZTracer::Trace &trace) :
     oc(c), poolid(ob->oloc.pool), oid(ob->get_soid()), start(s), length(l),
     set_item(this), trust_enoent(true),
-    tid(t), trace(trace) {
+    tid(t), trace(trace), issued(ceph::mono_clock::now()) {
     ob->reads.push_back(&set_item);
   }
 
   void finish(int r) override {
+    oc->perfcounter->tinc(l_objectcacher_read_miss_lat,
+			  ceph::mono_clock::now() - issued);
     oc->bh_read_finish(poolid, oid, tid, start, length, bl, r, trust_enoent);
     trace.event("finish");
 
@@ -102,6 +105,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left,
   //inherit and if later access, this auto clean.
   right->set_dontneed(left->get_dontneed());
   right->set_nocache(left->get_nocache());
+  right->set_frequent(left->get_frequent());
 
   right->last_write_tid = left->last_write_tid;
   right->last_read_tid = left->last_read_tid;
@@ -623,7 +627,8 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name,
     trace_endpoint("ObjectCacher"),
     flush_set_callback(flush_callback),
     flush_set_callback_arg(flush_callback_arg),
-    last_read_tid(0), flusher_stop(false), flusher_thread(this),finisher(cct),
+    last_read_tid(0), adaptive(false), arc_target(0),
+    flusher_stop(false), flusher_thread(this),finisher(cct),
     stat_clean(0), stat_zero(0), stat_dirty(0), stat_rx(0), stat_tx(0),
     stat_missing(0), stat_error(0), stat_dirty_waiting(0), reads_outstanding(0)
 {
@@ -643,6 +648,7 @@ ObjectCacher::~ObjectCacher()
        ++i)
     assert(i->empty());
   assert(bh_lru_rest.lru_get_size() == 0);
+  assert(bh_lru_frequent.lru_get_size() == 0);
   assert(bh_lru_dirty.lru_get_size() == 0);
   assert(ob_lru.lru_get_size() == 0);
   assert(dirty_or_tx_bh.empty());
@@ -677,6 +683,15 @@ void ObjectCacher::perf_start()
 		      "Write data blocked on dirty limit");
   plb.add_time(l_objectcacher_write_time_blocked, "write_time_blocked",
 	       "Time spent blocking a write due to dirty limits");
+  plb.add_u64_counter(l_objectcacher_ghost_hit_recent, "ghost_hit_recent",
+		      "Misses on data recently trimmed as read-once");
+  plb.add_u64_counter(l_objectcacher_ghost_hit_frequent,
+		      "ghost_hit_frequent",
+		      "Misses on data recently trimmed as frequently read");
+  plb.add_u64(l_objectcacher_arc_target, "arc_target",
+	      "Adaptive policy: preferred number of read-once buffers");
+  plb.add_time_avg(l_objectcacher_read_miss_lat, "read_miss_latency",
+		   "Time to fetch data that missed the cache");
 
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
@@ -1174,7 +1189,7 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid,
 	mark_clean(bh);
 	bh->set_journal_tid(0);
 	if (bh->get_nocache())
-	  bh_lru_rest.lru_bottouch(bh);
+	  bh_lru_clean(bh).lru_bottouch(bh);
 	hit.push_back(make_pair(bh->start(), bh));
 	ldout(cct, 10) << "bh_write_commit clean " << *bh << dendl;
       } else {
@@ -1248,6 +1263,87 @@ void ObjectCacher::flush(ZTracer::Trace *trace, loff_t amount)
 }
 
 
+void ObjectCacher::set_adaptive(bool v)
+{
+  if (v == adaptive)
+    return;
+  adaptive = v;
+  if (adaptive)
+    return;
+
+  // fold the frequent list back into the plain lru
+  for (auto& pool : objects) {
+    for (auto& p : pool) {
+      for (auto& q : p.second->data) {
+	BufferHead *bh = q.second;
+	if (!bh->get_frequent())
+	  continue;
+	if (!bh->is_dirty()) {
+	  bh_lru_frequent.lru_remove(bh);
+	  bh->set_frequent(false);
+	  bh_lru_rest.lru_insert_top(bh);
+	} else {
+	  bh->set_frequent(false);
+	}
+      }
+    }
+  }
+  ghost_recent.clear();
+  ghost_frequent.clear();
+  arc_target = 0;
+  perfcounter->set(l_objectcacher_arc_target, arc_target);
+}
+
+// a new missing bh is about to be read: if we trimmed it recently, the
+// list it was trimmed from deserved more room
+void ObjectCacher::bh_lru_adapt(BufferHead *bh)
+{
+  GhostList::key_t k = {bh->ob->oloc.pool, bh->ob->get_soid(), bh->start()};
+  uint64_t recent = ghost_recent.size();
+  uint64_t frequent = ghost_frequent.size();
+  uint64_t cached = bh_lru_rest.lru_get_size() +
+    bh_lru_frequent.lru_get_size();
+  if (ghost_recent.erase(k)) {
+    arc_target = MIN(arc_target + MAX(frequent / recent, 1), cached);
+    perfcounter->inc(l_objectcacher_ghost_hit_recent);
+  } else if (ghost_frequent.erase(k)) {
+    uint64_t delta = MAX(recent / frequent, 1);
+    arc_target = arc_target > delta ? arc_target - delta : 0;
+    perfcounter->inc(l_objectcacher_ghost_hit_frequent);
+  } else {
+    return;
+  }
+  ldout(cct, 20) << "bh_lru_adapt ghost hit " << *bh << " arc_target "
+		 << arc_target << dendl;
+  bh->set_frequent(true);
+  perfcounter->set(l_objectcacher_arc_target, arc_target);
+}
+
+ObjectCacher::BufferHead *ObjectCacher::bh_lru_clean_expire()
+{
+  if (!adaptive)
+    return static_cast<BufferHead*>(bh_lru_rest.lru_expire());
+
+  LRU *first = &bh_lru_frequent, *second = &bh_lru_rest;
+  if (bh_lru_rest.lru_get_size() > arc_target ||
+      bh_lru_frequent.lru_get_size() == 0)
+    std::swap(first, second);
+  BufferHead *bh = static_cast<BufferHead*>(first->lru_expire());
+  if (!bh)
+    bh = static_cast<BufferHead*>(second->lru_expire());
+  if (!bh)
+    return NULL;
+
+  GhostList::key_t k = {bh->ob->oloc.pool, bh->ob->get_soid(), bh->start()};
+  size_t max_ghosts = MAX(bh_lru_rest.lru_get_size() +
+			  bh_lru_frequent.lru_get_size(), 1u);
+  if (bh->get_frequent())
+    ghost_frequent.insert(k, max_ghosts);
+  else
+    ghost_recent.insert(k, max_ghosts);
+  return bh;
+}
+
 void ObjectCacher::trim()
 {
   assert(lock.is_locked());
@@ -1256,7 +1352,7 @@ void ObjectCacher::trim()
 		 << " current " << ob_lru.lru_get_size() << dendl;
 
   while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_size) {
-    BufferHead *bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
+    BufferHead *bh = bh_lru_clean_expire();
     if (!bh)
       break;
 
@@ -1498,7 +1594,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
       for (map<loff_t, BufferHead*>::iterator bh_it = hits.begin();
 	   bh_it != hits.end();  ++bh_it)
 	//bump in lru, so we don't lose it when later read
-	touch_bh(bh_it->second);
+	touch_bh(bh_it->second, external_call);
 
     } else {
       assert(!hits.empty());
@@ -1514,16 +1610,16 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 	bytes_in_cache += bh->length();
 
 	if (bh->get_nocache() && bh->is_clean())
-	  bh_lru_rest.lru_bottouch(bh);
+	  bh_lru_clean(bh).lru_bottouch(bh);
 	else
-	  touch_bh(bh);
+	  touch_bh(bh, external_call);
 	//must be after touch_bh because touch_bh set dontneed false
 	if (dontneed &&
 	    ((loff_t)ex_it->offset <= bh->start() &&
 	     (bh->end() <=(loff_t)(ex_it->offset + ex_it->length)))) {
 	  bh->set_dontneed(true); //if dirty
 	  if (bh->is_clean())
-	    bh_lru_rest.lru_bottouch(bh);
+	    bh_lru_clean(bh).lru_bottouch(bh);
 	}
       }
 
@@ -2599,14 +2695,11 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
   int state = bh->get_state();
   // move between lru lists?
   if (s == BufferHead::STATE_DIRTY && state != BufferHead::STATE_DIRTY) {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_clean(bh).lru_remove(bh);
     bh_lru_dirty.lru_insert_top(bh);
   } else if (s != BufferHead::STATE_DIRTY &&state == BufferHead::STATE_DIRTY) {
     bh_lru_dirty.lru_remove(bh);
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    bh_lru_clean_insert(bh);
   }
 
   if ((s == BufferHead::STATE_TX ||
@@ -2641,10 +2734,9 @@ void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
     bh_lru_dirty.lru_insert_top(bh);
     dirty_or_tx_bh.insert(bh);
   } else {
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    if (adaptive && bh->is_missing())
+      bh_lru_adapt(bh);
+    bh_lru_clean_insert(bh);
   }
 
   if (bh->is_tx()) {
@@ -2663,7 +2755,7 @@ void ObjectCacher::bh_remove(Object *ob, BufferHead *bh)
     bh_lru_dirty.lru_remove(bh);
     dirty_or_tx_bh.erase(bh);
   } else {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_clean(bh).lru_remove(bh);
   }
 
   if (bh->is_tx()) {
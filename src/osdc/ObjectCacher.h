@@ -47,6 +47,12 @@ enum {
 				     // blocking a write due to dirty
 				     // limits
 
+  l_objectcacher_ghost_hit_recent, // misses on extents recently trimmed
+				   // from the recent list
+  l_objectcacher_ghost_hit_frequent, // ... from the frequent list
+  l_objectcacher_arc_target, // preferred length of the recent list
+  l_objectcacher_read_miss_lat, // time to fetch a missing extent
+
   l_objectcacher_last,
 };
 
@@ -119,6 +125,7 @@ class ObjectCacher {
     } ex;
     bool dontneed; //indicate bh don't need by anyone
     bool nocache; //indicate bh don't need by this caller
+    bool frequent; //hit again since cached (adaptive policy)
 
   public:
     Object *ob;
@@ -138,6 +145,7 @@ class ObjectCacher {
       ref(0),
       dontneed(false),
       nocache(false),
+      frequent(false),
       ob(o),
       last_write_tid(0),
       last_read_tid(0),
@@ -204,6 +212,13 @@ class ObjectCacher {
       return nocache;
     }
 
+    void set_frequent(bool v) {
+      frequent = v;
+    }
+    bool get_frequent() const {
+      return frequent;
+    }
+
     inline bool can_merge_journal(BufferHead *bh) const {
       return (get_journal_tid() == bh->get_journal_tid());
     }
@@ -418,8 +433,77 @@ class ObjectCacher {
 
   set<BufferHead*, BufferHead::ptr_lt> dirty_or_tx_bh;
   LRU   bh_lru_dirty, bh_lru_rest;
+  LRU   bh_lru_frequent;  // clean bhs hit again since cached (adaptive)
   LRU   ob_lru;
 
+  /*
+   * Adaptive replacement (ARC) for clean buffers.  Without it every
+   * non-dirty bh lives on bh_lru_rest and trim() expires from its tail.
+   * With it, bh_lru_rest only holds buffers read once, buffers hit again
+   * move to bh_lru_frequent, and trim() evicts from whichever list is
+   * over its share (arc_target bhs for bh_lru_rest).  The ghost lists
+   * remember recently trimmed extents; a miss on one of them means that
+   * list was evicted too eagerly and shifts arc_target toward it.
+   */
+  class GhostList {
+  public:
+    struct key_t {
+      int64_t pool;
+      sobject_t oid;
+      loff_t start;
+      bool operator<(const key_t& o) const {
+	if (pool != o.pool)
+	  return pool < o.pool;
+	if (oid != o.oid)
+	  return oid < o.oid;
+	return start < o.start;
+      }
+    };
+  private:
+    list<key_t> lru;  // most recently trimmed first
+    map<key_t, list<key_t>::iterator> index;
+  public:
+    size_t size() const {
+      return index.size();
+    }
+    void insert(const key_t& k, size_t max) {
+      erase(k);
+      lru.push_front(k);
+      index[k] = lru.begin();
+      while (index.size() > max) {
+	index.erase(lru.back());
+	lru.pop_back();
+      }
+    }
+    bool erase(const key_t& k) {
+      auto p = index.find(k);
+      if (p == index.end())
+	return false;
+      lru.erase(p->second);
+      index.erase(p);
+      return true;
+    }
+    void clear() {
+      lru.clear();
+      index.clear();
+    }
+  };
+  bool adaptive;
+  uint64_t arc_target;
+  GhostList ghost_recent, ghost_frequent;
+
+  LRU& bh_lru_clean(BufferHead *bh) {
+    return bh->get_frequent() ? bh_lru_frequent : bh_lru_rest;
+  }
+  void bh_lru_clean_insert(BufferHead *bh) {
+    if (bh->get_dontneed())
+      bh_lru_clean(bh).lru_insert_bot(bh);
+    else
+      bh_lru_clean(bh).lru_insert_top(bh);
+  }
+  void bh_lru_adapt(BufferHead *bh);
+  BufferHead *bh_lru_clean_expire();
+
   Cond flusher_cond;
   bool flusher_stop;
   void flusher_entry();
@@ -472,11 +556,19 @@ class ObjectCacher {
   loff_t get_stat_clean() const { return stat_clean; }
   loff_t get_stat_zero() const { return stat_zero; }
 
-  void touch_bh(BufferHead *bh) {
-    if (bh->is_dirty())
+  /// @param hit a read from the user found bh cached; only then may it
+  /// be promoted (not when a read retries after bh's rx completed)
+  void touch_bh(BufferHead *bh, bool hit = false) {
+    if (bh->is_dirty()) {
       bh_lru_dirty.lru_touch(bh);
-    else
-      bh_lru_rest.lru_touch(bh);
+    } else if (adaptive && hit && !bh->get_frequent()) {
+      // second hit: promote
+      bh_lru_rest.lru_remove(bh);
+      bh->set_frequent(true);
+      bh_lru_frequent.lru_insert_top(bh);
+    } else {
+      bh_lru_clean(bh).lru_touch(bh);
+    }
 
     bh->set_dontneed(false);
     bh->set_nocache(false);
@@ -659,6 +751,8 @@ public:
   void set_max_objects(int64_t v) {
     max_objects = v;
   }
+  /// switch clean buffer replacement between plain LRU and ARC
+  void set_adaptive(bool v);
 
 
   // file functions
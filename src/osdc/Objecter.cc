@@ -400,6 +400,7 @@ void Objecter::start(const OSDMap* o)
   start_tick();
   if (o) {
     osdmap->deepish_copy_from(*o);
+    _update_pg_mapping(nullptr, nullptr);
   } else if (osdmap->get_epoch() == 0) {
     _maybe_request_map();
   }
@@ -1182,6 +1183,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 			<< dendl;
 	  OSDMap::Incremental inc(m->incremental_maps[e]);
 	  osdmap->apply_incremental(inc);
+	  _update_pg_mapping(nullptr, &inc);
 
           emit_blacklist_events(inc);
 
@@ -1194,7 +1196,9 @@ void Objecter::handle_osd_map(MOSDMap *m)
 
           emit_blacklist_events(*osdmap, *new_osdmap);
 
+          OSDMap *old_osdmap = osdmap;
           osdmap = new_osdmap;
+          _update_pg_mapping(old_osdmap, nullptr);
 
 	  logger->inc(l_osdc_map_full);
 	}
@@ -1251,6 +1255,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	ldout(cct, 3) << "handle_osd_map decoding full epoch "
 		      << m->get_last() << dendl;
 	osdmap->decode(m->maps[m->get_last()]);
+	_update_pg_mapping(nullptr, nullptr);
 
 	_scan_requests(homeless_session, false, false, NULL,
 		       need_resend, need_resend_linger,
@@ -2746,6 +2751,49 @@ int64_t Objecter::get_object_pg_hash_position(int64_t pool, const string& key,
   return p->raw_hash_to_pg(p->hash_key(key, ns));
 }
 
+void Objecter::_update_pg_mapping(const OSDMap *oldmap,
+				  const OSDMap::Incremental *inc)
+{
+  // rwlock must be held for write
+  if (!use_pg_mapping) {
+    return;
+  }
+  uint64_t n;
+  if (inc) {
+    n = pg_mapping.update(*osdmap, *inc);
+  } else if (oldmap) {
+    n = pg_mapping.update(*oldmap, *osdmap);
+  } else {
+    pg_mapping.update(*osdmap);
+    n = pg_mapping.get_num_pgs();
+  }
+  ldout(cct, 10) << __func__ << " e" << pg_mapping.get_epoch()
+		 << " recalculated " << n << "/" << pg_mapping.get_num_pgs()
+		 << " pgs" << dendl;
+}
+
+void Objecter::_pg_to_up_acting_osds(pg_t pgid,
+				     vector<int> *up, int *up_primary,
+				     vector<int> *acting,
+				     int *acting_primary) const
+{
+  if (use_pg_mapping &&
+      pg_mapping.get_epoch() == osdmap->get_epoch() &&
+      pg_mapping.try_get(pgid, up, up_primary, acting, acting_primary)) {
+    return;
+  }
+  osdmap->pg_to_up_acting_osds(pgid, up, up_primary, acting, acting_primary);
+}
+
+bool Objecter::_get_primary_shard(pg_t pgid, spg_t *out) const
+{
+  if (use_pg_mapping &&
+      pg_mapping.get_epoch() == osdmap->get_epoch()) {
+    return pg_mapping.get_primary_shard(pgid, out);
+  }
+  return osdmap->get_primary_shard(pgid, out);
+}
+
 int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 {
   // rwlock is locked
@@ -2818,8 +2866,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   unsigned pg_num = pi->get_pg_num();
   int up_primary, acting_primary;
   vector<int> up, acting;
-  osdmap->pg_to_up_acting_osds(pgid, &up, &up_primary,
-			       &acting, &acting_primary);
+  _pg_to_up_acting_osds(pgid, &up, &up_primary, &acting, &acting_primary);
   bool sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
   unsigned prev_seed = ceph_stable_mod(pgid.ps(), t->pg_num, t->pg_num_mask);
   pg_t prev_pgid(prev_seed, pgid.pool());
@@ -2870,7 +2917,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
     t->min_size = min_size;
     t->pg_num = pg_num;
     t->pg_num_mask = pi->get_pg_num_mask();
-    osdmap->get_primary_shard(
+    _get_primary_shard(
       pg_t(ceph_stable_mod(pgid.ps(), t->pg_num, t->pg_num_mask), pgid.pool()),
       &t->actual_pgid);
     t->sort_bitwise = sort_bitwise;
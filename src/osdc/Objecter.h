@@ -39,6 +39,7 @@
 
 #include "messages/MOSDOp.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 using namespace std;
 
@@ -1188,6 +1189,9 @@ public:
   ZTracer::Endpoint trace_endpoint;
 private:
   OSDMap    *osdmap;
+  /// every pg's up/acting sets for osdmap, if objecter_pg_mapping
+  OSDMapMapping pg_mapping{false};
+  bool use_pg_mapping;
 public:
   using Dispatcher::cct;
   std::multimap<string,string> crush_location;
@@ -1898,6 +1902,11 @@ public:
   bool _osdmap_has_pool_full() const;
 
   bool target_should_be_paused(op_target_t *op);
+  void _update_pg_mapping(const OSDMap *oldmap,
+			  const OSDMap::Incremental *inc);
+  void _pg_to_up_acting_osds(pg_t pgid, vector<int> *up, int *up_primary,
+			     vector<int> *acting, int *acting_primary) const;
+  bool _get_primary_shard(pg_t pgid, spg_t *out) const;
   int _calc_target(op_target_t *t, Connection *con,
 		   bool any_change = false);
   int _map_session(op_target_t *op, OSDSession **s,
@@ -1997,6 +2006,7 @@ private:
     Dispatcher(cct_), messenger(m), monc(mc), finisher(fin),
     trace_endpoint("0.0.0.0", 0, "Objecter"),
     osdmap(new OSDMap),
+    use_pg_mapping(cct->_conf->objecter_pg_mapping),
     max_linger_id(0),
     keep_balanced_budget(false), honor_osdmap_full(true), osdmap_full_try(false),
     blacklist_events_enabled(false),
@@ -2632,6 +2632,31 @@ TEST(BufferList, crc32c_zeros) {
   }
 }
 
+TEST(BufferList, crc32c_multi) {
+  bufferlist bls[5];
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < i * 3; ++j) {
+      bufferptr p(rand() % 6000);
+      for (unsigned k = 0; k < p.length(); ++k)
+	p[k] = rand();
+      bls[i].append(p);
+    }
+  }
+  bls[2].crc32c(rand()); // cached, but for a different initial value
+  bls[3].crc32c(3);      // cached for the one we will ask for
+
+  const bufferlist *pbls[5];
+  uint32_t crcs[5];
+  for (int i = 0; i < 5; ++i) {
+    pbls[i] = &bls[i];
+    crcs[i] = i;
+  }
+  bufferlist::crc32c_multi(pbls, crcs, 5);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(bls[i].crc32c(i), crcs[i]);
+  }
+}
+
 TEST(BufferList, crc32c_append_perf) {
   int len = 256 * 1024 * 1024;
   bufferptr a(len);
@@ -93,6 +93,7 @@
      --show-mappings       show mappings
      --show-bad-mappings   show bad mappings
      --show-choose-tries   show choose tries histogram
+     --show-benchmark      time each rule and report mappings/sec
      --output-name name
                            prepend the data file(s) generated during the
                            testing routine with name
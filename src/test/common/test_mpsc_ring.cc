@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/MPSCRing.h"
+
+TEST(MPSCRing, basic)
+{
+  MPSCRing<int> ring(3);
+  ASSERT_EQ(4u, ring.capacity());
+  ASSERT_TRUE(ring.empty());
+
+  int out;
+  ASSERT_FALSE(ring.pop(&out));
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(ring.push(std::move(i)));
+  ASSERT_EQ(4u, ring.size());
+  int extra = 4;
+  ASSERT_FALSE(ring.push(std::move(extra)));
+
+  ASSERT_TRUE(ring.pop(&out));
+  ASSERT_EQ(0, out);
+  ASSERT_TRUE(ring.push(std::move(extra)));
+
+  std::vector<int> got;
+  ASSERT_EQ(4u, ring.drain([&](int&& v) { got.push_back(v); }));
+  ASSERT_EQ(std::vector<int>({1, 2, 3, 4}), got);
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(MPSCRing, move_only)
+{
+  MPSCRing<std::unique_ptr<int>> ring(2);
+  std::unique_ptr<int> p(new int(42));
+  ASSERT_TRUE(ring.push(std::move(p)));
+  ASSERT_FALSE(p);
+  std::unique_ptr<int> q(new int(43)), r(new int(44));
+  ASSERT_TRUE(ring.push(std::move(q)));
+  ASSERT_FALSE(ring.push(std::move(r)));
+  ASSERT_TRUE(r);  // a failed push leaves the item alone
+  std::unique_ptr<int> out;
+  ASSERT_TRUE(ring.pop(&out));
+  ASSERT_EQ(42, *out);
+}
+
+TEST(MPSCRing, producers)
+{
+  const int num_producers = 4;
+  const int per_producer = 100000;
+  MPSCRing<std::pair<int,int>> ring(64);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&ring, p]() {
+	for (int i = 0; i < per_producer; ++i) {
+	  std::pair<int,int> v(p, i);
+	  while (!ring.push(std::move(v)))
+	    std::this_thread::yield();
+	}
+      });
+  }
+
+  // every producer's items must come out complete and in order
+  std::vector<int> next(num_producers, 0);
+  int total = 0;
+  while (total < num_producers * per_producer) {
+    size_t n = ring.drain([&](std::pair<int,int>&& v) {
+	ASSERT_EQ(next[v.first], v.second);
+	++next[v.first];
+      });
+    if (!n)
+      std::this_thread::yield();
+    total += n;
+  }
+  for (auto& t : producers)
+    t.join();
+  ASSERT_TRUE(ring.empty());
+  for (int p = 0; p < num_producers; ++p)
+    ASSERT_EQ(per_producer, next[p]);
+}
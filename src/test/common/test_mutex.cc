@@ -9,6 +9,9 @@
 #include "gtest/gtest.h"
 #include "common/ceph_context.h"
 #include "common/config.h"
+#include "common/Cond.h"
+#include "common/Formatter.h"
+#include "common/perf_counters.h"
 #include "include/coredumpctl.h"
 
 /*
@@ -66,3 +69,48 @@ TEST(Mutex, DeleteLocked) {
   PrCtl unset_dumpable;
   EXPECT_DEATH(delete m,".*");
 }
+
+TEST(Mutex, HoldTime) {
+  CephContext *cct = new CephContext(0);
+  cct->_conf->set_val("mutex_perf_counter", "true");
+  cct->_conf->apply_changes(nullptr);
+  {
+    Mutex m("HoldTime", false, false, false, cct);
+    m.Lock();
+    usleep(1000);
+    m.Unlock();
+
+    JSONFormatter f;
+    cct->get_perfcounters_collection()->dump_formatted(&f, false,
+						       "mutex-HoldTime",
+						       "hold");
+    stringstream ss;
+    f.flush(ss);
+    EXPECT_NE(string::npos, ss.str().find("\"avgcount\":1"));
+  }
+  cct->put();
+}
+
+TEST(Mutex, HoldTimeCondWait) {
+  CephContext *cct = new CephContext(0);
+  cct->_conf->set_val("mutex_perf_counter", "true");
+  cct->_conf->apply_changes(nullptr);
+  {
+    Mutex m("HoldTimeCondWait", false, false, false, cct);
+    Cond c;
+    m.Lock();
+    c.WaitInterval(m, utime_t(0, 100000));
+    m.Unlock();
+
+    // the wait splits the hold in two and is not part of either
+    JSONFormatter f;
+    cct->get_perfcounters_collection()->dump_formatted(&f, false,
+						       "mutex-HoldTimeCondWait",
+						       "hold");
+    stringstream ss;
+    f.flush(ss);
+    EXPECT_NE(string::npos, ss.str().find("\"avgcount\":2"));
+    EXPECT_NE(string::npos, ss.str().find("\"sum\":0.0"));
+  }
+  cct->put();
+}
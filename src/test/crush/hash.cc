@@ -0,0 +1,72 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <climits>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "crush/hash.h"
+}
+
+// the batched straw2 hash must pick exactly what the scalar one picks,
+// whichever vector path the cpu runs, for every lane and any tail length
+static void check_many(__u32 a, const __s32 *b, __u32 c, unsigned n)
+{
+  std::vector<__u32> out(n + 1, 0xdeadbeef);
+  crush_hash32_3_many(CRUSH_HASH_RJENKINS1, a, b, c, out.data(), n);
+  for (unsigned i = 0; i < n; i++) {
+    ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, a, b[i], c), out[i])
+      << "a=" << a << " b[" << i << "]=" << b[i] << " c=" << c
+      << " n=" << n;
+  }
+  // nothing is written past the last item
+  ASSERT_EQ(0xdeadbeef, out[n]);
+}
+
+TEST(CrushHash, ManyMatchesScalar)
+{
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<__u32> u32;
+  for (int round = 0; round < 1000; round++) {
+    __u32 a = u32(rng);
+    __u32 c = u32(rng);
+    std::vector<__s32> b(18 + 1);
+    for (auto &id : b)
+      id = (__s32)u32(rng);
+    for (unsigned n = 0; n <= 17; n++) {
+      check_many(a, b.data(), c, n);
+      // items need not be aligned for the vector loads
+      check_many(a, b.data() + 1, c, n);
+    }
+  }
+}
+
+TEST(CrushHash, ManyBucketItems)
+{
+  // bucket item ids are negative for buckets and small for devices, and
+  // wide buckets take several passes through the vector loop
+  std::vector<__s32> ids;
+  for (__s32 i = -64; i < 256; i++)
+    ids.push_back(i);
+  ids.push_back(INT_MIN);
+  ids.push_back(INT_MAX);
+  for (__u32 x : {0u, 1u, 0x7fffffffu, 0xffffffffu}) {
+    for (__u32 r : {0u, 1u, 2u, 50u}) {
+      for (unsigned n : {0u, 1u, 7u, 8u, 9u, 31u, 32u, 33u}) {
+	check_many(x, ids.data(), r, n);
+      }
+      check_many(x, ids.data(), r, ids.size());
+    }
+  }
+}
+
+TEST(CrushHash, ManyUnknownType)
+{
+  __s32 ids[9] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+  __u32 out[9];
+  crush_hash32_3_many(CRUSH_HASH_RJENKINS1 + 1, 1, ids, 2, out, 9);
+  for (int i = 0; i < 9; i++)
+    ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1 + 1, 1, ids[i], 2), out[i]);
+}
@@ -121,6 +121,7 @@ TYPE(SequencerPosition)
 #ifdef HAVE_LIBAIO
 #include "os/bluestore/bluestore_types.h"
 TYPE(bluestore_cnode_t)
+TYPE(bluestore_alloc_snapshot_t)
 TYPE(bluestore_compression_header_t)
 TYPE(bluestore_extent_ref_map_t)
 TYPE(bluestore_pextent_t)
@@ -0,0 +1,387 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "include/stringify.h"
+#include "librbd/cache/WriteLogImageCache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <list>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace librbd {
+namespace cache {
+
+/// in-memory image; destaged updates can be held back to inspect the log
+template <>
+class ImageWriteback<MockImageCtx> {
+public:
+  typedef std::vector<std::pair<uint64_t,uint64_t> > Extents;
+
+  static Mutex s_lock;
+  static std::string s_image;
+  static bool s_hold;
+  static std::list<Context*> s_held;
+
+  ImageWriteback(MockImageCtx &image_ctx) {
+  }
+
+  void aio_read(Extents &&image_extents, bufferlist *bl,
+                int fadvise_flags, Context *on_finish) {
+    {
+      Mutex::Locker locker(s_lock);
+      for (auto &extent : image_extents) {
+        bl->append(s_image.substr(extent.first, extent.second));
+      }
+    }
+    on_finish->complete(0);
+  }
+  void aio_write(Extents &&image_extents, bufferlist&& bl,
+                 int fadvise_flags, Context *on_finish) {
+    Mutex::Locker locker(s_lock);
+    uint64_t off = 0;
+    for (auto &extent : image_extents) {
+      bl.copy(off, extent.second, &s_image[extent.first]);
+      off += extent.second;
+    }
+    complete(on_finish);
+  }
+  void aio_discard(uint64_t offset, uint64_t length,
+                   bool skip_partial_discard, Context *on_finish) {
+    Mutex::Locker locker(s_lock);
+    s_image.replace(offset, length, length, '\0');
+    complete(on_finish);
+  }
+  void aio_flush(Context *on_finish) {
+    on_finish->complete(0);
+  }
+  void aio_writesame(uint64_t offset, uint64_t length, bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) {
+    Mutex::Locker locker(s_lock);
+    for (uint64_t i = 0; i < length; ++i) {
+      s_image[offset + i] = bl[i % bl.length()];
+    }
+    complete(on_finish);
+  }
+
+  static void release(int r = 0) {
+    std::list<Context*> held;
+    {
+      Mutex::Locker locker(s_lock);
+      s_hold = false;
+      held.swap(s_held);
+    }
+    for (auto ctx : held) {
+      ctx->complete(r);
+    }
+  }
+
+  /// complete the oldest held update, leaving the others held
+  static void release_one(int r = 0) {
+    Context *ctx;
+    {
+      Mutex::Locker locker(s_lock);
+      assert(!s_held.empty());
+      ctx = s_held.front();
+      s_held.pop_front();
+    }
+    ctx->complete(r);
+  }
+
+private:
+  void complete(Context *on_finish) {
+    assert(s_lock.is_locked());
+    if (s_hold) {
+      s_held.push_back(on_finish);
+      return;
+    }
+    s_lock.Unlock();
+    on_finish->complete(0);
+    s_lock.Lock();
+  }
+};
+
+Mutex ImageWriteback<MockImageCtx>::s_lock("ImageWriteback::s_lock");
+std::string ImageWriteback<MockImageCtx>::s_image;
+bool ImageWriteback<MockImageCtx>::s_hold = false;
+std::list<Context*> ImageWriteback<MockImageCtx>::s_held;
+
+} // namespace cache
+} // namespace librbd
+
+// template definitions
+#include "librbd/cache/WriteLogImageCache.cc"
+template class librbd::cache::WriteLogImageCache<librbd::MockImageCtx>;
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+
+class TestMockCacheWriteLogImageCache : public TestMockFixture {
+public:
+  typedef WriteLogImageCache<MockImageCtx> MockWriteLogImageCache;
+  typedef ImageWriteback<MockImageCtx> MockImageWriteback;
+
+  static const uint64_t IMAGE_SIZE = 32 << 20;
+  static const uint64_t LOG_SIZE = 16 << 20;
+
+  char m_dir[64];
+  std::string m_path;
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+    strcpy(m_dir, "/tmp/rbd_wlog.XXXXXX");
+    ASSERT_TRUE(mkdtemp(m_dir) != nullptr);
+    m_path = std::string(m_dir) + "/log";
+
+    MockImageWriteback::s_image.assign(IMAGE_SIZE, '\0');
+    MockImageWriteback::s_hold = false;
+  }
+
+  void TearDown() override {
+    for (auto ctx : MockImageWriteback::s_held) {
+      delete ctx;
+    }
+    MockImageWriteback::s_held.clear();
+    ::unlink(m_path.c_str());
+    ::rmdir(m_dir);
+    TestMockFixture::TearDown();
+  }
+
+  void init_mock_image_ctx(MockImageCtx &mock_image_ctx) {
+    mock_image_ctx.object_cacher = nullptr;
+    expect_op_work_queue(mock_image_ctx);
+  }
+
+  int write(MockWriteLogImageCache &cache, uint64_t off, uint64_t len,
+            char c) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    C_SaferCond ctx;
+    cache.aio_write({{off, len}}, std::move(bl), 0, &ctx);
+    return ctx.wait();
+  }
+
+  std::string read(MockWriteLogImageCache &cache, uint64_t off,
+                   uint64_t len) {
+    bufferlist bl;
+    C_SaferCond ctx;
+    cache.aio_read({{off, len}}, &bl, 0, &ctx);
+    EXPECT_EQ(0, ctx.wait());
+    return std::string(bl.c_str(), bl.length());
+  }
+
+  std::string image(uint64_t off, uint64_t len) {
+    Mutex::Locker locker(MockImageWriteback::s_lock);
+    return MockImageWriteback::s_image.substr(off, len);
+  }
+};
+
+TEST_F(TestMockCacheWriteLogImageCache, WriteReadFlush) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  init_mock_image_ctx(mock_image_ctx);
+
+  MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+  C_SaferCond init_ctx;
+  cache.init(&init_ctx);
+  ASSERT_EQ(0, init_ctx.wait());
+
+  MockImageWriteback::s_hold = true;
+  ASSERT_EQ(0, write(cache, 0, 8192, 'a'));
+  ASSERT_EQ(0, write(cache, 4096, 512, 'b'));
+
+  // acknowledged, but not destaged yet
+  ASSERT_EQ(std::string(8192, '\0'), image(0, 8192));
+  ASSERT_EQ(std::string(4096, 'a') + std::string(512, 'b') +
+              std::string(3584, 'a') + std::string(4096, '\0'),
+            read(cache, 0, 12288));
+
+  C_SaferCond flush_ctx;
+  cache.flush(&flush_ctx);
+  MockImageWriteback::release();
+  ASSERT_EQ(0, flush_ctx.wait());
+  ASSERT_EQ(std::string(4096, 'a') + std::string(512, 'b') +
+              std::string(3584, 'a'),
+            image(0, 8192));
+
+  C_SaferCond shut_down_ctx;
+  cache.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, DiscardBarrier) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  init_mock_image_ctx(mock_image_ctx);
+
+  MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+  C_SaferCond init_ctx;
+  cache.init(&init_ctx);
+  ASSERT_EQ(0, init_ctx.wait());
+
+  ASSERT_EQ(0, write(cache, 0, 4096, 'a'));
+  MockImageWriteback::s_hold = true;
+  C_SaferCond discard_ctx;
+  cache.aio_discard(0, 4096, false, &discard_ctx);
+  ASSERT_EQ(0, discard_ctx.wait());
+
+  // a read overlapping the logged discard waits for it to be destaged
+  bufferlist bl;
+  C_SaferCond read_ctx;
+  cache.aio_read({{0, 4096}}, &bl, 0, &read_ctx);
+  MockImageWriteback::release();
+  ASSERT_EQ(0, read_ctx.wait());
+  ASSERT_EQ(std::string(4096, '\0'), std::string(bl.c_str(), bl.length()));
+
+  C_SaferCond shut_down_ctx;
+  cache.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, DestageError) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  init_mock_image_ctx(mock_image_ctx);
+
+  MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+  C_SaferCond init_ctx;
+  cache.init(&init_ctx);
+  ASSERT_EQ(0, init_ctx.wait());
+
+  // the discard queues behind the overlapping write, which then fails
+  MockImageWriteback::s_hold = true;
+  ASSERT_EQ(0, write(cache, 0, 4096, 'a'));
+  ASSERT_EQ(0, write(cache, 8192, 4096, 'b'));
+  C_SaferCond discard_ctx;
+  cache.aio_discard(0, 4096, false, &discard_ctx);
+  ASSERT_EQ(0, discard_ctx.wait());
+
+  std::atomic<bool> flushed { false };
+  C_SaferCond flush_ctx;
+  cache.flush(new FunctionContext([&flushed, &flush_ctx](int r) {
+      flushed = true;
+      flush_ctx.complete(r);
+    }));
+
+  // the first destaged write fails while the second is still in flight
+  MockImageWriteback::release_one(-EIO);
+  ASSERT_FALSE(flushed);
+
+  // the image under the undestaged discard is stale
+  bufferlist bl;
+  C_SaferCond read_ctx;
+  cache.aio_read({{0, 4096}}, &bl, 0, &read_ctx);
+  ASSERT_EQ(-EIO, read_ctx.wait());
+
+  // logged writes are still served from the log
+  ASSERT_EQ(std::string(4096, 'b'), read(cache, 8192, 4096));
+
+  // new updates are refused rather than left to fill the log
+  ASSERT_EQ(-EIO, write(cache, 16384, 4096, 'c'));
+  ASSERT_EQ(std::string(4096, '\0'), image(16384, 4096));
+
+  // neither flush nor shut down completes before the last destage callback
+  std::atomic<bool> shut_down { false };
+  C_SaferCond shut_down_ctx;
+  cache.shut_down(new FunctionContext([&shut_down, &shut_down_ctx](int r) {
+      shut_down = true;
+      shut_down_ctx.complete(r);
+    }));
+  ASSERT_FALSE(flushed);
+  ASSERT_FALSE(shut_down);
+
+  MockImageWriteback::release_one(0);
+  ASSERT_TRUE(flushed);
+  ASSERT_EQ(-EIO, flush_ctx.wait());
+  ASSERT_EQ(-EIO, shut_down_ctx.wait());
+  ASSERT_TRUE(MockImageWriteback::s_held.empty());
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, ReplayAfterCrash) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  init_mock_image_ctx(mock_image_ctx);
+
+  {
+    MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+    C_SaferCond init_ctx;
+    cache.init(&init_ctx);
+    ASSERT_EQ(0, init_ctx.wait());
+
+    MockImageWriteback::s_hold = true;
+    ASSERT_EQ(0, write(cache, 0, 4096, 'a'));
+    ASSERT_EQ(0, write(cache, 1 << 20, 4096, 'b'));
+    ASSERT_EQ(0, write(cache, 0, 512, 'c'));
+    // torn down without shut_down: nothing destaged
+  }
+  for (auto ctx : MockImageWriteback::s_held) {
+    delete ctx;
+  }
+  MockImageWriteback::s_held.clear();
+  MockImageWriteback::s_hold = false;
+  ASSERT_EQ(std::string(4096, '\0'), image(0, 4096));
+
+  MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+  C_SaferCond init_ctx;
+  cache.init(&init_ctx);
+  ASSERT_EQ(0, init_ctx.wait());
+
+  C_SaferCond flush_ctx;
+  cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+  ASSERT_EQ(std::string(512, 'c') + std::string(3584, 'a'), image(0, 4096));
+  ASSERT_EQ(std::string(4096, 'b'), image(1 << 20, 4096));
+
+  C_SaferCond shut_down_ctx;
+  cache.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, Wrap) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  init_mock_image_ctx(mock_image_ctx);
+
+  MockWriteLogImageCache cache(mock_image_ctx, m_path, LOG_SIZE);
+  C_SaferCond init_ctx;
+  cache.init(&init_ctx);
+  ASSERT_EQ(0, init_ctx.wait());
+
+  // twice the log size forces the ring to wrap and reuse retired space
+  uint64_t len = (1 << 20) + 4096;
+  for (uint64_t i = 0; i < 2 * LOG_SIZE / len; ++i) {
+    ASSERT_EQ(0, write(cache, i * len, len, 'a' + i % 26));
+  }
+
+  C_SaferCond flush_ctx;
+  cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+  for (uint64_t i = 0; i < 2 * LOG_SIZE / len; ++i) {
+    ASSERT_EQ(std::string(len, 'a' + i % 26), image(i * len, len));
+  }
+
+  C_SaferCond shut_down_ctx;
+  cache.shut_down(&shut_down_ctx);
+  ASSERT_EQ(0, shut_down_ctx.wait());
+}
+
+} // namespace cache
+} // namespace librbd
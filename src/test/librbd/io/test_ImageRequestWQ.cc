@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_fixture.h"
+#include "test/librbd/test_support.h"
+#include "common/Cond.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/ImageState.h"
+#include "librbd/internal.h"
+#include "librbd/io/AioCompletion.h"
+#include "librbd/io/ImageRequestWQ.h"
+#include "librbd/io/ReadResult.h"
+#include <atomic>
+#include <thread>
+
+void register_test_image_request_wq() {
+}
+
+class TestImageRequestWQ : public TestFixture {
+public:
+  uint64_t fast_path_reads(librbd::ImageCtx *ictx) {
+    return ictx->perfcounter->get(l_librbd_rd_fast_path);
+  }
+
+  ssize_t read(librbd::ImageCtx *ictx, uint64_t off, uint64_t len,
+               std::string *data) {
+    bufferlist bl;
+    ssize_t r = ictx->io_work_queue->read(off, len,
+                                          librbd::io::ReadResult{&bl}, 0);
+    if (r >= 0) {
+      *data = std::string(bl.c_str(), bl.length());
+    }
+    return r;
+  }
+};
+
+TEST_F(TestImageRequestWQ, ReadFastPath) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  ictx->read_fast_path = true;
+
+  std::string buffer(4096, '1');
+  bufferlist bl;
+  bl.append(buffer);
+  ASSERT_EQ(4096, ictx->io_work_queue->write(0, buffer.size(),
+                                             std::move(bl), 0));
+
+  uint64_t fast_path = fast_path_reads(ictx);
+  std::string data;
+  ASSERT_EQ(4096, read(ictx, 0, 4096, &data));
+  ASSERT_EQ(buffer, data);
+  ASSERT_EQ(fast_path + 1, fast_path_reads(ictx));
+}
+
+TEST_F(TestImageRequestWQ, ReadFastPathWritesBlocked) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  ictx->read_fast_path = true;
+
+  // ensure write-path is initialized
+  std::string buffer(4096, '1');
+  bufferlist write_bl;
+  write_bl.append(buffer);
+  ASSERT_EQ(4096, ictx->io_work_queue->write(0, buffer.size(),
+                                             bufferlist{write_bl}, 0));
+
+  uint64_t fast_path = fast_path_reads(ictx);
+  ASSERT_EQ(0, ictx->io_work_queue->block_writes());
+
+  std::string buffer2(4096, '2');
+  C_SaferCond write_ctx;
+  auto write_comp = librbd::io::AioCompletion::create(&write_ctx);
+  bufferlist write_bl2;
+  write_bl2.append(buffer2);
+  ictx->io_work_queue->aio_write(write_comp, 0, buffer2.size(),
+                                 std::move(write_bl2), 0);
+
+  // the read queues behind the blocked write instead of overtaking it
+  bufferlist read_bl;
+  C_SaferCond read_ctx;
+  auto read_comp = librbd::io::AioCompletion::create(&read_ctx);
+  ictx->io_work_queue->aio_read(read_comp, 0, buffer2.size(),
+                                librbd::io::ReadResult{&read_bl}, 0);
+  ASSERT_EQ(fast_path, fast_path_reads(ictx));
+
+  ictx->io_work_queue->unblock_writes();
+  ASSERT_EQ(0, write_ctx.wait());
+  ASSERT_EQ(4096, read_ctx.wait());
+  ASSERT_EQ(buffer2, std::string(read_bl.c_str(), read_bl.length()));
+  ASSERT_EQ(fast_path, fast_path_reads(ictx));
+
+  std::string data;
+  ASSERT_EQ(4096, read(ictx, 0, 4096, &data));
+  ASSERT_EQ(fast_path + 1, fast_path_reads(ictx));
+}
+
+TEST_F(TestImageRequestWQ, ReadFastPathShutDown) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  ictx->read_fast_path = true;
+
+  std::string buffer(4096, '1');
+  bufferlist bl;
+  bl.append(buffer);
+  ASSERT_EQ(4096, ictx->io_work_queue->write(0, buffer.size(),
+                                             std::move(bl), 0));
+
+  // read until the close shuts the queue down: every read either
+  // completes or is failed, none is dispatched on the closed image
+  std::atomic<bool> stop { false };
+  std::thread reader([this, ictx, &buffer, &stop]() {
+      while (!stop) {
+        std::string data;
+        ssize_t r = read(ictx, 0, 4096, &data);
+        if (r == -ESHUTDOWN) {
+          continue;
+        }
+        EXPECT_EQ(4096, r);
+        EXPECT_EQ(buffer, data);
+      }
+    });
+
+  m_ictxs.erase(ictx);
+  C_SaferCond close_ctx;
+  ictx->state->close(&close_ctx);
+  int r = close_ctx.wait();
+
+  uint64_t fast_path = fast_path_reads(ictx);
+  std::string data;
+  ssize_t read_r = read(ictx, 0, 4096, &data);
+  uint64_t fast_path_after = fast_path_reads(ictx);
+
+  stop = true;
+  reader.join();
+  delete ictx;
+
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(-ESHUTDOWN, read_r);
+  ASSERT_EQ(fast_path, fast_path_after);
+}
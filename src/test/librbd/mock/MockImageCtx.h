@@ -89,6 +89,7 @@ struct MockImageCtx {
       exclusive_lock(NULL), journal(NULL),
       trace_endpoint(image_ctx.trace_endpoint),
       concurrent_management_ops(image_ctx.concurrent_management_ops),
+      concurrent_management_ops_max(image_ctx.concurrent_management_ops_max),
       blacklist_on_break_lock(image_ctx.blacklist_on_break_lock),
       blacklist_expire_seconds(image_ctx.blacklist_expire_seconds),
       journal_order(image_ctx.journal_order),
@@ -277,6 +278,7 @@ struct MockImageCtx {
   ZTracer::Endpoint trace_endpoint;
 
   int concurrent_management_ops;
+  int concurrent_management_ops_max;
   bool blacklist_on_break_lock;
   uint32_t blacklist_expire_seconds;
   uint8_t journal_order;
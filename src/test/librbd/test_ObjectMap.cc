@@ -7,6 +7,8 @@
 #include "librbd/ImageWatcher.h"
 #include "librbd/internal.h"
 #include "librbd/ObjectMap.h"
+#include "librbd/Operations.h"
+#include "librbd/io/ImageRequestWQ.h"
 #include "cls/rbd/cls_rbd_client.h"
 #include <list>
 
@@ -134,3 +136,29 @@ TEST_F(TestObjectMap, InvalidateFlagInMemoryOnly) {
   ASSERT_FALSE(flags_set);
 }
 
+
+TEST_F(TestObjectMap, NextObjectMayExist) {
+  REQUIRE_FEATURE(RBD_FEATURE_OBJECT_MAP);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  uint64_t object_size = ictx->get_object_size();
+  librbd::NoOpProgressContext no_op;
+  ASSERT_EQ(0, ictx->operations->resize(8 * object_size, true, no_op));
+
+  bufferlist bl;
+  bl.append(std::string(256, '1'));
+  ASSERT_EQ(256, ictx->io_work_queue->write(2 * object_size, bl.length(),
+                                            bufferlist{bl}, 0));
+  ASSERT_EQ(256, ictx->io_work_queue->write(5 * object_size, bl.length(),
+                                            bufferlist{bl}, 0));
+
+  RWLock::RLocker snap_locker(ictx->snap_lock);
+  ASSERT_TRUE(ictx->object_map != nullptr);
+  ASSERT_EQ(2U, ictx->object_map->next_object_may_exist(0, 8));
+  ASSERT_EQ(2U, ictx->object_map->next_object_may_exist(2, 8));
+  ASSERT_EQ(5U, ictx->object_map->next_object_may_exist(3, 8));
+  ASSERT_EQ(4U, ictx->object_map->next_object_may_exist(3, 4));
+  ASSERT_EQ(8U, ictx->object_map->next_object_may_exist(6, 16));
+}
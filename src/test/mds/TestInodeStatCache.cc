@@ -0,0 +1,183 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "mds/InodeStatCache.h"
+#include "messages/MClientRequest.h"
+#include "messages/MClientReply.h"
+
+#include "gtest/gtest.h"
+
+static MClientRequest *make_getattr(inodeno_t ino, client_t client)
+{
+  MClientRequest *req = new MClientRequest(CEPH_MDS_OP_GETATTR);
+  req->set_filepath(filepath(ino));
+  req->set_src(entity_name_t::CLIENT(client.v));
+  req->set_tid(42);
+  return req;
+}
+
+static InodeStatCache::Reply make_reply(const char *trace)
+{
+  InodeStatCache::Reply r;
+  r.trace.append(trace);
+  r.snapbl.append("snap");
+  r.mdsmap_epoch = 7;
+  return r;
+}
+
+TEST(MDSInodeStatCache, FastGetattr)
+{
+  MClientRequest *req = make_getattr(inodeno_t(0x1000), client_t(1));
+  EXPECT_TRUE(InodeStatCache::is_fast_getattr(req));
+
+  req->head.args.getattr.mask = CEPH_CAP_XATTR_SHARED;
+  EXPECT_FALSE(InodeStatCache::is_fast_getattr(req));
+  req->head.args.getattr.mask = CEPH_CAP_AUTH_SHARED;
+  EXPECT_TRUE(InodeStatCache::is_fast_getattr(req));
+
+  req->set_retry_attempt(1);
+  EXPECT_FALSE(InodeStatCache::is_fast_getattr(req));
+  req->set_retry_attempt(0);
+
+  req->set_filepath(filepath("foo", inodeno_t(0x1000)));
+  EXPECT_FALSE(InodeStatCache::is_fast_getattr(req));
+  req->put();
+
+  req = make_getattr(inodeno_t(0x1000), client_t(1));
+  req->set_src(entity_name_t::MDS(0));
+  EXPECT_FALSE(InodeStatCache::is_fast_getattr(req));
+  req->put();
+
+  req = new MClientRequest(CEPH_MDS_OP_LOOKUP);
+  req->set_src(entity_name_t::CLIENT(1));
+  EXPECT_FALSE(InodeStatCache::is_fast_getattr(req));
+  req->put();
+}
+
+TEST(MDSInodeStatCache, PublishAndReply)
+{
+  InodeStatCache cache;
+  inodeno_t ino(0x1000);
+
+  // nothing is kept or served until the rank is active
+  cache.publish(ino, client_t(1), make_reply("trace"));
+  EXPECT_FALSE(cache.contains(ino, client_t(1)));
+
+  cache.set_active(true);
+  cache.publish(ino, client_t(1), make_reply("trace"));
+  EXPECT_TRUE(cache.contains(ino, client_t(1)));
+  EXPECT_FALSE(cache.contains(ino, client_t(2)));
+  EXPECT_FALSE(cache.contains(inodeno_t(0x1001), client_t(1)));
+
+  MClientRequest *req = make_getattr(ino, client_t(1));
+  MClientReply *reply = cache.build_reply(req);
+  ASSERT_TRUE(reply != NULL);
+  EXPECT_EQ(42u, reply->get_tid());
+  EXPECT_EQ(CEPH_MDS_OP_GETATTR, reply->get_op());
+  EXPECT_EQ(0, reply->get_result());
+  EXPECT_EQ(7u, reply->get_mdsmap_epoch());
+  EXPECT_EQ(1, reply->head.is_target);
+  EXPECT_EQ(0, reply->head.is_dentry);
+  EXPECT_EQ(std::string("trace"), reply->get_trace_bl().to_str());
+  EXPECT_EQ(std::string("snap"), reply->snapbl.to_str());
+  reply->put();
+
+  // the published copy survives handing out a reply
+  reply = cache.build_reply(req);
+  ASSERT_TRUE(reply != NULL);
+  EXPECT_EQ(std::string("trace"), reply->get_trace_bl().to_str());
+  reply->put();
+  req->put();
+
+  req = make_getattr(ino, client_t(2));
+  EXPECT_TRUE(cache.build_reply(req) == NULL);
+  req->put();
+
+  std::map<inodeno_t, uint64_t> hits;
+  cache.take_hits(&hits);
+  EXPECT_EQ(1u, hits.size());
+  EXPECT_EQ(2u, hits[ino]);
+  hits.clear();
+  cache.take_hits(&hits);
+  EXPECT_TRUE(hits.empty());
+}
+
+TEST(MDSInodeStatCache, Invalidate)
+{
+  InodeStatCache cache;
+  cache.set_active(true);
+  for (uint64_t i = 0; i < 100; i++) {
+    cache.publish(inodeno_t(0x1000 + i), client_t(1), make_reply("a"));
+    cache.publish(inodeno_t(0x1000 + i), client_t(2), make_reply("b"));
+  }
+  EXPECT_EQ(200u, cache.size());
+
+  cache.invalidate(inodeno_t(0x1000));
+  EXPECT_FALSE(cache.contains(inodeno_t(0x1000), client_t(1)));
+  EXPECT_FALSE(cache.contains(inodeno_t(0x1000), client_t(2)));
+  EXPECT_EQ(198u, cache.size());
+
+  cache.invalidate_client(client_t(1));
+  EXPECT_EQ(99u, cache.size());
+  EXPECT_TRUE(cache.contains(inodeno_t(0x1001), client_t(2)));
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+
+  cache.publish(inodeno_t(0x1000), client_t(1), make_reply("a"));
+  cache.set_active(false);
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(cache.is_active());
+}
+
+TEST(MDSInodeStatCache, ConcurrentReaders)
+{
+  InodeStatCache cache;
+  cache.set_active(true);
+  const uint64_t inos = 64;
+  for (uint64_t i = 0; i < inos; i++)
+    cache.publish(inodeno_t(0x1000 + i), client_t(1), make_reply("t"));
+
+  // readers of a stable entry always get a reply while the owner keeps
+  // replacing the others
+  std::vector<std::thread> readers;
+  std::atomic<uint64_t> missed { 0 };
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&cache, &missed]() {
+	MClientRequest *req = make_getattr(inodeno_t(0x1000), client_t(1));
+	for (int n = 0; n < 10000; n++) {
+	  MClientReply *reply = cache.build_reply(req);
+	  if (reply)
+	    reply->put();
+	  else
+	    missed++;
+	}
+	req->put();
+      });
+  }
+  for (int n = 0; n < 1000; n++) {
+    inodeno_t ino(0x1001 + n % (inos - 1));
+    cache.invalidate(ino);
+    cache.publish(ino, client_t(1), make_reply("u"));
+  }
+  for (auto &t : readers)
+    t.join();
+  EXPECT_EQ(0u, missed);
+
+  std::map<inodeno_t, uint64_t> hits;
+  cache.take_hits(&hits);
+  EXPECT_EQ(40000u, hits[inodeno_t(0x1000)]);
+}
@@ -114,6 +114,60 @@ TEST(pgmap, calc_stats)
   }
 }
 
+TEST(pgmap, sharded_apply_incremental)
+{
+  // put back the thread count for the tests that follow
+  struct RestoreConf {
+    string threads =
+      stringify(g_ceph_context->_conf->mon_pg_stat_aggregate_threads);
+    ~RestoreConf() {
+      g_ceph_context->_conf->set_val("mon_pg_stat_aggregate_threads",
+				     threads);
+      g_ceph_context->_conf->apply_changes(NULL);
+    }
+  } restore_conf;
+
+  // enough updates for several aggregation shards
+  const unsigned num_pgs = 20000;
+  PGMap serial, sharded;
+  for (unsigned round = 0; round < 3; ++round) {
+    PGMap::Incremental inc;
+    inc.version = round + 1;
+    for (unsigned n = 0; n < num_pgs; ++n) {
+      pg_stat_t& ps = inc.pg_stat_updates[pg_t(n / 4, n % 4)];
+      ps.state = PG_STATE_ACTIVE;
+      ps.stats.sum.num_objects = n + round;
+      ps.log_size = round;
+      int primary = (n + round * (n % 7 == 0)) % 10;
+      ps.up = ps.acting = {primary, (primary + 1) % 10};
+      ps.up_primary = ps.acting_primary = primary;
+    }
+    g_ceph_context->_conf->set_val("mon_pg_stat_aggregate_threads", "1");
+    g_ceph_context->_conf->apply_changes(NULL);
+    serial.apply_incremental(g_ceph_context, inc);
+    g_ceph_context->_conf->set_val("mon_pg_stat_aggregate_threads", "4");
+    g_ceph_context->_conf->apply_changes(NULL);
+    sharded.apply_incremental(g_ceph_context, inc);
+
+    ASSERT_EQ(serial.num_pg, sharded.num_pg);
+    ASSERT_TRUE(serial.pg_sum.stats == sharded.pg_sum.stats);
+    ASSERT_EQ(serial.pg_sum.log_size, sharded.pg_sum.log_size);
+    ASSERT_EQ(serial.pg_sum.up, sharded.pg_sum.up);
+    ASSERT_EQ(4u, sharded.pg_pool_sum.size());
+    for (auto& p : serial.pg_pool_sum) {
+      ASSERT_TRUE(p.second.stats == sharded.pg_pool_sum[p.first].stats);
+      ASSERT_EQ(p.second.acting, sharded.pg_pool_sum[p.first].acting);
+    }
+    for (auto& p : serial.num_pg_by_osd) {
+      ASSERT_EQ(p.second.acting, sharded.num_pg_by_osd[p.first].acting);
+      ASSERT_EQ(p.second.primary, sharded.num_pg_by_osd[p.first].primary);
+    }
+    ASSERT_EQ(serial.pg_by_osd, sharded.pg_by_osd);
+    ASSERT_EQ(serial.per_pool_sum_delta.size(),
+	      sharded.per_pool_sum_delta.size());
+  }
+}
+
 namespace {
   class CheckTextTable : public TextTable {
   public:
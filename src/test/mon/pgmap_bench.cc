@@ -0,0 +1,180 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Replay synthetic pg stat reports into a PGMap at cluster scale and time
+ * how long the monitor/mgr spends applying each round and taking a digest
+ * of the result.  The number of aggregation threads follows the usual
+ * --mon-pg-stat-aggregate-threads option.
+ */
+
+#include <algorithm>
+#include <random>
+
+#include "mon/PGMap.h"
+
+#include "global/global_init.h"
+#include "common/ceph_argparse.h"
+#include "common/Clock.h"
+#include "common/debug.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_mon
+
+static void usage()
+{
+  derr << "usage: ceph_pgmap_bench [flags]\n"
+      "	 --pgs\n"
+      "	       number of pgs (default 200000)\n"
+      "	 --pools\n"
+      "	       number of pools the pgs are spread over (default 8)\n"
+      "	 --osds\n"
+      "	       number of osds (default 1000)\n"
+      "	 --size\n"
+      "	       replicas per pg (default 3)\n"
+      "	 --rounds\n"
+      "	       number of rounds in which every pg reports (default 10)\n"
+      "	 --remap-percent\n"
+      "	       share of pgs whose mapping changes each round (default 1)\n"
+      << dendl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned pgs = 200000;
+  unsigned pools = 8;
+  unsigned osds = 1000;
+  unsigned size = 3;
+  unsigned rounds = 10;
+  unsigned remap_percent = 1;
+};
+
+static void map_pg(const Config &cfg, std::mt19937 &rng, pg_stat_t *s)
+{
+  std::uniform_int_distribution<int> osd(0, cfg.osds - 1);
+  s->up.clear();
+  while (s->up.size() < cfg.size) {
+    int o = osd(rng);
+    if (std::find(s->up.begin(), s->up.end(), o) == s->up.end())
+      s->up.push_back(o);
+  }
+  s->acting = s->up;
+  s->up_primary = s->acting_primary = s->up[0];
+}
+
+int main(int argc, const char *argv[])
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_MON,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)nullptr)) {
+      cfg.pgs = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--pools", (char*)nullptr)) {
+      cfg.pools = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--osds", (char*)nullptr)) {
+      cfg.osds = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--size", (char*)nullptr)) {
+      cfg.size = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--rounds", (char*)nullptr)) {
+      cfg.rounds = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--remap-percent", (char*)nullptr)) {
+      cfg.remap_percent = atoi(val.c_str());
+    } else {
+      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
+      usage();
+      return 1;
+    }
+  }
+  if (!cfg.pgs || !cfg.pools || !cfg.size || cfg.osds < cfg.size) {
+    usage();
+    return 1;
+  }
+
+  common_init_finish(g_ceph_context);
+
+  dout(0) << "pgs " << cfg.pgs << " pools " << cfg.pools
+	  << " osds " << cfg.osds << " size " << cfg.size
+	  << " rounds " << cfg.rounds
+	  << " remap-percent " << cfg.remap_percent
+	  << " threads " << g_conf->mon_pg_stat_aggregate_threads << dendl;
+
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::uniform_int_distribution<int> objects(0, 16);
+
+  PGMap pg_map;
+  mempool::pgmap::map<pg_t,pg_stat_t> reports;
+  for (unsigned n = 0; n < cfg.pgs; ++n) {
+    pg_t pgid(n / cfg.pools, n % cfg.pools);
+    pg_stat_t& s = reports[pgid];
+    s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+    s.reported_epoch = 1;
+    map_pg(cfg, rng, &s);
+  }
+
+  utime_t stamp = ceph_clock_now();
+  {
+    PGMap::Incremental inc;
+    inc.version = pg_map.version + 1;
+    inc.stamp = stamp;
+    inc.pg_stat_updates = reports;
+    for (unsigned o = 0; o < cfg.osds; ++o) {
+      osd_stat_t os;
+      os.kb = 1 << 30;
+      inc.update_stat(o, 1, std::move(os));
+    }
+    pg_map.apply_incremental(g_ceph_context, inc);
+  }
+
+  utime_t apply_total, digest_total;
+  for (unsigned round = 0; round < cfg.rounds; ++round) {
+    PGMap::Incremental inc;
+    inc.version = pg_map.version + 1;
+    stamp += 5;
+    inc.stamp = stamp;
+    for (auto& p : reports) {
+      pg_stat_t& s = p.second;
+      s.reported_seq++;
+      s.stats.sum.num_objects += objects(rng);
+      s.stats.sum.num_bytes = s.stats.sum.num_objects << 22;
+      s.stats.sum.num_wr++;
+      if (percent(rng) < (int)cfg.remap_percent)
+	map_pg(cfg, rng, &s);
+    }
+    inc.pg_stat_updates = reports;
+
+    utime_t start = ceph_clock_now();
+    pg_map.apply_incremental(g_ceph_context, inc);
+    utime_t applied = ceph_clock_now();
+    PGMapDigest digest(pg_map);
+    utime_t end = ceph_clock_now();
+
+    apply_total += applied - start;
+    digest_total += end - applied;
+    dout(1) << "round " << round << " apply " << (applied - start)
+	    << " digest " << (end - applied) << dendl;
+  }
+
+  if (cfg.rounds) {
+    double apply = (double)apply_total / cfg.rounds;
+    double digest = (double)digest_total / cfg.rounds;
+    dout(0) << "avg apply " << apply * 1000 << " ms ("
+	    << (uint64_t)(cfg.pgs / apply) << " pg stats/s), avg digest "
+	    << digest * 1000 << " ms" << dendl;
+  }
+  dout(0) << "objects " << pg_map.pg_sum.stats.sum.num_objects
+	  << " pgs by state " << pg_map.num_pg_by_state.size() << dendl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Allocator microbenchmark: ages each allocator with a random
+ * allocate/release mix and reports throughput and fragmentation.
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "common/config.h"
+#include "global/global_context.h"
+#include "include/stringify.h"
+#include "os/bluestore/Allocator.h"
+
+#if GTEST_HAS_PARAM_TEST
+
+class AllocBench : public ::testing::TestWithParam<const char*> {
+public:
+  static const uint64_t block_size = 4096;
+  static const uint64_t capacity = 16ull << 30;   // 16 GB
+
+  boost::scoped_ptr<Allocator> alloc;
+  std::mt19937_64 rng;
+  AllocExtentVector allocated;
+  uint64_t used = 0;
+
+  AllocBench() : rng(1234) { }
+
+  void init_alloc() {
+    alloc.reset(Allocator::create(g_ceph_context, string(GetParam()),
+				  capacity, block_size));
+    ASSERT_TRUE(alloc);
+    alloc->init_add_free(0, capacity);
+  }
+
+  bool do_alloc(uint64_t want) {
+    if (alloc->reserve(want) < 0)
+      return false;
+    AllocExtentVector extents;
+    int64_t r = alloc->allocate(want, block_size, 0, &extents);
+    if (r < 0) {
+      alloc->unreserve(want);
+      return false;
+    }
+    if ((uint64_t)r < want)
+      alloc->unreserve(want - r);
+    for (auto& e : extents) {
+      allocated.push_back(e);
+      used += e.length;
+    }
+    return true;
+  }
+
+  void do_release() {
+    assert(!allocated.empty());
+    std::uniform_int_distribution<size_t> pick(0, allocated.size() - 1);
+    size_t i = pick(rng);
+    alloc->release(allocated[i].offset, allocated[i].length);
+    used -= allocated[i].length;
+    allocated[i] = allocated.back();
+    allocated.pop_back();
+  }
+
+  void report(const char *phase, uint64_t ops,
+	      std::chrono::steady_clock::duration elapsed) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    std::cout << GetParam() << " " << phase << ": " << ops << " ops in "
+	      << secs << "s (" << (uint64_t)(ops / secs) << " ops/s)"
+	      << " used " << prettybyte_t(used)
+	      << " extents " << allocated.size()
+	      << " fragmentation " << alloc->get_fragmentation(block_size)
+	      << std::endl;
+  }
+};
+
+TEST_P(AllocBench, churn)
+{
+  init_alloc();
+  std::uniform_int_distribution<uint64_t> blocks(1, 64);  // 4k..256k
+  const uint64_t fill_to = capacity / 10 * 7;
+  const uint64_t ops = 1000000;
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t n = 0;
+  while (used < fill_to) {
+    ASSERT_TRUE(do_alloc(blocks(rng) * block_size));
+    ++n;
+  }
+  report("fill", n, std::chrono::steady_clock::now() - start);
+
+  // keep utilization between 60% and 80% while punching holes all over
+  std::bernoulli_distribution coin(0.5);
+  const uint64_t low = capacity / 10 * 6, high = capacity / 10 * 8;
+  start = std::chrono::steady_clock::now();
+  for (n = 0; n < ops; ++n) {
+    if (used > low && (used >= high || coin(rng))) {
+      do_release();
+    } else {
+      ASSERT_TRUE(do_alloc(blocks(rng) * block_size));
+    }
+  }
+  report("churn", ops, std::chrono::steady_clock::now() - start);
+  EXPECT_EQ(capacity - used, alloc->get_free());
+
+  start = std::chrono::steady_clock::now();
+  n = allocated.size();
+  while (!allocated.empty())
+    do_release();
+  report("drain", n, std::chrono::steady_clock::now() - start);
+  EXPECT_EQ(capacity, alloc->get_free());
+  alloc->shutdown();
+}
+
+TEST_P(AllocBench, large_after_fragmentation)
+{
+  init_alloc();
+  // leave every other 64k chunk allocated, then time 4M requests that
+  // must be stitched together from whatever is left
+  const uint64_t chunk = 16 * block_size;
+  for (uint64_t i = 0; i < capacity / chunk; ++i)
+    ASSERT_TRUE(do_alloc(chunk));
+  AllocExtentVector kept;
+  for (size_t i = 0; i < allocated.size(); ++i) {
+    if (i % 2) {
+      kept.push_back(allocated[i]);
+      continue;
+    }
+    alloc->release(allocated[i].offset, allocated[i].length);
+    used -= allocated[i].length;
+  }
+  allocated.swap(kept);
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t n = 0;
+  while (alloc->get_free() >= (4ull << 20)) {
+    ASSERT_TRUE(do_alloc(4ull << 20));
+    ++n;
+  }
+  report("large", n, std::chrono::steady_clock::now() - start);
+  alloc->shutdown();
+}
+
+INSTANTIATE_TEST_CASE_P(
+  Allocator,
+  AllocBench,
+  ::testing::Values("stupid", "bitmap", "avl"));
+
+#else
+
+TEST(DummyTest, ValueParameterizedTestsAreNotSupportedOnThisPlatform) {}
+
+#endif
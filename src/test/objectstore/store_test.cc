@@ -6465,6 +6465,102 @@ TEST_P(StoreTest, KVDBStatsTest) {
   g_conf->set_val("rocksdb_collect_memory_stats","false");
 }
 
+TEST_P(StoreTest, BluestoreAllocSnapshot) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  bufferlist bl;
+  bufferptr bp(0x10000);
+  memset(bp.c_str(), 'a', bp.length());
+  bl.append(bp);
+  int r;
+
+  g_conf->set_val("bluestore_alloc_snapshot", "true");
+  g_conf->apply_changes(NULL);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  struct store_statfs_t before;
+  r = store->statfs(&before);
+  ASSERT_EQ(r, 0);
+
+  // clean umount saves the snapshot, mount loads it
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t loaded = logger->get(l_bluestore_alloc_snapshot_loaded);
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(loaded + 1, logger->get(l_bluestore_alloc_snapshot_loaded));
+  {
+    struct store_statfs_t after;
+    r = store->statfs(&after);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(before.available, after.available);
+    ASSERT_EQ(before.allocated, after.allocated);
+  }
+
+  // the first commit after mount drops the snapshot; an umount that
+  // does not save a new one leaves the store as a crash would, and the
+  // next mount has to rebuild the allocator from the freelist.
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid2, 0, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  r = store->statfs(&before);
+  ASSERT_EQ(r, 0);
+  g_conf->set_val("bluestore_alloc_snapshot", "false");
+  g_conf->apply_changes(NULL);
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  g_conf->set_val("bluestore_alloc_snapshot", "true");
+  g_conf->apply_changes(NULL);
+  loaded = logger->get(l_bluestore_alloc_snapshot_loaded);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(loaded, logger->get(l_bluestore_alloc_snapshot_loaded));
+  {
+    struct store_statfs_t after;
+    r = store->statfs(&after);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(before.available, after.available);
+    ASSERT_EQ(before.allocated, after.allocated);
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid2, 0, bl.length(), in);
+    ASSERT_EQ((int)bl.length(), r);
+    ASSERT_TRUE(bl_eq(bl, in));
+  }
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->fsck(false);
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+
+  g_conf->set_val("bluestore_alloc_snapshot", "false");
+  g_conf->apply_changes(NULL);
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 #if defined(HAVE_LIBAIO)
 TEST_P(StoreTestSpecificAUSize, garbageCollection) {
   ObjectStore::Sequencer osr("test");
@@ -308,6 +308,179 @@ TEST_P(KVTest, RMRange) {
   fini();
 }
 
+TEST_P(KVTest, ColumnFamilyRouting) {
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("cf1", ""));
+  int r = db->set_column_families(cfs);
+  if (r < 0)
+    return; // No column families for this database type
+  ASSERT_EQ(0, db->create_and_open(cout));
+  bufferlist value;
+  value.append("value");
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("a", "k1", value);
+    t->set("cf1", "k1", value);
+    t->set("cf1", "k2", value);
+    t->set("z", "k1", value);
+    db->submit_transaction_sync(t);
+  }
+  {
+    bufferlist v;
+    ASSERT_EQ(0, db->get("cf1", "k1", &v));
+    ASSERT_EQ(tostr(v), "value");
+    ASSERT_EQ(-ENOENT, db->get("cf1", "k3", &v));
+  }
+  {
+    KeyValueDB::Iterator it = db->get_iterator("cf1");
+    it->seek_to_first();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ("k1", it->key());
+    it->next();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ("k2", it->key());
+    it->next();
+    ASSERT_FALSE(it->valid());
+  }
+  {
+    // the whole space merges the family back in, in both directions
+    vector<pair<string,string> > expected = {
+      {"a", "k1"}, {"cf1", "k1"}, {"cf1", "k2"}, {"z", "k1"}};
+    KeyValueDB::WholeSpaceIterator it = db->get_iterator();
+    vector<pair<string,string> > keys;
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      keys.push_back(it->raw_key());
+    }
+    ASSERT_EQ(expected, keys);
+    keys.clear();
+    for (it->seek_to_last(); it->valid(); it->prev()) {
+      keys.insert(keys.begin(), it->raw_key());
+    }
+    ASSERT_EQ(expected, keys);
+
+    it->lower_bound("cf1", "k2");
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("cf1"), string("k2")), it->raw_key());
+    it->prev();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("cf1"), string("k1")), it->raw_key());
+    it->prev();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("a"), string("k1")), it->raw_key());
+    it->next();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("cf1"), string("k1")), it->raw_key());
+    it->upper_bound("cf1", "k2");
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("z"), string("k1")), it->raw_key());
+    it->seek_to_last("cf1");
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(make_pair(string("cf1"), string("k2")), it->raw_key());
+  }
+  fini();
+}
+
+TEST_P(KVTest, ColumnFamilyRmKeysByPrefix) {
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("cf1", ""));
+  int r = db->set_column_families(cfs);
+  if (r < 0)
+    return; // No column families for this database type
+  ASSERT_EQ(0, db->create_and_open(cout));
+  bufferlist value;
+  value.append("value");
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("cf1", "k1", value);
+    t->set("cf1", "k2", value);
+    t->set("cf", "k1", value);
+    t->set("cf10", "k1", value);
+    db->submit_transaction_sync(t);
+  }
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->rmkeys_by_prefix("cf1");
+    db->submit_transaction_sync(t);
+  }
+  {
+    bufferlist v;
+    ASSERT_EQ(-ENOENT, db->get("cf1", "k1", &v));
+    ASSERT_EQ(-ENOENT, db->get("cf1", "k2", &v));
+    ASSERT_EQ(0, db->get("cf", "k1", &v));
+    ASSERT_EQ(0, db->get("cf10", "k1", &v));
+    KeyValueDB::Iterator it = db->get_iterator("cf1");
+    it->seek_to_first();
+    ASSERT_FALSE(it->valid());
+  }
+  fini();
+}
+
+TEST_P(KVTest, ColumnFamilyMerge) {
+  shared_ptr<KeyValueDB::MergeOperator> p(new AppendMOP);
+  int r = db->set_merge_operator("cf1", p);
+  if (r < 0)
+    return; // No merge operators for this database type
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("cf1", ""));
+  r = db->set_column_families(cfs);
+  if (r < 0)
+    return; // No column families for this database type
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist v1, v2;
+    v1.append(string("1"));
+    v2.append(string("2"));
+    t->merge("cf1", "k1", v1);
+    t->merge("cf1", "k1", v2);
+    db->submit_transaction_sync(t);
+  }
+  {
+    bufferlist v;
+    ASSERT_EQ(0, db->get("cf1", "k1", &v));
+    ASSERT_EQ(tostr(v), "?12");
+  }
+  fini();
+}
+
+TEST_P(KVTest, ColumnFamilyMigration) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  bufferlist value;
+  value.append("value");
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (int i = 0; i < 100; ++i) {
+      t->set("cf1", "k" + stringify(i), value);
+    }
+    t->set("other", "k1", value);
+    db->submit_transaction_sync(t);
+  }
+  fini();
+
+  // keys of an existing store move into the family on open
+  for (int pass = 0; pass < 2; ++pass) {
+    init();
+    std::vector<KeyValueDB::ColumnFamily> cfs;
+    cfs.push_back(KeyValueDB::ColumnFamily("cf1", ""));
+    int r = db->set_column_families(cfs);
+    if (r < 0)
+      return; // No column families for this database type
+    ASSERT_EQ(0, db->open(cout));
+    bufferlist v;
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_EQ(0, db->get("cf1", "k" + stringify(i), &v));
+    }
+    ASSERT_EQ(0, db->get("other", "k1", &v));
+
+    int n = 0;
+    KeyValueDB::WholeSpaceIterator it = db->get_iterator();
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      ++n;
+    }
+    ASSERT_EQ(101, n);
+    fini();
+  }
+}
 
 INSTANTIATE_TEST_CASE_P(
   KeyValueDB,
@@ -423,6 +423,169 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
   }
 }
 
+TEST_F(OSDMapTest, MappingIncrementalUpdate) {
+  set_up_map();
+
+  OSDMapMapping by_inc, by_diff;
+  by_inc.update(osdmap);
+  by_diff.update(osdmap);
+
+  auto check = [this](const OSDMapMapping& m) {
+    ASSERT_EQ(osdmap.get_epoch(), m.get_epoch());
+    for (auto& p : osdmap.get_pools()) {
+      // raw pgs past pg_num must fold onto their actual pg
+      for (unsigned ps = 0; ps < p.second.get_pg_num() * 2; ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	ASSERT_TRUE(m.try_get(pgid, &up2, &up_primary2,
+			      &acting2, &acting_primary2));
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+  };
+  // apply inc to osdmap and both tables; return how many pgs the
+  // incremental update had to recompute
+  auto apply = [&](OSDMap::Incremental& inc) {
+    OSDMap oldmap;
+    oldmap.deepish_copy_from(osdmap);
+    osdmap.apply_incremental(inc);
+    uint64_t n = by_inc.update(osdmap, inc);
+    EXPECT_EQ(n, by_diff.update(oldmap, osdmap));
+    return n;
+  };
+
+  int64_t pool = osdmap.lookup_pg_pool_name("ec");
+  ASSERT_GE(pool, 0);
+  uint64_t total = by_inc.get_num_pgs();
+  pg_t pgid(0, pool);
+  vector<int> up, acting;
+  int up_primary, acting_primary;
+  osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+			      &acting, &acting_primary);
+
+  {
+    // nothing placement related
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_up_thru[0] = osdmap.get_epoch();
+    ASSERT_EQ(0u, apply(inc));
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    // pg_temp and primary_temp touch only their pgs
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>(
+      acting.rbegin(), acting.rend());
+    inc.new_primary_temp[pg_t(1, pool)] = acting[1];
+    ASSERT_EQ(2u, apply(inc));
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    // a down osd only moves the pgs it was mapped to
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[acting[0]] = CEPH_OSD_UP;
+    uint64_t n = apply(inc);
+    ASSERT_LT(0u, n);
+    ASSERT_GT(total, n);
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    // and so does marking it out
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[acting[0]] = CEPH_OSD_OUT;
+    uint64_t n = apply(inc);
+    ASSERT_GT(total, n);
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_primary_affinity[acting[1]] = 0;
+    inc.new_pg_temp[pgid].clear();
+    ASSERT_GT(total, apply(inc));
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    // back up and in: anything may move
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[acting[0]] = CEPH_OSD_UP;
+    inc.new_weight[acting[0]] = CEPH_OSD_IN;
+    ASSERT_EQ(total, apply(inc));
+    check(by_inc);
+    check(by_diff);
+  }
+  {
+    // growing the pool rebuilds just that pool
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_pool_t *p = inc.get_new_pool(pool, osdmap.get_pg_pool(pool));
+    p->set_pg_num(p->get_pg_num() * 2);
+    p->set_pgp_num(p->get_pgp_num() * 2);
+    ASSERT_EQ(osdmap.get_pg_pool(pool)->get_pg_num() * 2, apply(inc));
+    check(by_inc);
+    check(by_diff);
+  }
+}
+
+TEST_F(OSDMapTest, ShallowCopyIsCopyOnWrite) {
+  set_up_map();
+
+  const uint64_t features = CEPH_FEATURES_SUPPORTED_DEFAULT;
+  bufferlist before;
+  osdmap.encode(before, features);
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, 0));
+  vector<int> up, acting;
+  int up_primary, acting_primary;
+  osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+			      &acting, &acting_primary);
+
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>(
+    acting.rbegin(), acting.rend());
+  inc.new_primary_temp[pg_t(1, 0)] = acting[1];
+  inc.new_primary_affinity[acting[0]] = 0x8000;
+  uuid_d uuid;
+  uuid.generate_random();
+  inc.new_uuid[0] = uuid;
+  entity_addr_t addr;
+  addr.nonce = 1234;
+  inc.new_up_client[1] = addr;
+  inc.new_up_cluster[1] = addr;
+
+  OSDMap shallow, deep;
+  shallow.shallow_copy_from(osdmap);
+  deep.deepish_copy_from(osdmap);
+  ASSERT_EQ(0, shallow.apply_incremental(inc));
+  ASSERT_EQ(0, deep.apply_incremental(inc));
+
+  // the source map is untouched...
+  bufferlist after;
+  osdmap.encode(after, features);
+  ASSERT_TRUE(before.contents_equal(after));
+
+  // ...the copy matches one made the expensive way...
+  bufferlist sbl, dbl;
+  shallow.encode(sbl, features);
+  deep.encode(dbl, features);
+  ASSERT_TRUE(sbl.contents_equal(dbl));
+  vector<int> acting2;
+  shallow.pg_to_acting_osds(pgid, &acting2, &acting_primary);
+  ASSERT_EQ(vector<int>(acting.rbegin(), acting.rend()), acting2);
+
+  // ...and what the incremental did not touch is still shared
+  ASSERT_EQ(osdmap.crush, shallow.crush);
+}
+
 TEST(PGTempMap, basic)
 {
   PGTempMap m;
@@ -2064,6 +2064,50 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   EXPECT_EQ(del.reqid, entry->reqid);
 }
 
+TEST_F(PGLogTest, lazy_index) {
+  hobject_t oid(object_t("objname"), "key", 123, 456, 0, "");
+  osd_reqid_t reqid(entity_name_t::CLIENT(777), 8, 1);
+  pg_log_t plog;
+  plog.log.push_back(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(6,2),
+		   eversion_t(3,4), 1, reqid, utime_t(0,1), 0));
+  plog.head = eversion_t(6,2);
+
+  // a log loaded from disk is only indexed once it is looked at
+  IndexedLog loaded(plog);
+  EXPECT_FALSE(loaded.is_indexed(PGLOG_INDEXED_OBJECTS));
+  EXPECT_FALSE(loaded.is_indexed(PGLOG_INDEXED_CALLER_OPS));
+  EXPECT_TRUE(loaded.objects.empty());
+  EXPECT_TRUE(loaded.caller_ops.empty());
+  EXPECT_TRUE(loaded.logged_object(oid));
+  EXPECT_TRUE(loaded.is_indexed(PGLOG_INDEXED_OBJECTS));
+  EXPECT_FALSE(loaded.is_indexed(PGLOG_INDEXED_CALLER_OPS));
+  EXPECT_EQ(1U, loaded.objects.count(oid));
+  EXPECT_TRUE(loaded.caller_ops.empty());
+  EXPECT_TRUE(loaded.logged_req(reqid));
+  EXPECT_TRUE(loaded.is_indexed(PGLOG_INDEXED_CALLER_OPS));
+  EXPECT_EQ(1U, loaded.caller_ops.count(reqid));
+
+  // entries added before the index is built are picked up when it is
+  IndexedLog lazy(plog);
+  pg_log_entry_t del(pg_log_entry_t::DELETE, oid, eversion_t(7,3),
+		     eversion_t(6,2), 2,
+		     osd_reqid_t(entity_name_t::CLIENT(777), 8, 2),
+		     utime_t(1,2), 0);
+  lazy.add(del);
+  EXPECT_TRUE(lazy.objects.empty());
+  ASSERT_EQ(1U, lazy.get_objects().count(oid));
+  EXPECT_EQ(del.version, lazy.get_objects().find(oid)->second->version);
+
+  // a copy (through the copy constructor; a non-const lvalue would pick
+  // the forwarding one and start out unindexed) rebuilds the indices
+  // its source had built
+  const IndexedLog &src = loaded;
+  IndexedLog copy(src);
+  EXPECT_EQ(1U, copy.objects.count(oid));
+  EXPECT_EQ(1U, copy.caller_ops.count(reqid));
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
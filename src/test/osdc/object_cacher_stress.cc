@@ -9,6 +9,7 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "common/ceph_argparse.h"
+#include "common/Clock.h"
 #include "common/common_init.h"
 #include "common/config.h"
 #include "common/Mutex.h"
@@ -66,6 +67,7 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
 		   g_conf->client_oc_target_dirty,
 		   g_conf->client_oc_max_dirty_age,
 		   true);
+  obc.set_adaptive(g_conf->client_oc_adaptive);
   obc.start();
 
   std::atomic<unsigned> outstanding_reads = { 0 };
@@ -188,6 +190,7 @@ int correctness_test(uint64_t delay_ns)
 		   1<<17, // target dirty, 128KB
 		   g_conf->client_oc_max_dirty_age,
 		   true);
+  obc.set_adaptive(g_conf->client_oc_adaptive);
   obc.start();
   std::cerr << "just start()ed ObjectCacher" << std::endl;
 
@@ -351,6 +354,156 @@ int correctness_test(uint64_t delay_ns)
   return EXIT_FAILURE;
 }
 
+static int read_object(ObjectCacher &obc, Mutex &lock,
+		       ObjectCacher::ObjectSet *object_set,
+		       const std::string &oid, uint64_t len, bool *hit)
+{
+  bufferlist bl;
+  C_SaferCond cond;
+  ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &bl, 0);
+  ObjectExtent extent(oid, 0, 0, len, 0);
+  extent.oloc.pool = 0;
+  extent.buffer_extents.push_back(make_pair(0, len));
+  rd->extents.push_back(extent);
+  lock.Lock();
+  int r = obc.readx(rd, object_set, &cond);
+  lock.Unlock();
+  *hit = r != 0;
+  if (r == 0)
+    r = cond.wait();
+  return r;
+}
+
+/*
+ * With the adaptive policy, a single sequential pass over more data than
+ * the cache holds must not push out buffers that were read repeatedly.
+ */
+int arc_scan_test()
+{
+  std::cerr << "starting arc scan test" << std::endl;
+  Mutex lock("object_cacher_stress::object_cacher");
+  FakeWriteback writeback(g_ceph_context, &lock, 0);
+
+  const uint64_t obj_len = 1<<16;
+  const int num_hot = 4;
+  const int num_scan = 64;
+  ObjectCacher obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
+		   1<<20, // max cache size, 1MB: 16 objects
+		   1000, // max objects
+		   0, // max dirty
+		   0, // target dirty
+		   g_conf->client_oc_max_dirty_age,
+		   true);
+  obc.set_adaptive(true);
+  obc.start();
+  ObjectCacher::ObjectSet object_set(NULL, 0, 0);
+
+  // cache the hot objects, then hit each of them once more
+  bool hit;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < num_hot; ++i) {
+      int r = read_object(obc, lock, &object_set, "hot_" + stringify(i),
+			  obj_len, &hit);
+      assert(r == (int)obj_len);
+      assert(hit == (pass > 0));
+    }
+  }
+
+  // a scan of 4MB, each object read exactly once
+  for (int i = 0; i < num_scan; ++i) {
+    int r = read_object(obc, lock, &object_set, "scan_" + stringify(i),
+			obj_len, &hit);
+    assert(r == (int)obj_len);
+    assert(!hit);
+  }
+
+  int ret = EXIT_SUCCESS;
+  for (int i = 0; i < num_hot; ++i) {
+    int r = read_object(obc, lock, &object_set, "hot_" + stringify(i),
+			obj_len, &hit);
+    assert(r == (int)obj_len);
+    if (!hit) {
+      std::cout << "hot_" << i << " was evicted by the scan" << std::endl;
+      ret = EXIT_FAILURE;
+    }
+  }
+
+  lock.Lock();
+  obc.release_set(&object_set);
+  lock.Unlock();
+  obc.stop();
+
+  if (ret == EXIT_SUCCESS)
+    std::cout << "Testing ObjectCacher arc scan resistance complete"
+	      << std::endl;
+  return ret;
+}
+
+/*
+ * Hit ratio and throughput of the default LRU and the adaptive policy for
+ * reads of a hot working set that fits in the cache, interleaved with a
+ * sequential scan that does not.  Misses cost delay_ns.
+ */
+static int arc_bench_run(bool adaptive, long long num_ops, long long delay_ns)
+{
+  Mutex lock("object_cacher_stress::object_cacher");
+  FakeWriteback writeback(g_ceph_context, &lock, delay_ns);
+
+  const uint64_t obj_len = 1<<16;
+  const int num_hot = 96;
+  ObjectCacher obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
+		   8<<20, // max cache size, 8MB: 128 objects
+		   1000, // max objects
+		   0, // max dirty
+		   0, // target dirty
+		   g_conf->client_oc_max_dirty_age,
+		   true);
+  obc.set_adaptive(adaptive);
+  obc.start();
+  ObjectCacher::ObjectSet object_set(NULL, 0, 0);
+
+  long long hits = 0;
+  long long next_scan = 0;
+  utime_t start = ceph_clock_now();
+  for (long long i = 0; i < num_ops; ++i) {
+    // 3 in 4 reads go to the hot set, the rest continue the scan
+    std::string oid;
+    if (random() % 4)
+      oid = "hot_" + stringify(random() % num_hot);
+    else
+      oid = "scan_" + stringify(next_scan++);
+    bool hit;
+    int r = read_object(obc, lock, &object_set, oid, obj_len, &hit);
+    assert(r == (int)obj_len);
+    if (hit)
+      ++hits;
+  }
+  utime_t elapsed = ceph_clock_now() - start;
+
+  lock.Lock();
+  obc.release_set(&object_set);
+  lock.Unlock();
+  obc.stop();
+
+  std::cout << (adaptive ? "adaptive" : "lru     ")
+	    << "  ops " << num_ops
+	    << "  hit ratio " << (double)hits / num_ops
+	    << "  ops/s " << (long long)(num_ops / (double)elapsed)
+	    << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int arc_bench(long long num_ops, long long delay_ns)
+{
+  std::cerr << "starting arc bench, miss delay " << delay_ns << "ns"
+	    << std::endl;
+  int seed = random();
+  srandom(seed);
+  arc_bench_run(false, num_ops, delay_ns);
+  srandom(seed);
+  return arc_bench_run(true, num_ops, delay_ns);
+}
+
 int main(int argc, const char **argv)
 {
   std::vector<const char*> args;
@@ -368,6 +521,8 @@ int main(int argc, const char **argv)
   int seed = time(0) % 100000;
   bool stress = false;
   bool correctness = false;
+  bool arc_scan = false;
+  bool arc = false;
   std::ostringstream err;
   std::vector<const char*>::iterator i;
   for (i = args.begin(); i != args.end();) {
@@ -410,6 +565,10 @@ int main(int argc, const char **argv)
       stress = true;
     } else if (ceph_argparse_flag(args, i, "--correctness-test", NULL)) {
       correctness = true;
+    } else if (ceph_argparse_flag(args, i, "--arc-scan-test", NULL)) {
+      arc_scan = true;
+    } else if (ceph_argparse_flag(args, i, "--arc-bench", NULL)) {
+      arc = true;
     } else {
       cerr << "unknown option " << *i << std::endl;
       return EXIT_FAILURE;
@@ -423,4 +582,11 @@ int main(int argc, const char **argv)
   if (correctness) {
     return correctness_test(delay_ns);
   }
+  if (arc_scan) {
+    return arc_scan_test();
+  }
+  if (arc) {
+    srandom(seed);
+    return arc_bench(num_ops, delay_ns);
+  }
 }